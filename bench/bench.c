@@ -0,0 +1,103 @@
+#include "bench.h"
+
+#include <flecs.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static double _nowMs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e3 + ts.tv_nsec * 1e-6;
+}
+
+static int _compareDoubles(const void* a, const void* b)
+{
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+BenchSuite beginBenchSuite(const char* name, int argc, char** argv)
+{
+    BenchSuite suite = { .name = name, .repetitions = BENCH_REPETITIONS, .out = stdout };
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            const char* path = argv[++i];
+            suite.out = fopen(path, "w");
+            if (!suite.out) {
+                ecs_abort(1, "Cannot write [%s]", path);
+            }
+        } else if (strcmp(argv[i], "--repetitions") == 0 && i + 1 < argc) {
+            suite.repetitions = atoi(argv[++i]);
+        } else {
+            ecs_abort(1, "usage: %s [--json FILE] [--repetitions N]", argv[0]);
+        }
+    }
+    if (suite.repetitions < 1) {
+        ecs_abort(1, "Need at least one repetition");
+    }
+    fprintf(suite.out, "{\n  \"suite\": \"%s\",\n  \"repetitions\": %d,\n  \"cases\": [", name, suite.repetitions);
+    return suite;
+}
+
+void benchCase(BenchSuite* suite, const char* name, BenchFn setup, BenchFn run, BenchFn teardown, void* ctx,
+    double items)
+{
+    int n = suite->repetitions;
+    double* samples = malloc(sizeof(double) * n);
+    // The first run warms caches and allocators
+    for (int r = -1; r < n; ++r) {
+        if (setup) {
+            setup(ctx);
+        }
+        double begin = _nowMs();
+        run(ctx);
+        double elapsed = _nowMs() - begin;
+        if (teardown) {
+            teardown(ctx);
+        }
+        if (r >= 0) {
+            samples[r] = elapsed;
+        }
+    }
+    double mean = 0.0;
+    for (int r = 0; r < n; ++r) {
+        mean += samples[r] / n;
+    }
+    double variance = 0.0;
+    for (int r = 0; r < n; ++r) {
+        variance += (samples[r] - mean) * (samples[r] - mean) / (n > 1 ? n - 1 : 1);
+    }
+    // Samples stay in run order, so that drift over the runs shows
+    double* sorted = malloc(sizeof(double) * n);
+    memcpy(sorted, samples, sizeof(double) * n);
+    qsort(sorted, n, sizeof(double), _compareDoubles);
+    double median = n % 2 ? sorted[n / 2] : 0.5 * (sorted[n / 2 - 1] + sorted[n / 2]);
+
+    fprintf(suite->out, "%s\n    {\n", suite->nCases++ ? "," : "");
+    fprintf(suite->out, "      \"name\": \"%s\",\n      \"unit\": \"ms\",\n      \"items\": %.0f,\n", name, items);
+    fprintf(suite->out, "      \"min\": %.6f,\n      \"median\": %.6f,\n      \"mean\": %.6f,\n", sorted[0], median, mean);
+    fprintf(suite->out, "      \"stddev\": %.6f,\n      \"max\": %.6f,\n", sqrt(variance), sorted[n - 1]);
+    fprintf(suite->out, "      \"itemsPerSecond\": %.1f,\n      \"samples\": [", median > 0.0 ? items / median * 1e3 : 0.0);
+    for (int r = 0; r < n; ++r) {
+        fprintf(suite->out, "%s%.6f", r ? ", " : "", samples[r]);
+    }
+    fprintf(suite->out, "]\n    }");
+    fflush(suite->out);
+    // Readable progress next to the JSON
+    fprintf(stderr, "%s/%s: median %.3f ms, stddev %.3f ms over [%d] runs\n", suite->name, name, median,
+        sqrt(variance), n);
+    free(sorted);
+    free(samples);
+}
+
+void endBenchSuite(BenchSuite* suite)
+{
+    fprintf(suite->out, "\n  ]\n}\n");
+    if (suite->out != stdout) {
+        fclose(suite->out);
+    }
+    suite->out = NULL;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdio.h>
+
+/// @brief Timed runs of each case unless `--repetitions` says otherwise
+#define BENCH_REPETITIONS 10
+
+/// @brief Set up, run or tear down one repetition of a case
+typedef void (*BenchFn)(void* ctx);
+
+/// @brief Cases of one benchmark executable, written as one JSON document:
+/// `{"suite", "repetitions", "cases": [{"name", "unit", "items", "min",
+/// "median", "mean", "stddev", "max", "itemsPerSecond", "samples"}]}`,
+/// times in milliseconds
+typedef struct BenchSuite {
+    const char* name;
+    int repetitions;
+    FILE* out;
+    int nCases;
+} BenchSuite;
+
+/// @brief Start a suite from the command line: `--json FILE` writes the
+/// results there instead of stdout, `--repetitions N` sets the timed runs.
+/// Aborts on other arguments
+/// @param name Of the suite, not escaped
+/// @param argc
+/// @param argv
+/// @return The suite
+BenchSuite beginBenchSuite(const char* name, int argc, char** argv);
+
+/// @brief Time a case. It runs once untimed first, then `repetitions` times.
+/// Set up and tear down are not timed
+/// @param suite
+/// @param name Not escaped
+/// @param setup Before every run, or NULL
+/// @param run
+/// @param teardown After every run, or NULL
+/// @param ctx
+/// @param items Work done by one run, such as chunks spawned, for
+/// throughput
+void benchCase(BenchSuite* suite, const char* name, BenchFn setup, BenchFn run, BenchFn teardown, void* ctx,
+    double items);
+
+/// @brief Finish the JSON document and close its file
+/// @param suite
+void endBenchSuite(BenchSuite* suite);
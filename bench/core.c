@@ -0,0 +1,224 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "chunk.h"
+#include "engine.h"
+#include "lod.h"
+#include "nav/navgrid.h"
+#include "ocean.h"
+#include "player.h"
+#include "sector.h"
+
+#define N_SAMPLES (1 << 20)
+#define N_SHIPS 10000
+
+extern ECS_COMPONENT_DECLARE(Position);
+extern ECS_COMPONENT_DECLARE(Rotation);
+extern ECS_COMPONENT_DECLARE(AngularVelocity);
+extern ECS_COMPONENT_DECLARE(Acceleration);
+
+typedef struct {
+    ecs_world_t* ecs;
+    /// @brief Chunks of the sector, in spawn order
+    ecs_entity_t chunks[SECTOR_AREA];
+    ecs_query_t* query;
+    NavWorld nav;
+    int* xs;
+    int* ys;
+    /// @brief Keeps results alive
+    double sink;
+} _Ctx;
+
+/// @brief Islands and inlets, with about as much land as water
+static float _height(int x, int y)
+{
+    return sinf(x * 0.021f) * cosf(y * 0.017f) + 0.4f * sinf((x + y) * 0.09f) - 0.3f;
+}
+
+static void _fillChunk(TileHeights* tiles, ChunkCoord c)
+{
+    for (int i = 0; i < CHUNK_AREA; ++i) {
+        tiles->heights[i] = _height(c.x * CHUNK_SIZE + i % CHUNK_SIZE, c.y * CHUNK_SIZE + i / CHUNK_SIZE);
+    }
+}
+
+static ecs_world_t* _newWorld()
+{
+    ecs_world_t* ecs = ecs_init();
+    registerSector(ecs);
+    registerChunk(ecs);
+    return ecs;
+}
+
+////// Sector spawn
+
+static void _newEmptyWorld(void* ctx)
+{
+    ((_Ctx*)ctx)->ecs = _newWorld();
+}
+
+static void _spawnSector(void* ctx)
+{
+    spawnSector(((_Ctx*)ctx)->ecs, 0, 0, 0.0f, &spawnChunkDefault);
+}
+
+static void _finiWorld(void* ctx)
+{
+    ecs_fini(((_Ctx*)ctx)->ecs);
+}
+
+////// Chunk fill
+
+/// @brief Writes every chunk of the sector as an edit would, observers
+/// included
+static void _fillChunks(void* ctx)
+{
+    _Ctx* c = ctx;
+    for (int i = 0; i < SECTOR_AREA; ++i) {
+        TileHeights* tiles = ecs_get_mut(c->ecs, c->chunks[i], TileHeights);
+        _fillChunk(tiles, *ecs_get(c->ecs, c->chunks[i], ChunkCoord));
+        ecs_modified(c->ecs, c->chunks[i], TileHeights);
+    }
+}
+
+////// Query iteration
+
+static void _iterateChunks(void* ctx)
+{
+    _Ctx* c = ctx;
+    double sum = 0.0;
+    ecs_iter_t it = ecs_query_iter(c->ecs, c->query);
+    while (ecs_query_next(&it)) {
+        const TileHeights* tiles = ecs_field(&it, TileHeights, 1);
+        for (int i = 0; i < it.count; ++i) {
+            for (int t = 0; t < CHUNK_AREA; ++t) {
+                sum += tiles[i].heights[t];
+            }
+        }
+    }
+    c->sink += sum;
+}
+
+////// Ships
+
+static Hull _boxHull()
+{
+    // Samples on a grid under a 60 m x 12 m deck, 4 across
+    Hull hull = {
+        .nSamples = 8,
+        .mass = 1.5e6f,
+        .inertia = { 2.0e7f, 4.5e8f, 4.6e8f },
+        .sampleVolume = 1.5e6f / 1025.0f / 8 * 2.0f,
+        .sampleHeight = 6.0f,
+    };
+    for (int i = 0; i < hull.nSamples; ++i) {
+        hull.samples[i] = (Position) { .x = -30.0f + 60.0f * (i / 4), .y = -6.0f + 4.0f * (i % 4), .z = -2.0f };
+    }
+    return hull;
+}
+
+/// @brief A fleet spread over a sector, watched from one corner
+static ecs_world_t* _newFleetWorld()
+{
+    ecs_world_t* ecs = ecs_init();
+    registerEngine(ecs, NULL);
+    spatial_register(ecs);
+    player_register(ecs);
+    registerLod(ecs);
+    registerOcean(ecs);
+    ecs_measure_system_time(ecs, true);
+    Hull hull = _boxHull();
+    for (int i = 0; i < N_SHIPS; ++i) {
+        ecs_entity_t e = ecs_new_id(ecs);
+        ecs_set(ecs, e, Position, { .x = 100.0f * (i % 100), .y = 100.0f * (i / 100), .z = 0.0f });
+        ecs_set(ecs, e, Rotation, { .x = 0.0f, .y = 0.0f, .z = 0.38268f, .w = 0.92388f });
+        ecs_set_ptr(ecs, e, Hull, &hull);
+        ecs_set(ecs, e, Acceleration, { 0 });
+        ecs_set(ecs, e, AngularVelocity, { 0 });
+        ecs_set(ecs, e, UpdateRate, { 0 });
+    }
+    spectator_spawn(ecs, (Position) { 0.0f, 0.0f, 50.0f }, (Rotation) { 0.0f, 0.0f, 0.0f, 1.0f });
+    return ecs;
+}
+
+static void _progress(void* ctx)
+{
+    ecs_progress(((_Ctx*)ctx)->ecs, 1.0f / 60.0f);
+}
+
+////// Terrain sampling
+
+static void _sampleTerrain(void* ctx)
+{
+    _Ctx* c = ctx;
+    int open = 0;
+    for (int i = 0; i < N_SAMPLES; ++i) {
+        open += navIsNavigable(&c->nav, c->xs[i], c->ys[i]);
+    }
+    c->sink += open;
+}
+
+int main(int argc, char** argv)
+{
+    BenchSuite suite = beginBenchSuite("core", argc, argv);
+    _Ctx ctx = { 0 };
+    benchCase(&suite, "sectorSpawn", _newEmptyWorld, _spawnSector, _finiWorld, &ctx, SECTOR_AREA);
+
+    // One world for the rest, so that only the measured work differs
+    ctx.ecs = _newWorld();
+    for (int y = 0; y < SECTOR_SIZE; ++y) {
+        for (int x = 0; x < SECTOR_SIZE; ++x) {
+            ctx.chunks[y * SECTOR_SIZE + x] = spawnChunkDefault(ctx.ecs, x, y, 0.0f);
+        }
+    }
+    benchCase(&suite, "chunkFill", NULL, _fillChunks, NULL, &ctx, SECTOR_AREA);
+
+    ctx.query = ecs_query_init(ctx.ecs, &(ecs_query_desc_t) {
+        .filter.expr = "[in] ChunkCoord, [in] TileHeights",
+    });
+    benchCase(&suite, "queryIterate", NULL, _iterateChunks, NULL, &ctx, SECTOR_AREA);
+    ecs_query_fini(ctx.query);
+
+    TileHeights tiles;
+    for (int i = 0; i < SECTOR_AREA; ++i) {
+        ChunkCoord coord = { .x = i % SECTOR_SIZE, .y = i / SECTOR_SIZE };
+        _fillChunk(&tiles, coord);
+        navUpdateChunk(&ctx.nav, coord, &tiles);
+    }
+    navRebuildDirty(&ctx.nav);
+    // Scattered over the sector and a margin of unloaded tiles, the same
+    // points every run
+    ctx.xs = malloc(sizeof(int) * N_SAMPLES);
+    ctx.ys = malloc(sizeof(int) * N_SAMPLES);
+    uint32_t seed = 12345;
+    for (int i = 0; i < N_SAMPLES; ++i) {
+        seed = seed * 1664525u + 1013904223u;
+        ctx.xs[i] = (int)(seed >> 16) % (NAV_SECTOR_TILES + 64) - 32;
+        seed = seed * 1664525u + 1013904223u;
+        ctx.ys[i] = (int)(seed >> 16) % (NAV_SECTOR_TILES + 64) - 32;
+    }
+    benchCase(&suite, "terrainSample", NULL, _sampleTerrain, NULL, &ctx, N_SAMPLES);
+    free(ctx.xs);
+    free(ctx.ys);
+    cleanupNavWorld(&ctx.nav);
+    ecs_fini(ctx.ecs);
+
+    ctx.ecs = _newFleetWorld();
+    getSystemStats(ctx.ecs, NULL, 0);
+    benchCase(&suite, "fleetFrame", NULL, _progress, NULL, &ctx, N_SHIPS);
+    // Which system the frames went to, warm-up included
+    SystemStats systems[16];
+    int32_t n = getSystemStats(ctx.ecs, systems, 16);
+    for (int32_t i = 0; i < n && i < 16; ++i) {
+        fprintf(stderr, "  %-28s %8.3f ms/frame\n", systems[i].name, systems[i].ms / (suite.repetitions + 1));
+    }
+    cleanupUpdateScheduler(ecs_singleton_get_mut(ctx.ecs, UpdateScheduler));
+    ecs_fini(ctx.ecs);
+    cleanupEngine();
+
+    endBenchSuite(&suite);
+    fprintf(stderr, "checksum %f\n", ctx.sink);
+    return 0;
+}
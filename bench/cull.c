@@ -0,0 +1,215 @@
+#include <cglm/cglm.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "chunk.h"
+#include "sector.h"
+#include "vk/cull.h"
+#include "vk/vk.h"
+
+#define N_CHUNKS SECTOR_AREA
+#define N_REPEATS 50
+
+const char* PROJECT_NAME = "bench_cull";
+const char* ENGINE_NAME = "PotatoEngine";
+
+static double _now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/// @brief One sector of chunks with uneven heights
+static void _fillSector(ChunkBounds* bounds)
+{
+    srand(1);
+    for (int y = 0; y < SECTOR_SIZE; ++y) {
+        for (int x = 0; x < SECTOR_SIZE; ++x) {
+            float h = (float)(rand() % 40) - 10.0f;
+            float x0 = x * CHUNK_SIZE * TILE_SIZE, y0 = y * CHUNK_SIZE * TILE_SIZE;
+            bounds[y * SECTOR_SIZE + x] = (ChunkBounds) {
+                .min = { x0, y0, h - (float)(rand() % 8), 1.0f },
+                .max = { x0 + CHUNK_SIZE * TILE_SIZE, y0 + CHUNK_SIZE * TILE_SIZE, h + (float)(rand() % 8), h },
+            };
+        }
+    }
+}
+
+/// @brief The test of cull_chunks.comp
+/// @return LOD of the chunk, or -1 if culled
+static int _cullReference(const ChunkBounds* b, float planes[6][4], const float eye[3], const float lodDistances[3])
+{
+    float center[3], extent[3], nearest[3];
+    for (int i = 0; i < 3; ++i) {
+        center[i] = (b->min[i] + b->max[i]) * 0.5f;
+        extent[i] = (b->max[i] - b->min[i]) * 0.5f;
+        nearest[i] = glm_clamp(eye[i], b->min[i], b->max[i]);
+    }
+    for (int p = 0; p < 6; ++p) {
+        float d = planes[p][3];
+        for (int i = 0; i < 3; ++i) {
+            d += planes[p][i] * center[i] + fabsf(planes[p][i]) * extent[i];
+        }
+        if (d < 0.0f) {
+            return -1;
+        }
+    }
+    float d = glm_vec3_distance((float*)eye, nearest);
+    return (d >= lodDistances[0]) + (d >= lodDistances[1]) + (d >= lodDistances[2]);
+}
+
+static int _compareDraws(const void* a, const void* b)
+{
+    const VkDrawIndexedIndirectCommand* x = a;
+    const VkDrawIndexedIndirectCommand* y = b;
+    return (x->firstInstance > y->firstInstance) - (x->firstInstance < y->firstInstance);
+}
+
+static void _submitAndWait(const RenderDevice* device, Frame* frame)
+{
+    vkCheck(vkEndCommandBuffer(frame->cmd))
+    {
+        ecs_abort(1, "Failed to end command buffer");
+    }
+    VkSemaphore timeline = stagingTimeline(device->staging);
+    VkPipelineStageFlags stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    VkTimelineSemaphoreSubmitInfo timelineInfo = {
+        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+        .waitSemaphoreValueCount = 1,
+        .pWaitSemaphoreValues = &frame->stagingValue,
+    };
+    VkSubmitInfo si = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext = &timelineInfo,
+        .waitSemaphoreCount = frame->stagingValue ? 1 : 0,
+        .pWaitSemaphores = &timeline,
+        .pWaitDstStageMask = &stage,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &frame->cmd,
+    };
+    vkCheck(vkQueueSubmit(device->queue, 1, &si, frame->fence))
+    {
+        ecs_abort(1, "Failed to submit");
+    }
+    vkCheck(vkWaitForFences(device->handle, 1, &frame->fence, VK_TRUE, UINT64_MAX))
+    {
+        ecs_abort(1, "Failed to wait for fence");
+    }
+}
+
+static void _beginCommands(const RenderDevice* device, Frame* frame)
+{
+    vkResetFences(device->handle, 1, &frame->fence);
+    vkResetCommandPool(device->handle, frame->pool, 0);
+    resetLinearPool(&frame->transient);
+    VkCommandBufferBeginInfo bi = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    vkBeginCommandBuffer(frame->cmd, &bi);
+    frame->stagingValue = 0;
+    acquireFrameUploads(device->staging, frame);
+}
+
+int main()
+{
+    ecs_os_set_api_defaults();
+    VulkanSettings settings = { .device = { .index = -1, .headless = true } };
+    VulkanSystem system = newVulkanSystem(NULL, 0, &settings);
+    const RenderDevice* device = &system.renderDevice;
+    FrameManager frames = newFrameManager(device, 1);
+    Frame* frame = &frames.frames[0];
+    ChunkCuller culler = newChunkCuller(device, &frames);
+
+    static ChunkBounds bounds[N_CHUNKS];
+    _fillSector(bounds);
+    for (int i = 0; i < N_CHUNKS; ++i) {
+        setChunkBounds(&culler, allocChunkSlot(&culler), &bounds[i]);
+    }
+    // Low over one corner of the sector, looking across it
+    float side = SECTOR_SIZE * CHUNK_SIZE * TILE_SIZE;
+    vec3 eye = { -20.0f, -20.0f, 60.0f };
+    vec3 center = { side * 0.5f, side * 0.3f, 0.0f };
+    vec3 up = { 0.0f, 0.0f, 1.0f };
+    mat4 view, proj, viewProj;
+    glm_lookat(eye, center, up, view);
+    glm_perspective_rh_zo(glm_rad(60.0f), 16.0f / 9.0f, 0.5f, 800.0f, proj);
+    glm_mat4_mul(proj, view, viewProj);
+
+    // Draw list and count, copied out for checking
+    VkDeviceSize drawsSize = N_CHUNKS * sizeof(VkDrawIndexedIndirectCommand);
+    DeviceAllocation readbackMemory;
+    VkBuffer readback = newBuffer(device->allocator, drawsSize + sizeof(uint32_t),
+        VK_BUFFER_USAGE_TRANSFER_DST_BIT, MEMORY_USAGE_GPU_TO_CPU, &readbackMemory);
+
+    double gpuTime = 0;
+    for (int r = 0; r < N_REPEATS; ++r) {
+        _beginCommands(device, frame);
+        recordChunkCulling(&culler, frame, (const float*)viewProj, eye);
+        if (r == N_REPEATS - 1) {
+            VkMemoryBarrier toCopy = {
+                .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+                .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+            };
+            vkCmdPipelineBarrier(frame->cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                0, 1, &toCopy, 0, NULL, 0, NULL);
+            VkBufferCopy drawsCopy = { .size = drawsSize };
+            VkBufferCopy countCopy = { .dstOffset = drawsSize, .size = sizeof(uint32_t) };
+            vkCmdCopyBuffer(frame->cmd, culler.draws[0], readback, 1, &drawsCopy);
+            vkCmdCopyBuffer(frame->cmd, culler.counts[0], readback, 1, &countCopy);
+            VkMemoryBarrier toHost = {
+                .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+                .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+                .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+            };
+            vkCmdPipelineBarrier(frame->cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+                0, 1, &toHost, 0, NULL, 0, NULL);
+        }
+        double start = _now();
+        _submitAndWait(device, frame);
+        // The first submission also waits for the uploads
+        gpuTime += r > 0 ? _now() - start : 0;
+    }
+    gpuTime /= N_REPEATS - 1;
+
+    float planes[6][4];
+    int lods[N_CHUNKS];
+    int expected = 0;
+    double start = _now();
+    for (int r = 0; r < N_REPEATS; ++r) {
+        frustumPlanes((const float*)viewProj, planes);
+        expected = 0;
+        for (int i = 0; i < N_CHUNKS; ++i) {
+            lods[i] = _cullReference(&bounds[i], planes, eye, culler.lodDistances);
+            expected += lods[i] >= 0;
+        }
+    }
+    double cpuTime = (_now() - start) / N_REPEATS;
+
+    // Compare as sets, the order of the draw list depends on thread timing
+    invalidateDeviceAllocation(device->allocator, &readbackMemory, 0, drawsSize + sizeof(uint32_t));
+    VkDrawIndexedIndirectCommand* draws = readbackMemory.mapped;
+    uint32_t count = *(uint32_t*)((char*)readbackMemory.mapped + drawsSize);
+    qsort(draws, count, sizeof(*draws), _compareDraws);
+    int mismatches = count == (uint32_t)expected ? 0 : 1;
+    for (uint32_t d = 0; d < count && !mismatches; ++d) {
+        int lod = lods[draws[d].firstInstance];
+        mismatches += lod < 0 || draws[d].indexCount != culler.lodIndexCount[lod]
+            || draws[d].firstIndex != culler.lodFirstIndex[lod] || draws[d].instanceCount != 1;
+    }
+    printf("cull [%d] chunks: GPU %.3f ms per submission, CPU reference %.3f ms, [%u] drawn, CPU expects [%d]\n",
+        N_CHUNKS, gpuTime * 1e3, cpuTime * 1e3, count, expected);
+    if (mismatches) {
+        fprintf(stderr, "GPU culling differs from the CPU reference\n");
+    }
+
+    cleanupBuffer(device->allocator, readback, &readbackMemory);
+    cleanupChunkCuller(&culler);
+    cleanupFrameManager(&frames);
+    cleanupVulkanSystem(&system);
+    return mismatches ? 1 : 0;
+}
@@ -0,0 +1,182 @@
+#include <cglm/cglm.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "chunk.h"
+#include "engine.h"
+#include "graphics.h"
+#include "player.h"
+#include "sector.h"
+#include "spatial.h"
+#include "utils/arena.h"
+#include "utils/jobs.h"
+#include "utils/memtrack.h"
+#include "utils/startup.h"
+#include "vk/vk.h"
+
+#define WIDTH 1280
+#define HEIGHT 720
+#define N_WARMUP 10
+/// @brief Frames of one timed run
+#define N_FRAMES 20
+
+const char* PROJECT_NAME = "bench_frame";
+const char* ENGINE_NAME = "PotatoEngine";
+
+/// @brief Rolling hills, so that every LOD and skirt is drawn
+static ecs_entity_t _spawnHills(ecs_world_t* ecs, int x, int y, float h)
+{
+    ecs_entity_t e = spawnChunk(ecs, x, y, h);
+    TileHeights* tiles = ecs_emplace(ecs, e, TileHeights);
+    for (int ty = 0; ty < CHUNK_SIZE; ++ty) {
+        for (int tx = 0; tx < CHUNK_SIZE; ++tx) {
+            float wx = (x * CHUNK_SIZE + tx) * TILE_SIZE;
+            float wy = (y * CHUNK_SIZE + ty) * TILE_SIZE;
+            tiles->heights[ty * CHUNK_SIZE + tx] = h + 12.0f * sinf(wx * 0.02f) * cosf(wy * 0.03f);
+        }
+    }
+    ecs_modified(ecs, e, TileHeights);
+    return e;
+}
+
+static void _writePpm(const char* path, const uint8_t* rgba)
+{
+    FILE* f = fopen(path, "wb");
+    if (!f) {
+        fprintf(stderr, "Cannot write %s\n", path);
+        return;
+    }
+    fprintf(f, "P6\n%d %d\n255\n", WIDTH, HEIGHT);
+    for (int i = 0; i < WIDTH * HEIGHT; ++i) {
+        fwrite(&rgba[i * 4], 1, 3, f);
+    }
+    fclose(f);
+}
+
+static int _compareDoubles(const void* a, const void* b)
+{
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+typedef struct {
+    ecs_world_t* ecs;
+    ecs_entity_t graphics;
+    /// @brief Times reported by the frame manager, of every run
+    double* cpu;
+    double* gpu;
+    int nFrames;
+} _Ctx;
+
+static void _drawFrames(void* ctx)
+{
+    _Ctx* c = ctx;
+    for (int i = 0; i < N_FRAMES; ++i) {
+        ecs_progress(c->ecs, 0);
+        // Times of the frame that just began, GPU times of an earlier one
+        const FrameStats* stats = &ecs_get(c->ecs, c->graphics, FrameManager)->stats;
+        c->cpu[c->nFrames] = stats->cpuMs;
+        c->gpu[c->nFrames] = stats->gpuMs;
+        c->nFrames++;
+    }
+}
+
+/// @brief Draws a sector of terrain offscreen with the full renderer. With
+/// `--ppm FILE`, the last frame is written there as an image for comparison
+int main(int argc, char** argv)
+{
+    // The rest of the arguments are the suite's
+    const char* ppmPath = NULL;
+    char** suiteArgs = malloc(sizeof(char*) * argc);
+    int nSuiteArgs = 0;
+    for (int i = 0; i < argc; ++i) {
+        if (strcmp(argv[i], "--ppm") == 0 && i + 1 < argc) {
+            ppmPath = argv[++i];
+        } else {
+            suiteArgs[nSuiteArgs++] = argv[i];
+        }
+    }
+    BenchSuite suite = beginBenchSuite("frame", nSuiteArgs, suiteArgs);
+    free(suiteArgs);
+
+    trackEcsMemory();
+    ecs_world_t* ecs = ecs_init();
+    registerEngine(ecs, &(EngineSettings) { .reservedThreads = 3 });
+    registerJobs(ecs, 3);
+    registerSector(ecs);
+    registerChunk(ecs);
+    spatial_register(ecs);
+    player_register(ecs);
+    registerGraphics(ecs);
+    spawnSector(ecs, 0, 0, 4.0f, &_spawnHills);
+    // High over one corner of the sector, looking across it
+    versor yaw, pitch, rot;
+    glm_quatv(yaw, glm_rad(-45.0f), (vec3) { 0.0f, 0.0f, 1.0f });
+    glm_quatv(pitch, glm_rad(60.0f), (vec3) { 1.0f, 0.0f, 0.0f });
+    glm_quat_mul(yaw, pitch, rot);
+    spectator_spawn(ecs, (Position) { -40.0f, -40.0f, 120.0f }, (Rotation) { rot[0], rot[1], rot[2], rot[3] });
+
+    GraphicsSettings settings = {
+        .headless = true,
+        .width = WIDTH,
+        .height = HEIGHT,
+        .readback = ppmPath != NULL,
+        .profileGpu = true,
+    };
+    beginStartupTimeline();
+    ecs_entity_t graphics = createGraphicsSystem(ecs, &settings);
+    for (int i = 0; i < N_WARMUP; ++i) {
+        ecs_progress(ecs, 0);
+    }
+    fprintf(stderr, "graphics startup: first frame after %.2f ms\n", timeToFirstFrameMs());
+
+    // The untimed first run of the case is warmup too
+    int maxFrames = N_FRAMES * (suite.repetitions + 1);
+    _Ctx ctx = {
+        .ecs = ecs,
+        .graphics = graphics,
+        .cpu = malloc(sizeof(double) * maxFrames),
+        .gpu = malloc(sizeof(double) * maxFrames),
+    };
+    uint64_t heapBefore = heapAllocations();
+    char name[32];
+    snprintf(name, sizeof(name), "frame%dx%d", WIDTH, HEIGHT);
+    benchCase(&suite, name, NULL, _drawFrames, NULL, &ctx, N_FRAMES);
+    // Of the engine's allocators, flecs allocates on its own
+    uint64_t heapGrowth = heapAllocations() - heapBefore;
+    fprintf(stderr, "heap allocations in [%d] steady frames: %llu\n", ctx.nFrames, (unsigned long long)heapGrowth);
+    qsort(ctx.cpu, ctx.nFrames, sizeof(double), _compareDoubles);
+    qsort(ctx.gpu, ctx.nFrames, sizeof(double), _compareDoubles);
+    fprintf(stderr, "  CPU median %.3f ms p99 %.3f ms, GPU median %.3f ms p99 %.3f ms\n", ctx.cpu[ctx.nFrames / 2],
+        ctx.cpu[ctx.nFrames * 99 / 100], ctx.gpu[ctx.nFrames / 2], ctx.gpu[ctx.nFrames * 99 / 100]);
+    free(ctx.cpu);
+    free(ctx.gpu);
+    GpuPassStats passes[GPU_PROFILER_MAX_SCOPES];
+    uint32_t nPasses = getGpuPassStats(ecs_get(ecs, graphics, FrameManager)->profiler, passes, GPU_PROFILER_MAX_SCOPES);
+    for (uint32_t p = 0; p < nPasses && p < GPU_PROFILER_MAX_SCOPES; ++p) {
+        fprintf(stderr, "  pass [%s]: avg %.3f ms, p50 %.3f ms, p95 %.3f ms, p99 %.3f ms\n",
+            passes[p].name, passes[p].avgMs, passes[p].p50Ms, passes[p].p95Ms, passes[p].p99Ms);
+    }
+    for (MemTag t = 0; t < MEM_TAG_COUNT; ++t) {
+        MemStats m = memStats(t);
+        fprintf(stderr, "  memory [%s]: %.1f KiB, peak %.1f KiB, [%lld] allocations\n", memTagName(t),
+            m.bytes / 1024.0, m.peakBytes / 1024.0, (long long)m.count);
+    }
+
+    if (ppmPath) {
+        _writePpm(ppmPath, readGraphicsFrame(ecs, graphics));
+    }
+    cleanupGraphicsSystem(ecs, graphics);
+    ecs_fini(ecs);
+    cleanupEngine();
+    endBenchSuite(&suite);
+    // Steady frames are meant to reuse what warmup allocated
+    if (heapGrowth > 0) {
+        fprintf(stderr, "Steady frames allocated from the heap\n");
+        return 1;
+    }
+    return 0;
+}
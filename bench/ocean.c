@@ -0,0 +1,100 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "ocean.h"
+
+#define N_POINTS (1 << 20)
+#define N_SHIPS 10000
+
+typedef struct {
+    SeaState sea;
+    float* xs;
+    float* ys;
+    float* zs;
+    Hull hull;
+    Position* pos;
+    Acceleration* acc;
+    AngularVelocity* angVel;
+    /// @brief Keeps results alive
+    double sink;
+} _Ctx;
+
+static Hull _boxHull(int nSamples)
+{
+    // Samples on a grid under a 60 m x 12 m deck, 4 across
+    Hull hull = {
+        .nSamples = nSamples,
+        .mass = 1.5e6f,
+        .inertia = { 2.0e7f, 4.5e8f, 4.6e8f },
+        .sampleVolume = 1.5e6f / 1025.0f / nSamples * 2.0f,
+        .sampleHeight = 6.0f,
+    };
+    int rows = nSamples / 4;
+    for (int i = 0; i < nSamples; ++i) {
+        hull.samples[i] = (Position) {
+            .x = -30.0f + 60.0f * (i / 4) / (rows - 1),
+            .y = -6.0f + 4.0f * (i % 4),
+            .z = -2.0f,
+        };
+    }
+    return hull;
+}
+
+////// Surface
+
+static void _sampleSurface(void* ctx)
+{
+    _Ctx* c = ctx;
+    sampleSeaSurface(&c->sea, c->xs, c->ys, c->zs, N_POINTS);
+    c->sink += c->zs[N_POINTS / 2];
+}
+
+////// Ships
+
+static void _applyBuoyancy(void* ctx)
+{
+    _Ctx* c = ctx;
+    Rotation rot = { .x = 0.0f, .y = 0.0f, .z = 0.38268f, .w = 0.92388f };
+    for (int i = 0; i < N_SHIPS; ++i) {
+        applyHullBuoyancy(&c->sea, &c->hull, c->pos[i], rot, &c->acc[i], &c->angVel[i], 1.0f / 60.0f);
+    }
+    c->sink += c->acc[N_SHIPS / 2].z;
+}
+
+int main(int argc, char** argv)
+{
+    BenchSuite suite = beginBenchSuite("ocean", argc, argv);
+    _Ctx ctx = { .sea = newSeaStateDefault() };
+    updateSeaState(&ctx.sea, 12.5);
+
+    ctx.xs = malloc(sizeof(float) * N_POINTS);
+    ctx.ys = malloc(sizeof(float) * N_POINTS);
+    ctx.zs = malloc(sizeof(float) * N_POINTS);
+    for (int i = 0; i < N_POINTS; ++i) {
+        ctx.xs[i] = (float)(i % 1024);
+        ctx.ys[i] = (float)(i / 1024);
+    }
+    benchCase(&suite, "surfaceSample", NULL, _sampleSurface, NULL, &ctx, N_POINTS);
+    free(ctx.xs);
+    free(ctx.ys);
+    free(ctx.zs);
+
+    ctx.pos = malloc(sizeof(Position) * N_SHIPS);
+    ctx.acc = calloc(N_SHIPS, sizeof(Acceleration));
+    ctx.angVel = calloc(N_SHIPS, sizeof(AngularVelocity));
+    for (int i = 0; i < N_SHIPS; ++i) {
+        ctx.pos[i] = (Position) { .x = 37.0f * (i % 100), .y = 53.0f * (i / 100), .z = 0.0f };
+    }
+    ctx.hull = _boxHull(8);
+    benchCase(&suite, "shipBuoyancy8Samples", NULL, _applyBuoyancy, NULL, &ctx, N_SHIPS);
+    ctx.hull = _boxHull(32);
+    benchCase(&suite, "shipBuoyancy32Samples", NULL, _applyBuoyancy, NULL, &ctx, N_SHIPS);
+    free(ctx.pos);
+    free(ctx.acc);
+    free(ctx.angVel);
+
+    endBenchSuite(&suite);
+    fprintf(stderr, "checksum %f\n", ctx.sink);
+    return 0;
+}
@@ -0,0 +1,126 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "vk/vk.h"
+
+#define N_VARIANTS 16
+
+const char* PROJECT_NAME = "bench_pipeline_cache";
+const char* ENGINE_NAME = "PotatoEngine";
+
+static double _now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint32_t* _readSpirv(const char* path, size_t* size)
+{
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        ecs_abort(1, "Failed to open [%s]", path);
+    }
+    fseek(f, 0, SEEK_END);
+    *size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint32_t* code = malloc(*size);
+    if (fread(code, 1, *size, f) != *size) {
+        ecs_abort(1, "Failed to read [%s]", path);
+    }
+    fclose(f);
+    return code;
+}
+
+/// @brief Create every variant of the shader through the device cache
+/// @return Seconds taken
+static double _createPipelines(const RenderDevice* device, const uint32_t* code, size_t size)
+{
+    VkDescriptorSetLayoutBinding binding = {
+        .binding = 0,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .descriptorCount = 1,
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+    };
+    VkDescriptorSetLayoutCreateInfo setCI = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = 1,
+        .pBindings = &binding,
+    };
+    VkDescriptorSetLayout setLayout;
+    vkCheck(vkCreateDescriptorSetLayout(device->handle, &setCI, hostAllocationCallbacks(), &setLayout))
+    {
+        ecs_abort(1, "Failed to create descriptor set layout");
+    }
+    VkPipelineLayoutCreateInfo layoutCI = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = &setLayout,
+    };
+    VkPipelineLayout layout;
+    vkCheck(vkCreatePipelineLayout(device->handle, &layoutCI, hostAllocationCallbacks(), &layout))
+    {
+        ecs_abort(1, "Failed to create pipeline layout");
+    }
+
+    double start = _now();
+    VkShaderModule module = newShaderModule(device, code, size);
+    VkPipeline pipelines[N_VARIANTS];
+    for (uint32_t i = 0; i < N_VARIANTS; ++i) {
+        VkSpecializationMapEntry entry = { .constantID = 0, .offset = 0, .size = sizeof(uint32_t) };
+        VkSpecializationInfo spec = {
+            .mapEntryCount = 1,
+            .pMapEntries = &entry,
+            .dataSize = sizeof(uint32_t),
+            .pData = &i,
+        };
+        VkComputePipelineCreateInfo ci = {
+            .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+            .stage = {
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+                .module = module,
+                .pName = "main",
+                .pSpecializationInfo = &spec,
+            },
+            .layout = layout,
+        };
+        pipelines[i] = newComputePipeline(device, &ci);
+    }
+    double elapsed = _now() - start;
+
+    for (int i = 0; i < N_VARIANTS; ++i) {
+        vkDestroyPipeline(device->handle, pipelines[i], hostAllocationCallbacks());
+    }
+    vkDestroyShaderModule(device->handle, module, hostAllocationCallbacks());
+    vkDestroyPipelineLayout(device->handle, layout, hostAllocationCallbacks());
+    vkDestroyDescriptorSetLayout(device->handle, setLayout, hostAllocationCallbacks());
+    return elapsed;
+}
+
+/// @brief Start Vulkan, create all pipelines and shut down, saving the cache
+static double _run(const char* cachePath, const uint32_t* code, size_t size)
+{
+    VulkanSettings settings = { .pipelineCachePath = cachePath, .device = { .index = -1, .headless = true } };
+    VulkanSystem system = newVulkanSystem(NULL, 0, &settings);
+    double elapsed = _createPipelines(&system.renderDevice, code, size);
+    cleanupVulkanSystem(&system);
+    return elapsed;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s SHADER.spv CACHE_FILE\n", argv[0]);
+        return 1;
+    }
+    size_t size;
+    uint32_t* code = _readSpirv(argv[1], &size);
+    remove(argv[2]);
+    double cold = _run(argv[2], code, size);
+    double warm = _run(argv[2], code, size);
+    printf("pipelines [%d]: cold %.2f ms, warm %.2f ms\n", N_VARIANTS, cold * 1e3, warm * 1e3);
+    free(code);
+    return 0;
+}
@@ -0,0 +1,339 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "utils/jobs.h"
+#include "vk/recorder.h"
+#include "vk/vk.h"
+
+#define N_DRAWS 10000
+#define N_MATERIALS 16
+#define N_REPEATS 20
+#define MAX_THREADS 16
+#define TARGET_SIZE 256
+#define TARGET_FORMAT VK_FORMAT_R8G8B8A8_UNORM
+
+const char* PROJECT_NAME = "bench_record";
+const char* ENGINE_NAME = "PotatoEngine";
+
+typedef struct {
+    uint32_t material;
+    float offset[2];
+    float scale;
+} Draw;
+
+typedef struct {
+    const Draw* draws;
+    VkPipeline pipelines[N_MATERIALS];
+    VkPipelineLayout layout;
+} Scene;
+
+static double _now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static uint32_t* _readSpirv(const char* path, size_t* size)
+{
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        ecs_abort(1, "Failed to open [%s]", path);
+    }
+    fseek(f, 0, SEEK_END);
+    *size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint32_t* code = malloc(*size);
+    if (fread(code, 1, *size, f) != *size) {
+        ecs_abort(1, "Failed to read [%s]", path);
+    }
+    fclose(f);
+    return code;
+}
+
+static VkShaderModule _loadShader(const RenderDevice* device, const char* path)
+{
+    size_t size;
+    uint32_t* code = _readSpirv(path, &size);
+    VkShaderModule module = newShaderModule(device, code, size);
+    free(code);
+    return module;
+}
+
+/// @brief One pipeline per material, differing in a specialization constant
+static void _newPipelines(const RenderDevice* device, Scene* scene, VkShaderModule vert, VkShaderModule frag)
+{
+    VkPushConstantRange push = { .stageFlags = VK_SHADER_STAGE_VERTEX_BIT, .size = 16 };
+    VkPipelineLayoutCreateInfo layoutCI = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &push,
+    };
+    vkCheck(vkCreatePipelineLayout(device->handle, &layoutCI, hostAllocationCallbacks(), &scene->layout))
+    {
+        ecs_abort(1, "Failed to create pipeline layout");
+    }
+    VkPipelineVertexInputStateCreateInfo vertexInput = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+    };
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+        .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+    };
+    VkPipelineViewportStateCreateInfo viewport = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+        .viewportCount = 1,
+        .scissorCount = 1,
+    };
+    VkPipelineRasterizationStateCreateInfo raster = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+        .polygonMode = VK_POLYGON_MODE_FILL,
+        .cullMode = VK_CULL_MODE_NONE,
+        .lineWidth = 1.0f,
+    };
+    VkPipelineMultisampleStateCreateInfo multisample = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+        .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+    };
+    VkPipelineColorBlendAttachmentState blendAttachment = { .colorWriteMask = 0xf };
+    VkPipelineColorBlendStateCreateInfo blend = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+        .attachmentCount = 1,
+        .pAttachments = &blendAttachment,
+    };
+    VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+    VkPipelineDynamicStateCreateInfo dynamic = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+        .dynamicStateCount = 2,
+        .pDynamicStates = dynamicStates,
+    };
+    VkFormat format = TARGET_FORMAT;
+    VkPipelineRenderingCreateInfo rendering = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO,
+        .colorAttachmentCount = 1,
+        .pColorAttachmentFormats = &format,
+    };
+    for (uint32_t m = 0; m < N_MATERIALS; ++m) {
+        VkSpecializationMapEntry entry = { .constantID = 0, .offset = 0, .size = sizeof(uint32_t) };
+        VkSpecializationInfo spec = {
+            .mapEntryCount = 1,
+            .pMapEntries = &entry,
+            .dataSize = sizeof(uint32_t),
+            .pData = &m,
+        };
+        VkPipelineShaderStageCreateInfo stages[] = {
+            {
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                .stage = VK_SHADER_STAGE_VERTEX_BIT,
+                .module = vert,
+                .pName = "main",
+            },
+            {
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+                .module = frag,
+                .pName = "main",
+                .pSpecializationInfo = &spec,
+            },
+        };
+        VkGraphicsPipelineCreateInfo ci = {
+            .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+            .pNext = &rendering,
+            .stageCount = 2,
+            .pStages = stages,
+            .pVertexInputState = &vertexInput,
+            .pInputAssemblyState = &inputAssembly,
+            .pViewportState = &viewport,
+            .pRasterizationState = &raster,
+            .pMultisampleState = &multisample,
+            .pColorBlendState = &blend,
+            .pDynamicState = &dynamic,
+            .layout = scene->layout,
+        };
+        scene->pipelines[m] = newGraphicsPipeline(device, &ci);
+    }
+}
+
+static void _recordDraws(void* ctx, VkCommandBuffer cmd, int begin, int end)
+{
+    const Scene* scene = ctx;
+    VkViewport viewport = { .width = TARGET_SIZE, .height = TARGET_SIZE, .maxDepth = 1.0f };
+    VkRect2D scissor = { .extent = { TARGET_SIZE, TARGET_SIZE } };
+    vkCmdSetViewport(cmd, 0, 1, &viewport);
+    vkCmdSetScissor(cmd, 0, 1, &scissor);
+    uint32_t bound = UINT32_MAX;
+    for (int i = begin; i < end; ++i) {
+        const Draw* draw = &scene->draws[i];
+        if (draw->material != bound) {
+            bound = draw->material;
+            vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, scene->pipelines[bound]);
+        }
+        vkCmdPushConstants(cmd, scene->layout, VK_SHADER_STAGE_VERTEX_BIT, 0, 12, draw->offset);
+        vkCmdDraw(cmd, 3, 1, 0, 0);
+    }
+}
+
+/// @brief Record the whole draw list `N_REPEATS` times with `nThreads`
+/// threads recording, submitting each recording so the buffers are valid
+/// @return Median seconds of recording
+static double _benchThreads(const RenderDevice* device, Scene* scene, VkImage image, VkImageView target, int nThreads)
+{
+    JobPool* jobs = newJobPool(nThreads - 1);
+    CommandRecorder recorder = newCommandRecorder(device, jobs, 1);
+    FrameManager frames = newFrameManager(device, 1);
+    Frame* frame = &frames.frames[0];
+    VkFormat format = TARGET_FORMAT;
+    VkCommandBufferInheritanceRenderingInfo inheritance = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO,
+        .colorAttachmentCount = 1,
+        .pColorAttachmentFormats = &format,
+        .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+    };
+    VkRenderingAttachmentInfo color = {
+        .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+        .imageView = target,
+        .imageLayout = VK_IMAGE_LAYOUT_GENERAL,
+        .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+        .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+    };
+    VkRenderingInfo rendering = {
+        .sType = VK_STRUCTURE_TYPE_RENDERING_INFO,
+        .flags = VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT,
+        .renderArea = { .extent = { TARGET_SIZE, TARGET_SIZE } },
+        .layerCount = 1,
+        .colorAttachmentCount = 1,
+        .pColorAttachments = &color,
+    };
+    double times[N_REPEATS];
+    for (int r = 0; r < N_REPEATS; ++r) {
+        vkCheck(vkWaitForFences(device->handle, 1, &frame->fence, VK_TRUE, UINT64_MAX))
+        {
+            ecs_abort(1, "Failed to wait for fence");
+        }
+        vkResetFences(device->handle, 1, &frame->fence);
+        vkResetCommandPool(device->handle, frame->pool, 0);
+        resetCommandRecorder(&recorder, 0);
+        VkCommandBufferBeginInfo bi = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+            .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        };
+        vkBeginCommandBuffer(frame->cmd, &bi);
+        VkImageMemoryBarrier toTarget = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+            .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            .newLayout = VK_IMAGE_LAYOUT_GENERAL,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = image,
+            .subresourceRange = { .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .levelCount = 1, .layerCount = 1 },
+        };
+        vkCmdPipelineBarrier(frame->cmd, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, 0, NULL, 0, NULL, 1, &toTarget);
+        vkCmdBeginRendering(frame->cmd, &rendering);
+        double start = _now();
+        recordParallel(&recorder, 0, frame->cmd, &inheritance, N_DRAWS, _recordDraws, scene);
+        times[r] = _now() - start;
+        vkCmdEndRendering(frame->cmd);
+        vkEndCommandBuffer(frame->cmd);
+        VkSubmitInfo si = {
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .commandBufferCount = 1,
+            .pCommandBuffers = &frame->cmd,
+        };
+        vkCheck(vkQueueSubmit(device->queue, 1, &si, frame->fence))
+        {
+            ecs_abort(1, "Failed to submit");
+        }
+    }
+    vkWaitForFences(device->handle, 1, &frame->fence, VK_TRUE, UINT64_MAX);
+    cleanupFrameManager(&frames);
+    cleanupCommandRecorder(&recorder);
+    cleanupJobPool(jobs);
+    // Insertion sort for the median
+    for (int i = 1; i < N_REPEATS; ++i) {
+        for (int j = i; j > 0 && times[j] < times[j - 1]; --j) {
+            double t = times[j];
+            times[j] = times[j - 1];
+            times[j - 1] = t;
+        }
+    }
+    return times[N_REPEATS / 2];
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s VERT.spv FRAG.spv\n", argv[0]);
+        return 1;
+    }
+    ecs_os_set_api_defaults();
+    VulkanSettings settings = { .device = { .index = -1, .headless = true } };
+    VulkanSystem system = newVulkanSystem(NULL, 0, &settings);
+    const RenderDevice* device = &system.renderDevice;
+
+    Scene scene = { 0 };
+    VkShaderModule vert = _loadShader(device, argv[1]);
+    VkShaderModule frag = _loadShader(device, argv[2]);
+    _newPipelines(device, &scene, vert, frag);
+    // Sorted by material, as the renderer sorts its draw list
+    Draw* draws = malloc(sizeof(Draw) * N_DRAWS);
+    srand(1);
+    for (int i = 0; i < N_DRAWS; ++i) {
+        draws[i] = (Draw) {
+            .material = (uint32_t)((int64_t)i * N_MATERIALS / N_DRAWS),
+            .offset = { rand() / (float)RAND_MAX * 2 - 1, rand() / (float)RAND_MAX * 2 - 1 },
+            .scale = 0.01f,
+        };
+    }
+    scene.draws = draws;
+
+    VkImageCreateInfo imageCI = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = TARGET_FORMAT,
+        .extent = { TARGET_SIZE, TARGET_SIZE, 1 },
+        .mipLevels = 1,
+        .arrayLayers = 1,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+    };
+    DeviceAllocation targetMemory;
+    VkImage targetImage = newImage(device->allocator, &imageCI, MEMORY_USAGE_GPU_ONLY, &targetMemory);
+    VkImageViewCreateInfo viewCI = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .image = targetImage,
+        .viewType = VK_IMAGE_VIEW_TYPE_2D,
+        .format = TARGET_FORMAT,
+        .subresourceRange = { .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .levelCount = 1, .layerCount = 1 },
+    };
+    VkImageView target;
+    vkCheck(vkCreateImageView(device->handle, &viewCI, hostAllocationCallbacks(), &target))
+    {
+        ecs_abort(1, "Failed to create image view");
+    }
+
+    int maxThreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    maxThreads = maxThreads < 1 ? 1 : maxThreads > MAX_THREADS ? MAX_THREADS : maxThreads;
+    double single = 0;
+    for (int t = 1; t <= maxThreads; ++t) {
+        double seconds = _benchThreads(device, &scene, targetImage, target, t);
+        single = t == 1 ? seconds : single;
+        printf("record [%d] draws, [%d] threads: %.3f ms, speedup %.2fx\n", N_DRAWS, t, seconds * 1e3, single / seconds);
+    }
+
+    vkDestroyImageView(device->handle, target, hostAllocationCallbacks());
+    cleanupImage(device->allocator, targetImage, &targetMemory);
+    for (int m = 0; m < N_MATERIALS; ++m) {
+        vkDestroyPipeline(device->handle, scene.pipelines[m], hostAllocationCallbacks());
+    }
+    vkDestroyPipelineLayout(device->handle, scene.layout, hostAllocationCallbacks());
+    vkDestroyShaderModule(device->handle, vert, hostAllocationCallbacks());
+    vkDestroyShaderModule(device->handle, frag, hostAllocationCallbacks());
+    free(draws);
+    cleanupVulkanSystem(&system);
+    return 0;
+}
\ No newline at end of file
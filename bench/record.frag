@@ -0,0 +1,11 @@
+#version 450
+
+// Each material is a pipeline specialized with its own colour
+layout(constant_id = 0) const uint MATERIAL = 0;
+
+layout(location = 0) out vec4 color;
+
+void main()
+{
+    color = vec4(float(MATERIAL % 4u) / 3.0, float(MATERIAL / 4u % 4u) / 3.0, 0.5, 1);
+}
@@ -0,0 +1,15 @@
+#version 450
+
+// One small triangle per draw, placed by push constants so that every draw
+// records state of its own
+
+layout(push_constant) uniform Draw {
+    vec2 offset;
+    float scale;
+};
+
+void main()
+{
+    vec2 corners[3] = vec2[](vec2(0, -1), vec2(1, 1), vec2(-1, 1));
+    gl_Position = vec4(offset + corners[gl_VertexIndex] * scale, 0, 1);
+}
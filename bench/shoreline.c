@@ -0,0 +1,88 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bench.h"
+#include "nav/navgrid.h"
+#include "shoreline.h"
+
+typedef struct {
+    NavWorld nav;
+    JobPool* pool;
+    /// @brief Distances of the last rect computed
+    int8_t* out;
+    /// @brief Keeps results alive
+    double sink;
+} _Ctx;
+
+/// @brief One sector of islands and inlets
+static void _fillSector(NavWorld* nav)
+{
+    TileHeights tiles;
+    for (int cy = 0; cy < SECTOR_SIZE; ++cy) {
+        for (int cx = 0; cx < SECTOR_SIZE; ++cx) {
+            for (int i = 0; i < CHUNK_AREA; ++i) {
+                float x = (float)(cx * CHUNK_SIZE + i % CHUNK_SIZE);
+                float y = (float)(cy * CHUNK_SIZE + i / CHUNK_SIZE);
+                tiles.heights[i] = sinf(x * 0.021f) * cosf(y * 0.017f) + 0.4f * sinf((x + y) * 0.09f) - 0.3f;
+            }
+            navUpdateChunk(nav, (ChunkCoord) { .x = cx, .y = cy }, &tiles);
+        }
+    }
+    navRebuildDirty(nav);
+}
+
+////// Sector
+
+static void _computeSector(void* ctx)
+{
+    _Ctx* c = ctx;
+    ShoreRect rect = { .x0 = 0, .y0 = 0, .x1 = NAV_SECTOR_TILES, .y1 = NAV_SECTOR_TILES };
+    shoreComputeRect(&c->nav, c->pool, rect, c->out);
+    c->sink += c->out[NAV_SECTOR_TILES * NAV_SECTOR_TILES / 2 + 7];
+}
+
+////// Chunk edit
+
+/// @brief What a single chunk edit recomputes, rounded out to whole chunks
+static ShoreRect _editRect()
+{
+    int pad = ((int)SHORE_MAX_DISTANCE + 2 + CHUNK_SIZE - 1) / CHUNK_SIZE * CHUNK_SIZE;
+    return (ShoreRect) { .x0 = 512 - pad, .y0 = 512 - pad, .x1 = 512 + CHUNK_SIZE + pad, .y1 = 512 + CHUNK_SIZE + pad };
+}
+
+static void _computeChunkEdit(void* ctx)
+{
+    _Ctx* c = ctx;
+    shoreComputeRect(&c->nav, c->pool, _editRect(), c->out);
+    c->sink += c->out[0];
+}
+
+int main(int argc, char** argv)
+{
+    ecs_os_set_api_defaults();
+    BenchSuite suite = beginBenchSuite("shoreline", argc, argv);
+    _Ctx ctx = { 0 };
+    _fillSector(&ctx.nav);
+    ctx.out = malloc((size_t)NAV_SECTOR_TILES * NAV_SECTOR_TILES);
+    const int threads[] = { 0, 1, 3, 7 };
+    for (int i = 0; i < 4; ++i) {
+        char name[32];
+        snprintf(name, sizeof(name), "sector%dThreads", threads[i]);
+        ctx.pool = newJobPool(threads[i]);
+        benchCase(&suite, name, NULL, _computeSector, NULL, &ctx, (double)NAV_SECTOR_TILES * NAV_SECTOR_TILES);
+        cleanupJobPool(ctx.pool);
+    }
+
+    ctx.pool = newJobPool(0);
+    ShoreRect rect = _editRect();
+    benchCase(&suite, "chunkEdit", NULL, _computeChunkEdit, NULL, &ctx,
+        (double)(rect.x1 - rect.x0) * (rect.y1 - rect.y0));
+    cleanupJobPool(ctx.pool);
+    free(ctx.out);
+    cleanupNavWorld(&ctx.nav);
+
+    endBenchSuite(&suite);
+    fprintf(stderr, "checksum %f\n", ctx.sink);
+    return 0;
+}
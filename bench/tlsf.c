@@ -0,0 +1,96 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "vk/tlsf.h"
+
+#define RANGE_SIZE (64ull << 20)
+#define N_LIVE 512
+#define N_OPS 100000
+/// @brief Full validation walks every block, so only every this many ops
+#define VALIDATE_PERIOD 61
+
+typedef struct {
+    TlsfBlock* block;
+    uint64_t offset;
+    uint64_t size;
+    uint64_t align;
+} _Live;
+
+/// @brief Sizes from a few bytes to a few MiB, odd ones included
+static uint64_t _randomSize()
+{
+    uint64_t size = 1ull << (rand() % 22);
+    return size + (uint64_t)rand() % size;
+}
+
+static int _fail(int op, const char* what)
+{
+    fprintf(stderr, "tlsf: %s after op [%d]\n", what, op);
+    return 1;
+}
+
+/// @brief Whether a live range overlaps any other
+static bool _overlaps(const _Live* live, int n, int i)
+{
+    for (int j = 0; j < n; ++j) {
+        if (j != i && live[j].block && live[i].offset < live[j].offset + live[j].size
+            && live[j].offset < live[i].offset + live[i].size) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int main()
+{
+    static _Live live[N_LIVE];
+    Tlsf* tlsf = newTlsf(RANGE_SIZE);
+    srand(7);
+    int nAllocs = 0, nFailed = 0;
+    for (int op = 0; op < N_OPS; ++op) {
+        int i = rand() % N_LIVE;
+        if (live[i].block) {
+            tlsfFree(tlsf, live[i].block);
+            live[i].block = NULL;
+        } else {
+            uint64_t size = _randomSize();
+            uint64_t align = (uint64_t)TLSF_GRANULARITY << (rand() % 9);
+            uint64_t offset;
+            TlsfBlock* block = tlsfAlloc(tlsf, size, align, &offset);
+            if (!block) {
+                nFailed++;
+                continue;
+            }
+            nAllocs++;
+            live[i] = (_Live) { .block = block, .offset = offset, .size = size, .align = align };
+            if (offset % align || offset + size > RANGE_SIZE) {
+                return _fail(op, "misaligned or out of range");
+            }
+            if (_overlaps(live, N_LIVE, i)) {
+                return _fail(op, "overlapping allocations");
+            }
+        }
+        if (op % VALIDATE_PERIOD == 0) {
+            const char* broken = tlsfValidate(tlsf);
+            if (broken) {
+                return _fail(op, broken);
+            }
+        }
+    }
+    for (int i = 0; i < N_LIVE; ++i) {
+        if (live[i].block) {
+            tlsfFree(tlsf, live[i].block);
+        }
+    }
+    const char* broken = tlsfValidate(tlsf);
+    if (broken) {
+        return _fail(N_OPS, broken);
+    }
+    // Everything merged back into one range
+    if (!tlsfIsEmpty(tlsf) || tlsfLargestFree(tlsf) != RANGE_SIZE) {
+        return _fail(N_OPS, "free ranges were not merged back");
+    }
+    printf("tlsf: [%d] allocations, [%d] did not fit, bookkeeping intact\n", nAllocs, nFailed);
+    cleanupTlsf(tlsf);
+    return 0;
+}
@@ -0,0 +1,99 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "vk/vk.h"
+
+#define N_LIVE 2048
+#define N_OPS 200000
+
+const char* PROJECT_NAME = "bench_vk_memory";
+const char* ENGINE_NAME = "PotatoEngine";
+
+static double _now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/// @brief Buffer sizes skewed towards small ones, like uniform and vertex
+/// buffers of chunks
+static VkDeviceSize _randomSize()
+{
+    return 256ull << (rand() % 12);
+}
+
+/// @brief Replace random live buffers through the allocator
+/// @return Seconds taken
+static double _churnAllocator(const RenderDevice* device)
+{
+    static DeviceAllocation live[N_LIVE];
+    VkMemoryRequirements reqs;
+    VkBuffer probe = newBuffer(device->allocator, 256, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        MEMORY_USAGE_GPU_ONLY, &live[0]);
+    vkGetBufferMemoryRequirements(device->handle, probe, &reqs);
+    cleanupBuffer(device->allocator, probe, &live[0]);
+
+    srand(1);
+    double start = _now();
+    for (int i = 0; i < N_OPS; ++i) {
+        DeviceAllocation* a = &live[rand() % N_LIVE];
+        deviceFree(device->allocator, a);
+        reqs.size = _randomSize();
+        if (!deviceAlloc(device->allocator, reqs, MEMORY_USAGE_GPU_ONLY, true, a)) {
+            ecs_abort(1, "Out of device memory");
+        }
+    }
+    double elapsed = _now() - start;
+    logDeviceAllocatorStats(device->allocator);
+    DeviceMemoryStats stats = deviceAllocatorStats(device->allocator, live[0].memoryType);
+    printf("allocator: [%u] blocks, [%llu] MiB held for [%llu] MiB live\n", stats.blockCount,
+        (unsigned long long)(stats.blockBytes >> 20), (unsigned long long)(stats.allocatedBytes >> 20));
+    for (int i = 0; i < N_LIVE; ++i) {
+        deviceFree(device->allocator, &live[i]);
+    }
+    return elapsed;
+}
+
+/// @brief Same pattern with one vkAllocateMemory per buffer
+/// @return Seconds taken
+static double _churnRaw(const RenderDevice* device)
+{
+    static VkDeviceMemory live[N_LIVE];
+    int type = findMemoryType(&device->phys->memProps, ~0u, MEMORY_USAGE_GPU_ONLY);
+    srand(1);
+    double start = _now();
+    for (int i = 0; i < N_OPS; ++i) {
+        VkDeviceMemory* m = &live[rand() % N_LIVE];
+        if (*m) {
+            vkFreeMemory(device->handle, *m, NULL);
+        }
+        VkMemoryAllocateInfo ai = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+            .allocationSize = _randomSize(),
+            .memoryTypeIndex = type,
+        };
+        vkCheck(vkAllocateMemory(device->handle, &ai, NULL, m))
+        {
+            ecs_abort(1, "Failed to allocate device memory");
+        }
+    }
+    double elapsed = _now() - start;
+    for (int i = 0; i < N_LIVE; ++i) {
+        vkFreeMemory(device->handle, live[i], NULL);
+    }
+    return elapsed;
+}
+
+int main()
+{
+    VulkanSettings settings = { .device = { .index = -1, .headless = true } };
+    VulkanSystem system = newVulkanSystem(NULL, 0, &settings);
+    double sub = _churnAllocator(&system.renderDevice);
+    double raw = _churnRaw(&system.renderDevice);
+    printf("[%d] frees and allocations of [%d] live: allocator %.2f ms, vkAllocateMemory %.2f ms\n",
+        N_OPS, N_LIVE, sub * 1e3, raw * 1e3);
+    cleanupVulkanSystem(&system);
+    return 0;
+}
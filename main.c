@@ -4,40 +4,139 @@ const char* ENGINE_NAME = "PotatoEngine";
 #include <flecs.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "chunk.h"
+#include "engine.h"
 #include "graphics.h"
+#include "lod.h"
+#include "nav/flowfield.h"
+#include "nav/navgrid.h"
+#include "ocean.h"
+#include "player.h"
 #include "sector.h"
+#include "shoreline.h"
+#include "spatial.h"
+#include "utils/arena.h"
+#include "utils/jobs.h"
+#include "utils/log.h"
+#include "utils/memtrack.h"
+#include "utils/startup.h"
+#include "utils/trace.h"
+
+/// @brief Worker threads for background jobs, next to the main thread
+#define GAME_WORKER_THREADS 3
+/// @brief Seconds between exports of system stats, when enabled
+#define GAME_STATS_INTERVAL 1.0f
 
 typedef struct {
     ecs_world_t* ecs;
+    ecs_entity_t graphics;
 } Game;
 
-void gameInit(Game* game)
+void gameInit(Game* game, const EngineSettings* engine)
 {
     game->ecs = ecs_init();
-    registerGraphics(game->ecs);
+    registerEngine(game->ecs, engine);
+    registerJobs(game->ecs, GAME_WORKER_THREADS);
     registerSector(game->ecs);
     registerChunk(game->ecs);
+    spatial_register(game->ecs);
+    player_register(game->ecs);
+    registerGraphics(game->ecs);
+    registerLod(game->ecs);
+    registerOcean(game->ecs);
+    registerNav(game->ecs);
+    registerFlowFields(game->ecs);
+    registerShoreline(game->ecs);
 }
 
 void cleanupGame(Game* game)
 {
+    if (game->graphics) {
+        cleanupGraphicsSystem(game->ecs, game->graphics);
+    }
+    // Singletons holding memory of their own, which flecs does not know about
+    cleanupUpdateScheduler(ecs_singleton_get_mut(game->ecs, UpdateScheduler));
+    cleanupShoreWorld(ecs_singleton_get_mut(game->ecs, ShoreWorld));
+    cleanupFlowFieldCache(ecs_singleton_get_mut(game->ecs, FlowFieldCache));
+    cleanupNavWorld(ecs_singleton_get_mut(game->ecs, NavWorld));
+    JobPool* jobs = ecs_singleton_get(game->ecs, Jobs)->pool;
     ecs_fini(game->ecs);
+    cleanupJobPool(jobs);
+    cleanupEngine();
 }
 
-int main()
+int main(int argc, char** argv)
 {
-    Game game;
-    gameInit(&game);
+    beginStartupTimeline();
+    // Draw offscreen where there is no display, e.g. on build machines
+    GraphicsSettings graphics = { 0 };
+    // Job workers get cores of their own
+    EngineSettings engine = { .reservedThreads = GAME_WORKER_THREADS };
+    const char* tracePath = NULL;
+    bool usage = false;
+    for (int i = 1; i < argc && !usage; ++i) {
+        if (strcmp(argv[i], "--headless") == 0) {
+            graphics.headless = true;
+        } else if (strcmp(argv[i], "--no-vsync") == 0) {
+            graphics.noVsync = true;
+        } else if (strcmp(argv[i], "--profile-gpu") == 0) {
+            graphics.profileGpu = true;
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            engine.threads = atoi(argv[++i]);
+            usage = engine.threads < 1;
+        } else if (strcmp(argv[i], "--stats") == 0 && i + 1 < argc) {
+            engine.statsPath = argv[++i];
+            engine.statsInterval = GAME_STATS_INTERVAL;
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            tracePath = argv[++i];
+        } else if (strcmp(argv[i], "--validation") == 0 && i + 1 < argc) {
+            graphics.validation = parseValidationLevel(argv[++i]);
+            usage = graphics.validation == VALIDATION_DEFAULT;
+        } else {
+            usage = true;
+        }
+    }
+    if (usage) {
+        fprintf(stderr, "usage: %s [--headless] [--no-vsync] [--profile-gpu] [--threads N] [--stats FILE.jsonl]"
+                        " [--trace FILE.json] [--validation off|errors|warnings|info|verbose]\n",
+            argv[0]);
+        return 1;
+    }
+    // From the start, to see what startup spends its time on
+    if (tracePath) {
+        TRACE_THREAD_NAME("main");
+        startTracing();
+    }
+
+    trackEcsMemory();
+    Game game = { 0 };
+    double worldBegin = startupNowMs();
+    gameInit(&game, &engine);
+    recordStartupSpan("world", worldBegin, startupNowMs());
+    // Spawning and frames only copy their log messages from here on
+    startAsyncLog();
 
     ecs_log_set_level(0);
 
-    createGraphicsSystem(game.ecs);
+    game.graphics = createGraphicsSystem(game.ecs, &graphics);
+    // One frame, to know how long until there is something to see
+    ecs_progress(game.ecs, 0);
+    logStartupTimeline();
     // spawnSector(game.ecs, 0, 0, 0, &spawnChunkDefault);
     // spawnSector(game.ecs, 0, 1, 0, &spawnChunk);
     // spawnSector(game.ecs, 1, 0, 0, NULL);
     // spawnSector(game.ecs, 1, 1, 0, NULL);
 
     cleanupGame(&game);
+    stopAsyncLog();
+    if (tracePath) {
+        writeTraceJson(tracePath);
+    }
+    // Workers are idle by now
+    cleanupTraceBuffers();
+    cleanupScratchArenas();
+    logMemStats();
+    logMemLeaks();
 }
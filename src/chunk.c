@@ -20,6 +20,7 @@ ecs_entity_t spawnChunkDefault(ecs_world_t* ecs, int x, int y, float h)
             tiles->heights[i * CHUNK_SIZE + j] = h;
         }
     }
+    ecs_modified(ecs, e, TileHeights);
     return e;
 }
 
@@ -10,6 +10,12 @@ extern ECS_COMPONENT_DECLARE(TileHeights);
 #define CHUNK_SIZE 16
 #define CHUNK_AREA (CHUNK_SIZE * CHUNK_SIZE)
 
+/// @brief Edge length of a tile in world units
+#define TILE_SIZE 1.0f
+
+/// @brief Height of the calm sea surface. Tiles below it are water
+#define SEA_LEVEL 0.0f
+
 /// @brief Chunk coordinates, which is tile coordinates divided by 16
 typedef struct {
     int x, y;
@@ -20,7 +26,8 @@ typedef struct {
     float h;
 } ChunkHeight;
 
-/// @brief All heights in a chunk
+/// @brief All heights in a chunk, row major as `heights[y * CHUNK_SIZE + x]`.
+/// Call `ecs_modified` after editing so that derived terrain data updates
 typedef struct {
     float heights[CHUNK_AREA];
 } TileHeights;
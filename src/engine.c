@@ -0,0 +1,147 @@
+#include "engine.h"
+
+#include <stdio.h>
+#include <unistd.h>
+#include <utils/log.h>
+#include <utils/trace.h>
+
+ECS_DECLARE(InputPhase);
+ECS_DECLARE(SimulatePhase);
+ECS_DECLARE(TerrainPhase);
+ECS_DECLARE(RenderPreparePhase);
+ECS_DECLARE(SubmitPhase);
+
+/// @brief Systems exported at most, the rest are left out
+#define ENGINE_MAX_EXPORTED_SYSTEMS 64
+
+/// @brief Stats of the one world running the engine. The flecs stats keep
+/// the previous totals, so that each export covers only its interval
+static ecs_pipeline_stats_t _pipelineStats;
+static ecs_world_stats_t _worldStats;
+static FILE* _statsFile;
+
+static ecs_entity_t _newPhase(ecs_world_t* ecs, const char* name, ecs_entity_t after)
+{
+    return ecs_entity(ecs, {
+        .name = name,
+        .add = { EcsPhase, ecs_dependson(after) },
+    });
+}
+
+int32_t getSystemStats(ecs_world_t* ecs, SystemStats* out, int32_t capacity)
+{
+    if (!ecs_pipeline_stats_get(ecs, ecs_get_pipeline(ecs), &_pipelineStats)) {
+        return 0;
+    }
+    int32_t n = 0;
+    const ecs_entity_t* systems = ecs_vec_first_t(&_pipelineStats.systems, ecs_entity_t);
+    for (int32_t i = 0; i < ecs_vec_count(&_pipelineStats.systems); ++i) {
+        // Zero marks where stages merge
+        if (!systems[i]) {
+            continue;
+        }
+        const ecs_system_stats_t* s = ecs_map_get_deref(&_pipelineStats.system_stats, ecs_system_stats_t, systems[i]);
+        if (!s) {
+            continue;
+        }
+        if (n < capacity) {
+            // Rates are what the totals grew by since the last call
+            int32_t t = s->query.t;
+            out[n] = (SystemStats) {
+                .system = systems[i],
+                .name = ecs_get_name(ecs, systems[i]),
+                .ms = s->time_spent.counter.rate.avg[t] * 1e3,
+                .calls = (int32_t)s->invoke_count.counter.rate.avg[t],
+            };
+        }
+        n++;
+    }
+    return n;
+}
+
+static void exportStatsSystem(ecs_iter_t* it)
+{
+    TRACE_ZONE(__func__);
+    SystemStats systems[ENGINE_MAX_EXPORTED_SYSTEMS];
+    int32_t n = getSystemStats(it->world, systems, ENGINE_MAX_EXPORTED_SYSTEMS);
+    n = n < ENGINE_MAX_EXPORTED_SYSTEMS ? n : ENGINE_MAX_EXPORTED_SYSTEMS;
+    ecs_world_stats_get(it->world, &_worldStats);
+    int32_t t = _worldStats.t;
+    double frames = _worldStats.frame.frame_count.counter.rate.avg[t];
+    double perFrame = frames > 0.0 ? 1.0 / frames : 0.0;
+    double frameMs = _worldStats.performance.frame_time.counter.rate.avg[t] * 1e3 * perFrame;
+    double entities = _worldStats.entities.count.gauge.avg[t];
+    if (!_statsFile) {
+        LOG_TRACE("[%.0f] frames of [%.2f] ms with [%.0f] entities", frames, frameMs, entities);
+        ecs_log_push();
+        for (int32_t i = 0; i < n; ++i) {
+            LOG_TRACE("%-28s %8.3f ms/frame in [%d] calls", systems[i].name, systems[i].ms * perFrame,
+                systems[i].calls);
+        }
+        ecs_log_pop();
+        return;
+    }
+    fprintf(_statsFile, "{\"time\": %.3f, \"frames\": %.0f, \"frameMs\": %.4f, \"entities\": %.0f, \"systems\": [",
+        ecs_get_world_info(it->world)->world_time_total, frames, frameMs, entities);
+    for (int32_t i = 0; i < n; ++i) {
+        fprintf(_statsFile, "%s{\"name\": \"%s\", \"msPerFrame\": %.4f, \"calls\": %d}", i ? ", " : "",
+            systems[i].name ? systems[i].name : "", systems[i].ms * perFrame, systems[i].calls);
+    }
+    fprintf(_statsFile, "]}\n");
+    fflush(_statsFile);
+}
+
+/// @brief One thread per core not reserved, at least the main thread
+static int32_t _defaultThreads(int32_t reserved)
+{
+    int32_t cores = (int32_t)sysconf(_SC_NPROCESSORS_ONLN);
+    return cores - reserved > 1 ? cores - reserved : 1;
+}
+
+void registerEngine(ecs_world_t* ecs, const EngineSettings* settings)
+{
+    EngineSettings s = settings ? *settings : (EngineSettings) { 0 };
+    s.threads = s.threads ? s.threads : _defaultThreads(s.reservedThreads);
+    ecs_trace("Registering engine pipeline with [%d] threads", s.threads);
+    ecs_log_push();
+    InputPhase = _newPhase(ecs, "InputPhase", EcsOnLoad);
+    SimulatePhase = _newPhase(ecs, "SimulatePhase", InputPhase);
+    TerrainPhase = _newPhase(ecs, "TerrainPhase", SimulatePhase);
+    RenderPreparePhase = _newPhase(ecs, "RenderPreparePhase", TerrainPhase);
+    SubmitPhase = _newPhase(ecs, "SubmitPhase", RenderPreparePhase);
+    if (s.threads > 1) {
+        ecs_set_threads(ecs, s.threads);
+    }
+    if (s.statsInterval > 0.0f) {
+        ecs_measure_system_time(ecs, true);
+        ecs_measure_frame_time(ecs, true);
+        if (s.statsPath) {
+            _statsFile = fopen(s.statsPath, "a");
+            if (!_statsFile) {
+                ecs_warn("Cannot write stats to [%s], tracing them instead", s.statsPath);
+            }
+        }
+        // First in the frame, so that exports cover whole frames
+        ecs_system(ecs, {
+            .entity = ecs_entity(ecs, {
+                .name = "exportStatsSystem",
+                .add = { ecs_dependson(InputPhase) },
+            }),
+            .callback = exportStatsSystem,
+            .interval = s.statsInterval,
+        });
+        ecs_trace("Exporting system stats every [%.1f] s", s.statsInterval);
+    }
+    ecs_log_pop();
+}
+
+void cleanupEngine()
+{
+    ecs_pipeline_stats_fini(&_pipelineStats);
+    _pipelineStats = (ecs_pipeline_stats_t) { 0 };
+    _worldStats = (ecs_world_stats_t) { 0 };
+    if (_statsFile) {
+        fclose(_statsFile);
+        _statsFile = NULL;
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <flecs.h>
+#include <stdint.h>
+
+// Phases of a frame, each after the one before. Systems go in these
+// instead of the flecs phases
+
+/// @brief Reads input and sets what players want to do
+extern ECS_DECLARE(InputPhase);
+/// @brief Moves ships and everything else that lives in the world
+extern ECS_DECLARE(SimulatePhase);
+/// @brief Keeps navigation and shorelines up to date with terrain edits
+extern ECS_DECLARE(TerrainPhase);
+/// @brief Gathers what the renderers need from the world
+extern ECS_DECLARE(RenderPreparePhase);
+/// @brief Records and submits the frame
+extern ECS_DECLARE(SubmitPhase);
+
+typedef struct EngineSettings {
+    /// @brief Threads running multi-threaded systems, the main thread
+    /// included. 0 for one per core not reserved, 1 runs everything on the
+    /// main thread
+    int32_t threads;
+    /// @brief Threads that keep cores busy outside the pipeline, such as
+    /// job workers. Only used when `threads` is 0
+    int32_t reservedThreads;
+    /// @brief Seconds between exports of per-system times, 0 for none
+    float statsInterval;
+    /// @brief File to append the exports to as JSON lines, or NULL to trace
+    /// them
+    const char* statsPath;
+} EngineSettings;
+
+/// @brief Time of one system between two calls of `getSystemStats`
+typedef struct SystemStats {
+    ecs_entity_t system;
+    const char* name;
+    double ms;
+    int32_t calls;
+} SystemStats;
+
+/// @brief Registers the phases and starts the worker threads. With stats
+/// enabled, measures the time of every system and exports it. Call before
+/// registering any system
+/// @param ecs
+/// @param settings May be NULL for defaults
+void registerEngine(ecs_world_t* ecs, const EngineSettings* settings);
+
+/// @brief Close the stats export and free the stats, once frames are done
+void cleanupEngine();
+
+/// @brief Time of every system since the previous call, in pipeline order.
+/// System time is measured only with stats enabled, or after
+/// `ecs_measure_system_time`. Not thread safe
+/// @param ecs
+/// @param out
+/// @param capacity
+/// @return Number of systems, which may exceed `capacity`
+int32_t getSystemStats(ecs_world_t* ecs, SystemStats* out, int32_t capacity);
@@ -2,60 +2,496 @@
 
 #include <SDL.h>
 #include <SDL_vulkan.h>
+#include <cglm/cglm.h>
+#include <stdio.h>
+#include <string.h>
 
+#include "engine.h"
+#include "player.h"
+#include "spatial.h"
+#include "terrain.h"
+#include "utils/arena.h"
+#include "utils/jobs.h"
+#include "utils/memtrack.h"
+#include "utils/startup.h"
+#include "utils/trace.h"
 #include "vk/vk.h"
 
+extern ECS_COMPONENT_DECLARE(Position);
+extern ECS_COMPONENT_DECLARE(Rotation);
+
 extern const char* PROJECT_NAME;
 
-typedef SDL_Window* SDLWindowPtr;
+/// @brief The SDL window and its drawable size, which its events keep up
+/// to date
+typedef struct {
+    SDL_Window* handle;
+    /// @brief In pixels, 0 while minimized
+    int width, height;
+    /// @brief Hidden until the first frame is presented
+    bool shown;
+} Window;
+
+/// @brief Name of the pipeline cache in the per-user data directory
+#define PIPELINE_CACHE_FILE "pipeline_cache.bin"
+/// @brief Environment variable overriding the choice of GPU
+#define DEVICE_ENV "RUSSETAIR_DEVICE"
+/// @brief Environment variables setting the validation level, unless set by
+/// the caller, and the message IDs to ignore
+#define VALIDATION_ENV "RUSSETAIR_VALIDATION"
+#define VALIDATION_IGNORE_ENV "RUSSETAIR_VALIDATION_IGNORE"
+/// @brief How long a frame waits for a swapchain image before skipping
+#define ACQUIRE_TIMEOUT_NS 100000000ull
+/// @brief Size of the window or offscreen image unless set
+#define DEFAULT_WIDTH 1280
+#define DEFAULT_HEIGHT 720
+/// @brief Swapchain images asked for unless set
+#define DEFAULT_SWAPCHAIN_IMAGES 3
 
 ECS_DECLARE(GraphicsSystem);
-ECS_COMPONENT_DECLARE(SDLWindowPtr);
+ECS_COMPONENT_DECLARE(Window);
+
+/// @brief Where the world is drawn from. A singleton that follows a spectator
+typedef struct {
+    vec3 eye;
+    versor rotation;
+    /// @brief Vertical field of view in radians
+    float fovY;
+    float zNear, zFar;
+} Camera;
+
+ECS_COMPONENT_DECLARE(Camera);
+
+/// @brief View and projection of the camera, looking down its local -z
+static void _cameraViewProj(Camera camera, VkExtent2D extent, mat4 viewProj)
+{
+    mat4 rotation, view, proj;
+    glm_quat_mat4(camera.rotation, rotation);
+    glm_translate_make(view, camera.eye);
+    glm_mat4_mul(view, rotation, view);
+    // Rigid, so the inverse is a transpose and a translation
+    glm_inv_tr(view);
+    glm_perspective_rh_zo(camera.fovY, (float)extent.width / (float)extent.height,
+        camera.zNear, camera.zFar, proj);
+    glm_mat4_mul(proj, view, viewProj);
+}
+
+static void followSpectatorSystem(ecs_iter_t* it)
+{
+    TRACE_ZONE(__func__);
+    const Position* p = ecs_field(it, Position, 1);
+    const Rotation* r = ecs_field(it, Rotation, 2);
+    Camera* camera = ecs_field(it, Camera, 3);
+    // Any spectator will do until there is a way to pick one
+    if (it->count > 0) {
+        glm_vec3_copy((vec3) { p[0].x, p[0].y, p[0].z }, camera->eye);
+        glm_quat_init(camera->rotation, r[0].x, r[0].y, r[0].z, r[0].w);
+    }
+}
+
+/// @brief Drain SDL events. Quitting ends the main loop, and size changes
+/// are picked up by the next frame
+static void pollWindowEventsSystem(ecs_iter_t* it)
+{
+    TRACE_ZONE(__func__);
+    Window* window = ecs_field(it, Window, 1);
+    SDL_Event event;
+    while (SDL_PollEvent(&event)) {
+        if (event.type == SDL_QUIT) {
+            ecs_quit(it->world);
+        }
+        if (event.type != SDL_WINDOWEVENT) {
+            continue;
+        }
+        // Minimizing does not change the window size on every platform
+        Uint8 what = event.window.event;
+        if (what != SDL_WINDOWEVENT_SIZE_CHANGED && what != SDL_WINDOWEVENT_MINIMIZED
+            && what != SDL_WINDOWEVENT_RESTORED) {
+            continue;
+        }
+        for (int i = 0; i < it->count; ++i) {
+            if (SDL_GetWindowID(window[i].handle) != event.window.windowID) {
+                continue;
+            }
+            if (what == SDL_WINDOWEVENT_MINIMIZED) {
+                window[i].width = window[i].height = 0;
+            } else {
+                SDL_Vulkan_GetDrawableSize(window[i].handle, &window[i].width, &window[i].height);
+            }
+        }
+    }
+}
+
+/// @brief Record what is drawn into a frame's target. Terrain is a single
+/// indirect draw, so it is recorded here rather than split with
+/// `recordParallel`, which pays off for long draw lists only
+static void _recordFrame(FrameManager* frames, Frame* frame, TerrainRenderer* terrain,
+    const Camera* camera, const RenderTarget* target)
+{
+    mat4 viewProj;
+    _cameraViewProj(*camera, target->extent, viewProj);
+    drawTerrain(terrain, frame, target, frames->frameIndex, (const float*)viewProj, camera->eye);
+}
+
+static void drawFrameSystem(ecs_iter_t* it)
+{
+    TRACE_ZONE(__func__);
+    Window* window = ecs_field(it, Window, 1);
+    const VulkanSystem* system = ecs_field(it, VulkanSystem, 2);
+    Swapchain* swapchain = ecs_field(it, Swapchain, 3);
+    FrameManager* frames = ecs_field(it, FrameManager, 4);
+    TerrainRenderer* terrain = ecs_field(it, TerrainRenderer, 5);
+    const Camera* camera = ecs_field(it, Camera, 6);
+    for (int i = 0; i < it->count; ++i) {
+        int width = window[i].width, height = window[i].height;
+        // Minimized, nothing to present to
+        if (width == 0 || height == 0) {
+            continue;
+        }
+        // Resize before acquiring rather than waiting for the driver to
+        // report the swapchain out of date
+        VkExtent2D made = swapchain[i].windowExtent;
+        bool resized = (uint32_t)width != made.width || (uint32_t)height != made.height;
+        FrameStatus status = FRAME_OUT_OF_DATE;
+        Frame* frame;
+        if (!resized) {
+            status = beginFrame(&frames[i], &swapchain[i], ACQUIRE_TIMEOUT_NS, &frame);
+        }
+        if (status == FRAME_OK) {
+            RenderTarget target = swapchainTarget(&swapchain[i], frame);
+            _recordFrame(&frames[i], frame, terrain, camera, &target);
+            status = endFrame(&frames[i], &swapchain[i]);
+            if (status == FRAME_OK && !window[i].shown) {
+                // Shown once there is something in it
+                SDL_ShowWindow(window[i].handle);
+                window[i].shown = true;
+            }
+            if (status == FRAME_OK) {
+                markFirstFrame();
+            }
+        }
+        if (status == FRAME_TIMEOUT) {
+            ecs_warn("No swapchain image within [%llu] ms, skipped a frame", ACQUIRE_TIMEOUT_NS / 1000000);
+        } else if (status == FRAME_OUT_OF_DATE) {
+            recreateSwapchain(&system[i].renderDevice, &swapchain[i], width, height, frames[i].frameIndex);
+        }
+    }
+}
+
+static void drawOffscreenFrameSystem(ecs_iter_t* it)
+{
+    TRACE_ZONE(__func__);
+    OffscreenImage* image = ecs_field(it, OffscreenImage, 1);
+    FrameManager* frames = ecs_field(it, FrameManager, 2);
+    TerrainRenderer* terrain = ecs_field(it, TerrainRenderer, 3);
+    const Camera* camera = ecs_field(it, Camera, 4);
+    for (int i = 0; i < it->count; ++i) {
+        // Nothing to acquire, so offscreen frames always begin
+        Frame* frame;
+        beginFrame(&frames[i], NULL, 0, &frame);
+        RenderTarget target = offscreenTarget(&image[i]);
+        _recordFrame(&frames[i], frame, terrain, camera, &target);
+        recordOffscreenReadback(&image[i], frame);
+        endFrame(&frames[i], NULL);
+        markFirstFrame();
+    }
+}
 
 void registerGraphics(ecs_world_t* ecs)
 {
     ECS_TAG_DEFINE(ecs, GraphicsSystem);
-    ECS_COMPONENT_DEFINE(ecs, SDLWindowPtr);
+    ECS_COMPONENT_DEFINE(ecs, Window);
+    ECS_COMPONENT_DEFINE(ecs, Camera);
     registerVulkan(ecs);
+    registerTerrain(ecs);
+    // Looking straight down from above the first chunks
+    ecs_singleton_set(ecs, Camera, {
+        .eye = { 32.0f, 32.0f, 60.0f },
+        .rotation = { 0.0f, 0.0f, 0.0f, 1.0f },
+        .fovY = glm_rad(60.0f),
+        .zNear = 0.5f,
+        .zFar = 4000.0f,
+    });
+    // SDL wants its events pumped on the thread that made the window, which
+    // is where systems that are not multi-threaded run
+    ECS_SYSTEM(ecs, pollWindowEventsSystem, InputPhase, [inout] Window);
+    ECS_SYSTEM(ecs, followSpectatorSystem, RenderPreparePhase, [in] Position, [in] Rotation, [out] Camera($), Spectator);
+    ECS_SYSTEM(ecs, drawFrameSystem, SubmitPhase,
+        [inout] Window, [in] VulkanSystem, [inout] Swapchain, [inout] FrameManager,
+        [inout] TerrainRenderer($), [in] Camera($));
+    ECS_SYSTEM(ecs, drawOffscreenFrameSystem, SubmitPhase,
+        [inout] OffscreenImage, [inout] FrameManager, [inout] TerrainRenderer($), [in] Camera($));
 }
 
-ecs_entity_t createGraphicsSystem(ecs_world_t* ecs)
+/// @brief `DEVICE_ENV` holds either the index of a device or part of its name
+static DeviceSelection _deviceSelectionFromEnv()
 {
-    SDL_Init(SDL_INIT_EVERYTHING);
-    ecs_entity_t e = ecs_new_id(ecs);
+    DeviceSelection selection = { .name = NULL, .index = -1 };
+    const char* value = getenv(DEVICE_ENV);
+    if (!value || !*value) {
+        return selection;
+    }
+    char* end;
+    long index = strtol(value, &end, 10);
+    if (*end == '\0' && index >= 0) {
+        selection.index = (int)index;
+    } else {
+        selection.name = value;
+    }
+    return selection;
+}
 
-    ecs_add(ecs, e, GraphicsSystem);
+/// @brief `VALIDATION_IGNORE_ENV` holds message IDs separated by commas, as
+/// printed by the layers, e.g. `0x7cd0911d`
+static ValidationSettings _validationSettingsFromEnv(ValidationLevel level)
+{
+    ValidationSettings settings = { .level = level };
+    const char* value = getenv(VALIDATION_ENV);
+    if (level == VALIDATION_DEFAULT && value && *value) {
+        settings.level = parseValidationLevel(value);
+        if (settings.level == VALIDATION_DEFAULT) {
+            ecs_warn("Unknown %s [%s], using the default", VALIDATION_ENV, value);
+        }
+    }
+    const char* ids = getenv(VALIDATION_IGNORE_ENV);
+    while (ids && *ids && settings.nIgnoredIds < VALIDATION_MAX_IGNORED) {
+        char* end;
+        long long id = strtoll(ids, &end, 0);
+        if (end == ids) {
+            ecs_warn("Bad message ID in %s at [%s]", VALIDATION_IGNORE_ENV, ids);
+            break;
+        }
+        settings.ignoredIds[settings.nIgnoredIds++] = (int32_t)id;
+        ids = *end == ',' ? end + 1 : end;
+    }
+    return settings;
+}
 
-    SDLWindowPtr* window_p = ecs_emplace(ecs, e, SDLWindowPtr);
+/// @brief What the steps of graphics startup hand to each other
+typedef struct {
+    const GraphicsSettings* graphicsSettings;
+    VkExtent2D extent;
+    VulkanSettings settings;
+    Window window;
+    const char** extensions;
     uint32_t n_extensions;
-    const char** extensions = NULL;
-    *window_p = SDL_CreateWindow(
-        PROJECT_NAME, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
-        1280, 720, SDL_WINDOW_VULKAN | SDL_WINDOW_ALLOW_HIGHDPI | SDL_WINDOW_HIDDEN /* FIXME Hide until we can draw something */);
-    if (!*window_p) {
+    char* cachePath;
+    void* cacheData;
+    VulkanSystem system;
+    VkSurfaceKHR surface;
+    Swapchain swapchain;
+    OffscreenImage image;
+    VkFormat colorFormat;
+    FrameManager frames;
+    JobPool* pool;
+    TerrainRenderer terrain;
+} _GraphicsStartup;
+
+/// @brief Start SDL video and get the instance extensions a surface needs,
+/// which takes no window
+static void _startSdl(void* ctx)
+{
+    _GraphicsStartup* s = ctx;
+    if (SDL_InitSubSystem(SDL_INIT_VIDEO) != 0) {
         ecs_abort(1, "SDL init failed: %s", SDL_GetError());
     }
-
-    if (!SDL_Vulkan_GetInstanceExtensions(*window_p, &n_extensions, NULL)) {
+    if (SDL_Vulkan_LoadLibrary(NULL) != 0) {
+        ecs_abort(1, "Failed to load Vulkan through SDL: %s", SDL_GetError());
+    }
+    if (!SDL_Vulkan_GetInstanceExtensions(NULL, &s->n_extensions, NULL)) {
         ecs_abort(1, "Failed to get number of required extensions: %s", SDL_GetError());
     }
-    extensions = malloc(sizeof(const char*) * n_extensions);
-    if (!SDL_Vulkan_GetInstanceExtensions(*window_p, &n_extensions, extensions)) {
+    // Runs on the thread of `createGraphicsSystem`, which releases it
+    s->extensions = ARENA_NEW(scratchArena(), const char*, s->n_extensions);
+    if (!SDL_Vulkan_GetInstanceExtensions(NULL, &s->n_extensions, s->extensions)) {
         ecs_abort(1, "Failed to get required extensions: %s", SDL_GetError());
     }
-    // ecs_entity_t system = ecs_new_w_pair(ecs, EcsIsA, VulkanSystem);
-    VulkanSystem system = newVulkanSystem(extensions, n_extensions);
-    free(extensions);
+}
+
+static void _openWindow(void* ctx)
+{
+    _GraphicsStartup* s = ctx;
+    // Hidden until the first frame is presented, see `drawFrameSystem`
+    s->window.handle = SDL_CreateWindow(
+        PROJECT_NAME, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
+        s->extent.width, s->extent.height, SDL_WINDOW_VULKAN | SDL_WINDOW_ALLOW_HIGHDPI | SDL_WINDOW_RESIZABLE | SDL_WINDOW_HIDDEN);
+    if (!s->window.handle) {
+        ecs_abort(1, "SDL init failed: %s", SDL_GetError());
+    }
+    SDL_Vulkan_GetDrawableSize(s->window.handle, &s->window.width, &s->window.height);
+}
+
+/// @brief Compiled pipelines persist in the per-user data directory
+static void _readPipelineCache(void* ctx)
+{
+    _GraphicsStartup* s = ctx;
+    char* prefPath = SDL_GetPrefPath("russetair", PROJECT_NAME);
+    if (prefPath) {
+        size_t len = strlen(prefPath) + strlen(PIPELINE_CACHE_FILE) + 1;
+        s->cachePath = memAlloc(MEM_GENERAL, len);
+        snprintf(s->cachePath, len, "%s%s", prefPath, PIPELINE_CACHE_FILE);
+        SDL_free(prefPath);
+    }
+    s->settings.pipelineCachePath = s->cachePath;
+    s->cacheData = readPipelineCacheFile(s->cachePath, &s->settings.pipelineCacheSize);
+    s->settings.pipelineCacheData = s->cacheData;
+}
+
+static void _createInstance(void* ctx)
+{
+    _GraphicsStartup* s = ctx;
+    s->system = newVulkanInstance(s->extensions, s->n_extensions, &s->settings);
+}
+
+static void _createDevice(void* ctx)
+{
+    _GraphicsStartup* s = ctx;
+    s->settings.device.surface = s->surface;
+    newVulkanDevice(&s->system, &s->settings);
+}
+
+static void _createSurface(void* ctx)
+{
+    _GraphicsStartup* s = ctx;
+    if (!SDL_Vulkan_CreateSurface(s->window.handle, s->system.instance, &s->surface)) {
+        ecs_abort(1, "Failed to create Vulkan surface: %s", SDL_GetError());
+    }
+}
+
+static void _createTarget(void* ctx)
+{
+    _GraphicsStartup* s = ctx;
+    if (s->graphicsSettings->headless) {
+        s->image = newOffscreenImage(&s->system.renderDevice, s->extent,
+            s->graphicsSettings->readback ? FRAMES_IN_FLIGHT : 0);
+        s->colorFormat = OFFSCREEN_FORMAT;
+    } else {
+        const GraphicsSettings* settings = s->graphicsSettings;
+        int images = settings->swapchainImages ? (int)settings->swapchainImages : DEFAULT_SWAPCHAIN_IMAGES;
+        s->swapchain = newSwapchain(&s->system.renderDevice, s->surface, images, !settings->noVsync,
+            s->extent.width, s->extent.height);
+        s->colorFormat = (VkFormat)s->swapchain.imageFormat;
+    }
+}
+
+static void _createFrames(void* ctx)
+{
+    _GraphicsStartup* s = ctx;
+    s->frames = newFrameManager(&s->system.renderDevice, FRAMES_IN_FLIGHT);
+    setGpuProfilerEnabled(s->frames.profiler, s->graphicsSettings->profileGpu);
+}
+
+static void _createRenderers(void* ctx)
+{
+    _GraphicsStartup* s = ctx;
+    s->terrain = newTerrainRenderer(&s->system.renderDevice, &s->frames, s->colorFormat);
+}
+
+ecs_entity_t createGraphicsSystem(ecs_world_t* ecs, const GraphicsSettings* graphicsSettings)
+{
+    TRACE_ZONE(__func__);
+    bool headless = graphicsSettings->headless;
+    _GraphicsStartup s = {
+        .graphicsSettings = graphicsSettings,
+        .extent = {
+            graphicsSettings->width ? graphicsSettings->width : DEFAULT_WIDTH,
+            graphicsSettings->height ? graphicsSettings->height : DEFAULT_HEIGHT,
+        },
+        .settings = {
+            .device = _deviceSelectionFromEnv(),
+            .validation = _validationSettingsFromEnv(graphicsSettings->validation),
+        },
+        .pool = ecs_singleton_get(ecs, Jobs)->pool,
+    };
+    s.settings.device.headless = headless;
+
+    // Independent steps overlap: the window opens while the instance is
+    // created, and the pipeline cache is read meanwhile. SDL stays on this
+    // thread, as some platforms need it there. Headless instances need no
+    // surface extensions, and SDL video is never started, as there may be
+    // no display
+    Arena* scratch = scratchArena();
+    ArenaMark mark = arenaMark(scratch);
+    StartupGraph graph = { 0 };
+    uint32_t cache = addStartupStep(&graph, "cache", _readPipelineCache, &s, false, NULL, 0);
+    uint32_t instance, surface = 0;
+    if (headless) {
+        instance = addStartupStep(&graph, "instance", _createInstance, &s, false, NULL, 0);
+    } else {
+        uint32_t sdl = addStartupStep(&graph, "sdl", _startSdl, &s, true, NULL, 0);
+        uint32_t window = addStartupStep(&graph, "window", _openWindow, &s, true, &sdl, 1);
+        instance = addStartupStep(&graph, "instance", _createInstance, &s, false, &sdl, 1);
+        surface = addStartupStep(&graph, "surface", _createSurface, &s, true, (uint32_t[]) { window, instance }, 2);
+    }
+    // Devices are chosen by whether they can present to the surface
+    uint32_t device = addStartupStep(&graph, "device", _createDevice, &s, false,
+        (uint32_t[]) { instance, cache, surface }, headless ? 2 : 3);
+    uint32_t target = addStartupStep(&graph, headless ? "offscreen" : "swapchain", _createTarget, &s, false, &device, 1);
+    // The device allocator is not thread safe, so steps that allocate follow
+    // one another
+    uint32_t frames = addStartupStep(&graph, "frames", _createFrames, &s, false, &target, 1);
+    addStartupStep(&graph, "renderers", _createRenderers, &s, false, &frames, 1);
+    runStartupGraph(&graph, s.pool);
+    arenaRelease(scratch, mark);
+    memFree(s.cacheData);
+    memFree(s.cachePath);
 
-    // createVulkanPhysicalDevices(ecs, system);
-    // createVulkanRenderDevice(ecs, system);
-    // VkSurfaceKHR surface;
-    // if (!SDL_Vulkan_CreateSurface(*window_p, *ecs_get(ecs, instance, VkInstance), &surface)) {
-    //     ecs_abort(1, "Failed to create Vulkan surface: %s", SDL_GetError());
-    // }
-    // setupVulkanSurface(ecs, instance, surface);
-    // // TODO: settings
-    // setupSwapchain(ecs, instance, 3, true, 1280, 720);
+    ecs_entity_t e = ecs_new_id(ecs);
+    ecs_add(ecs, e, GraphicsSystem);
+    if (headless) {
+        ecs_set_ptr(ecs, e, OffscreenImage, &s.image);
+    } else {
+        ecs_set_ptr(ecs, e, Window, &s.window);
+        ecs_set_ptr(ecs, e, Swapchain, &s.swapchain);
+    }
+    ecs_set_ptr(ecs, e, VulkanSystem, &s.system);
+    ecs_set_ptr(ecs, e, FrameManager, &s.frames);
+    ecs_singleton_set_ptr(ecs, TerrainRenderer, &s.terrain);
+    uploadTerrainChunks(ecs);
 
     return e;
 }
+
+void cleanupGraphicsSystem(ecs_world_t* ecs, ecs_entity_t e)
+{
+    VulkanSystem* system = ecs_get_mut(ecs, e, VulkanSystem);
+    vkCheck(vkDeviceWaitIdle(system->renderDevice.handle))
+    {
+        ecs_abort(1, "Failed to wait for device idle");
+    }
+    cleanupTerrainRenderer(ecs_singleton_get_mut(ecs, TerrainRenderer));
+    ecs_singleton_remove(ecs, TerrainRenderer);
+    // Observers do not free slots once the renderer is gone
+    ecs_remove_all(ecs, ecs_id(ChunkSlot));
+    cleanupFrameManager(ecs_get_mut(ecs, e, FrameManager));
+    if (ecs_has(ecs, e, OffscreenImage)) {
+        cleanupOffscreenImage(ecs_get_mut(ecs, e, OffscreenImage));
+        ecs_remove(ecs, e, OffscreenImage);
+    } else {
+        Swapchain* swapchain = ecs_get_mut(ecs, e, Swapchain);
+        cleanupSwapchain(system->renderDevice.handle, swapchain);
+        // SDL created the surface without callbacks
+        vkDestroySurfaceKHR(system->instance, swapchain->surface, NULL);
+        ecs_remove(ecs, e, Swapchain);
+    }
+    ecs_remove(ecs, e, FrameManager);
+    system = ecs_get_mut(ecs, e, VulkanSystem);
+    cleanupVulkanSystem(system);
+    ecs_remove(ecs, e, VulkanSystem);
+    const Window* window = ecs_get(ecs, e, Window);
+    if (window) {
+        SDL_DestroyWindow(window->handle);
+    }
+    ecs_delete(ecs, e);
+    SDL_Quit();
+}
+
+const uint8_t* readGraphicsFrame(ecs_world_t* ecs, ecs_entity_t e)
+{
+    const FrameManager* frames = ecs_get(ecs, e, FrameManager);
+    if (!ecs_has(ecs, e, OffscreenImage) || frames->frameIndex == 0) {
+        return NULL;
+    }
+    const Frame* last = &frames->frames[(frames->frameIndex - 1) % frames->nFrames];
+    return readOffscreenImage(ecs_get_mut(ecs, e, OffscreenImage), last);
+}
@@ -1,9 +1,55 @@
 #pragma once
 
 #include <flecs.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "vk/validation.h"
 
 extern ECS_COMPONENT_DECLARE(GraphicsSystem);
 
+/// @brief How the graphics system is created
+typedef struct GraphicsSettings {
+    /// @brief No SDL window and no surface, frames are drawn into an
+    /// offscreen image. Works without a display, e.g. on lavapipe
+    bool headless;
+    /// @brief Of the window or the offscreen image, 0 for the default
+    uint32_t width, height;
+    /// @brief Swapchain images to ask for, 0 for the default. The surface
+    /// may allow fewer or need more
+    uint32_t swapchainImages;
+    /// @brief Present as soon as a frame is done, which may tear
+    bool noVsync;
+    /// @brief Headless only, copy every frame back for `readGraphicsFrame`
+    bool readback;
+    /// @brief Time render and compute passes, see `getGpuPassStats` of the
+    /// `FrameManager` profiler. Needs the `gpu_profiling` build option
+    bool profileGpu;
+    /// @brief `VALIDATION_DEFAULT` defers to the `RUSSETAIR_VALIDATION`
+    /// environment variable, then to the `validation` build option
+    ValidationLevel validation;
+} GraphicsSettings;
+
+/// @brief Registers the window, Vulkan and the renderers. Requires
+/// `registerEngine`, `registerChunk`, `spatial_register` and
+/// `player_register`
+/// @param ecs
 void registerGraphics(ecs_world_t* ecs);
 
-ecs_entity_t createGraphicsSystem(ecs_world_t* ecs);
+/// @brief Create the window or offscreen image, Vulkan and the renderers
+/// @param ecs
+/// @param settings
+/// @return The graphics system entity
+ecs_entity_t createGraphicsSystem(ecs_world_t* ecs, const GraphicsSettings* settings);
+
+/// @brief Wait for the last frame drawn and read it back
+/// @param ecs
+/// @param e The graphics system entity
+/// @return Tightly packed RGBA rows from the top left, valid until the next
+/// frame. NULL unless headless with readback, or before the first frame
+const uint8_t* readGraphicsFrame(ecs_world_t* ecs, ecs_entity_t e);
+
+/// @brief Save what should persist, then release Vulkan, the window and SDL
+/// @param ecs
+/// @param e The graphics system entity
+void cleanupGraphicsSystem(ecs_world_t* ecs, ecs_entity_t e);
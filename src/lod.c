@@ -0,0 +1,130 @@
+#include "lod.h"
+
+#include <math.h>
+#include <stb_ds.h>
+#include <utils/trace.h>
+
+#include "engine.h"
+#include "player.h"
+
+ECS_COMPONENT_DECLARE(UpdateRate);
+ECS_COMPONENT_DECLARE(UpdateScheduler);
+
+/// @brief Buckets are reassigned every this many ticks, a slice at a time
+#define LOD_REBUCKET_PERIOD 8
+
+/// @brief Spread entities evenly over phases regardless of id patterns
+static inline uint8_t _phase(ecs_entity_t e)
+{
+    return (uint8_t)((((uint32_t)e * 2654435761u) >> 24) & (LOD_MAX_PERIOD - 1));
+}
+
+static uint8_t _bucket(const UpdateScheduler* sched, Position p)
+{
+    int n = arrlen(sched->arrObservers);
+    if (n == 0) {
+        // Nobody is watching, but the world should still progress evenly
+        return 0;
+    }
+    float best = INFINITY;
+    for (int i = 0; i < n; ++i) {
+        float dx = p.x - sched->arrObservers[i].x;
+        float dy = p.y - sched->arrObservers[i].y;
+        float dz = p.z - sched->arrObservers[i].z;
+        float d2 = dx * dx + dy * dy + dz * dz;
+        best = d2 < best ? d2 : best;
+    }
+    uint8_t bucket = 0;
+    while (bucket < LOD_BUCKETS - 1 && best > sched->distances[bucket] * sched->distances[bucket]) {
+        ++bucket;
+    }
+    return bucket;
+}
+
+////// ECS
+
+static void updateSchedulerSystem(ecs_iter_t* it)
+{
+    TRACE_ZONE(__func__);
+    UpdateScheduler* sched = ecs_field(it, UpdateScheduler, 1);
+    sched->tick++;
+    if (sched->arrObservers) {
+        arrdeln(sched->arrObservers, 0, arrlen(sched->arrObservers));
+    }
+    ecs_iter_t qit = ecs_query_iter(it->world, sched->observers);
+    while (ecs_query_next(&qit)) {
+        Position* p = ecs_field(&qit, Position, 1);
+        for (int i = 0; i < qit.count; ++i) {
+            arrput(sched->arrObservers, p[i]);
+        }
+    }
+}
+
+/// @brief The phase only depends on the entity, so it is set once, also
+/// over a value set later
+static void onUpdateRateSet(ecs_iter_t* it)
+{
+    UpdateRate* rate = ecs_field(it, UpdateRate, 1);
+    for (int i = 0; i < it->count; ++i) {
+        rate[i].phase = _phase(it->entities[i]);
+    }
+}
+
+static void assignUpdateRateSystem(ecs_iter_t* it)
+{
+    TRACE_ZONE(__func__);
+    Position* p = ecs_field(it, Position, 1);
+    UpdateRate* rate = ecs_field(it, UpdateRate, 2);
+    UpdateScheduler* sched = ecs_field(it, UpdateScheduler, 3);
+    for (int i = 0; i < it->count; ++i) {
+        // Only a slice of entities is reassigned per tick to keep the
+        // distance checks off any single tick
+        if (((sched->tick + rate[i].phase) & (LOD_REBUCKET_PERIOD - 1)) != 0) {
+            continue;
+        }
+        uint8_t bucket = _bucket(sched, p[i]);
+        // Mostly unchanged, so the cache line stays clean
+        if (bucket != rate[i].bucket) {
+            rate[i].bucket = bucket;
+        }
+    }
+}
+
+void cleanupUpdateScheduler(UpdateScheduler* sched)
+{
+    arrfree(sched->arrObservers);
+}
+
+void registerLod(ecs_world_t* ecs)
+{
+    ECS_COMPONENT_DEFINE(ecs, UpdateRate);
+    ECS_COMPONENT_DEFINE(ecs, UpdateScheduler);
+    ecs_singleton_set(ecs, UpdateScheduler, {
+        .periods = { 1, 2, 8, LOD_MAX_PERIOD },
+        .distances = { 2000.0f, 6000.0f, 15000.0f },
+        .observers = ecs_query_init(ecs, &(ecs_query_desc_t) {
+            .filter.expr = "[in] Position, PlayerControlled || Spectator",
+        }),
+    });
+
+    ecs_observer(ecs, {
+        .entity = ecs_entity(ecs, { .name = "onUpdateRateSet" }),
+        .filter.expr = "[inout] UpdateRate",
+        .events = { EcsOnAdd, EcsOnSet },
+        .callback = onUpdateRateSet,
+    });
+
+    ECS_SYSTEM(ecs, updateSchedulerSystem, SimulatePhase, [inout] UpdateScheduler($));
+    // Reads positions and the scheduler's observers and tick, which are only
+    // written before it in the phase, and writes the bucket of its own
+    // entity when due
+    ecs_system(ecs, {
+        .entity = ecs_entity(ecs, {
+            .name = "assignUpdateRateSystem",
+            .add = { ecs_dependson(SimulatePhase) },
+        }),
+        .query.filter.expr = "[in] Position, [inout] UpdateRate, [in] UpdateScheduler($)",
+        .callback = assignUpdateRateSystem,
+        .multi_threaded = true,
+    });
+}
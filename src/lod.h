@@ -0,0 +1,72 @@
+#pragma once
+
+#include <flecs.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "spatial.h"
+
+/// @brief Number of update rate buckets
+#define LOD_BUCKETS 4
+/// @brief Longest period of any bucket, in ticks
+#define LOD_MAX_PERIOD 32
+
+extern ECS_COMPONENT_DECLARE(UpdateRate);
+extern ECS_COMPONENT_DECLARE(UpdateScheduler);
+
+/// @brief Opts an entity into reduced update rates far from any observer.
+/// Add it zeroed. Its phase is set when it is added or set, its bucket by
+/// the scheduler
+typedef struct {
+    /// @brief Index into `UpdateScheduler.periods`
+    uint8_t bucket;
+    /// @brief Tick offset within the period, spreads a bucket over ticks
+    uint8_t phase;
+} UpdateRate;
+
+/// @brief Decides which entities update on which tick. A singleton
+typedef struct {
+    uint32_t tick;
+    /// @brief Ticks between updates of each bucket, powers of two
+    uint32_t periods[LOD_BUCKETS];
+    /// @brief Entities beyond `distances[i]` from every observer go into
+    /// bucket `i + 1`, in m
+    float distances[LOD_BUCKETS - 1];
+    /// @brief stb array of `PlayerControlled` and `Spectator` positions
+    /// this tick
+    Position* arrObservers;
+    ecs_query_t* observers;
+} UpdateScheduler;
+
+/// @brief Registers the scheduler. Requires `registerEngine`,
+/// `spatial_register` and `player_register`
+/// @param ecs
+void registerLod(ecs_world_t* ecs);
+
+/// @brief Free the observer positions, e.g. before the world is destroyed
+/// @param sched
+void cleanupUpdateScheduler(UpdateScheduler* sched);
+
+/// @brief Whether an entity updates this tick. Systems opt in by taking an
+/// optional `?UpdateRate` term and skipping entities that are not due
+/// @param sched
+/// @param rate May be NULL, in which case the entity always updates
+/// @return
+static inline bool lodIsDue(const UpdateScheduler* sched, const UpdateRate* rate)
+{
+    if (!rate) {
+        return true;
+    }
+    uint32_t period = sched->periods[rate->bucket];
+    return ((sched->tick + rate->phase) & (period - 1)) == 0;
+}
+
+/// @brief Number of ticks that a due entity stands in for, to scale time
+/// steps and impulses by
+/// @param sched
+/// @param rate May be NULL
+/// @return
+static inline uint32_t lodPeriod(const UpdateScheduler* sched, const UpdateRate* rate)
+{
+    return rate ? sched->periods[rate->bucket] : 1;
+}
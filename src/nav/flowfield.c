@@ -0,0 +1,304 @@
+#include "flowfield.h"
+
+#include <math.h>
+#include <stb_ds.h>
+#include <stdlib.h>
+#include <utils/arena.h>
+#include <utils/log.h>
+#include <utils/math.h>
+#include <utils/memtrack.h>
+#include <utils/trace.h>
+
+#include "engine.h"
+#include "spatial.h"
+
+extern ECS_COMPONENT_DECLARE(Position);
+extern ECS_COMPONENT_DECLARE(Velocity);
+
+ECS_COMPONENT_DECLARE(FlowFieldCache);
+ECS_COMPONENT_DECLARE(FlowFollower);
+
+#define FLOW_SECTOR_AREA (NAV_SECTOR_TILES * NAV_SECTOR_TILES)
+
+/// @brief Counter-clockwise from east, orthogonal directions on even indices
+static const int _dirDx[8] = { 1, 1, 0, -1, -1, -1, 0, 1 };
+static const int _dirDy[8] = { 0, 1, 1, 1, 0, -1, -1, -1 };
+/// @brief Step costs in half tiles, 2 and 3 approximate 1 and sqrt(2)
+static const uint32_t _dirCost[8] = { 2, 3, 2, 3, 2, 3, 2, 3 };
+
+/// @brief Input of one field computation
+typedef struct {
+    FlowField* field;
+    int goalX, goalY;
+    /// @brief Copy of the navigable rows of every chunk of the sector, so
+    /// that terrain may change while the worker runs
+    uint16_t rows[SECTOR_AREA * CHUNK_SIZE];
+} _FlowJob;
+
+static inline bool _isOpen(const _FlowJob* job, int x, int y)
+{
+    if (x < 0 || y < 0 || x >= NAV_SECTOR_TILES || y >= NAV_SECTOR_TILES) {
+        return false;
+    }
+    int chunk = (y / CHUNK_SIZE) * SECTOR_SIZE + x / CHUNK_SIZE;
+    return (job->rows[chunk * CHUNK_SIZE + y % CHUNK_SIZE] >> (x % CHUNK_SIZE)) & 1;
+}
+
+/// @brief Whether a step is possible, diagonals may not cut corners
+static inline bool _canStep(const _FlowJob* job, int x, int y, int d)
+{
+    int nx = x + _dirDx[d], ny = y + _dirDy[d];
+    if (!_isOpen(job, nx, ny)) {
+        return false;
+    }
+    return (d & 1) == 0 || (_isOpen(job, nx, y) && _isOpen(job, x, ny));
+}
+
+/// @brief Wavefront from the goal. Step costs are small integers, so the
+/// open set is a ring of buckets, one per cost modulo 4
+static void _integrate(const _FlowJob* job, uint32_t* integration)
+{
+    for (int i = 0; i < FLOW_SECTOR_AREA; ++i) {
+        integration[i] = FLOW_COST_UNREACHABLE;
+    }
+    Arena* scratch = scratchArena();
+    ArenaMark mark = arenaMark(scratch);
+    Arena* previous = stbdsUseArena(scratch);
+    uint32_t* buckets[4] = { 0 };
+    uint32_t goal = job->goalY * NAV_SECTOR_TILES + job->goalX;
+    integration[goal] = 0;
+    arrput(buckets[0], goal);
+    int pending = 1;
+    for (uint32_t cost = 0; pending > 0; ++cost) {
+        // Steps cost 2 or 3, so they never land in the bucket being drained
+        uint32_t* bucket = buckets[cost & 3];
+        int n = arrlen(bucket);
+        for (int i = 0; i < n; ++i) {
+            uint32_t idx = bucket[i];
+            if (integration[idx] != cost) {
+                continue;
+            }
+            int x = idx % NAV_SECTOR_TILES, y = idx / NAV_SECTOR_TILES;
+            for (int d = 0; d < 8; ++d) {
+                if (!_canStep(job, x, y, d)) {
+                    continue;
+                }
+                uint32_t ni = (y + _dirDy[d]) * NAV_SECTOR_TILES + x + _dirDx[d];
+                uint32_t nc = cost + _dirCost[d];
+                if (nc < integration[ni]) {
+                    integration[ni] = nc;
+                    arrput(buckets[nc & 3], ni);
+                    ++pending;
+                }
+            }
+        }
+        pending -= n;
+        if (n > 0) {
+            arrdeln(buckets[cost & 3], 0, n);
+        }
+    }
+    stbdsUseArena(previous);
+    arenaRelease(scratch, mark);
+}
+
+/// @brief Point every tile at its cheapest neighbour
+static void _directions(const _FlowJob* job, const uint32_t* integration, uint8_t* directions)
+{
+    for (int y = 0; y < NAV_SECTOR_TILES; ++y) {
+        for (int x = 0; x < NAV_SECTOR_TILES; ++x) {
+            int idx = y * NAV_SECTOR_TILES + x;
+            uint32_t best = integration[idx];
+            uint8_t dir = best == 0 ? FLOW_DIR_GOAL : FLOW_DIR_NONE;
+            for (int d = 0; d < 8 && best != 0 && best != FLOW_COST_UNREACHABLE; ++d) {
+                if (!_canStep(job, x, y, d)) {
+                    continue;
+                }
+                uint32_t c = integration[(y + _dirDy[d]) * NAV_SECTOR_TILES + x + _dirDx[d]];
+                if (c < best) {
+                    best = c;
+                    dir = d;
+                }
+            }
+            directions[idx] = dir;
+        }
+    }
+}
+
+static void _computeField(void* ctx)
+{
+    _FlowJob* job = ctx;
+    FlowField* field = job->field;
+    _integrate(job, field->integration);
+    _directions(job, field->integration, field->directions);
+    atomic_store(&field->state, FLOW_FIELD_READY);
+    memFree(job);
+}
+
+/// @brief Pick the slot to compute a new field in
+static FlowField* _evict(FlowFieldCache* cache)
+{
+    FlowField* victim = NULL;
+    for (int i = 0; i < FLOW_FIELD_CAPACITY; ++i) {
+        FlowField* f = &cache->fields[i];
+        int state = atomic_load(&f->state);
+        if (state == FLOW_FIELD_EMPTY) {
+            return f;
+        }
+        if (state == FLOW_FIELD_READY && (!victim || f->lastUsed < victim->lastUsed)) {
+            victim = f;
+        }
+    }
+    return victim;
+}
+
+static void _startField(FlowField* field, JobPool* pool, const NavSector* sector, NavTile goal)
+{
+    LOG_TRACE("Computing flow field to [%d, %d]", goal.x, goal.y);
+    if (!field->integration) {
+        field->integration = memAlloc(MEM_TERRAIN, sizeof(*field->integration) * FLOW_SECTOR_AREA);
+        field->directions = memAlloc(MEM_TERRAIN, sizeof(*field->directions) * FLOW_SECTOR_AREA);
+    }
+    field->sector = sector->coord;
+    field->goal = goal;
+    field->generation = sector->generation;
+    atomic_store(&field->state, FLOW_FIELD_PENDING);
+
+    _FlowJob* job = memAlloc(MEM_TERRAIN, sizeof(*job));
+    job->field = field;
+    job->goalX = goal.x - sector->coord.x * NAV_SECTOR_TILES;
+    job->goalY = goal.y - sector->coord.y * NAV_SECTOR_TILES;
+    for (int c = 0; c < SECTOR_AREA; ++c) {
+        memcpy(&job->rows[c * CHUNK_SIZE], sector->chunks[c].rows, sizeof(sector->chunks[c].rows));
+    }
+    jobPoolSubmit(pool, _computeField, job);
+}
+
+const FlowField* flowFieldRequest(FlowFieldCache* cache, JobPool* pool, const NavWorld* nav, NavTile goal)
+{
+    const NavSector* sector = navGetSector(nav,
+        i32floordiv(goal.x, NAV_SECTOR_TILES), i32floordiv(goal.y, NAV_SECTOR_TILES));
+    if (!sector || !navIsNavigable(nav, goal.x, goal.y)) {
+        return NULL;
+    }
+    FlowField *fresh = NULL, *stale = NULL;
+    bool computing = false;
+    for (int i = 0; i < FLOW_FIELD_CAPACITY; ++i) {
+        FlowField* f = &cache->fields[i];
+        int state = atomic_load(&f->state);
+        if (state == FLOW_FIELD_EMPTY || f->goal.x != goal.x || f->goal.y != goal.y) {
+            continue;
+        }
+        bool current = f->generation == sector->generation;
+        if (state == FLOW_FIELD_READY && current) {
+            fresh = f;
+        } else if (state == FLOW_FIELD_READY && (!stale || f->generation > stale->generation)) {
+            stale = f;
+        } else if (state == FLOW_FIELD_PENDING && current) {
+            computing = true;
+        }
+    }
+    cache->clock++;
+    if (fresh) {
+        fresh->lastUsed = cache->clock;
+        return fresh;
+    }
+    if (stale) {
+        // Keep the old field from being evicted while it is still in use
+        stale->lastUsed = cache->clock;
+    }
+    if (!computing) {
+        FlowField* slot = _evict(cache);
+        if (slot && slot != stale) {
+            slot->lastUsed = cache->clock;
+            _startField(slot, pool, sector, goal);
+        }
+    }
+    return stale;
+}
+
+bool flowFieldDirection(const FlowField* field, int x, int y, float* dx, float* dy)
+{
+    int lx = x - field->sector.x * NAV_SECTOR_TILES;
+    int ly = y - field->sector.y * NAV_SECTOR_TILES;
+    if (lx < 0 || ly < 0 || lx >= NAV_SECTOR_TILES || ly >= NAV_SECTOR_TILES) {
+        return false;
+    }
+    uint8_t d = field->directions[ly * NAV_SECTOR_TILES + lx];
+    if (d == FLOW_DIR_NONE) {
+        return false;
+    }
+    if (d == FLOW_DIR_GOAL) {
+        *dx = 0.0f;
+        *dy = 0.0f;
+        return true;
+    }
+    float norm = (d & 1) ? (float)M_SQRT1_2 : 1.0f;
+    *dx = _dirDx[d] * norm;
+    *dy = _dirDy[d] * norm;
+    return true;
+}
+
+void cleanupFlowFieldCache(FlowFieldCache* cache)
+{
+    for (int i = 0; i < FLOW_FIELD_CAPACITY; ++i) {
+        FlowField* f = &cache->fields[i];
+        while (atomic_load(&f->state) == FLOW_FIELD_PENDING) {
+            ecs_os_sleep(0, 1000000);
+        }
+        memFree(f->integration);
+        memFree(f->directions);
+        f->integration = NULL;
+        f->directions = NULL;
+    }
+    memFree(cache->fields);
+    cache->fields = NULL;
+}
+
+////// ECS
+
+static void steerFlowFollowersSystem(ecs_iter_t* it)
+{
+    TRACE_ZONE(__func__);
+    Position* p = ecs_field(it, Position, 1);
+    Velocity* v = ecs_field(it, Velocity, 2);
+    FlowFollower* follower = ecs_field(it, FlowFollower, 3);
+    NavWorld* nav = ecs_field(it, NavWorld, 4);
+    FlowFieldCache* cache = ecs_field(it, FlowFieldCache, 5);
+    Jobs* jobs = ecs_field(it, Jobs, 6);
+
+    const FlowField* field = NULL;
+    NavTile fieldGoal = { 0 };
+    for (int i = 0; i < it->count; ++i) {
+        NavTile goal = follower[i].goal;
+        // Fleets share goals, so consecutive ships usually share the field
+        if (i == 0 || goal.x != fieldGoal.x || goal.y != fieldGoal.y) {
+            field = flowFieldRequest(cache, jobs->pool, nav, goal);
+            fieldGoal = goal;
+        }
+        int x = (int)floorf(p[i].x / TILE_SIZE), y = (int)floorf(p[i].y / TILE_SIZE);
+        float dx, dy;
+        if (!field || !flowFieldDirection(field, x, y, &dx, &dy)) {
+            // Head straight for the goal until there is a field to follow
+            dx = (goal.x + 0.5f) * TILE_SIZE - p[i].x;
+            dy = (goal.y + 0.5f) * TILE_SIZE - p[i].y;
+            float len = sqrtf(dx * dx + dy * dy);
+            if (len > 0.0f) {
+                dx /= len;
+                dy /= len;
+            }
+        }
+        v[i].x = dx * follower[i].speed;
+        v[i].y = dy * follower[i].speed;
+    }
+}
+
+void registerFlowFields(ecs_world_t* ecs)
+{
+    ECS_COMPONENT_DEFINE(ecs, FlowFieldCache);
+    ECS_COMPONENT_DEFINE(ecs, FlowFollower);
+    ecs_singleton_set(ecs, FlowFieldCache, { .fields = memCalloc(MEM_TERRAIN, FLOW_FIELD_CAPACITY, sizeof(FlowField)) });
+
+    ECS_SYSTEM(ecs, steerFlowFollowersSystem, SimulatePhase,
+        [in] Position, [out] Velocity, [in] FlowFollower,
+        [in] NavWorld($), [inout] FlowFieldCache($), [in] Jobs($));
+}
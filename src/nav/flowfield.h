@@ -0,0 +1,85 @@
+#pragma once
+
+#include <flecs.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <utils/jobs.h>
+
+#include "navgrid.h"
+
+/// @brief Number of flow fields kept around, each ~5 MiB
+#define FLOW_FIELD_CAPACITY 8
+/// @brief Direction of the goal tile itself
+#define FLOW_DIR_GOAL 8
+/// @brief Direction of tiles that cannot reach the goal
+#define FLOW_DIR_NONE 255
+/// @brief Integration cost of tiles that cannot reach the goal
+#define FLOW_COST_UNREACHABLE UINT32_MAX
+
+extern ECS_COMPONENT_DECLARE(FlowFieldCache);
+extern ECS_COMPONENT_DECLARE(FlowFollower);
+
+typedef enum {
+    FLOW_FIELD_EMPTY,
+    FLOW_FIELD_PENDING,
+    FLOW_FIELD_READY,
+} FlowFieldState;
+
+/// @brief Paths from every tile of a sector to one goal tile
+typedef struct {
+    /// @brief A `FlowFieldState`. Workers publish fields by setting it
+    _Atomic int state;
+    SectorCoord sector;
+    NavTile goal;
+    /// @brief `NavSector.generation` the field was computed from
+    uint32_t generation;
+    uint64_t lastUsed;
+    /// @brief Cost to the goal in half tiles, row major over the sector
+    uint32_t* integration;
+    /// @brief Direction of the next tile, 0-7 counter-clockwise from east
+    uint8_t* directions;
+} FlowField;
+
+/// @brief Flow fields cached by goal, evicting the least recently used. A singleton
+typedef struct {
+    /// @brief `FLOW_FIELD_CAPACITY` slots. Heap allocated, since workers
+    /// write into them while the component may move
+    FlowField* fields;
+    uint64_t clock;
+} FlowFieldCache;
+
+/// @brief Steers `Velocity` along the flow field of a goal
+typedef struct {
+    NavTile goal;
+    /// @brief Speed in world units per s
+    float speed;
+} FlowFollower;
+
+/// @brief Registers flow field types and the steering system. Requires
+/// `registerEngine`, `registerNav`, `registerJobs` and `spatial_register`
+/// @param ecs
+void registerFlowFields(ecs_world_t* ecs);
+
+/// @brief Get the flow field towards a goal, queueing its computation on the
+/// worker pool if it is missing or out of date
+/// @param cache
+/// @param pool
+/// @param nav
+/// @param goal Global goal tile
+/// @return The freshest field for the goal, which may be out of date while a
+/// newer one is computed, or NULL if none is ready yet or the goal is on land
+const FlowField* flowFieldRequest(FlowFieldCache* cache, JobPool* pool, const NavWorld* nav, NavTile goal);
+
+/// @brief Direction to move from a tile
+/// @param field
+/// @param x Global tile X
+/// @param y Global tile Y
+/// @param dx Output unit direction X
+/// @param dy Output unit direction Y
+/// @return false if the tile is outside the field or cannot reach the goal
+bool flowFieldDirection(const FlowField* field, int x, int y, float* dx, float* dy);
+
+/// @brief Wait for pending fields and release all slots
+/// @param cache
+void cleanupFlowFieldCache(FlowFieldCache* cache);
@@ -0,0 +1,366 @@
+#include "navgrid.h"
+
+#include <math.h>
+#include <stb_ds.h>
+#include <stdlib.h>
+#include <utils/log.h>
+#include <utils/math.h>
+#include <utils/memtrack.h>
+#include <utils/trace.h>
+
+#include "engine.h"
+
+ECS_COMPONENT_DECLARE(NavWorld);
+
+/// @brief Entrances at least this wide get a portal at both ends instead of
+/// one in the middle
+#define NAV_WIDE_ENTRANCE 6
+
+static const int _sideDx[4] = { 1, 0, -1, 0 };
+static const int _sideDy[4] = { 0, 1, 0, -1 };
+
+static inline bool _isOpen(const NavChunk* chunk, int tx, int ty)
+{
+    return (chunk->rows[ty] >> tx) & 1;
+}
+
+NavSector* navGetSector(const NavWorld* nav, int sx, int sy)
+{
+    // Lookups into an empty stb hashmap allocate, so skip them
+    NavSectorEntry* map = nav->mapSectors;
+    if (!map) {
+        return NULL;
+    }
+    NavSectorEntry* e = hmgetp_null(map, navKey(sx, sy));
+    return e ? e->value : NULL;
+}
+
+NavChunk* navGetChunk(const NavWorld* nav, int cx, int cy)
+{
+    NavSector* sector = navGetSector(nav,
+        i32floordiv(cx, SECTOR_SIZE), i32floordiv(cy, SECTOR_SIZE));
+    if (!sector) {
+        return NULL;
+    }
+    int lx = i32floormod(cx, SECTOR_SIZE);
+    int ly = i32floormod(cy, SECTOR_SIZE);
+    return &sector->chunks[ly * SECTOR_SIZE + lx];
+}
+
+bool navIsNavigable(const NavWorld* nav, int x, int y)
+{
+    const NavChunk* chunk = navGetChunk(nav, i32floordiv(x, CHUNK_SIZE), i32floordiv(y, CHUNK_SIZE));
+    return chunk && chunk->present
+        && _isOpen(chunk, i32floormod(x, CHUNK_SIZE), i32floormod(y, CHUNK_SIZE));
+}
+
+static NavSector* _getOrNewSector(NavWorld* nav, int sx, int sy)
+{
+    NavSector* sector = navGetSector(nav, sx, sy);
+    if (sector) {
+        return sector;
+    }
+    LOG_TRACE("Creating NavSector [%d, %d]", sx, sy);
+    sector = memCalloc(MEM_TERRAIN, 1, sizeof(*sector));
+    sector->coord = (SectorCoord) { .x = sx, .y = sy };
+    hmput(nav->mapSectors, navKey(sx, sy), sector);
+    return sector;
+}
+
+void navUpdateChunk(NavWorld* nav, ChunkCoord coord, const TileHeights* tiles)
+{
+    NavSector* sector = _getOrNewSector(nav,
+        i32floordiv(coord.x, SECTOR_SIZE), i32floordiv(coord.y, SECTOR_SIZE));
+    int lx = i32floormod(coord.x, SECTOR_SIZE);
+    int ly = i32floormod(coord.y, SECTOR_SIZE);
+    NavChunk* chunk = &sector->chunks[ly * SECTOR_SIZE + lx];
+
+    uint16_t rows[CHUNK_SIZE];
+    for (int y = 0; y < CHUNK_SIZE; ++y) {
+        uint16_t row = 0;
+        for (int x = 0; x < CHUNK_SIZE; ++x) {
+            row |= (uint16_t)navIsWater(tiles->heights[y * CHUNK_SIZE + x]) << x;
+        }
+        rows[y] = row;
+    }
+    // Edits that keep the coastline where it was do not affect navigation
+    if (chunk->present && memcmp(rows, chunk->rows, sizeof(rows)) == 0) {
+        return;
+    }
+    memcpy(chunk->rows, rows, sizeof(rows));
+    chunk->present = true;
+    sector->generation++;
+    hmput(nav->mapDirty, navKey(coord.x, coord.y), true);
+}
+
+void navRemoveChunk(NavWorld* nav, ChunkCoord coord)
+{
+    NavSector* sector = navGetSector(nav, i32floordiv(coord.x, SECTOR_SIZE), i32floordiv(coord.y, SECTOR_SIZE));
+    if (!sector) {
+        return;
+    }
+    NavChunk* chunk = &sector->chunks[i32floormod(coord.y, SECTOR_SIZE) * SECTOR_SIZE + i32floormod(coord.x, SECTOR_SIZE)];
+    if (!chunk->present) {
+        return;
+    }
+    memset(chunk->rows, 0, sizeof(chunk->rows));
+    chunk->present = false;
+    sector->generation++;
+    // Rebuilding the chunk also rebuilds its borders with the four
+    // neighbours and their edges, and frees its own
+    hmput(nav->mapDirty, navKey(coord.x, coord.y), true);
+}
+
+////// Chunk-local search
+
+typedef struct {
+    float dist;
+    int16_t index;
+} _HeapItem;
+
+static void _heapPush(_HeapItem* heap, int* n, _HeapItem item)
+{
+    int i = (*n)++;
+    while (i > 0) {
+        int p = (i - 1) / 2;
+        if (heap[p].dist <= item.dist) {
+            break;
+        }
+        heap[i] = heap[p];
+        i = p;
+    }
+    heap[i] = item;
+}
+
+static _HeapItem _heapPop(_HeapItem* heap, int* n)
+{
+    _HeapItem top = heap[0];
+    _HeapItem last = heap[--(*n)];
+    int i = 0;
+    for (;;) {
+        int c = 2 * i + 1;
+        if (c >= *n) {
+            break;
+        }
+        if (c + 1 < *n && heap[c + 1].dist < heap[c].dist) {
+            ++c;
+        }
+        if (last.dist <= heap[c].dist) {
+            break;
+        }
+        heap[i] = heap[c];
+        i = c;
+    }
+    heap[i] = last;
+    return top;
+}
+
+void navChunkDijkstra(const NavChunk* chunk, int tx, int ty, float dist[CHUNK_AREA], int16_t parent[CHUNK_AREA])
+{
+    static const int dx[8] = { 1, -1, 0, 0, 1, 1, -1, -1 };
+    static const int dy[8] = { 0, 0, 1, -1, 1, -1, 1, -1 };
+    static const float cost[8] = { 1, 1, 1, 1, M_SQRT2, M_SQRT2, M_SQRT2, M_SQRT2 };
+
+    for (int i = 0; i < CHUNK_AREA; ++i) {
+        dist[i] = INFINITY;
+        if (parent) {
+            parent[i] = -1;
+        }
+    }
+    if (!chunk->present || !_isOpen(chunk, tx, ty)) {
+        return;
+    }
+    // Every tile is pushed at most once per incoming direction
+    _HeapItem heap[CHUNK_AREA * 8];
+    int n = 0;
+    dist[ty * CHUNK_SIZE + tx] = 0.0f;
+    _heapPush(heap, &n, (_HeapItem) { .dist = 0.0f, .index = ty * CHUNK_SIZE + tx });
+    while (n > 0) {
+        _HeapItem cur = _heapPop(heap, &n);
+        if (cur.dist > dist[cur.index]) {
+            continue;
+        }
+        int x = cur.index % CHUNK_SIZE, y = cur.index / CHUNK_SIZE;
+        for (int d = 0; d < 8; ++d) {
+            int nx = x + dx[d], ny = y + dy[d];
+            if (nx < 0 || ny < 0 || nx >= CHUNK_SIZE || ny >= CHUNK_SIZE || !_isOpen(chunk, nx, ny)) {
+                continue;
+            }
+            // No corner cutting past land
+            if (d >= 4 && !(_isOpen(chunk, nx, y) && _isOpen(chunk, x, ny))) {
+                continue;
+            }
+            int ni = ny * CHUNK_SIZE + nx;
+            float nd = cur.dist + cost[d];
+            if (nd < dist[ni]) {
+                dist[ni] = nd;
+                if (parent) {
+                    parent[ni] = cur.index;
+                }
+                _heapPush(heap, &n, (_HeapItem) { .dist = nd, .index = ni });
+            }
+        }
+    }
+}
+
+////// Portal graph
+
+/// @brief Recompute entrances on one border of a chunk, on both sides of it
+static void _rebuildBorder(NavWorld* nav, int cx, int cy, NavSide side)
+{
+    NavSide opposite = (side + 2) % 4;
+    NavChunk* a = navGetChunk(nav, cx, cy);
+    NavChunk* b = navGetChunk(nav, cx + _sideDx[side], cy + _sideDy[side]);
+    if (a) {
+        a->portals[side] = 0;
+    }
+    if (b) {
+        b->portals[opposite] = 0;
+    }
+    if (!a || !b || !a->present || !b->present) {
+        return;
+    }
+    bool open[CHUNK_SIZE + 1];
+    for (int o = 0; o < CHUNK_SIZE; ++o) {
+        int ax, ay, bx, by;
+        navPortalTile(side * CHUNK_SIZE + o, &ax, &ay);
+        navPortalTile(opposite * CHUNK_SIZE + o, &bx, &by);
+        open[o] = _isOpen(a, ax, ay) && _isOpen(b, bx, by);
+    }
+    open[CHUNK_SIZE] = false;
+    uint16_t mask = 0;
+    int start = -1;
+    for (int o = 0; o <= CHUNK_SIZE; ++o) {
+        if (open[o] && start < 0) {
+            start = o;
+        } else if (!open[o] && start >= 0) {
+            int end = o - 1;
+            if (end - start + 1 >= NAV_WIDE_ENTRANCE) {
+                mask |= (1u << start) | (1u << end);
+            } else {
+                mask |= 1u << ((start + end) / 2);
+            }
+            start = -1;
+        }
+    }
+    a->portals[side] = mask;
+    b->portals[opposite] = mask;
+}
+
+/// @brief Recompute paths between all portals inside a chunk
+static void _rebuildEdges(NavChunk* chunk)
+{
+    arrfree(chunk->arrEdges);
+    if (!chunk->present) {
+        return;
+    }
+    float dist[CHUNK_AREA];
+    for (int s = 0; s < NAV_CHUNK_PORTALS; ++s) {
+        if (!(chunk->portals[s / CHUNK_SIZE] >> (s % CHUNK_SIZE) & 1)) {
+            continue;
+        }
+        int sx, sy;
+        navPortalTile(s, &sx, &sy);
+        navChunkDijkstra(chunk, sx, sy, dist, NULL);
+        for (int t = 0; t < NAV_CHUNK_PORTALS; ++t) {
+            if (t == s || !(chunk->portals[t / CHUNK_SIZE] >> (t % CHUNK_SIZE) & 1)) {
+                continue;
+            }
+            int tx, ty;
+            navPortalTile(t, &tx, &ty);
+            float d = dist[ty * CHUNK_SIZE + tx];
+            if (isfinite(d)) {
+                arrput(chunk->arrEdges, ((NavEdge) { .from = s, .to = t, .cost = d }));
+            }
+        }
+    }
+}
+
+void navRebuildDirty(NavWorld* nav)
+{
+    int nDirty = hmlen(nav->mapDirty);
+    if (nDirty == 0) {
+        return;
+    }
+    LOG_TRACE("Rebuilding portals around [%d] chunks", nDirty);
+    ecs_log_push();
+    NavDirtyEntry* mapEdges = NULL;
+    for (int i = 0; i < nDirty; ++i) {
+        int64_t key = nav->mapDirty[i].key;
+        int cx = (int32_t)(key >> 32), cy = (int32_t)key;
+        hmput(mapEdges, key, true);
+        for (int side = 0; side < 4; ++side) {
+            _rebuildBorder(nav, cx, cy, side);
+            hmput(mapEdges, navKey(cx + _sideDx[side], cy + _sideDy[side]), true);
+        }
+    }
+    for (int i = 0; i < hmlen(mapEdges); ++i) {
+        int64_t key = mapEdges[i].key;
+        NavChunk* chunk = navGetChunk(nav, (int32_t)(key >> 32), (int32_t)key);
+        if (chunk) {
+            _rebuildEdges(chunk);
+        }
+    }
+    LOG_TRACE("Rebuilt edges of [%d] chunks", (int)hmlen(mapEdges));
+    hmfree(mapEdges);
+    hmfree(nav->mapDirty);
+    ecs_log_pop();
+}
+
+void cleanupNavWorld(NavWorld* nav)
+{
+    for (int i = 0; i < hmlen(nav->mapSectors); ++i) {
+        NavSector* sector = nav->mapSectors[i].value;
+        for (int c = 0; c < SECTOR_AREA; ++c) {
+            arrfree(sector->chunks[c].arrEdges);
+        }
+        memFree(sector);
+    }
+    hmfree(nav->mapSectors);
+    hmfree(nav->mapDirty);
+}
+
+////// ECS
+
+static void onTileHeightsSet(ecs_iter_t* it)
+{
+    TileHeights* tiles = ecs_field(it, TileHeights, 1);
+    ChunkCoord* coord = ecs_field(it, ChunkCoord, 2);
+    NavWorld* nav = ecs_singleton_get_mut(it->world, NavWorld);
+    MemTag tag = memUseTag(MEM_TERRAIN);
+    for (int i = 0; i < it->count; ++i) {
+        navUpdateChunk(nav, coord[i], &tiles[i]);
+    }
+    memUseTag(tag);
+}
+
+static void onNavChunkRemove(ecs_iter_t* it)
+{
+    ChunkCoord* coord = ecs_field(it, ChunkCoord, 2);
+    NavWorld* nav = ecs_field(it, NavWorld, 3);
+    MemTag tag = memUseTag(MEM_TERRAIN);
+    for (int i = 0; i < it->count; ++i) {
+        navRemoveChunk(nav, coord[i]);
+    }
+    memUseTag(tag);
+}
+
+static void rebuildNavSystem(ecs_iter_t* it)
+{
+    TRACE_ZONE(__func__);
+    NavWorld* nav = ecs_field(it, NavWorld, 1);
+    MemTag tag = memUseTag(MEM_TERRAIN);
+    navRebuildDirty(nav);
+    memUseTag(tag);
+}
+
+void registerNav(ecs_world_t* ecs)
+{
+    ECS_COMPONENT_DEFINE(ecs, NavWorld);
+    ecs_singleton_set(ecs, NavWorld, { 0 });
+
+    ECS_OBSERVER(ecs, onTileHeightsSet, EcsOnSet, [in] TileHeights, [in] ChunkCoord);
+    // Matches only while the singleton lives, not once the world is torn down
+    ECS_OBSERVER(ecs, onNavChunkRemove, EcsOnRemove, [in] TileHeights, [in] ChunkCoord, [inout] NavWorld($));
+    ECS_SYSTEM(ecs, rebuildNavSystem, TerrainPhase, NavWorld($));
+}
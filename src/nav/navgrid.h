@@ -0,0 +1,156 @@
+#pragma once
+
+#include <flecs.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "chunk.h"
+#include "sector.h"
+
+/// @brief Number of tiles per edge of a sector
+#define NAV_SECTOR_TILES (SECTOR_SIZE * CHUNK_SIZE)
+/// @brief Number of portal slots of a chunk, one per border tile per side
+#define NAV_CHUNK_PORTALS (4 * CHUNK_SIZE)
+
+extern ECS_COMPONENT_DECLARE(NavWorld);
+
+/// @brief Global tile coordinates
+typedef struct {
+    int x, y;
+} NavTile;
+
+/// @brief Chunk border. Portal slots are numbered `side * CHUNK_SIZE + offset`
+typedef enum {
+    NAV_EAST,
+    NAV_NORTH,
+    NAV_WEST,
+    NAV_SOUTH,
+} NavSide;
+
+/// @brief Path between two portals of the same chunk
+typedef struct {
+    uint8_t from, to;
+    float cost;
+} NavEdge;
+
+/// @brief Navigation data of one chunk
+typedef struct {
+    /// @brief Navigable tiles, bit x of row y
+    uint16_t rows[CHUNK_SIZE];
+    /// @brief Portal slots in use, bit offset of each side
+    uint16_t portals[4];
+    /// @brief Intra-chunk edges between portals, both directions
+    NavEdge* arrEdges;
+    bool present;
+} NavChunk;
+
+/// @brief Navigation data of one sector
+typedef struct {
+    SectorCoord coord;
+    NavChunk chunks[SECTOR_AREA];
+    /// @brief Bumped on every terrain change inside the sector
+    uint32_t generation;
+} NavSector;
+
+typedef struct {
+    int64_t key;
+    NavSector* value;
+} NavSectorEntry;
+
+typedef struct {
+    int64_t key;
+    bool value;
+} NavDirtyEntry;
+
+/// @brief Navigation over all loaded sectors. A singleton
+typedef struct {
+    /// @brief stb hashmap from sector key to sector
+    NavSectorEntry* mapSectors;
+    /// @brief stb hashmap of chunks whose portals must be rebuilt
+    NavDirtyEntry* mapDirty;
+} NavWorld;
+
+/// @brief Registers navigation types, the terrain observers and the
+/// portal maintenance system. Requires `registerEngine` and `registerChunk`
+/// @param ecs
+void registerNav(ecs_world_t* ecs);
+
+/// @brief Whether a tile of this height is navigable by ships
+static inline bool navIsWater(float height)
+{
+    return height < SEA_LEVEL;
+}
+
+/// @brief Packs two signed grid coordinates into a hashmap key
+static inline int64_t navKey(int x, int y)
+{
+    return (int64_t)(((uint64_t)(uint32_t)x << 32) | (uint32_t)y);
+}
+
+/// @brief Get a chunk by global chunk coordinates
+/// @param nav
+/// @param cx
+/// @param cy
+/// @return The chunk, or NULL if its sector is not loaded
+NavChunk* navGetChunk(const NavWorld* nav, int cx, int cy);
+
+/// @brief Get a sector by sector coordinates
+/// @return The sector, or NULL if it is not loaded
+NavSector* navGetSector(const NavWorld* nav, int sx, int sy);
+
+/// @brief Whether a global tile is navigable. Unloaded tiles are not
+bool navIsNavigable(const NavWorld* nav, int x, int y);
+
+/// @brief Copy tile heights of a chunk into the navigation grid, and
+/// schedule its portals for rebuilding
+/// @param nav
+/// @param coord
+/// @param tiles
+void navUpdateChunk(NavWorld* nav, ChunkCoord coord, const TileHeights* tiles);
+
+/// @brief Forget the tiles of a chunk that is gone, and schedule its portals
+/// for rebuilding, which closes them. Its sector stays loaded
+/// @param nav
+/// @param coord
+void navRemoveChunk(NavWorld* nav, ChunkCoord coord);
+
+/// @brief Rebuild portals and intra-chunk edges around all changed chunks
+/// @param nav
+void navRebuildDirty(NavWorld* nav);
+
+/// @brief Release all sectors
+/// @param nav
+void cleanupNavWorld(NavWorld* nav);
+
+/// @brief Shortest paths from one tile to every tile of its chunk, moving
+/// in 8 directions without cutting corners
+/// @param chunk
+/// @param tx Chunk-local X of the source
+/// @param ty Chunk-local Y of the source
+/// @param dist Output distances, `INFINITY` when unreachable
+/// @param parent Output index of the previous tile, -1 at the source. May be NULL
+void navChunkDijkstra(const NavChunk* chunk, int tx, int ty, float dist[CHUNK_AREA], int16_t parent[CHUNK_AREA]);
+
+/// @brief Chunk-local tile of a portal slot
+static inline void navPortalTile(int slot, int* tx, int* ty)
+{
+    int offset = slot % CHUNK_SIZE;
+    switch (slot / CHUNK_SIZE) {
+    case NAV_EAST:
+        *tx = CHUNK_SIZE - 1;
+        *ty = offset;
+        break;
+    case NAV_NORTH:
+        *tx = offset;
+        *ty = CHUNK_SIZE - 1;
+        break;
+    case NAV_WEST:
+        *tx = 0;
+        *ty = offset;
+        break;
+    default:
+        *tx = offset;
+        *ty = 0;
+        break;
+    }
+}
@@ -0,0 +1,284 @@
+#include "pathfind.h"
+
+#include <math.h>
+#include <stb_ds.h>
+#include <utils/arena.h>
+#include <utils/math.h>
+
+/// @brief Pseudo portal slots for the endpoints of a query
+#define NAV_SLOT_START NAV_CHUNK_PORTALS
+#define NAV_SLOT_GOAL (NAV_CHUNK_PORTALS + 1)
+/// @brief Slightly favours nodes closer to the goal among equal cost paths,
+/// which avoids expanding whole plateaus of open water
+#define NAV_TIE_BREAK 1.001f
+
+static const int _sideDx[4] = { 1, 0, -1, 0 };
+static const int _sideDy[4] = { 0, 1, 0, -1 };
+
+/// @brief Node of the abstract graph, a portal slot of a chunk
+typedef struct {
+    int cx, cy;
+    int slot;
+} _Node;
+
+static inline int64_t _nodeKey(_Node n)
+{
+    return (int64_t)(((uint64_t)(n.cx & 0xFFFFFF) << 40)
+        | ((uint64_t)(n.cy & 0xFFFFFF) << 16) | (uint64_t)n.slot);
+}
+
+static inline _Node _keyNode(int64_t key)
+{
+    // Shift up and back down to sign extend 24 bit coordinates
+    return (_Node) {
+        .cx = (int32_t)((uint32_t)((uint64_t)key >> 40) << 8) >> 8,
+        .cy = (int32_t)((uint32_t)((uint64_t)key >> 16) << 8) >> 8,
+        .slot = (int)(key & 0xFFFF),
+    };
+}
+
+typedef struct {
+    int64_t key;
+    struct {
+        float g;
+        int64_t parent;
+        bool closed;
+    } value;
+} _NodeRecord;
+
+typedef struct {
+    float f;
+    int64_t key;
+} _OpenItem;
+
+/// @brief Endpoints of a query and their distance fields inside their chunks
+typedef struct {
+    NavTile start, goal;
+    int startCx, startCy, goalCx, goalCy;
+    float startDist[CHUNK_AREA];
+    float goalDist[CHUNK_AREA];
+} _Query;
+
+static NavTile _nodeTile(const _Query* q, _Node n)
+{
+    if (n.slot == NAV_SLOT_START) {
+        return q->start;
+    }
+    if (n.slot == NAV_SLOT_GOAL) {
+        return q->goal;
+    }
+    int tx, ty;
+    navPortalTile(n.slot, &tx, &ty);
+    return (NavTile) { .x = n.cx * CHUNK_SIZE + tx, .y = n.cy * CHUNK_SIZE + ty };
+}
+
+static inline int _localIndex(NavTile t)
+{
+    return i32floormod(t.y, CHUNK_SIZE) * CHUNK_SIZE + i32floormod(t.x, CHUNK_SIZE);
+}
+
+/// @brief Octile distance, admissible for 8-connected moves
+static float _heuristic(NavTile a, NavTile b)
+{
+    float dx = fabsf((float)(a.x - b.x)), dy = fabsf((float)(a.y - b.y));
+    return dx > dy ? dx + (M_SQRT2 - 1.0f) * dy : dy + (M_SQRT2 - 1.0f) * dx;
+}
+
+static void _openPush(_OpenItem** arrOpen, _OpenItem item)
+{
+    _OpenItem* heap = *arrOpen;
+    arrput(heap, item);
+    int i = arrlen(heap) - 1;
+    while (i > 0) {
+        int p = (i - 1) / 2;
+        if (heap[p].f <= item.f) {
+            break;
+        }
+        heap[i] = heap[p];
+        i = p;
+    }
+    heap[i] = item;
+    *arrOpen = heap;
+}
+
+static _OpenItem _openPop(_OpenItem* heap)
+{
+    _OpenItem top = heap[0];
+    _OpenItem last = arrpop(heap);
+    int n = arrlen(heap);
+    if (n == 0) {
+        return top;
+    }
+    int i = 0;
+    for (;;) {
+        int c = 2 * i + 1;
+        if (c >= n) {
+            break;
+        }
+        if (c + 1 < n && heap[c + 1].f < heap[c].f) {
+            ++c;
+        }
+        if (last.f <= heap[c].f) {
+            break;
+        }
+        heap[i] = heap[c];
+        i = c;
+    }
+    heap[i] = last;
+    return top;
+}
+
+static void _relax(_NodeRecord** mapNodes, _OpenItem** arrOpen, const _Query* q,
+    int64_t from, float g, _Node to, float cost)
+{
+    int64_t key = _nodeKey(to);
+    float ng = g + cost;
+    _NodeRecord* rec = hmgetp_null(*mapNodes, key);
+    if (rec && (rec->value.closed || rec->value.g <= ng)) {
+        return;
+    }
+    _NodeRecord r = { .key = key, .value = { .g = ng, .parent = from, .closed = false } };
+    hmputs(*mapNodes, r);
+    _openPush(arrOpen, (_OpenItem) { .f = ng + NAV_TIE_BREAK * _heuristic(_nodeTile(q, to), q->goal), .key = key });
+}
+
+/// @brief A* over the portal graph
+/// @return stb array of node keys from goal back to start, NULL if unreachable
+static int64_t* _searchAbstract(const NavWorld* nav, const _Query* q)
+{
+    _NodeRecord* mapNodes = NULL;
+    _OpenItem* arrOpen = NULL;
+    int64_t* arrResult = NULL;
+
+    _Node startNode = { .cx = q->startCx, .cy = q->startCy, .slot = NAV_SLOT_START };
+    _Node goalNode = { .cx = q->goalCx, .cy = q->goalCy, .slot = NAV_SLOT_GOAL };
+    int64_t goalKey = _nodeKey(goalNode);
+    _relax(&mapNodes, &arrOpen, q, -1, 0.0f, startNode, 0.0f);
+
+    while (arrlen(arrOpen) > 0) {
+        _OpenItem cur = _openPop(arrOpen);
+        _NodeRecord* rec = hmgetp(mapNodes, cur.key);
+        if (rec->value.closed) {
+            continue;
+        }
+        rec->value.closed = true;
+        float g = rec->value.g;
+        if (cur.key == goalKey) {
+            for (int64_t k = goalKey; k != -1; k = hmgetp(mapNodes, k)->value.parent) {
+                arrput(arrResult, k);
+            }
+            break;
+        }
+        _Node node = _keyNode(cur.key);
+        const NavChunk* chunk = navGetChunk(nav, node.cx, node.cy);
+        bool inGoalChunk = node.cx == q->goalCx && node.cy == q->goalCy;
+
+        if (node.slot == NAV_SLOT_START) {
+            for (int s = 0; s < NAV_CHUNK_PORTALS; ++s) {
+                if (!(chunk->portals[s / CHUNK_SIZE] >> (s % CHUNK_SIZE) & 1)) {
+                    continue;
+                }
+                _Node to = { .cx = node.cx, .cy = node.cy, .slot = s };
+                float d = q->startDist[_localIndex(_nodeTile(q, to))];
+                if (isfinite(d)) {
+                    _relax(&mapNodes, &arrOpen, q, cur.key, g, to, d);
+                }
+            }
+            float d = q->startDist[_localIndex(q->goal)];
+            if (inGoalChunk && isfinite(d)) {
+                _relax(&mapNodes, &arrOpen, q, cur.key, g, goalNode, d);
+            }
+            continue;
+        }
+
+        // Step across the border into the neighbouring chunk
+        int side = node.slot / CHUNK_SIZE, offset = node.slot % CHUNK_SIZE;
+        int opposite = (side + 2) % 4;
+        _Node across = { .cx = node.cx + _sideDx[side], .cy = node.cy + _sideDy[side],
+            .slot = opposite * CHUNK_SIZE + offset };
+        const NavChunk* neighbour = navGetChunk(nav, across.cx, across.cy);
+        if (neighbour && (neighbour->portals[opposite] >> offset & 1)) {
+            _relax(&mapNodes, &arrOpen, q, cur.key, g, across, 1.0f);
+        }
+        // Move to other portals of the same chunk
+        for (int e = 0; e < arrlen(chunk->arrEdges); ++e) {
+            NavEdge edge = chunk->arrEdges[e];
+            if (edge.from == node.slot) {
+                _Node to = { .cx = node.cx, .cy = node.cy, .slot = edge.to };
+                _relax(&mapNodes, &arrOpen, q, cur.key, g, to, edge.cost);
+            }
+        }
+        if (inGoalChunk) {
+            float d = q->goalDist[_localIndex(_nodeTile(q, node))];
+            if (isfinite(d)) {
+                _relax(&mapNodes, &arrOpen, q, cur.key, g, goalNode, d);
+            }
+        }
+    }
+    hmfree(mapNodes);
+    arrfree(arrOpen);
+    return arrResult;
+}
+
+/// @brief Append the tiles after `from` up to and including `to`, both
+/// inside the same chunk
+static void _refineLocal(const NavWorld* nav, NavTile from, NavTile to, NavTile** arrPath)
+{
+    int cx = i32floordiv(from.x, CHUNK_SIZE), cy = i32floordiv(from.y, CHUNK_SIZE);
+    const NavChunk* chunk = navGetChunk(nav, cx, cy);
+    float dist[CHUNK_AREA];
+    int16_t parent[CHUNK_AREA];
+    navChunkDijkstra(chunk, i32floormod(from.x, CHUNK_SIZE), i32floormod(from.y, CHUNK_SIZE), dist, parent);
+
+    int first = arrlen(*arrPath);
+    for (int i = _localIndex(to); parent[i] != -1; i = parent[i]) {
+        arrput(*arrPath, ((NavTile) { .x = cx * CHUNK_SIZE + i % CHUNK_SIZE, .y = cy * CHUNK_SIZE + i / CHUNK_SIZE }));
+    }
+    // Tiles were appended goal first
+    for (int i = first, j = arrlen(*arrPath) - 1; i < j; ++i, --j) {
+        NavTile t = (*arrPath)[i];
+        (*arrPath)[i] = (*arrPath)[j];
+        (*arrPath)[j] = t;
+    }
+}
+
+NavTile* navFindPath(const NavWorld* nav, NavTile start, NavTile goal)
+{
+    if (!navIsNavigable(nav, start.x, start.y) || !navIsNavigable(nav, goal.x, goal.y)) {
+        return NULL;
+    }
+    Arena* scratch = scratchArena();
+    ArenaMark mark = arenaMark(scratch);
+    _Query* q = ARENA_NEW(scratch, _Query, 1);
+    q->start = start;
+    q->goal = goal;
+    q->startCx = i32floordiv(start.x, CHUNK_SIZE);
+    q->startCy = i32floordiv(start.y, CHUNK_SIZE);
+    q->goalCx = i32floordiv(goal.x, CHUNK_SIZE);
+    q->goalCy = i32floordiv(goal.y, CHUNK_SIZE);
+    navChunkDijkstra(navGetChunk(nav, q->startCx, q->startCy),
+        i32floormod(start.x, CHUNK_SIZE), i32floormod(start.y, CHUNK_SIZE), q->startDist, NULL);
+    navChunkDijkstra(navGetChunk(nav, q->goalCx, q->goalCy),
+        i32floormod(goal.x, CHUNK_SIZE), i32floormod(goal.y, CHUNK_SIZE), q->goalDist, NULL);
+
+    // Only the path outlives the query
+    Arena* previous = stbdsUseArena(scratch);
+    int64_t* arrNodes = _searchAbstract(nav, q);
+    stbdsUseArena(previous);
+    NavTile* arrPath = NULL;
+    if (arrNodes) {
+        arrput(arrPath, start);
+        // Nodes are ordered goal first
+        for (int i = arrlen(arrNodes) - 1; i > 0; --i) {
+            _Node a = _keyNode(arrNodes[i]), b = _keyNode(arrNodes[i - 1]);
+            NavTile to = _nodeTile(q, b);
+            if (a.cx == b.cx && a.cy == b.cy) {
+                _refineLocal(nav, _nodeTile(q, a), to, &arrPath);
+            } else {
+                arrput(arrPath, to);
+            }
+        }
+    }
+    arenaRelease(scratch, mark);
+    return arrPath;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include "navgrid.h"
+
+/// @brief Find a path with hierarchical A*. The search runs over the portal
+/// graph, and only chunks on the resulting route are searched tile by tile
+/// @param nav
+/// @param start Global tile to start from
+/// @param goal Global tile to reach
+/// @return stb array of tiles from start to goal inclusive, or NULL if the
+/// goal is unreachable. Free with `arrfree`
+NavTile* navFindPath(const NavWorld* nav, NavTile start, NavTile goal);
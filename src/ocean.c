@@ -0,0 +1,299 @@
+#include "ocean.h"
+
+#include <math.h>
+#include <utils/trace.h>
+
+#include "chunk.h"
+#include "engine.h"
+#include "lod.h"
+
+extern ECS_COMPONENT_DECLARE(Position);
+extern ECS_COMPONENT_DECLARE(Rotation);
+extern ECS_COMPONENT_DECLARE(AngularVelocity);
+extern ECS_COMPONENT_DECLARE(Acceleration);
+
+ECS_COMPONENT_DECLARE(SeaState);
+ECS_COMPONENT_DECLARE(Hull);
+
+#define OCEAN_PI 3.14159265358979f
+#define OCEAN_TWO_PI 6.28318530717959f
+#define OCEAN_GRAVITY 9.81f
+#define OCEAN_WATER_DENSITY 1025.0f
+
+/// @brief Adding and removing 1.5 * 2^23 rounds a float to the nearest integer.
+/// Unlike `rintf` this vectorizes everywhere
+#define OCEAN_ROUND_MAGIC 12582912.0f
+
+/// @brief Sine polynomial on [-pi/2, pi/2]
+static inline float _sinPoly(float x)
+{
+    float x2 = x * x;
+    return x * (1.0f + x2 * (-1.0f / 6.0f + x2 * (1.0f / 120.0f + x2 * (-1.0f / 5040.0f + x2 * (1.0f / 362880.0f)))));
+}
+
+/// @brief Computes x - m pi in two steps, which keeps precision for large angles
+static inline float _reducePi(float x, float m)
+{
+    return (x - m * 3.140625f) - m * 9.67653589793e-4f;
+}
+
+/// @brief Polynomial sine, accurate to ~4e-6 for angles up to ~1e4 rad.
+/// Branch free so that loops over batches vectorize
+static inline float _fastSin(float x)
+{
+    // sin(x) = (-1)^n sin(x - n pi), with x - n pi in [-pi/2, pi/2]
+    float n = (x * (1.0f / OCEAN_PI) + OCEAN_ROUND_MAGIC) - OCEAN_ROUND_MAGIC;
+    float sign = (float)(1 - 2 * ((int)n & 1));
+    return sign * _sinPoly(_reducePi(x, n));
+}
+
+/// @brief Polynomial cosine, see `_fastSin`
+static inline float _fastCos(float x)
+{
+    // cos(x) = -(-1)^n sin(x - (n + 1/2) pi)
+    float n = (x * (1.0f / OCEAN_PI) - 0.5f + OCEAN_ROUND_MAGIC) - OCEAN_ROUND_MAGIC;
+    float sign = (float)(2 * ((int)n & 1) - 1);
+    return sign * _sinPoly(_reducePi(x, n + 0.5f));
+}
+
+static inline Position _quatRotate(Rotation q, Position v)
+{
+    // v' = v + 2w (q x v) + 2 q x (q x v)
+    float tx = 2.0f * (q.y * v.z - q.z * v.y);
+    float ty = 2.0f * (q.z * v.x - q.x * v.z);
+    float tz = 2.0f * (q.x * v.y - q.y * v.x);
+    return (Position) {
+        .x = v.x + q.w * tx + (q.y * tz - q.z * ty),
+        .y = v.y + q.w * ty + (q.z * tx - q.x * tz),
+        .z = v.z + q.w * tz + (q.x * ty - q.y * tx),
+    };
+}
+
+static inline Rotation _quatConjugate(Rotation q)
+{
+    return (Rotation) { .x = -q.x, .y = -q.y, .z = -q.z, .w = q.w };
+}
+
+SeaState newSeaState(const GerstnerWave* waves, int nWaves)
+{
+    if (nWaves > OCEAN_MAX_WAVES) {
+        ecs_abort(1, "Too many waves [%d], at most [%d]", nWaves, OCEAN_MAX_WAVES);
+    }
+    SeaState sea = { .nWaves = nWaves };
+    SeaStateTable* t = &sea.table;
+    for (int i = 0; i < nWaves; ++i) {
+        GerstnerWave w = waves[i];
+        float len = sqrtf(w.dirX * w.dirX + w.dirY * w.dirY);
+        w.dirX /= len;
+        w.dirY /= len;
+        sea.waves[i] = w;
+
+        float k = OCEAN_TWO_PI / w.wavelength;
+        // Spread steepness over all waves so that crests never loop over
+        float qa = w.steepness / (k * nWaves);
+        t->kx[i] = k * w.dirX;
+        t->ky[i] = k * w.dirY;
+        t->amp[i] = w.amplitude;
+        t->qax[i] = qa * w.dirX;
+        t->qay[i] = qa * w.dirY;
+        t->omega[i] = sqrtf(OCEAN_GRAVITY * k);
+    }
+    updateSeaState(&sea, 0.0);
+    return sea;
+}
+
+SeaState newSeaStateDefault()
+{
+    static const GerstnerWave waves[] = {
+        { .dirX = 1.0f, .dirY = 0.2f, .wavelength = 60.0f, .amplitude = 0.9f, .steepness = 0.5f, .phase = 0.0f },
+        { .dirX = 0.8f, .dirY = 0.6f, .wavelength = 31.0f, .amplitude = 0.45f, .steepness = 0.5f, .phase = 1.3f },
+        { .dirX = 0.3f, .dirY = 1.0f, .wavelength = 17.0f, .amplitude = 0.2f, .steepness = 0.4f, .phase = 2.1f },
+        { .dirX = -0.4f, .dirY = 1.0f, .wavelength = 9.0f, .amplitude = 0.1f, .steepness = 0.3f, .phase = 4.0f },
+    };
+    return newSeaState(waves, sizeof(waves) / sizeof(*waves));
+}
+
+void updateSeaState(SeaState* sea, double time)
+{
+    sea->time = time;
+    SeaStateTable* t = &sea->table;
+    for (int i = 0; i < sea->nWaves; ++i) {
+        // Reduce in double so that phases stay precise over long sessions
+        double phase = sea->waves[i].phase - t->omega[i] * time;
+        t->phaseT[i] = (float)fmod(phase, OCEAN_TWO_PI);
+    }
+}
+
+/// @brief Horizontal displacement of the surface points that originate
+/// from one batch of points
+static void _displaceBatch(const SeaStateTable* t, int nWaves,
+    const float* xs, const float* ys, float* dxs, float* dys)
+{
+    for (int l = 0; l < OCEAN_BATCH; ++l) {
+        dxs[l] = 0.0f;
+        dys[l] = 0.0f;
+    }
+    for (int w = 0; w < nWaves; ++w) {
+        float kx = t->kx[w], ky = t->ky[w], ph = t->phaseT[w];
+        float qax = t->qax[w], qay = t->qay[w];
+        for (int l = 0; l < OCEAN_BATCH; ++l) {
+            float c = _fastCos(kx * xs[l] + ky * ys[l] + ph);
+            dxs[l] -= qax * c;
+            dys[l] -= qay * c;
+        }
+    }
+}
+
+/// @brief Height of the surface points that originate from one batch of points
+static void _heightBatch(const SeaStateTable* t, int nWaves,
+    const float* xs, const float* ys, float* zs)
+{
+    for (int l = 0; l < OCEAN_BATCH; ++l) {
+        zs[l] = SEA_LEVEL;
+    }
+    for (int w = 0; w < nWaves; ++w) {
+        float kx = t->kx[w], ky = t->ky[w], ph = t->phaseT[w];
+        float amp = t->amp[w];
+        for (int l = 0; l < OCEAN_BATCH; ++l) {
+            zs[l] += amp * _fastSin(kx * xs[l] + ky * ys[l] + ph);
+        }
+    }
+}
+
+void sampleSeaSurface(const SeaState* sea, const float* xs, const float* ys, float* zs, int n)
+{
+    const SeaStateTable* t = &sea->table;
+    for (int base = 0; base < n; base += OCEAN_BATCH) {
+        int m = n - base < OCEAN_BATCH ? n - base : OCEAN_BATCH;
+        float bx[OCEAN_BATCH], by[OCEAN_BATCH], dx[OCEAN_BATCH], dy[OCEAN_BATCH], bz[OCEAN_BATCH];
+        for (int l = 0; l < OCEAN_BATCH; ++l) {
+            // Pad the tail with the last point
+            int src = base + (l < m ? l : m - 1);
+            bx[l] = xs[src];
+            by[l] = ys[src];
+        }
+        // Gerstner waves move surface points sideways. One fixed point
+        // iteration finds the point whose displaced position is above us
+        _displaceBatch(t, sea->nWaves, bx, by, dx, dy);
+        for (int l = 0; l < OCEAN_BATCH; ++l) {
+            bx[l] -= dx[l];
+            by[l] -= dy[l];
+        }
+        _heightBatch(t, sea->nWaves, bx, by, bz);
+        for (int l = 0; l < m; ++l) {
+            zs[base + l] = bz[l];
+        }
+    }
+}
+
+void applyHullBuoyancy(const SeaState* sea, const Hull* hull, Position pos, Rotation rot,
+    Acceleration* acc, AngularVelocity* angVel, float dt)
+{
+    ecs_assert(hull->nSamples <= HULL_MAX_SAMPLES, ECS_INVALID_PARAMETER, "Too many hull samples");
+    int n = hull->nSamples < HULL_MAX_SAMPLES ? hull->nSamples : HULL_MAX_SAMPLES;
+    Position arms[HULL_MAX_SAMPLES];
+    float xs[HULL_MAX_SAMPLES], ys[HULL_MAX_SAMPLES], zs[HULL_MAX_SAMPLES];
+    for (int i = 0; i < n; ++i) {
+        arms[i] = _quatRotate(rot, hull->samples[i]);
+        xs[i] = pos.x + arms[i].x;
+        ys[i] = pos.y + arms[i].y;
+    }
+    sampleSeaSurface(sea, xs, ys, zs, n);
+
+    float forcePerSample = OCEAN_WATER_DENSITY * OCEAN_GRAVITY * hull->sampleVolume;
+    float force = 0.0f;
+    Position torque = { 0 };
+    for (int i = 0; i < n; ++i) {
+        // Samples sit in the middle of their hull column
+        float depth = zs[i] - (pos.z + arms[i].z);
+        float submerged = depth / hull->sampleHeight + 0.5f;
+        submerged = submerged < 0.0f ? 0.0f : (submerged > 1.0f ? 1.0f : submerged);
+        float f = forcePerSample * submerged;
+        force += f;
+        // Force is straight up, so arm x (0, 0, f) = (y f, -x f, 0)
+        torque.x += arms[i].y * f;
+        torque.y -= arms[i].x * f;
+    }
+    acc->z += force / hull->mass;
+
+    // Inertia is known in body space only
+    Position bodyTorque = _quatRotate(_quatConjugate(rot), torque);
+    Position bodyDelta = {
+        .x = bodyTorque.x / hull->inertia[0] * dt,
+        .y = bodyTorque.y / hull->inertia[1] * dt,
+        .z = bodyTorque.z / hull->inertia[2] * dt,
+    };
+    Position delta = _quatRotate(rot, bodyDelta);
+    angVel->x += delta.x;
+    angVel->y += delta.y;
+    angVel->z += delta.z;
+}
+
+static void onHullSet(ecs_iter_t* it)
+{
+    Hull* hull = ecs_field(it, Hull, 1);
+    for (int i = 0; i < it->count; ++i) {
+        if (hull[i].nSamples < 0 || hull[i].nSamples > HULL_MAX_SAMPLES) {
+            ecs_abort(1, "Invalid number of hull samples [%d], at most [%d]", hull[i].nSamples, HULL_MAX_SAMPLES);
+        }
+    }
+}
+
+static void updateSeaStateSystem(ecs_iter_t* it)
+{
+    TRACE_ZONE(__func__);
+    SeaState* sea = ecs_field(it, SeaState, 1);
+    updateSeaState(sea, sea->time + it->delta_time);
+}
+
+static void applyBuoyancySystem(ecs_iter_t* it)
+{
+    TRACE_ZONE(__func__);
+    Position* p = ecs_field(it, Position, 1);
+    Rotation* r = ecs_field(it, Rotation, 2);
+    Hull* hull = ecs_field(it, Hull, 3);
+    Acceleration* acc = ecs_field(it, Acceleration, 4);
+    AngularVelocity* angVel = ecs_field(it, AngularVelocity, 5);
+    SeaState* sea = ecs_field(it, SeaState, 6);
+    UpdateScheduler* sched = ecs_field(it, UpdateScheduler, 7);
+    UpdateRate* rate = ecs_field_is_set(it, 8) ? ecs_field(it, UpdateRate, 8) : NULL;
+    for (int i = 0; i < it->count; ++i) {
+        const UpdateRate* ri = rate ? &rate[i] : NULL;
+        if (!lodIsDue(sched, ri)) {
+            continue;
+        }
+        // Distant hulls update less often, so they take the impulse of all
+        // the ticks they skip at once. Acceleration is of this tick alone,
+        // its integrator steps over the period
+        uint32_t period = lodPeriod(sched, ri);
+        applyHullBuoyancy(sea, &hull[i], p[i], r[i], &acc[i], &angVel[i], it->delta_time * period);
+    }
+}
+
+void registerOcean(ecs_world_t* ecs)
+{
+    ECS_COMPONENT_DEFINE(ecs, SeaState);
+    ECS_COMPONENT_DEFINE(ecs, Hull);
+
+    SeaState sea = newSeaStateDefault();
+    ecs_set_ptr(ecs, ecs_id(SeaState), SeaState, &sea);
+
+    ECS_OBSERVER(ecs, onHullSet, EcsOnSet, [in] Hull);
+
+    ECS_SYSTEM(ecs, updateSeaStateSystem, SimulatePhase, SeaState($));
+    // Reads the sea state and scheduler singletons, written by earlier
+    // systems of the phase, and the pose, hull and rate of each ship. Adds
+    // only to that ship's acceleration, cleared earlier in the phase, and
+    // angular velocity
+    ecs_system(ecs, {
+        .entity = ecs_entity(ecs, {
+            .name = "applyBuoyancySystem",
+            .add = { ecs_dependson(SimulatePhase) },
+        }),
+        .query.filter.expr = "[in] Position, [in] Rotation, [in] Hull, "
+                             "[inout] Acceleration, [inout] AngularVelocity, [in] SeaState($), "
+                             "[in] UpdateScheduler($), [in] ?UpdateRate",
+        .callback = applyBuoyancySystem,
+        .multi_threaded = true,
+    });
+}
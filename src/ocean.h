@@ -0,0 +1,108 @@
+#pragma once
+
+#include <flecs.h>
+
+#include "spatial.h"
+
+/// @brief Maximum number of wave trains in a sea state
+#define OCEAN_MAX_WAVES 16
+/// @brief Number of sample points evaluated together. Inner loops run over
+/// exactly this many lanes so that the compiler can vectorize them
+#define OCEAN_BATCH 8
+/// @brief Maximum number of buoyancy sample points on a hull
+#define HULL_MAX_SAMPLES 32
+
+extern ECS_COMPONENT_DECLARE(SeaState);
+extern ECS_COMPONENT_DECLARE(Hull);
+
+/// @brief One Gerstner wave train
+typedef struct {
+    /// @brief Direction of travel, normalized on construction
+    float dirX, dirY;
+    /// @brief Crest to crest distance in m
+    float wavelength;
+    /// @brief Crest height above mean sea level in m
+    float amplitude;
+    /// @brief Sharpness of crests in [0, 1]. 0 is a sine wave
+    float steepness;
+    /// @brief Initial phase in rad
+    float phase;
+} GerstnerWave;
+
+/// @brief Per-wave constants, stored as structure of arrays for batching
+typedef struct {
+    /// @brief Wave vector, direction times wave number
+    float kx[OCEAN_MAX_WAVES], ky[OCEAN_MAX_WAVES];
+    /// @brief Vertical amplitude
+    float amp[OCEAN_MAX_WAVES];
+    /// @brief Horizontal displacement amplitude along X and Y
+    float qax[OCEAN_MAX_WAVES], qay[OCEAN_MAX_WAVES];
+    /// @brief Angular frequency from the deep water dispersion relation
+    float omega[OCEAN_MAX_WAVES];
+    /// @brief Phase at the current tick, rebuilt by `updateSeaState`
+    float phaseT[OCEAN_MAX_WAVES];
+} SeaStateTable;
+
+/// @brief Sea surface model, a sum of Gerstner waves around `SEA_LEVEL`
+typedef struct {
+    int nWaves;
+    /// @brief Simulation time of the cached table in s
+    double time;
+    GerstnerWave waves[OCEAN_MAX_WAVES];
+    SeaStateTable table;
+} SeaState;
+
+/// @brief Buoyancy description of a ship hull
+typedef struct {
+    /// @brief At most `HULL_MAX_SAMPLES`, checked when the hull is set
+    int nSamples;
+    /// @brief Mass in kg
+    float mass;
+    /// @brief Principal moments of inertia in kg m^2, in body space
+    float inertia[3];
+    /// @brief Volume in m^3 displaced by a fully submerged sample
+    float sampleVolume;
+    /// @brief Vertical extent in m of the hull column around a sample
+    float sampleHeight;
+    /// @brief Sample points relative to the center of mass, in body space
+    Position samples[HULL_MAX_SAMPLES];
+} Hull;
+
+/// @brief Registers ocean types and the sea state and buoyancy systems.
+/// Requires `registerEngine`, `spatial_register` and `registerLod`
+/// @param ecs
+void registerOcean(ecs_world_t* ecs);
+
+/// @brief Create a sea state from wave trains
+/// @param waves
+/// @param nWaves Number of waves, at most `OCEAN_MAX_WAVES`
+/// @return Sea state with its table built for time 0
+SeaState newSeaState(const GerstnerWave* waves, int nWaves);
+
+/// @brief Create a moderate sea with a handful of waves
+/// @return Sea state with its table built for time 0
+SeaState newSeaStateDefault();
+
+/// @brief Rebuild the per-tick table. Call once per tick, before sampling
+/// @param sea
+/// @param time Simulation time in s
+void updateSeaState(SeaState* sea, double time);
+
+/// @brief Sample the sea surface height at many points
+/// @param sea
+/// @param xs X coordinates of points
+/// @param ys Y coordinates of points
+/// @param zs Output surface heights
+/// @param n Number of points
+void sampleSeaSurface(const SeaState* sea, const float* xs, const float* ys, float* zs, int n);
+
+/// @brief Add buoyancy of one hull to its acceleration and angular velocity
+/// @param sea
+/// @param hull
+/// @param pos Center of mass
+/// @param rot
+/// @param acc The buoyant force divided by mass is added to it
+/// @param angVel Integrates the buoyant torque over `dt`
+/// @param dt Time step in s
+void applyHullBuoyancy(const SeaState* sea, const Hull* hull, Position pos, Rotation rot,
+    Acceleration* acc, AngularVelocity* angVel, float dt);
@@ -3,13 +3,13 @@
 extern ECS_COMPONENT_DECLARE(Position);
 extern ECS_COMPONENT_DECLARE(Rotation);
 
-ECS_COMPONENT_DECLARE(PlayerControlled);
-ECS_COMPONENT_DECLARE(Spectator);
+ECS_TAG_DECLARE(PlayerControlled);
+ECS_TAG_DECLARE(Spectator);
 
 void player_register(ecs_world_t* ecs)
 {
-    ECS_TAG(ecs, PlayerControlled);
-    ECS_TAG(ecs, Spectator);
+    ECS_TAG_DEFINE(ecs, PlayerControlled);
+    ECS_TAG_DEFINE(ecs, Spectator);
 }
 
 void spectator_spawn(ecs_world_t* ecs, Position pos, Rotation rot)
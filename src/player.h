@@ -4,6 +4,11 @@
 
 #include "spatial.h"
 
+/// @brief Entity controlled by a local player
+extern ECS_TAG_DECLARE(PlayerControlled);
+/// @brief Entity the world is observed from
+extern ECS_TAG_DECLARE(Spectator);
+
 /// @brief Registers types for players, spectators, etc
 /// @param ecs
 void player_register(ecs_world_t* ecs);
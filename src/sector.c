@@ -1,5 +1,8 @@
 #include "sector.h"
 
+#include <utils/log.h>
+#include <utils/trace.h>
+
 ECS_COMPONENT_DECLARE(SectorCoord);
 ECS_COMPONENT_DECLARE(SectorHeight);
 
@@ -11,7 +14,8 @@ void registerSector(ecs_world_t* ecs)
 
 ecs_entity_t spawnSector(ecs_world_t* ecs, int x, int y, float h, ecs_entity_t (*chunk_spawner)(ecs_world_t*, int, int, float))
 {
-    ecs_trace("Spawning sector [%d, %d, %f]", x, y, h);
+    TRACE_ZONE(__func__);
+    LOG_TRACE("Spawning sector [%d, %d, %f]", x, y, h);
     ecs_entity_t e = ecs_new_id(ecs);
     ecs_set(ecs, e, SectorCoord, { .x = x, .y = y });
     ecs_set(ecs, e, SectorHeight, { .h = h });
@@ -20,7 +24,7 @@ ecs_entity_t spawnSector(ecs_world_t* ecs, int x, int y, float h, ecs_entity_t (
     }
     for (int i = 0; i < SECTOR_SIZE; ++i) {
         for (int j = 0; j < SECTOR_SIZE; ++j) {
-            ecs_entity_t c = chunk_spawner(ecs, x, y, h);
+            ecs_entity_t c = chunk_spawner(ecs, x * SECTOR_SIZE + j, y * SECTOR_SIZE + i, h);
             ecs_add_pair(ecs, c, EcsChildOf, e);
         }
     }
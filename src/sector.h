@@ -9,7 +9,7 @@
 extern ECS_COMPONENT_DECLARE(SectorCoord);
 extern ECS_COMPONENT_DECLARE(SectorHeight);
 
-/// @brief Sector coordinates, which is chunk coordinates / 16
+/// @brief Sector coordinates, which is chunk coordinates / SECTOR_SIZE
 typedef struct {
     int x, y;
 } SectorCoord;
@@ -26,7 +26,7 @@ void registerSector(ecs_world_t* ecs);
 /// @param x Sector coordinate X
 /// @param y Sector coordinate Y
 /// @param h Sector height
-/// @param chunk_spawner Chunk spawn function. If NULL, chunks are not spawned
+/// @param chunk_spawner Chunk spawn function, called with global chunk coordinates. If NULL, chunks are not spawned
 /// @return Sector ID
 ecs_entity_t spawnSector(ecs_world_t* ecs, int x, int y, float h,
     ecs_entity_t (*chunk_spawner)(ecs_world_t*, int, int, float));
\ No newline at end of file
@@ -0,0 +1,385 @@
+#include "shoreline.h"
+
+#include <math.h>
+#include <stb_ds.h>
+#include <string.h>
+#include <utils/arena.h>
+#include <utils/log.h>
+#include <utils/math.h>
+#include <utils/memtrack.h>
+#include <utils/trace.h>
+
+#include "engine.h"
+
+ECS_COMPONENT_DECLARE(ShoreDistance);
+ECS_COMPONENT_DECLARE(ShoreWorld);
+
+/// @brief Tiles further than this cannot change a clamped distance
+#define SHORE_MARGIN ((int)SHORE_MAX_DISTANCE + 2)
+#define SHORE_INF 1e20f
+
+enum {
+    _LAND,
+    _WATER,
+    _UNKNOWN,
+};
+
+/// @brief Squared distances to the nearest land and water tiles of a grid
+typedef struct {
+    int w, h;
+    uint8_t* mask;
+    float* toLand;
+    float* toWater;
+} _Edt;
+
+/// @brief 1D squared distance transform of a sampled function (Felzenszwalb
+/// and Huttenlocher). Infinite samples are skipped instead of entering the
+/// lower envelope. `v` and `z` are scratch of n and n + 1 elements
+static void _edt1d(const float* f, float* d, int n, int* v, float* z)
+{
+    int k = -1;
+    for (int q = 0; q < n; ++q) {
+        if (f[q] >= SHORE_INF) {
+            continue;
+        }
+        if (k < 0) {
+            k = 0;
+            v[0] = q;
+            z[0] = -SHORE_INF;
+            z[1] = SHORE_INF;
+            continue;
+        }
+        float s;
+        for (;;) {
+            int p = v[k];
+            s = ((f[q] + (float)q * q) - (f[p] + (float)p * p)) / (2.0f * (q - p));
+            // z[0] is minus infinity, so this stops at the first parabola
+            if (s > z[k]) {
+                break;
+            }
+            --k;
+        }
+        ++k;
+        v[k] = q;
+        z[k] = s;
+        z[k + 1] = SHORE_INF;
+    }
+    if (k < 0) {
+        for (int q = 0; q < n; ++q) {
+            d[q] = SHORE_INF;
+        }
+        return;
+    }
+    k = 0;
+    for (int q = 0; q < n; ++q) {
+        while (z[k + 1] < q) {
+            ++k;
+        }
+        float dq = (float)(q - v[k]);
+        d[q] = dq * dq + f[v[k]];
+    }
+}
+
+/// @brief Transform along columns [begin, end)
+static void _edtColumns(void* ctx, int begin, int end)
+{
+    _Edt* edt = ctx;
+    int h = edt->h;
+    Arena* scratch = scratchArena();
+    ArenaMark mark = arenaMark(scratch);
+    float* f = ARENA_NEW(scratch, float, h * 2);
+    float* z = ARENA_NEW(scratch, float, h + 1);
+    int* v = ARENA_NEW(scratch, int, h);
+    float* d = f + h;
+    for (int x = begin; x < end; ++x) {
+        for (int y = 0; y < h; ++y) {
+            f[y] = edt->mask[y * edt->w + x] == _LAND ? 0.0f : SHORE_INF;
+        }
+        _edt1d(f, d, h, v, z);
+        for (int y = 0; y < h; ++y) {
+            edt->toLand[y * edt->w + x] = d[y];
+        }
+        for (int y = 0; y < h; ++y) {
+            f[y] = edt->mask[y * edt->w + x] == _WATER ? 0.0f : SHORE_INF;
+        }
+        _edt1d(f, d, h, v, z);
+        for (int y = 0; y < h; ++y) {
+            edt->toWater[y * edt->w + x] = d[y];
+        }
+    }
+    arenaRelease(scratch, mark);
+}
+
+/// @brief Transform along rows [begin, end), after the columns
+static void _edtRows(void* ctx, int begin, int end)
+{
+    _Edt* edt = ctx;
+    int w = edt->w;
+    Arena* scratch = scratchArena();
+    ArenaMark mark = arenaMark(scratch);
+    float* d = ARENA_NEW(scratch, float, w);
+    float* z = ARENA_NEW(scratch, float, w + 1);
+    int* v = ARENA_NEW(scratch, int, w);
+    for (int y = begin; y < end; ++y) {
+        float* land = &edt->toLand[y * w];
+        float* water = &edt->toWater[y * w];
+        _edt1d(land, d, w, v, z);
+        memcpy(land, d, sizeof(float) * w);
+        _edt1d(water, d, w, v, z);
+        memcpy(water, d, sizeof(float) * w);
+    }
+    arenaRelease(scratch, mark);
+}
+
+/// @brief Fill the land and water mask of a rectangle, one chunk at a time
+static void _fillMask(const NavWorld* nav, ShoreRect r, uint8_t* mask)
+{
+    int w = r.x1 - r.x0;
+    for (int cy = i32floordiv(r.y0, CHUNK_SIZE); cy * CHUNK_SIZE < r.y1; ++cy) {
+        for (int cx = i32floordiv(r.x0, CHUNK_SIZE); cx * CHUNK_SIZE < r.x1; ++cx) {
+            const NavChunk* chunk = navGetChunk(nav, cx, cy);
+            int y0 = i32max(r.y0, cy * CHUNK_SIZE), y1 = i32min(r.y1, (cy + 1) * CHUNK_SIZE);
+            int x0 = i32max(r.x0, cx * CHUNK_SIZE), x1 = i32min(r.x1, (cx + 1) * CHUNK_SIZE);
+            for (int y = y0; y < y1; ++y) {
+                for (int x = x0; x < x1; ++x) {
+                    uint8_t m = _UNKNOWN;
+                    if (chunk && chunk->present) {
+                        m = (chunk->rows[y - cy * CHUNK_SIZE] >> (x - cx * CHUNK_SIZE)) & 1 ? _WATER : _LAND;
+                    }
+                    mask[(y - r.y0) * w + (x - r.x0)] = m;
+                }
+            }
+        }
+    }
+}
+
+static inline int8_t _quantize(float d)
+{
+    float q = roundf(d * SHORE_STEPS_PER_TILE);
+    return (int8_t)(q < -127.0f ? -127.0f : (q > 127.0f ? 127.0f : q));
+}
+
+void shoreComputeRect(const NavWorld* nav, JobPool* pool, ShoreRect rect, int8_t* out)
+{
+    // Sources up to the clamp distance away still matter
+    ShoreRect in = {
+        .x0 = rect.x0 - SHORE_MARGIN,
+        .y0 = rect.y0 - SHORE_MARGIN,
+        .x1 = rect.x1 + SHORE_MARGIN,
+        .y1 = rect.y1 + SHORE_MARGIN,
+    };
+    _Edt edt = { .w = in.x1 - in.x0, .h = in.y1 - in.y0 };
+    size_t n = (size_t)edt.w * edt.h;
+    Arena* scratch = scratchArena();
+    ArenaMark mark = arenaMark(scratch);
+    edt.mask = ARENA_NEW(scratch, uint8_t, n);
+    edt.toLand = ARENA_NEW(scratch, float, n);
+    edt.toWater = ARENA_NEW(scratch, float, n);
+    _fillMask(nav, in, edt.mask);
+    jobPoolParallelFor(pool, edt.w, _edtColumns, &edt);
+    jobPoolParallelFor(pool, edt.h, _edtRows, &edt);
+
+    int outW = rect.x1 - rect.x0;
+    for (int y = rect.y0; y < rect.y1; ++y) {
+        for (int x = rect.x0; x < rect.x1; ++x) {
+            size_t i = (size_t)(y - in.y0) * edt.w + (x - in.x0);
+            // The coastline runs halfway between a land and a water tile
+            float d = edt.mask[i] == _LAND
+                ? -(sqrtf(edt.toWater[i]) - 0.5f)
+                : sqrtf(edt.toLand[i]) - 0.5f;
+            out[(y - rect.y0) * outW + (x - rect.x0)] = _quantize(d);
+        }
+    }
+    arenaRelease(scratch, mark);
+}
+
+void shoreQuery(const ecs_world_t* ecs, const ShoreWorld* shore,
+    const float* xs, const float* ys, float* out, int n)
+{
+    ShoreChunkEntry* map = shore->mapChunks;
+    int64_t lastKey = 0;
+    const ShoreDistance* last = NULL;
+    bool haveLast = false;
+    for (int i = 0; i < n; ++i) {
+        int x = (int)floorf(xs[i] / TILE_SIZE), y = (int)floorf(ys[i] / TILE_SIZE);
+        int64_t key = navKey(i32floordiv(x, CHUNK_SIZE), i32floordiv(y, CHUNK_SIZE));
+        // Batches are usually spatially coherent, so remember the last chunk
+        if (!haveLast || key != lastKey) {
+            ShoreChunkEntry* e = map ? hmgetp_null(map, key) : NULL;
+            last = e ? ecs_get(ecs, e->value.entity, ShoreDistance) : NULL;
+            lastKey = key;
+            haveLast = true;
+        }
+        if (!last) {
+            out[i] = SHORE_MAX_DISTANCE;
+            continue;
+        }
+        int t = i32floormod(y, CHUNK_SIZE) * CHUNK_SIZE + i32floormod(x, CHUNK_SIZE);
+        out[i] = (float)last->d[t] / SHORE_STEPS_PER_TILE;
+    }
+}
+
+////// ECS
+
+static inline bool _touches(ShoreRect a, ShoreRect b)
+{
+    return a.x0 <= b.x1 && b.x0 <= a.x1 && a.y0 <= b.y1 && b.y0 <= a.y1;
+}
+
+static inline bool _inOneSector(ShoreRect r)
+{
+    return i32floordiv(r.x0, NAV_SECTOR_TILES) == i32floordiv(r.x1 - 1, NAV_SECTOR_TILES)
+        && i32floordiv(r.y0, NAV_SECTOR_TILES) == i32floordiv(r.y1 - 1, NAV_SECTOR_TILES);
+}
+
+static void _markDirty(ShoreWorld* shore, ChunkCoord c)
+{
+    ShoreRect r = {
+        .x0 = c.x * CHUNK_SIZE,
+        .y0 = c.y * CHUNK_SIZE,
+        .x1 = (c.x + 1) * CHUNK_SIZE,
+        .y1 = (c.y + 1) * CHUNK_SIZE,
+    };
+    // Merging only what touches keeps edits far apart in separate areas,
+    // and a growing area may reach others, so start over after each merge
+    for (int i = 0; i < arrlen(shore->arrDirty);) {
+        ShoreRect d = shore->arrDirty[i];
+        ShoreRect u = {
+            .x0 = i32min(d.x0, r.x0),
+            .y0 = i32min(d.y0, r.y0),
+            .x1 = i32max(d.x1, r.x1),
+            .y1 = i32max(d.y1, r.y1),
+        };
+        if (_touches(d, r) && _inOneSector(u)) {
+            r = u;
+            arrdelswap(shore->arrDirty, i);
+            i = 0;
+        } else {
+            ++i;
+        }
+    }
+    arrput(shore->arrDirty, r);
+}
+
+static void onShoreTileHeightsSet(ecs_iter_t* it)
+{
+    TileHeights* tiles = ecs_field(it, TileHeights, 1);
+    ChunkCoord* coord = ecs_field(it, ChunkCoord, 2);
+    ShoreWorld* shore = ecs_singleton_get_mut(it->world, ShoreWorld);
+    MemTag tag = memUseTag(MEM_TERRAIN);
+    for (int i = 0; i < it->count; ++i) {
+        ShoreChunk chunk = { .entity = it->entities[i] };
+        for (int y = 0; y < CHUNK_SIZE; ++y) {
+            for (int x = 0; x < CHUNK_SIZE; ++x) {
+                chunk.rows[y] |= (uint16_t)navIsWater(tiles[i].heights[y * CHUNK_SIZE + x]) << x;
+            }
+        }
+        int64_t key = navKey(coord[i].x, coord[i].y);
+        ShoreChunkEntry* e = hmgetp_null(shore->mapChunks, key);
+        // Edits that keep the coastline where it was change no distance
+        if (e && e->value.entity == chunk.entity && memcmp(e->value.rows, chunk.rows, sizeof(chunk.rows)) == 0) {
+            continue;
+        }
+        hmput(shore->mapChunks, key, chunk);
+        _markDirty(shore, coord[i]);
+    }
+    memUseTag(tag);
+}
+
+static void onShoreChunkRemove(ecs_iter_t* it)
+{
+    ChunkCoord* coord = ecs_field(it, ChunkCoord, 2);
+    ShoreWorld* shore = ecs_field(it, ShoreWorld, 3);
+    if (!shore->mapChunks) {
+        return;
+    }
+    for (int i = 0; i < it->count; ++i) {
+        int64_t key = navKey(coord[i].x, coord[i].y);
+        ShoreChunkEntry* e = hmgetp_null(shore->mapChunks, key);
+        if (e && e->value.entity == it->entities[i]) {
+            (void)hmdel(shore->mapChunks, key);
+            // Nav forgets the chunk too, which moves the coast of its
+            // neighbours
+            MemTag tag = memUseTag(MEM_TERRAIN);
+            _markDirty(shore, coord[i]);
+            memUseTag(tag);
+        }
+    }
+}
+
+/// @brief Recompute around one edited area and store the result in the
+/// chunks
+static void _updateRect(ecs_world_t* ecs, ShoreWorld* shore, const NavWorld* nav,
+    JobPool* pool, ShoreRect dirty)
+{
+    // Distances change up to the clamp distance away from an edit. Round
+    // out to whole chunks since they are stored per chunk
+    ShoreRect r = {
+        .x0 = i32floordiv(dirty.x0 - SHORE_MARGIN, CHUNK_SIZE) * CHUNK_SIZE,
+        .y0 = i32floordiv(dirty.y0 - SHORE_MARGIN, CHUNK_SIZE) * CHUNK_SIZE,
+        .x1 = (i32floordiv(dirty.x1 + SHORE_MARGIN - 1, CHUNK_SIZE) + 1) * CHUNK_SIZE,
+        .y1 = (i32floordiv(dirty.y1 + SHORE_MARGIN - 1, CHUNK_SIZE) + 1) * CHUNK_SIZE,
+    };
+    LOG_TRACE("Updating shoreline of [%d, %d] - [%d, %d]", r.x0, r.y0, r.x1, r.y1);
+    int w = r.x1 - r.x0;
+    Arena* scratch = scratchArena();
+    ArenaMark mark = arenaMark(scratch);
+    int8_t* out = ARENA_NEW(scratch, int8_t, (size_t)w * (r.y1 - r.y0));
+    shoreComputeRect(nav, pool, r, out);
+    for (int cy = r.y0 / CHUNK_SIZE; cy < r.y1 / CHUNK_SIZE; ++cy) {
+        for (int cx = r.x0 / CHUNK_SIZE; cx < r.x1 / CHUNK_SIZE; ++cx) {
+            ShoreChunkEntry* e = hmgetp_null(shore->mapChunks, navKey(cx, cy));
+            if (!e) {
+                continue;
+            }
+            ShoreDistance* sd = ecs_get_mut(ecs, e->value.entity, ShoreDistance);
+            for (int y = 0; y < CHUNK_SIZE; ++y) {
+                const int8_t* src = &out[(size_t)(cy * CHUNK_SIZE + y - r.y0) * w + (cx * CHUNK_SIZE - r.x0)];
+                memcpy(&sd->d[y * CHUNK_SIZE], src, CHUNK_SIZE);
+            }
+            ecs_modified(ecs, e->value.entity, ShoreDistance);
+        }
+    }
+    arenaRelease(scratch, mark);
+}
+
+static void updateShorelineSystem(ecs_iter_t* it)
+{
+    TRACE_ZONE(__func__);
+    ShoreWorld* shore = ecs_field(it, ShoreWorld, 1);
+    NavWorld* nav = ecs_field(it, NavWorld, 2);
+    Jobs* jobs = ecs_field(it, Jobs, 3);
+    MemTag tag = memUseTag(MEM_TERRAIN);
+    for (int i = 0; i < arrlen(shore->arrDirty); ++i) {
+        _updateRect(it->world, shore, nav, jobs->pool, shore->arrDirty[i]);
+    }
+    arrsetlen(shore->arrDirty, 0);
+    memUseTag(tag);
+}
+
+void cleanupShoreWorld(ShoreWorld* shore)
+{
+    hmfree(shore->mapChunks);
+    arrfree(shore->arrDirty);
+}
+
+void registerShoreline(ecs_world_t* ecs)
+{
+    ECS_COMPONENT_DEFINE(ecs, ShoreDistance);
+    ECS_COMPONENT_DEFINE(ecs, ShoreWorld);
+    ecs_singleton_set(ecs, ShoreWorld, { 0 });
+
+    ECS_OBSERVER(ecs, onShoreTileHeightsSet, EcsOnSet, [in] TileHeights, [in] ChunkCoord);
+    // Matches only while the singleton lives, not once the world is torn down
+    ECS_OBSERVER(ecs, onShoreChunkRemove, EcsOnRemove, [in] TileHeights, [in] ChunkCoord, [inout] ShoreWorld($));
+    // Writes components of chunks other than the ones iterated
+    ecs_system(ecs, {
+        .entity = ecs_entity(ecs, {
+            .name = "updateShorelineSystem",
+            .add = { ecs_dependson(TerrainPhase) },
+        }),
+        .query.filter.expr = "[inout] ShoreWorld($), [in] NavWorld($), [in] Jobs($)",
+        .callback = updateShorelineSystem,
+        .no_readonly = true,
+    });
+}
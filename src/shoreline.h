@@ -0,0 +1,76 @@
+#pragma once
+
+#include <flecs.h>
+#include <stdint.h>
+#include <utils/jobs.h>
+
+#include "chunk.h"
+#include "nav/navgrid.h"
+
+/// @brief Quantization steps per tile of `ShoreDistance`
+#define SHORE_STEPS_PER_TILE 4
+/// @brief Largest distance that `ShoreDistance` can tell apart, in tiles
+#define SHORE_MAX_DISTANCE (127.0f / SHORE_STEPS_PER_TILE)
+
+extern ECS_COMPONENT_DECLARE(ShoreDistance);
+extern ECS_COMPONENT_DECLARE(ShoreWorld);
+
+/// @brief Signed distance from each tile to the coastline, positive over
+/// water and negative over land, in 1/`SHORE_STEPS_PER_TILE` tiles. Row
+/// major like `TileHeights`, clamped to `SHORE_MAX_DISTANCE`
+typedef struct {
+    int8_t d[CHUNK_AREA];
+} ShoreDistance;
+
+/// @brief A chunk with shoreline distances
+typedef struct {
+    ecs_entity_t entity;
+    /// @brief Water bit per tile when last seen, like `NavChunk.rows`
+    uint16_t rows[CHUNK_SIZE];
+} ShoreChunk;
+
+typedef struct {
+    int64_t key;
+    ShoreChunk value;
+} ShoreChunkEntry;
+
+/// @brief Tile rectangle [x0, x1) x [y0, y1) in global tiles
+typedef struct {
+    int x0, y0, x1, y1;
+} ShoreRect;
+
+/// @brief Bookkeeping of shoreline distances. A singleton
+typedef struct {
+    /// @brief stb hashmap from chunk key to chunk
+    ShoreChunkEntry* mapChunks;
+    /// @brief stb array of edited areas. Areas that overlap or touch are
+    /// merged, as long as they stay within one sector
+    ShoreRect* arrDirty;
+} ShoreWorld;
+
+/// @brief Registers shoreline types, the terrain observer and the update
+/// system. Requires `registerEngine`, `registerNav` and `registerJobs`
+/// @param ecs
+void registerShoreline(ecs_world_t* ecs);
+
+/// @brief Free the bookkeeping, e.g. before the world is destroyed
+/// @param shore
+void cleanupShoreWorld(ShoreWorld* shore);
+
+/// @brief Compute quantized signed distances of a rectangle of tiles with
+/// two-pass exact Euclidean distance transforms, in parallel
+/// @param nav Source of land and water. Unloaded tiles are neither
+/// @param pool
+/// @param rect Tiles to compute
+/// @param out Row major over `rect`
+void shoreComputeRect(const NavWorld* nav, JobPool* pool, ShoreRect rect, int8_t* out);
+
+/// @brief Sample signed distances in tiles at many world positions
+/// @param ecs
+/// @param shore
+/// @param xs World X of points
+/// @param ys World Y of points
+/// @param out Distances in tiles. Points on unloaded chunks get `SHORE_MAX_DISTANCE`
+/// @param n Number of points
+void shoreQuery(const ecs_world_t* ecs, const ShoreWorld* shore,
+    const float* xs, const float* ys, float* out, int n);
@@ -1,11 +1,23 @@
 #include "spatial.h"
 
+#include <string.h>
+#include <utils/trace.h>
+
+#include "engine.h"
+
 ECS_COMPONENT_DECLARE(Position);
 ECS_COMPONENT_DECLARE(Rotation);
 ECS_COMPONENT_DECLARE(Velocity);
 ECS_COMPONENT_DECLARE(AngularVelocity);
 ECS_COMPONENT_DECLARE(Acceleration);
 
+static void clearAccelerationSystem(ecs_iter_t* it)
+{
+    TRACE_ZONE(__func__);
+    Acceleration* acc = ecs_field(it, Acceleration, 1);
+    memset(acc, 0, sizeof(Acceleration) * it->count);
+}
+
 void spatial_register(ecs_world_t* ecs)
 {
     ECS_COMPONENT_DEFINE(ecs, Position);
@@ -13,4 +25,15 @@ void spatial_register(ecs_world_t* ecs)
     ECS_COMPONENT_DEFINE(ecs, Velocity);
     ECS_COMPONENT_DEFINE(ecs, AngularVelocity);
     ECS_COMPONENT_DEFINE(ecs, Acceleration);
+
+    // Registered before every other system of the phase, so it runs first
+    ecs_system(ecs, {
+        .entity = ecs_entity(ecs, {
+            .name = "clearAccelerationSystem",
+            .add = { ecs_dependson(SimulatePhase) },
+        }),
+        .query.filter.expr = "[out] Acceleration",
+        .callback = clearAccelerationSystem,
+        .multi_threaded = true,
+    });
 }
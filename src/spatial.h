@@ -22,9 +22,15 @@ typedef struct {
     float x, y, z;
 } AngularVelocity;
 
-/// @brief Acceleration in m/s^2
+/// @brief Acceleration in m/s^2 of the current tick. Cleared at the start
+/// of `SimulatePhase`, systems of the phase add to it. Entities with an
+/// `UpdateRate` only get it on ticks they are due, and are integrated over
+/// `dt * lodPeriod` then
 typedef struct {
     float x, y, z;
 } Acceleration;
 
+/// @brief Registers the components and clears accelerations every tick.
+/// Requires `registerEngine`
+/// @param ecs
 void spatial_register(ecs_world_t* ecs);
\ No newline at end of file
@@ -0,0 +1,517 @@
+#include "terrain.h"
+
+#include <math.h>
+#include <stb_ds.h>
+
+#include "vk/vk.h"
+
+ECS_COMPONENT_DECLARE(ChunkSlot);
+ECS_COMPONENT_DECLARE(TerrainRenderer);
+
+static const uint32_t _terrainVertSpv[] =
+#include "vk/shaders/terrain.vert.inc"
+    ;
+static const uint32_t _terrainFragSpv[] =
+#include "vk/shaders/terrain.frag.inc"
+    ;
+
+/// @brief How far skirts hang below the lowest tile of a chunk, in m. Deep
+/// enough to cover the step to a neighbour or a coarser LOD
+#define SKIRT_DEPTH 4.0f
+
+/// @brief Box around every tile of a chunk and its skirt
+static ChunkBounds _chunkBounds(const ChunkCoord* coord, const ChunkHeight* height, const TileHeights* tiles)
+{
+    float lo = height->h, hi = height->h;
+    for (int i = 0; i < CHUNK_AREA; ++i) {
+        lo = fminf(lo, tiles->heights[i]);
+        hi = fmaxf(hi, tiles->heights[i]);
+    }
+    lo -= SKIRT_DEPTH;
+    float x = coord->x * CHUNK_SIZE * TILE_SIZE;
+    float y = coord->y * CHUNK_SIZE * TILE_SIZE;
+    return (ChunkBounds) {
+        .min = { x, y, lo, 1.0f },
+        .max = { x + CHUNK_SIZE * TILE_SIZE, y + CHUNK_SIZE * TILE_SIZE, hi, height->h },
+    };
+}
+
+/// @brief Upload a chunk's bounds and tiles, giving it a slot first if it
+/// has none. Without tiles the chunk is flat at its nominal height
+static void _uploadChunk(ecs_world_t* ecs, TerrainRenderer* terrain, ecs_entity_t e,
+    const ChunkCoord* coord, const ChunkHeight* height, const TileHeights* tiles)
+{
+    const ChunkSlot* slot = ecs_get(ecs, e, ChunkSlot);
+    uint32_t s = slot ? slot->slot : allocChunkSlot(&terrain->culler);
+    if (s == CULL_NO_SLOT) {
+        // Left undrawn, and tried again when its tiles are set next
+        return;
+    }
+    TileHeights flat;
+    if (!tiles) {
+        for (int i = 0; i < CHUNK_AREA; ++i) {
+            flat.heights[i] = height->h;
+        }
+        tiles = &flat;
+    }
+    ChunkBounds bounds = _chunkBounds(coord, height, tiles);
+    setChunkBounds(&terrain->culler, s, &bounds);
+    writeSlot(&terrain->heights, s, tiles);
+    if (!slot) {
+        ecs_set(ecs, e, ChunkSlot, { .slot = s });
+    }
+}
+
+////// Pipeline
+
+static VkFormat _chooseDepthFormat(VkPhysicalDevice phys)
+{
+    // At least one of the first two is always supported
+    static const VkFormat candidates[] = {
+        VK_FORMAT_D32_SFLOAT,
+        VK_FORMAT_X8_D24_UNORM_PACK32,
+        VK_FORMAT_D16_UNORM,
+    };
+    for (size_t i = 0; i < sizeof(candidates) / sizeof(*candidates); ++i) {
+        VkFormatProperties props;
+        vkGetPhysicalDeviceFormatProperties(phys, candidates[i], &props);
+        if (props.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) {
+            return candidates[i];
+        }
+    }
+    ecs_abort(1, "No depth format");
+    return VK_FORMAT_UNDEFINED;
+}
+
+static void _newTerrainPipeline(const RenderDevice* device, TerrainRenderer* terrain, VkFormat colorFormat)
+{
+    VkDescriptorSetLayoutBinding bindings[2] = {
+        { 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT },
+        { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_VERTEX_BIT },
+    };
+    VkDescriptorSetLayoutCreateInfo setCI = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = 2,
+        .pBindings = bindings,
+    };
+    vkCheck(vkCreateDescriptorSetLayout(device->handle, &setCI, hostAllocationCallbacks(), &terrain->setLayout))
+    {
+        ecs_abort(1, "Failed to create terrain descriptor set layout");
+    }
+    VkPushConstantRange push = { .stageFlags = VK_SHADER_STAGE_VERTEX_BIT, .size = 16 * sizeof(float) };
+    VkPipelineLayoutCreateInfo layoutCI = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = &terrain->setLayout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &push,
+    };
+    vkCheck(vkCreatePipelineLayout(device->handle, &layoutCI, hostAllocationCallbacks(), &terrain->layout))
+    {
+        ecs_abort(1, "Failed to create terrain pipeline layout");
+    }
+
+    VkShaderModule vert = newShaderModule(device, _terrainVertSpv, sizeof(_terrainVertSpv));
+    VkShaderModule frag = newShaderModule(device, _terrainFragSpv, sizeof(_terrainFragSpv));
+    VkPipelineShaderStageCreateInfo stages[] = {
+        {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_VERTEX_BIT,
+            .module = vert,
+            .pName = "main",
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .module = frag,
+            .pName = "main",
+        },
+    };
+    // Vertices are pulled from the chunk bounds and heights, there are no
+    // attributes
+    VkPipelineVertexInputStateCreateInfo vertexInput = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+    };
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+        .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+    };
+    VkPipelineViewportStateCreateInfo viewport = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+        .viewportCount = 1,
+        .scissorCount = 1,
+    };
+    // Grid triangles are counterclockwise seen from above. Skirts are seen
+    // from either side, so nothing is culled
+    VkPipelineRasterizationStateCreateInfo raster = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+        .polygonMode = VK_POLYGON_MODE_FILL,
+        .cullMode = VK_CULL_MODE_NONE,
+        .frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE,
+        .lineWidth = 1.0f,
+    };
+    VkPipelineMultisampleStateCreateInfo multisample = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+        .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+    };
+    VkPipelineDepthStencilStateCreateInfo depth = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+        .depthTestEnable = VK_TRUE,
+        .depthWriteEnable = VK_TRUE,
+        .depthCompareOp = VK_COMPARE_OP_LESS,
+    };
+    VkPipelineColorBlendAttachmentState blendAttachment = { .colorWriteMask = 0xf };
+    VkPipelineColorBlendStateCreateInfo blend = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+        .attachmentCount = 1,
+        .pAttachments = &blendAttachment,
+    };
+    VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+    VkPipelineDynamicStateCreateInfo dynamic = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+        .dynamicStateCount = 2,
+        .pDynamicStates = dynamicStates,
+    };
+    VkPipelineRenderingCreateInfo rendering = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO,
+        .colorAttachmentCount = 1,
+        .pColorAttachmentFormats = &colorFormat,
+        .depthAttachmentFormat = terrain->depthFormat,
+    };
+    VkGraphicsPipelineCreateInfo ci = {
+        .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+        .pNext = &rendering,
+        .stageCount = 2,
+        .pStages = stages,
+        .pVertexInputState = &vertexInput,
+        .pInputAssemblyState = &inputAssembly,
+        .pViewportState = &viewport,
+        .pRasterizationState = &raster,
+        .pMultisampleState = &multisample,
+        .pDepthStencilState = &depth,
+        .pColorBlendState = &blend,
+        .pDynamicState = &dynamic,
+        .layout = terrain->layout,
+    };
+    terrain->pipeline = newGraphicsPipeline(device, &ci);
+    vkDestroyShaderModule(device->handle, vert, hostAllocationCallbacks());
+    vkDestroyShaderModule(device->handle, frag, hostAllocationCallbacks());
+}
+
+/// @brief One set per frame slot, as the bounds and heights are
+static void _newTerrainDescriptors(TerrainRenderer* terrain)
+{
+    VkDescriptorPoolSize size = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2 * terrain->nFrames };
+    VkDescriptorPoolCreateInfo poolCI = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .maxSets = terrain->nFrames,
+        .poolSizeCount = 1,
+        .pPoolSizes = &size,
+    };
+    vkCheck(vkCreateDescriptorPool(terrain->device, &poolCI, hostAllocationCallbacks(), &terrain->descriptorPool))
+    {
+        ecs_abort(1, "Failed to create terrain descriptor pool");
+    }
+    VkDescriptorSetLayout layouts[MAX_FRAMES_IN_FLIGHT];
+    for (uint32_t f = 0; f < terrain->nFrames; ++f) {
+        layouts[f] = terrain->setLayout;
+    }
+    VkDescriptorSetAllocateInfo ai = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = terrain->descriptorPool,
+        .descriptorSetCount = terrain->nFrames,
+        .pSetLayouts = layouts,
+    };
+    vkCheck(vkAllocateDescriptorSets(terrain->device, &ai, terrain->sets))
+    {
+        ecs_abort(1, "Failed to allocate terrain descriptor sets");
+    }
+    for (uint32_t f = 0; f < terrain->nFrames; ++f) {
+        VkDescriptorBufferInfo infos[2] = {
+            { terrain->culler.bounds.buffers[f], 0, VK_WHOLE_SIZE },
+            { terrain->heights.buffers[f], 0, VK_WHOLE_SIZE },
+        };
+        VkWriteDescriptorSet writes[2];
+        for (uint32_t b = 0; b < 2; ++b) {
+            writes[b] = (VkWriteDescriptorSet) {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = terrain->sets[f],
+                .dstBinding = b,
+                .descriptorCount = 1,
+                .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .pBufferInfo = &infos[b],
+            };
+        }
+        vkUpdateDescriptorSets(terrain->device, 2, writes, 0, NULL);
+    }
+}
+
+////// Depth buffer
+
+static void _destroyDepth(TerrainRenderer* terrain, VkImage image, VkImageView view, DeviceAllocation* memory)
+{
+    vkDestroyImageView(terrain->device, view, hostAllocationCallbacks());
+    cleanupImage(terrain->allocator, image, memory);
+}
+
+/// @brief Make the depth buffer match `extent`. The old one is retired with
+/// `frameIndex`, as frames in flight may still use it
+static void _resizeDepth(TerrainRenderer* terrain, VkExtent2D extent, uint64_t frameIndex)
+{
+    if (terrain->depth) {
+        _RetiredDepth retired = {
+            .image = terrain->depth,
+            .view = terrain->depthView,
+            .memory = terrain->depthMemory,
+            .frame = frameIndex,
+        };
+        arrput(terrain->_arrRetired, retired);
+    }
+    ecs_trace("Creating [%ux%u] depth buffer", extent.width, extent.height);
+    VkImageCreateInfo ci = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = terrain->depthFormat,
+        .extent = { extent.width, extent.height, 1 },
+        .mipLevels = 1,
+        .arrayLayers = 1,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
+    };
+    terrain->depth = newImage(terrain->allocator, &ci, MEMORY_USAGE_GPU_ONLY, &terrain->depthMemory);
+    VkImageViewCreateInfo viewCI = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .image = terrain->depth,
+        .viewType = VK_IMAGE_VIEW_TYPE_2D,
+        .format = terrain->depthFormat,
+        .subresourceRange = { .aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT, .levelCount = 1, .layerCount = 1 },
+    };
+    vkCheck(vkCreateImageView(terrain->device, &viewCI, hostAllocationCallbacks(), &terrain->depthView))
+    {
+        ecs_abort(1, "Failed to create depth image view");
+    }
+    terrain->depthExtent = extent;
+}
+
+static void _releaseRetiredDepth(TerrainRenderer* terrain, uint64_t completedFrames)
+{
+    int n = 0;
+    while (n < arrlen(terrain->_arrRetired) && terrain->_arrRetired[n].frame <= completedFrames) {
+        _RetiredDepth* r = &terrain->_arrRetired[n++];
+        _destroyDepth(terrain, r->image, r->view, &r->memory);
+    }
+    if (n > 0) {
+        arrdeln(terrain->_arrRetired, 0, n);
+    }
+}
+
+////// Renderer
+
+TerrainRenderer newTerrainRenderer(const RenderDevice* device, const FrameManager* frames, VkFormat colorFormat)
+{
+    ecs_trace("Creating TerrainRenderer");
+    ecs_log_push();
+    TerrainRenderer terrain = {
+        .device = device->handle,
+        .allocator = device->allocator,
+        .nFrames = frames->nFrames,
+        .culler = newChunkCuller(device, frames),
+        .depthFormat = _chooseDepthFormat(device->phys->handle),
+    };
+    terrain.heights = newSlotBuffer(device, terrain.nFrames, CULL_MAX_CHUNKS, sizeof(TileHeights), MEM_TERRAIN);
+    _newTerrainPipeline(device, &terrain, colorFormat);
+    _newTerrainDescriptors(&terrain);
+    ecs_log_pop();
+    return terrain;
+}
+
+void cleanupTerrainRenderer(TerrainRenderer* terrain)
+{
+    ecs_trace("Cleaning up TerrainRenderer");
+    _releaseRetiredDepth(terrain, UINT64_MAX);
+    arrfree(terrain->_arrRetired);
+    if (terrain->depth) {
+        _destroyDepth(terrain, terrain->depth, terrain->depthView, &terrain->depthMemory);
+    }
+    vkDestroyDescriptorPool(terrain->device, terrain->descriptorPool, hostAllocationCallbacks());
+    vkDestroyPipeline(terrain->device, terrain->pipeline, hostAllocationCallbacks());
+    vkDestroyPipelineLayout(terrain->device, terrain->layout, hostAllocationCallbacks());
+    vkDestroyDescriptorSetLayout(terrain->device, terrain->setLayout, hostAllocationCallbacks());
+    cleanupSlotBuffer(&terrain->heights);
+    cleanupChunkCuller(&terrain->culler);
+    *terrain = (TerrainRenderer) { 0 };
+}
+
+void drawTerrain(TerrainRenderer* terrain, Frame* frame, const RenderTarget* target, uint64_t frameIndex,
+    const float viewProj[16], const float eye[3])
+{
+    // Same rule as retired swapchains
+    if (frameIndex >= terrain->nFrames) {
+        _releaseRetiredDepth(terrain, frameIndex - terrain->nFrames);
+    }
+    VkExtent2D extent = target->extent;
+    if (extent.width != terrain->depthExtent.width || extent.height != terrain->depthExtent.height) {
+        _resizeDepth(terrain, extent, frameIndex);
+    }
+    VkCommandBuffer cmd = frame->cmd;
+    // Made visible along with the bounds by the culling pass
+    uploadSlots(&terrain->heights, frame->slot);
+    recordChunkCulling(&terrain->culler, frame, viewProj, eye);
+
+    GPU_SCOPE_BEGIN(frame, "terrain");
+    // Both attachments are cleared, so their old contents are discarded. The
+    // color image may still be read where the last frame handed it over
+    VkImageMemoryBarrier toAttachment[] = {
+        {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+            .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            .newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = target->image,
+            .subresourceRange = { .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .levelCount = 1, .layerCount = 1 },
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+            .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            .newLayout = VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = terrain->depth,
+            .subresourceRange = { .aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT, .levelCount = 1, .layerCount = 1 },
+        },
+    };
+    vkCmdPipelineBarrier(cmd,
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | target->finalStage,
+        VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
+        0, 0, NULL, 0, NULL, 2, toAttachment);
+    VkRenderingAttachmentInfo color = {
+        .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+        .imageView = target->view,
+        .imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+        .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+        .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+        .clearValue.color = { .float32 = { 0.05f, 0.12f, 0.2f, 1.0f } },
+    };
+    VkRenderingAttachmentInfo depth = {
+        .sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+        .imageView = terrain->depthView,
+        .imageLayout = VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
+        .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+        .storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+        .clearValue.depthStencil = { .depth = 1.0f },
+    };
+    VkRenderingInfo rendering = {
+        .sType = VK_STRUCTURE_TYPE_RENDERING_INFO,
+        .renderArea = { .extent = extent },
+        .layerCount = 1,
+        .colorAttachmentCount = 1,
+        .pColorAttachments = &color,
+        .pDepthAttachment = &depth,
+    };
+    vkCmdBeginRendering(cmd, &rendering);
+    // A negative height makes clip space y point up, as cglm's projections expect
+    VkViewport viewport = {
+        .y = (float)extent.height,
+        .width = (float)extent.width,
+        .height = -(float)extent.height,
+        .maxDepth = 1.0f,
+    };
+    VkRect2D scissor = { .extent = extent };
+    vkCmdSetViewport(cmd, 0, 1, &viewport);
+    vkCmdSetScissor(cmd, 0, 1, &scissor);
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, terrain->pipeline);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, terrain->layout, 0, 1, &terrain->sets[frame->slot], 0, NULL);
+    vkCmdPushConstants(cmd, terrain->layout, VK_SHADER_STAGE_VERTEX_BIT, 0, 16 * sizeof(float), viewProj);
+    drawCulledChunks(&terrain->culler, cmd, frame->slot);
+    vkCmdEndRendering(cmd);
+
+    VkImageMemoryBarrier toFinal = toAttachment[0];
+    toFinal.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    toFinal.dstAccessMask = target->finalAccess;
+    toFinal.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    toFinal.newLayout = target->finalLayout;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, target->finalStage,
+        0, 0, NULL, 0, NULL, 1, &toFinal);
+    GPU_SCOPE_END(frame);
+}
+
+////// ECS
+
+/// @brief Upload the chunks of an observer's iterator
+static void _onChunksSet(ecs_iter_t* it, const TileHeights* tiles)
+{
+    ChunkCoord* coord = ecs_field(it, ChunkCoord, 1);
+    ChunkHeight* height = ecs_field(it, ChunkHeight, 2);
+    // Uploaded by `uploadTerrainChunks` once there is a renderer
+    if (!ecs_singleton_get(it->world, TerrainRenderer)) {
+        return;
+    }
+    TerrainRenderer* terrain = ecs_singleton_get_mut(it->world, TerrainRenderer);
+    // Adding slots moves entities out of the table being iterated
+    ecs_defer_begin(it->world);
+    for (int i = 0; i < it->count; ++i) {
+        _uploadChunk(it->world, terrain, it->entities[i], &coord[i], &height[i], tiles ? &tiles[i] : NULL);
+    }
+    ecs_defer_end(it->world);
+}
+
+static void onChunkSet(ecs_iter_t* it)
+{
+    _onChunksSet(it, NULL);
+}
+
+static void onChunkTilesSet(ecs_iter_t* it)
+{
+    _onChunksSet(it, ecs_field(it, TileHeights, 3));
+}
+
+static void onChunkSlotRemove(ecs_iter_t* it)
+{
+    ChunkSlot* slot = ecs_field(it, ChunkSlot, 1);
+    // Slots die with the renderer
+    if (!ecs_singleton_get(it->world, TerrainRenderer)) {
+        return;
+    }
+    TerrainRenderer* terrain = ecs_singleton_get_mut(it->world, TerrainRenderer);
+    for (int i = 0; i < it->count; ++i) {
+        freeChunkSlot(&terrain->culler, slot[i].slot);
+    }
+}
+
+void uploadTerrainChunks(ecs_world_t* ecs)
+{
+    TerrainRenderer* terrain = ecs_singleton_get_mut(ecs, TerrainRenderer);
+    ecs_filter_t* f = ecs_filter_init(ecs, &(ecs_filter_desc_t) {
+        .expr = "[in] ChunkCoord, [in] ChunkHeight, [in] ?TileHeights",
+    });
+    ecs_defer_begin(ecs);
+    int n = 0;
+    ecs_iter_t it = ecs_filter_iter(ecs, f);
+    while (ecs_filter_next(&it)) {
+        ChunkCoord* coord = ecs_field(&it, ChunkCoord, 1);
+        ChunkHeight* height = ecs_field(&it, ChunkHeight, 2);
+        TileHeights* tiles = ecs_field_is_set(&it, 3) ? ecs_field(&it, TileHeights, 3) : NULL;
+        for (int i = 0; i < it.count; ++i) {
+            _uploadChunk(ecs, terrain, it.entities[i], &coord[i], &height[i], tiles ? &tiles[i] : NULL);
+        }
+        n += it.count;
+    }
+    ecs_defer_end(ecs);
+    ecs_filter_fini(f);
+    ecs_trace("Uploaded [%d] chunks", n);
+}
+
+void registerTerrain(ecs_world_t* ecs)
+{
+    ECS_COMPONENT_DEFINE(ecs, ChunkSlot);
+    ECS_COMPONENT_DEFINE(ecs, TerrainRenderer);
+    // Chunks with tiles are handled by the second observer only
+    ECS_OBSERVER(ecs, onChunkSet, EcsOnSet, [in] ChunkCoord, [in] ChunkHeight, !TileHeights);
+    ECS_OBSERVER(ecs, onChunkTilesSet, EcsOnSet, [in] ChunkCoord, [in] ChunkHeight, [in] TileHeights);
+    ECS_OBSERVER(ecs, onChunkSlotRemove, EcsOnRemove, [in] ChunkSlot);
+}
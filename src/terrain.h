@@ -0,0 +1,87 @@
+#pragma once
+
+#include <flecs.h>
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+#include "chunk.h"
+#include "vk/cull.h"
+#include "vk/frame.h"
+#include "vk/memory.h"
+#include "vk/slot_buffer.h"
+
+extern ECS_COMPONENT_DECLARE(ChunkSlot);
+extern ECS_COMPONENT_DECLARE(TerrainRenderer);
+
+/// @brief Where a chunk lives on the GPU. Added and removed by the terrain
+/// renderer
+typedef struct {
+    uint32_t slot;
+} ChunkSlot;
+
+/// @brief A depth buffer replaced after a resize, destroyed once the frames
+/// that used it are done
+typedef struct {
+    VkImage image;
+    VkImageView view;
+    DeviceAllocation memory;
+    /// @brief Frames before this one may use it
+    uint64_t frame;
+} _RetiredDepth;
+
+/// @brief Draws terrain chunks culled on the GPU. A singleton while the
+/// graphics system exists. Chunks are uploaded when set and when the
+/// renderer is created
+typedef struct TerrainRenderer {
+    VkDevice device;
+    DeviceAllocator* allocator;
+    uint32_t nFrames;
+    ChunkCuller culler;
+    /// @brief `TileHeights` of the chunk in each culler slot, as is. The
+    /// vertex shader pulls corner heights from it
+    SlotBuffer heights;
+    VkDescriptorSetLayout setLayout;
+    VkPipelineLayout layout;
+    VkPipeline pipeline;
+    VkDescriptorPool descriptorPool;
+    /// @brief Per frame slot, over the frame slot's bounds and heights
+    VkDescriptorSet sets[MAX_FRAMES_IN_FLIGHT];
+    VkFormat depthFormat;
+    VkImage depth;
+    VkImageView depthView;
+    DeviceAllocation depthMemory;
+    VkExtent2D depthExtent;
+    _RetiredDepth* _arrRetired;
+} TerrainRenderer;
+
+/// @brief Registers the terrain renderer and the observers that keep chunks
+/// on the GPU. Requires `registerChunk`
+/// @param ecs
+void registerTerrain(ecs_world_t* ecs);
+
+/// @brief Create the renderer
+/// @param device
+/// @param frames
+/// @param colorFormat Of the images drawn into
+/// @return The renderer
+TerrainRenderer newTerrainRenderer(const RenderDevice* device, const FrameManager* frames, VkFormat colorFormat);
+
+/// @brief Destroy the renderer. The device must be idle
+/// @param terrain
+void cleanupTerrainRenderer(TerrainRenderer* terrain);
+
+/// @brief Give every chunk a slot and upload its bounds. Call once the
+/// renderer singleton is set, chunks set later are uploaded by observers
+/// @param ecs
+void uploadTerrainChunks(ecs_world_t* ecs);
+
+/// @brief Cull the chunks and draw them into a target, leaving it in its
+/// final layout
+/// @param terrain
+/// @param frame
+/// @param target Of the format the renderer was created for
+/// @param frameIndex Index of the frame being recorded
+/// @param viewProj Column major, with clip space depth from 0 to 1
+/// @param eye
+void drawTerrain(TerrainRenderer* terrain, Frame* frame, const RenderTarget* target, uint64_t frameIndex,
+    const float viewProj[16], const float eye[3]);
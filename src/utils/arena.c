@@ -0,0 +1,251 @@
+#include "arena.h"
+
+#include <flecs.h>
+#include <stdatomic.h>
+#include <string.h>
+
+#include "memtrack.h"
+
+struct _ArenaBlock {
+    _ArenaBlock* next;
+    size_t size;
+    size_t used;
+    _Alignas(ARENA_ALIGN) unsigned char data[];
+};
+
+/// @brief A thread's scratch arena, listed for cleanup
+typedef struct _Scratch {
+    Arena arena;
+    struct _Scratch* next;
+} _Scratch;
+
+/// @brief In front of every stb_ds allocation, so that growing and freeing
+/// it know where it lives
+typedef struct {
+    Arena* arena;
+    size_t size;
+} _StbdsHeader;
+
+_Static_assert(sizeof(_StbdsHeader) <= ARENA_ALIGN, "stb_ds header breaks alignment");
+
+/// @brief Every thread's scratch arena, newest first. Only ever pushed to
+/// until cleanup
+static _Atomic(_Scratch*) _scratches;
+static _Thread_local _Scratch* _scratch;
+static _Thread_local Arena* _stbdsArena;
+static _Atomic uint64_t _heapAllocations;
+
+/// @brief Counted under the tag the calling thread uses
+static void* _heapAlloc(size_t size)
+{
+    atomic_fetch_add_explicit(&_heapAllocations, 1, memory_order_relaxed);
+    return memAlloc(memCurrentTag(), size);
+}
+
+Arena newArena(size_t blockSize)
+{
+    return (Arena) { .blockSize = blockSize };
+}
+
+void cleanupArena(Arena* arena)
+{
+    _ArenaBlock* block = arena->first;
+    while (block) {
+        _ArenaBlock* next = block->next;
+        memFree(block);
+        block = next;
+    }
+    arena->first = NULL;
+    arena->current = NULL;
+}
+
+/// @brief Offset of the first byte at or after `used` aligned to `align`
+static size_t _alignedOffset(const _ArenaBlock* block, size_t used, size_t align)
+{
+    uintptr_t base = (uintptr_t)block->data;
+    return ((base + used + align - 1) & ~(uintptr_t)(align - 1)) - base;
+}
+
+void* arenaAlloc(Arena* arena, size_t size, size_t align)
+{
+    align = align ? align : 1;
+    _ArenaBlock* last = NULL;
+    for (_ArenaBlock* block = arena->current; block; block = block->next) {
+        if (block != arena->current) {
+            // Blocks after the current one hold nothing
+            block->used = 0;
+        }
+        size_t begin = _alignedOffset(block, block->used, align);
+        if (begin + size <= block->size) {
+            block->used = begin + size;
+            arena->current = block;
+            return block->data + begin;
+        }
+        last = block;
+    }
+    size_t blockSize = size + align > arena->blockSize ? size + align : arena->blockSize;
+    _ArenaBlock* block = _heapAlloc(sizeof(*block) + blockSize);
+    block->next = NULL;
+    block->size = blockSize;
+    if (last) {
+        last->next = block;
+    } else {
+        arena->first = block;
+    }
+    size_t begin = _alignedOffset(block, 0, align);
+    block->used = begin + size;
+    arena->current = block;
+    return block->data + begin;
+}
+
+ArenaMark arenaMark(const Arena* arena)
+{
+    return (ArenaMark) {
+        .block = arena->current,
+        .used = arena->current ? arena->current->used : 0,
+    };
+}
+
+void arenaRelease(Arena* arena, ArenaMark mark)
+{
+    if (!mark.block) {
+        resetArena(arena);
+        return;
+    }
+    arena->current = mark.block;
+    arena->current->used = mark.used;
+}
+
+void resetArena(Arena* arena)
+{
+    arena->current = arena->first;
+    if (arena->current) {
+        arena->current->used = 0;
+    }
+}
+
+Arena* scratchArena()
+{
+    if (!_scratch) {
+        // Lives until cleanup, blocks of finished threads are not reclaimed
+        // before that
+        _Scratch* scratch = _heapAlloc(sizeof(*scratch));
+        scratch->arena = newArena(SCRATCH_BLOCK_SIZE);
+        _Scratch* head = atomic_load(&_scratches);
+        do {
+            scratch->next = head;
+        } while (!atomic_compare_exchange_weak(&_scratches, &head, scratch));
+        _scratch = scratch;
+    }
+    return &_scratch->arena;
+}
+
+void cleanupScratchArenas()
+{
+    _Scratch* scratch = atomic_exchange(&_scratches, NULL);
+    while (scratch) {
+        _Scratch* next = scratch->next;
+        cleanupArena(&scratch->arena);
+        memFree(scratch);
+        scratch = next;
+    }
+    _scratch = NULL;
+}
+
+Pool newPool(size_t itemSize, uint32_t perBlock)
+{
+    // Free items hold the next free item
+    itemSize = itemSize < sizeof(void*) ? sizeof(void*) : itemSize;
+    return (Pool) {
+        .itemSize = (itemSize + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1),
+        .perBlock = perBlock ? perBlock : 1,
+    };
+}
+
+void cleanupPool(Pool* pool)
+{
+    void* block = pool->blocks;
+    while (block) {
+        void* next = *(void**)block;
+        memFree(block);
+        block = next;
+    }
+    pool->blocks = NULL;
+    pool->free = NULL;
+}
+
+void* poolAlloc(Pool* pool)
+{
+    if (!pool->free) {
+        // The first slot links the blocks
+        char* block = _heapAlloc(ARENA_ALIGN + pool->itemSize * pool->perBlock);
+        *(void**)block = pool->blocks;
+        pool->blocks = block;
+        for (uint32_t i = pool->perBlock; i-- > 0;) {
+            void* item = block + ARENA_ALIGN + pool->itemSize * i;
+            *(void**)item = pool->free;
+            pool->free = item;
+        }
+    }
+    void* item = pool->free;
+    pool->free = *(void**)item;
+    return item;
+}
+
+void poolFree(Pool* pool, void* item)
+{
+    if (!item) {
+        return;
+    }
+    *(void**)item = pool->free;
+    pool->free = item;
+}
+
+Arena* stbdsUseArena(Arena* arena)
+{
+    Arena* previous = _stbdsArena;
+    _stbdsArena = arena;
+    return previous;
+}
+
+void* stbdsRealloc(void* context, void* ptr, size_t size)
+{
+    // stb_ds passes no context, and allocates hashmap indexes anew, so new
+    // allocations can only go where the thread's arena is
+    (void)context;
+    _StbdsHeader* header = ptr ? (_StbdsHeader*)((char*)ptr - ARENA_ALIGN) : NULL;
+    Arena* arena = header ? header->arena : _stbdsArena;
+    if (!arena) {
+        atomic_fetch_add_explicit(&_heapAllocations, 1, memory_order_relaxed);
+        header = memRealloc(memCurrentTag(), header, ARENA_ALIGN + size);
+        *header = (_StbdsHeader) { .size = size };
+        return (char*)header + ARENA_ALIGN;
+    }
+    if (header && size <= header->size) {
+        return ptr;
+    }
+    // The old copy goes back with the arena
+    _StbdsHeader* grown = arenaAlloc(arena, ARENA_ALIGN + size, ARENA_ALIGN);
+    *grown = (_StbdsHeader) { .arena = arena, .size = size };
+    if (header) {
+        memcpy((char*)grown + ARENA_ALIGN, ptr, header->size);
+    }
+    return (char*)grown + ARENA_ALIGN;
+}
+
+void stbdsFree(void* context, void* ptr)
+{
+    (void)context;
+    if (!ptr) {
+        return;
+    }
+    _StbdsHeader* header = (_StbdsHeader*)((char*)ptr - ARENA_ALIGN);
+    if (!header->arena) {
+        memFree(header);
+    }
+}
+
+uint64_t heapAllocations()
+{
+    return atomic_load_explicit(&_heapAllocations, memory_order_relaxed);
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/// @brief Bytes of the blocks of a thread's scratch arena
+#define SCRATCH_BLOCK_SIZE (256u << 10)
+/// @brief Alignment of everything the allocators hand out unless asked for
+/// more, enough for any scalar or SIMD type in use
+#define ARENA_ALIGN 16
+
+/// @brief Allocate `n` objects of `type` from an arena
+#define ARENA_NEW(arena, type, n) ((type*)arenaAlloc((arena), sizeof(type) * (n), _Alignof(type)))
+
+typedef struct _ArenaBlock _ArenaBlock;
+
+/// @brief Linear allocator over a chain of blocks. Allocations are not
+/// freed one by one: the arena is reset, or released back to a mark. Blocks
+/// are kept, so once an arena has grown to what its workload needs it no
+/// longer calls the heap. Not thread safe
+typedef struct Arena {
+    _ArenaBlock* first;
+    /// @brief Block being allocated from, those after it are unused
+    _ArenaBlock* current;
+    size_t blockSize;
+} Arena;
+
+/// @brief Where an arena was at some point, to release back to
+typedef struct ArenaMark {
+    _ArenaBlock* block;
+    size_t used;
+} ArenaMark;
+
+/// @brief Free list of fixed-size items carved out of blocks, for objects
+/// made and destroyed often. Not thread safe
+typedef struct Pool {
+    size_t itemSize;
+    uint32_t perBlock;
+    void* free;
+    /// @brief Chained through their first item's bytes
+    void* blocks;
+} Pool;
+
+/// @brief Create an arena. Nothing is allocated until first used
+/// @param blockSize Bytes of each block, larger allocations get a block of
+/// their own size
+/// @return The arena
+Arena newArena(size_t blockSize);
+
+/// @brief Free every block, and with them all allocations
+/// @param arena
+void cleanupArena(Arena* arena);
+
+/// @brief Allocate from the arena. Aborts when out of memory
+/// @param arena
+/// @param size
+/// @param align A power of two
+/// @return Uninitialized memory, valid until the arena is reset, released
+/// before it or cleaned up
+void* arenaAlloc(Arena* arena, size_t size, size_t align);
+
+/// @brief Where the arena is now
+/// @param arena
+/// @return The mark
+ArenaMark arenaMark(const Arena* arena);
+
+/// @brief Drop every allocation made after a mark. Marks are released in
+/// the reverse order they were taken
+/// @param arena
+/// @param mark
+void arenaRelease(Arena* arena, ArenaMark mark);
+
+/// @brief Drop every allocation, keeping the blocks
+/// @param arena
+void resetArena(Arena* arena);
+
+/// @brief This thread's arena for temporaries. Take a mark before using it
+/// and release it before returning, so that callers' temporaries survive
+/// @return The arena, created on first use
+Arena* scratchArena();
+
+/// @brief Free the scratch arenas of every thread. Other threads must be
+/// done, e.g. at exit
+void cleanupScratchArenas();
+
+/// @brief Create a pool. Nothing is allocated until first used
+/// @param itemSize
+/// @param perBlock Items allocated at once when the pool runs out
+/// @return The pool
+Pool newPool(size_t itemSize, uint32_t perBlock);
+
+/// @brief Free every block, and with them all items
+/// @param pool
+void cleanupPool(Pool* pool);
+
+/// @brief Take an item. Aborts when out of memory
+/// @param pool
+/// @return Uninitialized memory, aligned to `ARENA_ALIGN`
+void* poolAlloc(Pool* pool);
+
+/// @brief Give an item back
+/// @param pool
+/// @param item From `poolAlloc` on the same pool, or NULL
+void poolFree(Pool* pool, void* item);
+
+/// @brief Where stb_ds arrays and hashmaps this thread creates from now on
+/// live. Growing an array keeps it where it was created, freeing one created
+/// in an arena does nothing, as the arena takes it back.
+///
+/// Hashmap indexes are not: stb_ds allocates a new one on every rehash, and
+/// it lands in the arena in use then. Hence no stb_ds container that
+/// outlives the arena may grow while it is in use, only those created in it
+/// @param arena NULL for the heap
+/// @return The previous arena, to restore
+Arena* stbdsUseArena(Arena* arena);
+
+/// @brief `STBDS_REALLOC` of thirdparty/stb/stb.c
+void* stbdsRealloc(void* context, void* ptr, size_t size);
+
+/// @brief `STBDS_FREE` of thirdparty/stb/stb.c
+void stbdsFree(void* context, void* ptr);
+
+/// @brief Heap allocations made by the arenas, pools and stb_ds since
+/// start. Steady state code leaves it unchanged
+/// @return The count
+uint64_t heapAllocations();
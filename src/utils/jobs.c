@@ -0,0 +1,203 @@
+#include "jobs.h"
+
+#include <stb_ds.h>
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "arena.h"
+#include "memtrack.h"
+#include "trace.h"
+
+ECS_COMPONENT_DECLARE(Jobs);
+
+typedef struct {
+    JobFn fn;
+    void* ctx;
+} _Job;
+
+struct JobPool {
+    ecs_os_mutex_t lock;
+    ecs_os_cond_t hasWork;
+    ecs_os_cond_t rangeDone;
+    ecs_os_thread_t* arrThreads;
+    /// @brief FIFO, jobs before `head` are taken
+    _Job* arrQueue;
+    int head;
+    bool quit;
+    /// @brief Of `_RangeGroup`, taken and given back under the lock
+    Pool groups;
+};
+
+/// @brief State of one `jobPoolParallelFor`, shared by the caller and its
+/// helper jobs. The last one to let go gives it back to the pool
+typedef struct {
+    JobPool* pool;
+    JobRangeFn fn;
+    void* ctx;
+    int n, nRanges;
+    /// @brief Next range to claim
+    int next;
+    /// @brief Ranges not finished yet
+    int remaining;
+    int refs;
+} _RangeGroup;
+
+/// @brief Take the oldest job. The pool lock must be held
+static bool _popLocked(JobPool* pool, _Job* job)
+{
+    if (pool->head == arrlen(pool->arrQueue)) {
+        return false;
+    }
+    *job = pool->arrQueue[pool->head++];
+    if (pool->head == arrlen(pool->arrQueue)) {
+        arrdeln(pool->arrQueue, 0, pool->head);
+        pool->head = 0;
+    }
+    return true;
+}
+
+static void* _worker(void* arg)
+{
+    JobPool* pool = arg;
+    TRACE_THREAD_NAME("jobs worker");
+    ecs_os_mutex_lock(pool->lock);
+    for (;;) {
+        while (pool->head == arrlen(pool->arrQueue) && !pool->quit) {
+            ecs_os_cond_wait(pool->hasWork, pool->lock);
+        }
+        _Job job;
+        if (!_popLocked(pool, &job)) {
+            break;
+        }
+        ecs_os_mutex_unlock(pool->lock);
+        job.fn(job.ctx);
+        ecs_os_mutex_lock(pool->lock);
+    }
+    ecs_os_mutex_unlock(pool->lock);
+    return NULL;
+}
+
+JobPool* newJobPool(int nThreads)
+{
+    ecs_trace("Starting JobPool with [%d] threads", nThreads);
+    JobPool* pool = memCalloc(MEM_GENERAL, 1, sizeof(*pool));
+    pool->lock = ecs_os_mutex_new();
+    pool->hasWork = ecs_os_cond_new();
+    pool->rangeDone = ecs_os_cond_new();
+    pool->groups = newPool(sizeof(_RangeGroup), 16);
+    for (int i = 0; i < nThreads; ++i) {
+        arrput(pool->arrThreads, ecs_os_thread_new(_worker, pool));
+    }
+    return pool;
+}
+
+void cleanupJobPool(JobPool* pool)
+{
+    ecs_os_mutex_lock(pool->lock);
+    pool->quit = true;
+    ecs_os_cond_broadcast(pool->hasWork);
+    ecs_os_mutex_unlock(pool->lock);
+    for (int i = 0; i < arrlen(pool->arrThreads); ++i) {
+        ecs_os_thread_join(pool->arrThreads[i]);
+    }
+    arrfree(pool->arrThreads);
+    arrfree(pool->arrQueue);
+    cleanupPool(&pool->groups);
+    ecs_os_cond_free(pool->rangeDone);
+    ecs_os_cond_free(pool->hasWork);
+    ecs_os_mutex_free(pool->lock);
+    memFree(pool);
+}
+
+int jobPoolThreads(const JobPool* pool)
+{
+    return arrlen(pool->arrThreads);
+}
+
+void jobPoolSubmit(JobPool* pool, JobFn fn, void* ctx)
+{
+    ecs_os_mutex_lock(pool->lock);
+    arrput(pool->arrQueue, ((_Job) { .fn = fn, .ctx = ctx }));
+    ecs_os_cond_signal(pool->hasWork);
+    ecs_os_mutex_unlock(pool->lock);
+}
+
+/// @brief Claim and run ranges until none are left
+static void _runRanges(_RangeGroup* group)
+{
+    JobPool* pool = group->pool;
+    ecs_os_mutex_lock(pool->lock);
+    while (group->next < group->nRanges) {
+        int i = group->next++;
+        ecs_os_mutex_unlock(pool->lock);
+        group->fn(group->ctx,
+            (int)((int64_t)group->n * i / group->nRanges),
+            (int)((int64_t)group->n * (i + 1) / group->nRanges));
+        ecs_os_mutex_lock(pool->lock);
+        if (--group->remaining == 0) {
+            ecs_os_cond_broadcast(pool->rangeDone);
+        }
+    }
+    ecs_os_mutex_unlock(pool->lock);
+}
+
+static void _releaseGroup(_RangeGroup* group)
+{
+    JobPool* pool = group->pool;
+    ecs_os_mutex_lock(pool->lock);
+    if (--group->refs == 0) {
+        poolFree(&pool->groups, group);
+    }
+    ecs_os_mutex_unlock(pool->lock);
+}
+
+static void _rangeHelper(void* ctx)
+{
+    _runRanges(ctx);
+    _releaseGroup(ctx);
+}
+
+void jobPoolParallelFor(JobPool* pool, int n, JobRangeFn fn, void* ctx)
+{
+    int nThreads = jobPoolThreads(pool);
+    // A few ranges per thread evens out ranges of uneven cost
+    int nRanges = (nThreads + 1) * 4;
+    if (nRanges > n) {
+        nRanges = n;
+    }
+    if (nRanges <= 1 || nThreads == 0) {
+        if (n > 0) {
+            fn(ctx, 0, n);
+        }
+        return;
+    }
+    ecs_os_mutex_lock(pool->lock);
+    _RangeGroup* group = poolAlloc(&pool->groups);
+    ecs_os_mutex_unlock(pool->lock);
+    *group = (_RangeGroup) {
+        .pool = pool,
+        .fn = fn,
+        .ctx = ctx,
+        .n = n,
+        .nRanges = nRanges,
+        .remaining = nRanges,
+        .refs = nThreads + 1,
+    };
+    // Helpers that start late find nothing left and return at once
+    for (int i = 0; i < nThreads; ++i) {
+        jobPoolSubmit(pool, _rangeHelper, group);
+    }
+    _runRanges(group);
+    ecs_os_mutex_lock(pool->lock);
+    while (group->remaining > 0) {
+        ecs_os_cond_wait(pool->rangeDone, pool->lock);
+    }
+    ecs_os_mutex_unlock(pool->lock);
+    _releaseGroup(group);
+}
+
+void registerJobs(ecs_world_t* ecs, int nThreads)
+{
+    ECS_COMPONENT_DEFINE(ecs, Jobs);
+    ecs_singleton_set(ecs, Jobs, { .pool = newJobPool(nThreads) });
+}
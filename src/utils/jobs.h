@@ -0,0 +1,47 @@
+#pragma once
+
+#include <flecs.h>
+
+extern ECS_COMPONENT_DECLARE(Jobs);
+
+/// @brief Fixed set of worker threads consuming a FIFO of jobs
+typedef struct JobPool JobPool;
+
+/// @brief Shared worker pool of the game. A singleton
+typedef struct {
+    JobPool* pool;
+} Jobs;
+
+typedef void (*JobFn)(void* ctx);
+typedef void (*JobRangeFn)(void* ctx, int begin, int end);
+
+/// @brief Registers the `Jobs` singleton and starts its worker threads
+/// @param ecs
+/// @param nThreads Number of worker threads
+void registerJobs(ecs_world_t* ecs, int nThreads);
+
+/// @brief Start worker threads. Requires the flecs OS API to be set
+/// @param nThreads
+/// @return The pool
+JobPool* newJobPool(int nThreads);
+
+/// @brief Finish queued jobs, then stop and join the workers
+/// @param pool
+void cleanupJobPool(JobPool* pool);
+
+/// @brief Number of worker threads
+int jobPoolThreads(const JobPool* pool);
+
+/// @brief Queue a job. It runs on some worker thread at some later point
+/// @param pool
+/// @param fn
+/// @param ctx Passed to `fn`, owned by the caller
+void jobPoolSubmit(JobPool* pool, JobFn fn, void* ctx);
+
+/// @brief Split [0, n) into ranges and run them on the calling thread and
+/// any idle workers. Returns when all ranges are done
+/// @param pool
+/// @param n
+/// @param fn
+/// @param ctx
+void jobPoolParallelFor(JobPool* pool, int n, JobRangeFn fn, void* ctx);
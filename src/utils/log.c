@@ -0,0 +1,489 @@
+#include "log.h"
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "memtrack.h"
+#include "trace.h"
+
+/// @brief How long a thread sleeps while waiting for the writer, in ns
+#define WRITER_WAIT_NS 1000000
+/// @brief Indentation levels written, as flecs does
+#define MAX_INDENT 15
+
+/// @brief A log call waiting to be written
+typedef struct {
+    /// @brief `traceNow` of the call, to order records across threads
+    uint64_t time;
+    const char* file;
+    int32_t level;
+    int32_t line;
+    int32_t indent;
+    /// @brief 0 when `text` is the message. Otherwise `args[0]` is the
+    /// format, and string arguments are offsets into `text`
+    int32_t nArgs;
+    /// @brief Records right after this one whose `text` continues the
+    /// message
+    int32_t chained;
+    LogArg args[LOG_MAX_ARGS + 1];
+    char text[LOG_TEXT_SIZE];
+} _LogRecord;
+
+/// @brief Records of one thread. Only the thread writes records and
+/// `tail`, only the writer thread reads them and moves `head`
+typedef struct LogRing {
+    _LogRecord records[LOG_THREAD_RECORDS];
+    _Alignas(64) _Atomic uint32_t head;
+    _Alignas(64) _Atomic uint32_t tail;
+    /// @brief Last `head` the thread saw, so it only reads the writer's
+    /// cache line when the ring looks full
+    uint32_t cachedHead;
+    _Atomic uint32_t dropped;
+    struct LogRing* next;
+    /// @brief What was allocated, as allocations are only 16 byte aligned
+    void* allocation;
+} LogRing;
+
+/// @brief Every thread's ring, newest first. Only pushed to while running,
+/// freed when stopped
+static _Atomic(LogRing*) _rings;
+static _Thread_local LogRing* _ring;
+/// @brief Counts stops, a thread's ring is stale when it was made before the
+/// last one
+static atomic_uint _generation;
+static _Thread_local uint32_t _ringGeneration;
+static atomic_bool _running;
+static atomic_bool _quit;
+static ecs_os_thread_t _writer;
+/// @brief The writer waits on `_wake` while every ring is empty, with
+/// `_sleeping` set so that threads only signal then
+static ecs_os_mutex_t _wakeLock;
+static ecs_os_cond_t _wake;
+static atomic_bool _sleeping;
+/// @brief The hook replaced, restored when stopped
+static ecs_os_api_log_t _previousLog;
+
+static LogRing* _threadRing()
+{
+    uint32_t generation = atomic_load_explicit(&_generation, memory_order_relaxed);
+    if (_ring && _ringGeneration == generation) {
+        return _ring;
+    }
+    void* allocation = memCalloc(MEM_GENERAL, 1, sizeof(LogRing) + _Alignof(LogRing));
+    LogRing* ring = (LogRing*)(((uintptr_t)allocation + _Alignof(LogRing) - 1) & ~(uintptr_t)(_Alignof(LogRing) - 1));
+    ring->allocation = allocation;
+    LogRing* head = atomic_load(&_rings);
+    do {
+        ring->next = head;
+    } while (!atomic_compare_exchange_weak(&_rings, &head, ring));
+    _ring = ring;
+    _ringGeneration = generation;
+    return ring;
+}
+
+/// @brief Take the next records of the calling thread's ring
+/// @param n Records taken, at most `LOG_THREAD_RECORDS`
+/// @param wait Wait for room instead of dropping the records
+/// @return The first record to fill, the others follow it in the ring. NULL
+/// when the ring is full
+static _LogRecord* _claim(LogRing* ring, uint32_t n, bool wait)
+{
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    while (tail + n - ring->cachedHead > LOG_THREAD_RECORDS) {
+        ring->cachedHead = atomic_load_explicit(&ring->head, memory_order_acquire);
+        if (tail + n - ring->cachedHead <= LOG_THREAD_RECORDS) {
+            break;
+        }
+        if (!wait) {
+            atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+            return NULL;
+        }
+        ecs_os_sleep(0, WRITER_WAIT_NS);
+    }
+    return &ring->records[tail % LOG_THREAD_RECORDS];
+}
+
+/// @brief Wake the writer if it waits for records
+static void _wakeWriter()
+{
+    // Pairs with the fence of `_writerThread`: either the writer sees the
+    // record, or this sees it sleeping
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&_sleeping, memory_order_relaxed)) {
+        ecs_os_mutex_lock(_wakeLock);
+        ecs_os_cond_signal(_wake);
+        ecs_os_mutex_unlock(_wakeLock);
+    }
+}
+
+/// @brief Hand the claimed records to the writer, all at once
+/// @param n As claimed
+/// @param wait Return once they are written
+static void _publish(LogRing* ring, uint32_t n, bool wait)
+{
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed) + n;
+    atomic_store_explicit(&ring->tail, tail, memory_order_release);
+    _wakeWriter();
+    while (wait && (int32_t)(tail - atomic_load_explicit(&ring->head, memory_order_acquire)) > 0) {
+        ecs_os_sleep(0, WRITER_WAIT_NS);
+    }
+}
+
+static void _copyText(char* dst, const char* src, size_t size)
+{
+    size_t len = strlen(src);
+    if (len >= size) {
+        len = size - 1;
+    }
+    memcpy(dst, src, len);
+    dst[len] = '\0';
+}
+
+static int64_t _asInt(const LogArg* arg)
+{
+    return arg->type == LOG_ARG_DOUBLE ? (int64_t)arg->d : arg->i;
+}
+
+static double _asDouble(const LogArg* arg)
+{
+    switch (arg->type) {
+    case LOG_ARG_DOUBLE:
+        return arg->d;
+    case LOG_ARG_UINT:
+        return (double)arg->u;
+    default:
+        return (double)arg->i;
+    }
+}
+
+/// @brief printf the arguments of a deferred record. Each conversion is
+/// printed on its own with the length of the value as passed, so the types
+/// in the format need not match exactly
+static void _formatRecord(const _LogRecord* r, char* out, size_t size)
+{
+    const char* c = r->args[0].s;
+    size_t len = 0;
+    int32_t arg = 1;
+    while (*c && len + 1 < size) {
+        if (*c != '%') {
+            out[len++] = *c++;
+            continue;
+        }
+        const char* start = c++;
+        if (*c == '%') {
+            out[len++] = *c++;
+            continue;
+        }
+        c += strspn(c, "-+ #0123456789.");
+        const char* flagsEnd = c;
+        c += strspn(c, "hlLjzt");
+        char conv = *c;
+        if (!conv) {
+            break;
+        }
+        c++;
+        // The conversion without its length, to put the right one back
+        char spec[32];
+        size_t specLen = flagsEnd - start < 24 ? (size_t)(flagsEnd - start) : 24;
+        memcpy(spec, start, specLen);
+        const LogArg* a = arg < r->nArgs ? &r->args[arg++] : NULL;
+        int n = 0;
+        if (!a) {
+            n = snprintf(out + len, size - len, "%.*s", (int)(c - start), start);
+        } else if (strchr("di", conv)) {
+            memcpy(spec + specLen, "lld", 4);
+            n = snprintf(out + len, size - len, spec, (long long)_asInt(a));
+        } else if (strchr("ouxX", conv)) {
+            memcpy(spec + specLen, "ll", 2);
+            spec[specLen + 2] = conv;
+            spec[specLen + 3] = '\0';
+            n = snprintf(out + len, size - len, spec, (unsigned long long)_asInt(a));
+        } else if (strchr("eEfFgGaA", conv)) {
+            spec[specLen] = conv;
+            spec[specLen + 1] = '\0';
+            n = snprintf(out + len, size - len, spec, _asDouble(a));
+        } else if (conv == 'c') {
+            memcpy(spec + specLen, "c", 2);
+            n = snprintf(out + len, size - len, spec, (int)_asInt(a));
+        } else if (conv == 's' && a->type == LOG_ARG_STRING) {
+            memcpy(spec + specLen, "s", 2);
+            n = snprintf(out + len, size - len, spec, r->text + a->u);
+        } else if (conv == 'p' && a->type == LOG_ARG_POINTER) {
+            memcpy(spec + specLen, "p", 2);
+            n = snprintf(out + len, size - len, spec, a->p);
+        } else {
+            n = snprintf(out + len, size - len, "%.*s", (int)(c - start), start);
+        }
+        len += n < 0 ? 0 : (size_t)n;
+        if (len >= size) {
+            len = size - 1;
+        }
+    }
+    out[len] = '\0';
+}
+
+/// @brief Write a record and those chained to it the way flecs writes its
+/// log
+static void _writeRecord(const LogRing* ring, uint32_t head)
+{
+    const _LogRecord* r = &ring->records[head % LOG_THREAD_RECORDS];
+    char message[1024];
+    const char* msg = r->text;
+    if (r->nArgs) {
+        _formatRecord(r, message, sizeof(message));
+        msg = message;
+    }
+    FILE* stream = r->level >= 0 ? stdout : stderr;
+    const char* prefix = r->level >= 4 ? "jrnl"
+        : r->level > 0                 ? "debug"
+        : r->level == 0                ? "info"
+        : r->level == -2               ? "warning"
+        : r->level == -3               ? "error"
+                                       : "fatal";
+    fputs(prefix, stream);
+    fputs(": ", stream);
+    if (r->level >= 0) {
+        for (int32_t i = 0; i < r->indent && i < MAX_INDENT; ++i) {
+            fputs("| ", stream);
+        }
+    } else if (r->file) {
+        const char* slash = strrchr(r->file, '/');
+        fprintf(stream, "%s: %d: ", slash ? slash + 1 : r->file, r->line);
+    }
+    fputs(msg, stream);
+    for (int32_t i = 1; i <= r->chained; ++i) {
+        fputs(ring->records[(head + i) % LOG_THREAD_RECORDS].text, stream);
+    }
+    fputc('\n', stream);
+}
+
+/// @brief Whether any ring holds a record
+static bool _anyWaiting()
+{
+    for (LogRing* ring = atomic_load(&_rings); ring; ring = ring->next) {
+        if (atomic_load_explicit(&ring->head, memory_order_relaxed)
+            != atomic_load_explicit(&ring->tail, memory_order_acquire)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/// @brief Write the oldest waiting record of any thread
+/// @return Whether there was one
+static bool _writeOldest()
+{
+    LogRing* oldest = NULL;
+    uint64_t oldestTime = UINT64_MAX;
+    for (LogRing* ring = atomic_load(&_rings); ring; ring = ring->next) {
+        uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        if (head == atomic_load_explicit(&ring->tail, memory_order_acquire)) {
+            continue;
+        }
+        uint64_t time = ring->records[head % LOG_THREAD_RECORDS].time;
+        if (time < oldestTime) {
+            oldest = ring;
+            oldestTime = time;
+        }
+    }
+    if (!oldest) {
+        return false;
+    }
+    uint32_t head = atomic_load_explicit(&oldest->head, memory_order_relaxed);
+    _writeRecord(oldest, head);
+    uint32_t n = 1 + oldest->records[head % LOG_THREAD_RECORDS].chained;
+    atomic_store_explicit(&oldest->head, head + n, memory_order_release);
+    return true;
+}
+
+static void* _writerThread(void* arg)
+{
+    (void)arg;
+    TRACE_THREAD_NAME("log writer");
+    while (!atomic_load_explicit(&_quit, memory_order_acquire)) {
+        if (_writeOldest()) {
+            continue;
+        }
+        fflush(stdout);
+        ecs_os_mutex_lock(_wakeLock);
+        atomic_store_explicit(&_sleeping, true, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+        // Threads that published before the fence did not see `_sleeping`
+        if (!_anyWaiting() && !atomic_load_explicit(&_quit, memory_order_acquire)) {
+            ecs_os_cond_wait(_wake, _wakeLock);
+        }
+        atomic_store_explicit(&_sleeping, false, memory_order_relaxed);
+        ecs_os_mutex_unlock(_wakeLock);
+    }
+    while (_writeOldest()) { }
+    fflush(stdout);
+    return NULL;
+}
+
+/// @brief Installed as `ecs_os_api.log_`, the message is already formatted
+static void _logHook(int32_t level, const char* file, int32_t line, const char* msg)
+{
+    if (!atomic_load_explicit(&_running, memory_order_acquire)) {
+        _previousLog(level, file, line, msg);
+        return;
+    }
+    bool wait = level <= -3;
+    LogRing* ring = _threadRing();
+    _LogRecord* r = _claim(ring, 1, wait);
+    if (!r) {
+        return;
+    }
+    r->time = traceNow();
+    r->file = file;
+    r->level = level;
+    r->line = line;
+    r->indent = ecs_os_api.log_indent_;
+    r->nArgs = 0;
+    r->chained = 0;
+    _copyText(r->text, msg, LOG_TEXT_SIZE);
+    _publish(ring, 1, wait);
+}
+
+void logDeferred_(int32_t level, const char* file, int32_t line, int32_t nArgs, const LogArg* args)
+{
+    if (nArgs > LOG_MAX_ARGS + 1) {
+        nArgs = LOG_MAX_ARGS + 1;
+    }
+    _LogRecord local;
+    LogRing* ring = NULL;
+    _LogRecord* r = &local;
+    bool running = atomic_load_explicit(&_running, memory_order_acquire);
+    if (running) {
+        ring = _threadRing();
+        r = _claim(ring, 1, false);
+        if (!r) {
+            return;
+        }
+    }
+    r->time = traceNow();
+    r->file = file;
+    r->level = level;
+    r->line = line;
+    r->indent = ecs_os_api.log_indent_;
+    r->nArgs = nArgs;
+    r->chained = 0;
+    // Strings may not outlive the call, so they are copied
+    size_t used = 0;
+    for (int32_t i = 0; i < nArgs; ++i) {
+        r->args[i] = args[i];
+        if (i > 0 && args[i].type == LOG_ARG_STRING) {
+            const char* s = args[i].s ? args[i].s : "(null)";
+            size_t len = strlen(s);
+            if (used + len + 1 > LOG_TEXT_SIZE) {
+                len = used < LOG_TEXT_SIZE ? LOG_TEXT_SIZE - 1 - used : 0;
+            }
+            size_t at = used < LOG_TEXT_SIZE ? used : LOG_TEXT_SIZE - 1;
+            memcpy(r->text + at, s, len);
+            r->text[at + len] = '\0';
+            r->args[i].u = at;
+            used = at + len + 1;
+        }
+    }
+    if (running) {
+        _publish(ring, 1, false);
+        return;
+    }
+    char message[1024];
+    _formatRecord(r, message, sizeof(message));
+    ecs_os_api.log_(level, file, line, message);
+}
+
+void logMessage(int32_t level, const char* file, int32_t line, const char* prefix, const char* msg)
+{
+    if (level > ecs_os_api.log_level_) {
+        return;
+    }
+    prefix = prefix ? prefix : "";
+    if (!atomic_load_explicit(&_running, memory_order_acquire)) {
+        char message[LOG_TEXT_SIZE * LOG_MAX_CHAINED];
+        snprintf(message, sizeof(message), "%s%s", prefix, msg);
+        ecs_os_api.log_(level, file, line, message);
+        return;
+    }
+    size_t prefixLen = strlen(prefix);
+    size_t len = prefixLen + strlen(msg);
+    size_t perRecord = LOG_TEXT_SIZE - 1;
+    uint32_t n = len > perRecord ? (uint32_t)((len + perRecord - 1) / perRecord) : 1;
+    n = n < LOG_MAX_CHAINED ? n : LOG_MAX_CHAINED;
+    LogRing* ring = _threadRing();
+    _LogRecord* r = _claim(ring, n, false);
+    if (!r) {
+        return;
+    }
+    r->time = traceNow();
+    r->file = file;
+    r->level = level;
+    r->line = line;
+    r->indent = ecs_os_api.log_indent_;
+    r->nArgs = 0;
+    r->chained = (int32_t)n - 1;
+    // The prefix and the message, split over the records in order
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t at = 0;
+    for (uint32_t i = 0; i < n; ++i) {
+        char* text = ring->records[(tail + i) % LOG_THREAD_RECORDS].text;
+        size_t end = at + perRecord < len ? at + perRecord : len;
+        size_t used = 0;
+        if (at < prefixLen) {
+            size_t take = (end < prefixLen ? end : prefixLen) - at;
+            memcpy(text, prefix + at, take);
+            used = take;
+            at += take;
+        }
+        memcpy(text + used, msg + (at - prefixLen), end - at);
+        text[used + end - at] = '\0';
+        at = end;
+    }
+    _publish(ring, n, false);
+}
+
+void startAsyncLog()
+{
+    if (atomic_load(&_running)) {
+        return;
+    }
+    ecs_trace("Starting async logging");
+    _previousLog = ecs_os_api.log_;
+    atomic_store(&_quit, false);
+    _wakeLock = ecs_os_mutex_new();
+    _wake = ecs_os_cond_new();
+    _writer = ecs_os_thread_new(_writerThread, NULL);
+    atomic_store(&_running, true);
+    ecs_os_api.log_ = _logHook;
+}
+
+void stopAsyncLog()
+{
+    if (!atomic_load(&_running)) {
+        return;
+    }
+    atomic_store(&_running, false);
+    ecs_os_api.log_ = _previousLog;
+    atomic_store(&_quit, true);
+    ecs_os_mutex_lock(_wakeLock);
+    ecs_os_cond_signal(_wake);
+    ecs_os_mutex_unlock(_wakeLock);
+    ecs_os_thread_join(_writer);
+    ecs_os_cond_free(_wake);
+    ecs_os_mutex_free(_wakeLock);
+    // Producers are done, threads that log after a restart make new rings
+    uint32_t dropped = 0;
+    LogRing* ring = atomic_exchange(&_rings, NULL);
+    while (ring) {
+        LogRing* next = ring->next;
+        dropped += atomic_load(&ring->dropped);
+        memFree(ring->allocation);
+        ring = next;
+    }
+    atomic_fetch_add(&_generation, 1);
+    if (dropped) {
+        ecs_warn("Dropped [%u] log records, the writer fell behind", dropped);
+    }
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <flecs.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/// @brief Records per thread waiting to be written, later ones are dropped
+#define LOG_THREAD_RECORDS 256
+/// @brief Arguments of a deferred log call, after the format
+#define LOG_MAX_ARGS 8
+/// @brief Bytes of a record for the message, or for the strings passed to a
+/// deferred call. Longer ones are cut
+#define LOG_TEXT_SIZE 320
+/// @brief Records one message of `logMessage` spans at most, longer ones
+/// are cut
+#define LOG_MAX_CHAINED 8
+
+typedef enum LogArgType {
+    LOG_ARG_INT,
+    LOG_ARG_UINT,
+    LOG_ARG_DOUBLE,
+    LOG_ARG_POINTER,
+    LOG_ARG_STRING,
+} LogArgType;
+
+/// @brief An argument of a deferred log call, as passed
+typedef struct LogArg {
+    LogArgType type;
+    union {
+        int64_t i;
+        uint64_t u;
+        double d;
+        const void* p;
+        const char* s;
+    };
+} LogArg;
+
+static inline LogArg _logInt(long long v)
+{
+    return (LogArg) { .type = LOG_ARG_INT, .i = v };
+}
+
+static inline LogArg _logUint(unsigned long long v)
+{
+    return (LogArg) { .type = LOG_ARG_UINT, .u = v };
+}
+
+static inline LogArg _logDouble(double v)
+{
+    return (LogArg) { .type = LOG_ARG_DOUBLE, .d = v };
+}
+
+static inline LogArg _logPointer(const void* v)
+{
+    return (LogArg) { .type = LOG_ARG_POINTER, .p = v };
+}
+
+static inline LogArg _logString(const char* v)
+{
+    return (LogArg) { .type = LOG_ARG_STRING, .s = v };
+}
+
+#define _logArg(x) _Generic((x),                                      \
+    _Bool: _logUint, char: _logInt, signed char: _logInt,             \
+    unsigned char: _logUint, short: _logInt, unsigned short: _logUint, \
+    int: _logInt, unsigned int: _logUint, long: _logInt,              \
+    unsigned long: _logUint, long long: _logInt,                      \
+    unsigned long long: _logUint, float: _logDouble, double: _logDouble, \
+    char*: _logString, const char*: _logString, default: _logPointer)(x)
+
+#define _LOG_COUNT(...) _LOG_COUNT_(__VA_ARGS__, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+#define _LOG_COUNT_(_1, _2, _3, _4, _5, _6, _7, _8, _9, n, ...) n
+#define _LOG_CAT(a, b) _LOG_CAT_(a, b)
+#define _LOG_CAT_(a, b) a##b
+#define _LOG_MAP_1(a) _logArg(a)
+#define _LOG_MAP_2(a, ...) _logArg(a), _LOG_MAP_1(__VA_ARGS__)
+#define _LOG_MAP_3(a, ...) _logArg(a), _LOG_MAP_2(__VA_ARGS__)
+#define _LOG_MAP_4(a, ...) _logArg(a), _LOG_MAP_3(__VA_ARGS__)
+#define _LOG_MAP_5(a, ...) _logArg(a), _LOG_MAP_4(__VA_ARGS__)
+#define _LOG_MAP_6(a, ...) _logArg(a), _LOG_MAP_5(__VA_ARGS__)
+#define _LOG_MAP_7(a, ...) _logArg(a), _LOG_MAP_6(__VA_ARGS__)
+#define _LOG_MAP_8(a, ...) _logArg(a), _LOG_MAP_7(__VA_ARGS__)
+#define _LOG_MAP_9(a, ...) _logArg(a), _LOG_MAP_8(__VA_ARGS__)
+
+#define _LOG(level, ...)                                                                   \
+    do {                                                                                   \
+        if ((level) <= ecs_os_api.log_level_) {                                            \
+            LogArg _logArgs[] = { _LOG_CAT(_LOG_MAP_, _LOG_COUNT(__VA_ARGS__))(__VA_ARGS__) }; \
+            logDeferred_(level, __FILE__, __LINE__, _LOG_COUNT(__VA_ARGS__), _logArgs);    \
+        }                                                                                  \
+    } while (0)
+
+/// @brief Like `ecs_trace`, but formatted by the log writer while async
+/// logging runs, so the caller only copies the arguments. The format must
+/// be a literal and take at most `LOG_MAX_ARGS` arguments, without `*`
+/// widths
+#define LOG_TRACE(...) _LOG(0, __VA_ARGS__)
+/// @brief Like `ecs_dbg`, deferred as `LOG_TRACE`
+#define LOG_DBG(...) _LOG(1, __VA_ARGS__)
+/// @brief Like `ecs_warn`, deferred as `LOG_TRACE`. Unlike flecs warnings
+/// and errors, it never waits for the writer
+#define LOG_WARN(...) _LOG(-2, __VA_ARGS__)
+
+/// @brief Route flecs logging through per-thread rings to a writer thread.
+/// Callers copy the message and return, the writer orders records across
+/// threads and writes them. Errors wait until written, so they are not
+/// lost to the abort that often follows. Requires the flecs OS API to be set
+void startAsyncLog();
+
+/// @brief Write what is left and go back to logging on the calling thread.
+/// Other threads must be done logging
+void stopAsyncLog();
+
+/// @brief Log a call of `LOG_TRACE`, `LOG_DBG` or `LOG_WARN`
+/// @param level
+/// @param file
+/// @param line
+/// @param nArgs Including the format
+/// @param args The format, then its arguments
+void logDeferred_(int32_t level, const char* file, int32_t line, int32_t nArgs, const LogArg* args);
+
+/// @brief Log a message formatted elsewhere, errors included, without
+/// waiting for the writer. While async logging runs the caller only copies
+/// it, over as many as `LOG_MAX_CHAINED` records
+/// @param level As of `ecs_log_`
+/// @param file
+/// @param line
+/// @param prefix Written before the message, or NULL
+/// @param msg
+void logMessage(int32_t level, const char* file, int32_t line, const char* prefix, const char* msg);
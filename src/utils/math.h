@@ -1,5 +1,7 @@
 #pragma once
 
+#include <stdint.h>
+
 #define DEF_MIN_MAX_CLAMP(T, prefix)                \
     static inline T prefix##min(T x, T y)           \
     {                                               \
@@ -19,4 +21,16 @@ DEF_MIN_MAX_CLAMP(uint32_t, u32)
 DEF_MIN_MAX_CLAMP(int64_t, i64)
 DEF_MIN_MAX_CLAMP(uint64_t, u64)
 
-#undef DEF_MIN_MAX_CLAMP
\ No newline at end of file
+#undef DEF_MIN_MAX_CLAMP
+/// @brief Division rounding towards negative infinity, for grid coordinates
+static inline int32_t i32floordiv(int32_t x, int32_t d)
+{
+    int32_t q = x / d;
+    return (x % d != 0 && ((x < 0) != (d < 0))) ? q - 1 : q;
+}
+
+/// @brief Remainder matching `i32floordiv`, always in [0, d) for positive d
+static inline int32_t i32floormod(int32_t x, int32_t d)
+{
+    return x - i32floordiv(x, d) * d;
+}
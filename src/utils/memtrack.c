@@ -0,0 +1,276 @@
+#include "memtrack.h"
+
+#include <flecs.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+/// @brief In front of every allocation, keeps alignment of what follows
+typedef struct _Header {
+    uint32_t tag;
+    size_t size;
+#ifdef MEM_DEBUG
+    /// @brief Call site, listed while the allocation is live
+    const char* file;
+    int32_t line;
+    struct _Header* prev;
+    struct _Header* next;
+#endif
+} _Header;
+
+#ifdef MEM_DEBUG
+#define HEADER_SIZE 48
+#else
+#define HEADER_SIZE 16
+#endif
+
+_Static_assert(sizeof(_Header) <= HEADER_SIZE, "Allocation header breaks alignment");
+
+typedef struct {
+    _Atomic int64_t bytes;
+    _Atomic int64_t peakBytes;
+    _Atomic int64_t count;
+    _Atomic int64_t totalCount;
+} _TagStats;
+
+static _TagStats _stats[MEM_TAG_COUNT];
+static _Thread_local MemTag _currentTag;
+
+#ifdef MEM_DEBUG
+/// @brief Ends of the list of live allocations. A spin lock, as allocations
+/// are made before the OS API is set
+static _Header _live = { .prev = &_live, .next = &_live };
+static atomic_flag _liveLock = ATOMIC_FLAG_INIT;
+
+static void _lockLive()
+{
+    while (atomic_flag_test_and_set_explicit(&_liveLock, memory_order_acquire)) {
+    }
+}
+
+static void _unlockLive()
+{
+    atomic_flag_clear_explicit(&_liveLock, memory_order_release);
+}
+
+static void _link(_Header* header)
+{
+    _lockLive();
+    header->prev = _live.prev;
+    header->next = &_live;
+    _live.prev->next = header;
+    _live.prev = header;
+    _unlockLive();
+}
+
+static void _unlink(_Header* header)
+{
+    _lockLive();
+    header->prev->next = header->next;
+    header->next->prev = header->prev;
+    _unlockLive();
+}
+#endif
+
+static const char* _tagNames[MEM_TAG_COUNT] = {
+    [MEM_GENERAL] = "general",
+    [MEM_TERRAIN] = "terrain",
+    [MEM_ECS] = "ecs",
+    [MEM_VULKAN_HOST] = "vulkan host",
+    [MEM_VULKAN_DEVICE] = "vulkan device",
+    [MEM_ASSETS] = "assets",
+};
+
+void memCount(MemTag tag, int64_t bytes, int64_t count)
+{
+    _TagStats* s = &_stats[tag];
+    int64_t now = atomic_fetch_add_explicit(&s->bytes, bytes, memory_order_relaxed) + bytes;
+    atomic_fetch_add_explicit(&s->count, count, memory_order_relaxed);
+    if (count > 0) {
+        atomic_fetch_add_explicit(&s->totalCount, count, memory_order_relaxed);
+    }
+    int64_t peak = atomic_load_explicit(&s->peakBytes, memory_order_relaxed);
+    while (now > peak
+        && !atomic_compare_exchange_weak_explicit(&s->peakBytes, &peak, now,
+            memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+void* memAllocAt_(MemTag tag, size_t size, const char* file, int32_t line)
+{
+    return memReallocAt_(tag, NULL, size, file, line);
+}
+
+void* memCallocAt_(MemTag tag, size_t n, size_t size, const char* file, int32_t line)
+{
+    if (size && n > SIZE_MAX / size) {
+        ecs_abort(1, "Allocation of [%zu] x [%zu] bytes overflows", n, size);
+    }
+    void* p = memAllocAt_(tag, n * size, file, line);
+    memset(p, 0, n * size);
+    return p;
+}
+
+void* memReallocAt_(MemTag tag, void* ptr, size_t size, const char* file, int32_t line)
+{
+    _Header* header = ptr ? (_Header*)((char*)ptr - HEADER_SIZE) : NULL;
+    size_t oldSize = header ? header->size : 0;
+    tag = header ? (MemTag)header->tag : tag;
+#ifdef MEM_DEBUG
+    // Moved by realloc, so out of the list meanwhile
+    if (header) {
+        _unlink(header);
+    }
+#endif
+    header = realloc(header, HEADER_SIZE + size);
+    if (!header) {
+        ecs_abort(1, "Out of memory allocating [%zu] bytes of [%s]", size, _tagNames[tag]);
+    }
+    header->tag = tag;
+    header->size = size;
+#ifdef MEM_DEBUG
+    header->file = file;
+    header->line = line;
+    _link(header);
+#else
+    (void)file;
+    (void)line;
+#endif
+    memCount(tag, (int64_t)size - (int64_t)oldSize, ptr ? 0 : 1);
+    return (char*)header + HEADER_SIZE;
+}
+
+void memFree(void* ptr)
+{
+    if (!ptr) {
+        return;
+    }
+    _Header* header = (_Header*)((char*)ptr - HEADER_SIZE);
+#ifdef MEM_DEBUG
+    _unlink(header);
+#endif
+    memCount(header->tag, -(int64_t)header->size, -1);
+    free(header);
+}
+
+MemTag memUseTag(MemTag tag)
+{
+    MemTag previous = _currentTag;
+    _currentTag = tag;
+    return previous;
+}
+
+MemTag memCurrentTag()
+{
+    return _currentTag;
+}
+
+static void* _ecsMalloc(ecs_size_t size)
+{
+    return memAlloc(MEM_ECS, (size_t)size);
+}
+
+static void* _ecsCalloc(ecs_size_t size)
+{
+    return memCalloc(MEM_ECS, 1, (size_t)size);
+}
+
+static void* _ecsRealloc(void* ptr, ecs_size_t size)
+{
+    return memRealloc(MEM_ECS, ptr, (size_t)size);
+}
+
+void trackEcsMemory()
+{
+    // Threads and the rest of the OS API first, which would otherwise
+    // overwrite the hooks when the world is created
+#ifdef FLECS_OS_API_IMPL
+    ecs_set_os_api_impl();
+#else
+    ecs_os_set_api_defaults();
+    // Marks the API as set, so that creating the world keeps it
+    ecs_os_api_t api = ecs_os_api;
+    ecs_os_set_api(&api);
+#endif
+    ecs_os_api.malloc_ = _ecsMalloc;
+    ecs_os_api.calloc_ = _ecsCalloc;
+    ecs_os_api.realloc_ = _ecsRealloc;
+    ecs_os_api.free_ = memFree;
+}
+
+MemStats memStats(MemTag tag)
+{
+    _TagStats* s = &_stats[tag];
+    return (MemStats) {
+        .bytes = atomic_load_explicit(&s->bytes, memory_order_relaxed),
+        .peakBytes = atomic_load_explicit(&s->peakBytes, memory_order_relaxed),
+        .count = atomic_load_explicit(&s->count, memory_order_relaxed),
+        .totalCount = atomic_load_explicit(&s->totalCount, memory_order_relaxed),
+    };
+}
+
+const char* memTagName(MemTag tag)
+{
+    return _tagNames[tag];
+}
+
+void logMemStats()
+{
+    ecs_trace("Memory by tag");
+    ecs_log_push();
+    for (int t = 0; t < MEM_TAG_COUNT; ++t) {
+        MemStats s = memStats(t);
+        ecs_trace("%-14s [%lld] KiB in [%lld] allocations, peak [%lld] KiB, [%lld] allocations made",
+            _tagNames[t], (long long)(s.bytes >> 10), (long long)s.count, (long long)(s.peakBytes >> 10),
+            (long long)s.totalCount);
+    }
+    ecs_log_pop();
+}
+
+/// @brief List the live allocations of a tag
+static void _logLeaks(MemTag tag)
+{
+#ifdef MEM_DEBUG
+    // Copied out first, as logging allocates
+    _Header found[MEM_LEAKS_LISTED];
+    int nFound = 0;
+    bool more = false;
+    _lockLive();
+    for (_Header* h = _live.next; h != &_live; h = h->next) {
+        if (h->tag != tag) {
+            continue;
+        }
+        if (nFound == MEM_LEAKS_LISTED) {
+            more = true;
+            break;
+        }
+        found[nFound++] = *h;
+    }
+    _unlockLive();
+    ecs_log_push();
+    for (int i = 0; i < nFound; ++i) {
+        ecs_warn("[%zu] bytes from %s:%d", found[i].size, found[i].file ? found[i].file : "?", found[i].line);
+    }
+    if (more) {
+        ecs_warn("...");
+    }
+    ecs_log_pop();
+#else
+    (void)tag;
+#endif
+}
+
+bool logMemLeaks()
+{
+    bool leaked = false;
+    for (int t = 0; t < MEM_TAG_COUNT; ++t) {
+        MemStats s = memStats(t);
+        if (s.count != 0 || s.bytes != 0) {
+            ecs_warn("Leaked [%lld] allocations, [%lld] bytes of [%s]", (long long)s.count, (long long)s.bytes,
+                _tagNames[t]);
+            _logLeaks(t);
+            leaked = true;
+        }
+    }
+    return leaked;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/// @brief What memory is for. Allocations are counted under one tag
+typedef enum MemTag {
+    /// @brief Anything not tagged otherwise
+    MEM_GENERAL,
+    /// @brief Terrain, navigation and shoreline data
+    MEM_TERRAIN,
+    /// @brief Allocations of flecs
+    MEM_ECS,
+    /// @brief Host memory of Vulkan objects
+    MEM_VULKAN_HOST,
+    /// @brief Device memory, counted by the device allocator
+    MEM_VULKAN_DEVICE,
+    /// @brief Data read from files
+    MEM_ASSETS,
+    MEM_TAG_COUNT,
+} MemTag;
+
+/// @brief Usage of one tag
+typedef struct MemStats {
+    int64_t bytes;
+    int64_t peakBytes;
+    /// @brief Allocations not freed yet
+    int64_t count;
+    /// @brief Allocations ever made
+    int64_t totalCount;
+} MemStats;
+
+/// @brief Allocations listed per tag by `logMemLeaks`, built with `mem_debug`
+#define MEM_LEAKS_LISTED 32
+
+#ifdef MEM_DEBUG
+#define _MEM_SITE __FILE__, __LINE__
+#else
+#define _MEM_SITE NULL, 0
+#endif
+
+/// @brief Allocate, counted under a tag. Aborts when out of memory
+/// @param tag
+/// @param size
+/// @return Memory for `memFree`, aligned to 16 bytes
+#define memAlloc(tag, size) memAllocAt_(tag, size, _MEM_SITE)
+
+/// @brief Like `memAlloc`, zeroed
+#define memCalloc(tag, n, size) memCallocAt_(tag, n, size, _MEM_SITE)
+
+/// @brief Resize an allocation, which keeps its tag
+/// @param tag Of a new allocation when `ptr` is NULL
+/// @param ptr From `memAlloc`, or NULL
+/// @param size
+/// @return The moved allocation
+#define memRealloc(tag, ptr, size) memReallocAt_(tag, ptr, size, _MEM_SITE)
+
+/// @brief `memAlloc` from a call site, kept for `logMemLeaks` when built
+/// with `mem_debug`
+/// @param tag
+/// @param size
+/// @param file NULL when not kept
+/// @param line
+void* memAllocAt_(MemTag tag, size_t size, const char* file, int32_t line);
+
+void* memCallocAt_(MemTag tag, size_t n, size_t size, const char* file, int32_t line);
+
+/// @brief `memRealloc` from a call site, which replaces the one kept
+void* memReallocAt_(MemTag tag, void* ptr, size_t size, const char* file, int32_t line);
+
+/// @brief Free an allocation of `memAlloc`, or NULL
+void memFree(void* ptr);
+
+/// @brief Count memory allocated elsewhere, e.g. device memory
+/// @param tag
+/// @param bytes Negative when freed
+/// @param count Allocations made, negative when freed
+void memCount(MemTag tag, int64_t bytes, int64_t count);
+
+/// @brief Tag of allocations this thread makes without naming one, such as
+/// stb_ds arrays and arena blocks
+/// @param tag
+/// @return The previous tag, to restore
+MemTag memUseTag(MemTag tag);
+
+/// @brief Tag set by `memUseTag` on this thread
+MemTag memCurrentTag();
+
+/// @brief Count allocations of flecs under `MEM_ECS`. Call before the first
+/// world is created, as flecs must not free what it allocated before
+void trackEcsMemory();
+
+MemStats memStats(MemTag tag);
+
+const char* memTagName(MemTag tag);
+
+/// @brief Trace current and peak usage of every tag
+void logMemStats();
+
+/// @brief Warn about every tag with allocations left. Built with
+/// `mem_debug`, also list the size and call site of the first
+/// `MEM_LEAKS_LISTED` left of each tag. Call at shutdown, once everything is
+/// cleaned up
+/// @return Whether any were left
+bool logMemLeaks();
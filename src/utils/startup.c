@@ -0,0 +1,197 @@
+#include "startup.h"
+
+#include <stdatomic.h>
+#include <time.h>
+
+#include "trace.h"
+
+typedef struct {
+    const char* name;
+    double beginMs;
+    double endMs;
+} _Span;
+
+static _Span _spans[STARTUP_MAX_STEPS];
+static atomic_uint _nSpans;
+static atomic_bool _begun;
+static uint64_t _beginNs;
+/// @brief Negative until the first frame
+static double _firstFrameMs = -1.0;
+static atomic_bool _firstFrameMarked;
+
+/// @brief Shared by the thread running a graph and its step jobs
+typedef struct {
+    StartupGraph* graph;
+    ecs_os_mutex_t lock;
+    /// @brief Signaled when a step is done
+    ecs_os_cond_t stepDone;
+} _GraphRun;
+
+typedef struct {
+    _GraphRun* run;
+    uint32_t step;
+} _StepJob;
+
+static uint64_t _monotonicNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+void beginStartupTimeline()
+{
+    bool begun = false;
+    if (atomic_compare_exchange_strong(&_begun, &begun, true)) {
+        _beginNs = _monotonicNs();
+    }
+}
+
+double startupNowMs()
+{
+    beginStartupTimeline();
+    return (_monotonicNs() - _beginNs) * 1e-6;
+}
+
+void recordStartupSpan(const char* name, double beginMs, double endMs)
+{
+    uint32_t i = atomic_fetch_add(&_nSpans, 1);
+    if (i >= STARTUP_MAX_STEPS) {
+        return;
+    }
+    _spans[i] = (_Span) { name, beginMs, endMs };
+}
+
+void markFirstFrame()
+{
+    if (atomic_load_explicit(&_firstFrameMarked, memory_order_relaxed)) {
+        return;
+    }
+    // The time is written before the flag is published, so readers that see
+    // the flag see the time
+    _firstFrameMs = startupNowMs();
+    atomic_store_explicit(&_firstFrameMarked, true, memory_order_release);
+}
+
+double timeToFirstFrameMs()
+{
+    return atomic_load_explicit(&_firstFrameMarked, memory_order_acquire) ? _firstFrameMs : -1.0;
+}
+
+void logStartupTimeline()
+{
+    uint32_t n = atomic_load(&_nSpans);
+    n = n < STARTUP_MAX_STEPS ? n : STARTUP_MAX_STEPS;
+    // Few spans, in about the order they started
+    for (uint32_t i = 1; i < n; ++i) {
+        for (uint32_t j = i; j > 0 && _spans[j].beginMs < _spans[j - 1].beginMs; --j) {
+            _Span s = _spans[j];
+            _spans[j] = _spans[j - 1];
+            _spans[j - 1] = s;
+        }
+    }
+    ecs_trace("Startup timeline");
+    ecs_log_push();
+    for (uint32_t i = 0; i < n; ++i) {
+        ecs_trace("[%8.2f - %8.2f ms] %-12s %8.2f ms", _spans[i].beginMs, _spans[i].endMs, _spans[i].name,
+            _spans[i].endMs - _spans[i].beginMs);
+    }
+    ecs_log_pop();
+    if (timeToFirstFrameMs() >= 0.0) {
+        ecs_trace("Time to first frame [%.2f] ms", timeToFirstFrameMs());
+    }
+}
+
+uint32_t addStartupStep(StartupGraph* graph, const char* name, StartupFn fn, void* ctx, bool mainThread,
+    const uint32_t* deps, uint32_t nDeps)
+{
+    if (graph->nSteps == STARTUP_MAX_STEPS || nDeps > STARTUP_MAX_DEPS) {
+        ecs_abort(1, "Too many startup steps or dependencies at [%s]", name);
+    }
+    uint32_t i = graph->nSteps++;
+    graph->steps[i].name = name;
+    graph->steps[i].fn = fn;
+    graph->steps[i].ctx = ctx;
+    graph->steps[i].mainThread = mainThread;
+    graph->steps[i].nDeps = nDeps;
+    graph->steps[i].waiting = nDeps;
+    graph->steps[i].started = false;
+    for (uint32_t d = 0; d < nDeps; ++d) {
+        // Only earlier steps, so the graph has no cycles
+        if (deps[d] >= i) {
+            ecs_abort(1, "Startup step [%s] waits for a later step", name);
+        }
+        graph->steps[i].deps[d] = deps[d];
+    }
+    return i;
+}
+
+static void _runStep(StartupGraph* graph, uint32_t i)
+{
+    double begin = startupNowMs();
+    {
+        TRACE_ZONE(graph->steps[i].name);
+        graph->steps[i].fn(graph->steps[i].ctx);
+    }
+    recordStartupSpan(graph->steps[i].name, begin, startupNowMs());
+}
+
+/// @brief Release the steps waiting for a step. The run lock must be held
+static void _finishLocked(StartupGraph* graph, uint32_t i)
+{
+    graph->nDone++;
+    for (uint32_t j = i + 1; j < graph->nSteps; ++j) {
+        for (uint32_t d = 0; d < graph->steps[j].nDeps; ++d) {
+            graph->steps[j].waiting -= graph->steps[j].deps[d] == i;
+        }
+    }
+}
+
+static void _stepJob(void* ctx)
+{
+    _StepJob* job = ctx;
+    _runStep(job->run->graph, job->step);
+    ecs_os_mutex_lock(job->run->lock);
+    _finishLocked(job->run->graph, job->step);
+    ecs_os_cond_broadcast(job->run->stepDone);
+    ecs_os_mutex_unlock(job->run->lock);
+}
+
+void runStartupGraph(StartupGraph* graph, JobPool* pool)
+{
+    _GraphRun run = {
+        .graph = graph,
+        .lock = ecs_os_mutex_new(),
+        .stepDone = ecs_os_cond_new(),
+    };
+    _StepJob jobs[STARTUP_MAX_STEPS];
+    ecs_os_mutex_lock(run.lock);
+    while (graph->nDone < graph->nSteps) {
+        // Hand every ready step to the workers, keep one for this thread
+        int32_t local = -1;
+        for (uint32_t i = 0; i < graph->nSteps; ++i) {
+            if (graph->steps[i].started || graph->steps[i].waiting) {
+                continue;
+            }
+            if (pool && !graph->steps[i].mainThread) {
+                graph->steps[i].started = true;
+                jobs[i] = (_StepJob) { &run, i };
+                jobPoolSubmit(pool, _stepJob, &jobs[i]);
+            } else if (local < 0) {
+                graph->steps[i].started = true;
+                local = (int32_t)i;
+            }
+        }
+        if (local >= 0) {
+            ecs_os_mutex_unlock(run.lock);
+            _runStep(graph, (uint32_t)local);
+            ecs_os_mutex_lock(run.lock);
+            _finishLocked(graph, (uint32_t)local);
+            continue;
+        }
+        ecs_os_cond_wait(run.stepDone, run.lock);
+    }
+    ecs_os_mutex_unlock(run.lock);
+    ecs_os_cond_free(run.stepDone);
+    ecs_os_mutex_free(run.lock);
+}
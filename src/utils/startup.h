@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "jobs.h"
+
+/// @brief Steps of a startup graph, and spans of the startup timeline
+#define STARTUP_MAX_STEPS 32
+/// @brief Steps a step can wait for
+#define STARTUP_MAX_DEPS 4
+
+typedef void (*StartupFn)(void* ctx);
+
+/// @brief Steps of startup and what each waits for. Steps run as soon as
+/// their dependencies are done, on the worker threads or, when they must,
+/// on the thread running the graph
+typedef struct StartupGraph {
+    struct {
+        const char* name;
+        StartupFn fn;
+        void* ctx;
+        bool mainThread;
+        uint32_t deps[STARTUP_MAX_DEPS];
+        uint32_t nDeps;
+        /// @brief Dependencies not done yet
+        uint32_t waiting;
+        bool started;
+    } steps[STARTUP_MAX_STEPS];
+    uint32_t nSteps;
+    uint32_t nDone;
+} StartupGraph;
+
+/// @brief Where the timeline starts. Call first thing in `main`, otherwise
+/// it starts at the first timeline call
+void beginStartupTimeline();
+
+/// @brief Milliseconds since the timeline began
+double startupNowMs();
+
+/// @brief Add a span to the timeline
+/// @param name Must outlive the timeline
+/// @param beginMs From `startupNowMs`
+/// @param endMs
+void recordStartupSpan(const char* name, double beginMs, double endMs);
+
+/// @brief Record that the first frame was submitted. Later calls do nothing,
+/// only called from the thread that submits frames
+void markFirstFrame();
+
+/// @brief Time from the start of the timeline to the first frame
+/// @return Milliseconds, negative before the first frame
+double timeToFirstFrameMs();
+
+/// @brief Log every span of the timeline and the time to first frame
+void logStartupTimeline();
+
+/// @brief Add a step
+/// @param graph
+/// @param name Must outlive the timeline
+/// @param fn
+/// @param ctx
+/// @param mainThread Whether it must run on the thread running the graph,
+/// e.g. to create windows
+/// @param deps Steps it waits for, added before it
+/// @param nDeps At most `STARTUP_MAX_DEPS`
+/// @return The step, for later steps to wait for
+uint32_t addStartupStep(StartupGraph* graph, const char* name, StartupFn fn, void* ctx, bool mainThread,
+    const uint32_t* deps, uint32_t nDeps);
+
+/// @brief Run every step, each as a span of the timeline. Returns when all
+/// are done
+/// @param graph
+/// @param pool Runs the steps not bound to the main thread, or NULL to run
+/// everything on the calling thread
+void runStartupGraph(StartupGraph* graph, JobPool* pool);
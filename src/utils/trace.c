@@ -0,0 +1,136 @@
+#include "trace.h"
+
+#include <flecs.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "memtrack.h"
+
+atomic_bool _traceEnabled;
+_Thread_local TraceBuffer* _traceBuffer;
+/// @brief Name of the calling thread, kept until it has a buffer
+static _Thread_local const char* _threadName;
+
+/// @brief Every thread's buffer, newest first. Only pushed to until cleanup
+static _Atomic(TraceBuffer*) _buffers;
+static atomic_uint _nextTid;
+/// @brief Ticks and nanoseconds when tracing started, to convert ticks
+static uint64_t _startTicks;
+static uint64_t _startNs;
+
+static uint64_t _monotonicNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+TraceBuffer* _newTraceBuffer()
+{
+    // Lives until cleanup, so that zones of finished threads can be exported
+    TraceBuffer* buffer = memCalloc(MEM_GENERAL, 1, sizeof(*buffer));
+    buffer->tid = atomic_fetch_add(&_nextTid, 1) + 1;
+    buffer->threadName = _threadName;
+    TraceBuffer* head = atomic_load(&_buffers);
+    do {
+        buffer->next = head;
+    } while (!atomic_compare_exchange_weak(&_buffers, &head, buffer));
+    _traceBuffer = buffer;
+    return buffer;
+}
+
+void startTracing()
+{
+    if (!_startTicks) {
+        _startNs = _monotonicNs();
+        _startTicks = traceNow();
+    }
+    atomic_store(&_traceEnabled, true);
+}
+
+void stopTracing()
+{
+    atomic_store(&_traceEnabled, false);
+}
+
+void cleanupTraceBuffers()
+{
+    atomic_store(&_traceEnabled, false);
+    TraceBuffer* buffer = atomic_exchange(&_buffers, NULL);
+    while (buffer) {
+        TraceBuffer* next = buffer->next;
+        memFree(buffer);
+        buffer = next;
+    }
+    _traceBuffer = NULL;
+}
+
+void setTraceThreadName(const char* name)
+{
+    // Buffers are only made by zones recorded while tracing
+    _threadName = name;
+    if (_traceBuffer) {
+        _traceBuffer->threadName = name;
+    }
+}
+
+/// @brief Write a string literal, escaping what JSON needs escaped
+static void _writeJsonString(FILE* f, const char* s)
+{
+    fputc('"', f);
+    for (; *s; ++s) {
+        if (*s == '"' || *s == '\\') {
+            fputc('\\', f);
+        }
+        fputc((unsigned char)*s < 0x20 ? ' ' : *s, f);
+    }
+    fputc('"', f);
+}
+
+bool writeTraceJson(const char* path)
+{
+    FILE* f = fopen(path, "w");
+    if (!f) {
+        ecs_err("Cannot write trace to [%s]", path);
+        return false;
+    }
+    // Ticks per microsecond, measured over the whole trace. TSC runs at a
+    // constant rate on every CPU this targets
+    uint64_t ns = _monotonicNs() - _startNs;
+    uint64_t ticks = traceNow() - _startTicks;
+    double usPerTick = ticks > 0 && ns > 0 ? (double)ns / (double)ticks * 1e-3 : 1e-3;
+    fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    bool first = true;
+    uint64_t zones = 0, dropped = 0;
+    for (TraceBuffer* b = atomic_load(&_buffers); b; b = b->next) {
+        if (b->threadName) {
+            fprintf(f, "%s{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":",
+                first ? "" : ",\n", b->tid);
+            _writeJsonString(f, b->threadName);
+            fprintf(f, "}}");
+            first = false;
+        }
+        uint32_t n = atomic_load_explicit(&b->count, memory_order_acquire);
+        for (uint32_t i = 0; i < n; ++i) {
+            const TraceEvent* e = &b->events[i];
+            // Zones begun before tracing started have no start time
+            if (e->begin < _startTicks) {
+                continue;
+            }
+            fprintf(f, "%s{\"ph\":\"X\",\"name\":", first ? "" : ",\n");
+            _writeJsonString(f, e->name);
+            fprintf(f, ",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", b->tid,
+                (e->begin - _startTicks) * usPerTick, (e->end - e->begin) * usPerTick);
+            first = false;
+        }
+        zones += n;
+        dropped += b->dropped;
+    }
+    fprintf(f, "\n]}\n");
+    fclose(f);
+    ecs_trace("Wrote [%llu] trace zones to [%s]", (unsigned long long)zones, path);
+    if (dropped) {
+        ecs_warn("Dropped [%llu] trace zones, thread buffers were full", (unsigned long long)dropped);
+    }
+    return true;
+}
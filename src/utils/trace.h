@@ -0,0 +1,111 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/// @brief Zones per thread, later ones are dropped
+#define TRACE_THREAD_ZONES (1 << 16)
+
+/// @brief A zone being timed
+typedef struct TraceZone {
+    const char* name;
+    /// @brief 0 when tracing was off at the start of the zone
+    uint64_t begin;
+} TraceZone;
+
+/// @brief A finished zone
+typedef struct TraceEvent {
+    const char* name;
+    uint64_t begin;
+    uint64_t end;
+} TraceEvent;
+
+/// @brief Zones of one thread. Only the thread writes, it publishes events
+/// by storing `count`, so the exporter can read while it runs
+typedef struct TraceBuffer {
+    TraceEvent events[TRACE_THREAD_ZONES];
+    _Atomic uint32_t count;
+    uint32_t dropped;
+    uint32_t tid;
+    const char* threadName;
+    struct TraceBuffer* next;
+} TraceBuffer;
+
+extern atomic_bool _traceEnabled;
+extern _Thread_local TraceBuffer* _traceBuffer;
+
+#ifdef TRACING
+/// @brief Time the rest of the enclosing block as a zone. At most one per
+/// block. Compiled out without `TRACING`
+/// @param name Must outlive the trace, e.g. a literal or `__func__`
+#define TRACE_ZONE(name) \
+    TraceZone _traceZone __attribute__((cleanup(endTraceZone))) = beginTraceZone(name)
+/// @brief Name the calling thread in exported traces
+#define TRACE_THREAD_NAME(name) setTraceThreadName(name)
+#else
+#define TRACE_ZONE(name) ((void)0)
+#define TRACE_THREAD_NAME(name) ((void)0)
+#endif
+
+/// @brief Timestamp in ticks, TSC cycles on x86 and nanoseconds elsewhere
+static inline uint64_t traceNow()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+#endif
+}
+
+/// @brief Give the calling thread its buffer, on its first zone recorded
+/// while tracing
+TraceBuffer* _newTraceBuffer();
+
+static inline TraceZone beginTraceZone(const char* name)
+{
+    bool on = atomic_load_explicit(&_traceEnabled, memory_order_relaxed);
+    return (TraceZone) { .name = name, .begin = on ? traceNow() : 0 };
+}
+
+static inline void endTraceZone(TraceZone* zone)
+{
+    if (!zone->begin) {
+        return;
+    }
+    uint64_t end = traceNow();
+    TraceBuffer* buffer = _traceBuffer ? _traceBuffer : _newTraceBuffer();
+    uint32_t n = atomic_load_explicit(&buffer->count, memory_order_relaxed);
+    if (n == TRACE_THREAD_ZONES) {
+        buffer->dropped++;
+        return;
+    }
+    buffer->events[n] = (TraceEvent) { zone->name, zone->begin, end };
+    atomic_store_explicit(&buffer->count, n + 1, memory_order_release);
+}
+
+/// @brief Start recording zones, from this point on
+void startTracing();
+
+/// @brief Stop recording zones. Recorded ones are kept for export
+void stopTracing();
+
+/// @brief Stop recording and free the zones of every thread. Other threads
+/// must be done, e.g. at exit. Tracing is not started again
+void cleanupTraceBuffers();
+
+/// @brief Name the calling thread in exported traces
+/// @param name Must outlive the trace
+void setTraceThreadName(const char* name);
+
+/// @brief Write the zones recorded so far as Chrome trace event JSON, which
+/// chrome://tracing and Perfetto open. Threads may keep recording
+/// @param path
+/// @return Whether the file was written
+bool writeTraceJson(const char* path);
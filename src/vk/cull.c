@@ -0,0 +1,335 @@
+#include "cull.h"
+#include "vk.h"
+
+#include <chunk.h>
+#include <math.h>
+#include <stb_ds.h>
+
+#include "device.h"
+#include "pipeline.h"
+#include "profiler.h"
+#include "staging.h"
+
+/// @brief Corners per edge of the chunk grid mesh
+#define CHUNK_VERTS (CHUNK_SIZE + 1)
+/// @brief First skirt vertex, after the corners
+#define CHUNK_SKIRT_BASE (CHUNK_VERTS * CHUNK_VERTS)
+
+static const uint32_t _cullChunksSpv[] =
+#include "vk/shaders/cull_chunks.comp.inc"
+    ;
+
+/// @brief `CullParams` of cull_chunks.comp, std140
+typedef struct {
+    float planes[6][4];
+    float eye[4];
+    float lodDistances[4];
+    uint32_t lodFirstIndex[4];
+    uint32_t lodIndexCount[4];
+    uint32_t slotCount;
+    uint32_t _pad[3];
+} _CullParams;
+
+static const ChunkBounds _freeBounds = { { 0 } };
+
+/// @brief Two counterclockwise triangles per quad seen from above, with
+/// quads `step` tiles wide, and a skirt around the border. Skirt vertices
+/// are numbered `CHUNK_SKIRT_BASE` past the corner they hang from
+/// @return An stb array of indices of all LODs, one after the other
+static uint16_t* _newLodIndices(uint32_t firstIndex[CHUNK_LODS], uint32_t indexCount[CHUNK_LODS])
+{
+    uint16_t* arrIndices = NULL;
+    for (int lod = 0; lod < CHUNK_LODS; ++lod) {
+        int step = lod == CHUNK_LODS - 1 ? CHUNK_SIZE : 1 << lod;
+        firstIndex[lod] = arrlenu(arrIndices);
+        for (int y = 0; y < CHUNK_SIZE; y += step) {
+            for (int x = 0; x < CHUNK_SIZE; x += step) {
+                uint16_t a = y * CHUNK_VERTS + x;
+                uint16_t b = a + step;
+                uint16_t c = a + step * CHUNK_VERTS;
+                uint16_t d = c + step;
+                arrput(arrIndices, a);
+                arrput(arrIndices, b);
+                arrput(arrIndices, c);
+                arrput(arrIndices, b);
+                arrput(arrIndices, d);
+                arrput(arrIndices, c);
+            }
+        }
+        // Edges of the south, north, west and east borders
+        for (int i = 0; i < CHUNK_SIZE; i += step) {
+            uint16_t edges[4][2] = {
+                { i, i + step },
+                { CHUNK_SIZE * CHUNK_VERTS + i, CHUNK_SIZE * CHUNK_VERTS + i + step },
+                { i * CHUNK_VERTS, (i + step) * CHUNK_VERTS },
+                { i * CHUNK_VERTS + CHUNK_SIZE, (i + step) * CHUNK_VERTS + CHUNK_SIZE },
+            };
+            for (int e = 0; e < 4; ++e) {
+                uint16_t a = edges[e][0], b = edges[e][1];
+                arrput(arrIndices, a);
+                arrput(arrIndices, b);
+                arrput(arrIndices, b + CHUNK_SKIRT_BASE);
+                arrput(arrIndices, a);
+                arrput(arrIndices, b + CHUNK_SKIRT_BASE);
+                arrput(arrIndices, a + CHUNK_SKIRT_BASE);
+            }
+        }
+        indexCount[lod] = arrlenu(arrIndices) - firstIndex[lod];
+    }
+    return arrIndices;
+}
+
+static void _newCullPipeline(const RenderDevice* device, ChunkCuller* culler)
+{
+    VkDescriptorSetLayoutBinding bindings[4] = {
+        { 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1, VK_SHADER_STAGE_COMPUTE_BIT },
+        { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT },
+        { 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT },
+        { 3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT },
+    };
+    VkDescriptorSetLayoutCreateInfo setCI = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = 4,
+        .pBindings = bindings,
+    };
+    vkCheck(vkCreateDescriptorSetLayout(device->handle, &setCI, hostAllocationCallbacks(), &culler->setLayout))
+    {
+        ecs_abort(1, "Failed to create culling descriptor set layout");
+    }
+    VkPipelineLayoutCreateInfo layoutCI = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = &culler->setLayout,
+    };
+    vkCheck(vkCreatePipelineLayout(device->handle, &layoutCI, hostAllocationCallbacks(), &culler->layout))
+    {
+        ecs_abort(1, "Failed to create culling pipeline layout");
+    }
+    VkShaderModule module = newShaderModule(device, _cullChunksSpv, sizeof(_cullChunksSpv));
+    VkComputePipelineCreateInfo ci = {
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .stage = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+            .module = module,
+            .pName = "main",
+        },
+        .layout = culler->layout,
+    };
+    culler->pipeline = newComputePipeline(device, &ci);
+    vkDestroyShaderModule(device->handle, module, hostAllocationCallbacks());
+}
+
+/// @brief One set per frame slot, reading parameters from the frame's
+/// transient pool at a dynamic offset
+static void _newCullDescriptors(ChunkCuller* culler, const FrameManager* frames)
+{
+    VkDescriptorPoolSize sizes[] = {
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, culler->nFrames },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3 * culler->nFrames },
+    };
+    VkDescriptorPoolCreateInfo poolCI = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .maxSets = culler->nFrames,
+        .poolSizeCount = 2,
+        .pPoolSizes = sizes,
+    };
+    vkCheck(vkCreateDescriptorPool(culler->device, &poolCI, hostAllocationCallbacks(), &culler->descriptorPool))
+    {
+        ecs_abort(1, "Failed to create culling descriptor pool");
+    }
+    VkDescriptorSetLayout layouts[MAX_FRAMES_IN_FLIGHT];
+    for (uint32_t f = 0; f < culler->nFrames; ++f) {
+        layouts[f] = culler->setLayout;
+    }
+    VkDescriptorSetAllocateInfo ai = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = culler->descriptorPool,
+        .descriptorSetCount = culler->nFrames,
+        .pSetLayouts = layouts,
+    };
+    vkCheck(vkAllocateDescriptorSets(culler->device, &ai, culler->sets))
+    {
+        ecs_abort(1, "Failed to allocate culling descriptor sets");
+    }
+    for (uint32_t f = 0; f < culler->nFrames; ++f) {
+        VkDescriptorBufferInfo infos[4] = {
+            { frames->frames[f].transient.buffer, 0, sizeof(_CullParams) },
+            { culler->bounds.buffers[f], 0, VK_WHOLE_SIZE },
+            { culler->draws[f], 0, VK_WHOLE_SIZE },
+            { culler->counts[f], 0, VK_WHOLE_SIZE },
+        };
+        VkWriteDescriptorSet writes[4];
+        for (uint32_t b = 0; b < 4; ++b) {
+            writes[b] = (VkWriteDescriptorSet) {
+                .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                .dstSet = culler->sets[f],
+                .dstBinding = b,
+                .descriptorCount = 1,
+                .descriptorType = b == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .pBufferInfo = &infos[b],
+            };
+        }
+        vkUpdateDescriptorSets(culler->device, 4, writes, 0, NULL);
+    }
+}
+
+ChunkCuller newChunkCuller(const RenderDevice* device, const FrameManager* frames)
+{
+    ecs_trace("Creating ChunkCuller for [%d] chunks", CULL_MAX_CHUNKS);
+    ecs_log_push();
+    ChunkCuller culler = {
+        .device = device->handle,
+        .allocator = device->allocator,
+        .staging = device->staging,
+        .lodDistances = { 48.0f, 96.0f, 192.0f },
+        .nFrames = frames->nFrames,
+    };
+    culler.bounds = newSlotBuffer(device, culler.nFrames, CULL_MAX_CHUNKS, sizeof(ChunkBounds), MEM_TERRAIN);
+    for (uint32_t f = 0; f < culler.nFrames; ++f) {
+        culler.draws[f] = newBuffer(device->allocator, CULL_MAX_CHUNKS * sizeof(VkDrawIndexedIndirectCommand),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            MEMORY_USAGE_GPU_ONLY, &culler.drawsMemory[f]);
+        culler.counts[f] = newBuffer(device->allocator, sizeof(uint32_t),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT
+                | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            MEMORY_USAGE_GPU_ONLY, &culler.countsMemory[f]);
+    }
+    uint16_t* arrIndices = _newLodIndices(culler.lodFirstIndex, culler.lodIndexCount);
+    VkDeviceSize indicesSize = arrlenu(arrIndices) * sizeof(uint16_t);
+    culler.indices = newBuffer(device->allocator, indicesSize,
+        VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        MEMORY_USAGE_GPU_ONLY, &culler.indicesMemory);
+    stagingUpload(device->staging, culler.indices, 0, arrIndices, indicesSize);
+    arrfree(arrIndices);
+    _newCullPipeline(device, &culler);
+    _newCullDescriptors(&culler, frames);
+    ecs_log_pop();
+    return culler;
+}
+
+void cleanupChunkCuller(ChunkCuller* culler)
+{
+    ecs_trace("Cleaning up ChunkCuller");
+    vkDestroyDescriptorPool(culler->device, culler->descriptorPool, hostAllocationCallbacks());
+    vkDestroyPipeline(culler->device, culler->pipeline, hostAllocationCallbacks());
+    vkDestroyPipelineLayout(culler->device, culler->layout, hostAllocationCallbacks());
+    vkDestroyDescriptorSetLayout(culler->device, culler->setLayout, hostAllocationCallbacks());
+    for (uint32_t f = 0; f < culler->nFrames; ++f) {
+        cleanupBuffer(culler->allocator, culler->draws[f], &culler->drawsMemory[f]);
+        cleanupBuffer(culler->allocator, culler->counts[f], &culler->countsMemory[f]);
+    }
+    cleanupBuffer(culler->allocator, culler->indices, &culler->indicesMemory);
+    cleanupSlotBuffer(&culler->bounds);
+    arrfree(culler->arrFreeSlots);
+    *culler = (ChunkCuller) { 0 };
+}
+
+uint32_t allocChunkSlot(ChunkCuller* culler)
+{
+    if (arrlen(culler->arrFreeSlots) > 0) {
+        return arrpop(culler->arrFreeSlots);
+    }
+    if (culler->slotCount == CULL_MAX_CHUNKS) {
+        if (!culler->warnedFull) {
+            ecs_warn("Out of chunk slots, chunks beyond [%d] are not drawn", CULL_MAX_CHUNKS);
+            culler->warnedFull = true;
+        }
+        return CULL_NO_SLOT;
+    }
+    return culler->slotCount++;
+}
+
+void freeChunkSlot(ChunkCuller* culler, uint32_t slot)
+{
+    setChunkBounds(culler, slot, &_freeBounds);
+    arrput(culler->arrFreeSlots, slot);
+}
+
+void setChunkBounds(ChunkCuller* culler, uint32_t slot, const ChunkBounds* bounds)
+{
+    writeSlot(&culler->bounds, slot, bounds);
+}
+
+void frustumPlanes(const float m[16], float planes[6][4])
+{
+    for (int i = 0; i < 4; ++i) {
+        float r0 = m[i * 4 + 0], r1 = m[i * 4 + 1], r2 = m[i * 4 + 2], r3 = m[i * 4 + 3];
+        planes[0][i] = r3 + r0;
+        planes[1][i] = r3 - r0;
+        planes[2][i] = r3 + r1;
+        planes[3][i] = r3 - r1;
+        planes[4][i] = r2;
+        planes[5][i] = r3 - r2;
+    }
+    for (int p = 0; p < 6; ++p) {
+        float len = sqrtf(planes[p][0] * planes[p][0] + planes[p][1] * planes[p][1] + planes[p][2] * planes[p][2]);
+        if (len > 0.0f) {
+            for (int i = 0; i < 4; ++i) {
+                planes[p][i] /= len;
+            }
+        }
+    }
+}
+
+void recordChunkCulling(ChunkCuller* culler, Frame* frame, const float viewProj[16], const float eye[3])
+{
+    VkCommandBuffer cmd = frame->cmd;
+    // The frame slot's fence was waited for, so nothing reads its copy
+    uploadSlots(&culler->bounds, frame->slot);
+    acquireFrameUploads(culler->staging, frame);
+    VkDeviceSize offset;
+    _CullParams* params = linearPoolAlloc(&frame->transient, sizeof(_CullParams), 16, &offset);
+    if (!params) {
+        ecs_abort(1, "Frame transient pool is full");
+    }
+    frustumPlanes(viewProj, params->planes);
+    for (int i = 0; i < 3; ++i) {
+        params->eye[i] = eye[i];
+        params->lodDistances[i] = culler->lodDistances[i];
+    }
+    for (int lod = 0; lod < CHUNK_LODS; ++lod) {
+        params->lodFirstIndex[lod] = culler->lodFirstIndex[lod];
+        params->lodIndexCount[lod] = culler->lodIndexCount[lod];
+    }
+    params->slotCount = culler->slotCount;
+    flushDeviceAllocation(culler->allocator, &frame->transient.allocation, offset, sizeof(_CullParams));
+
+    GPU_SCOPE_BEGIN(frame, "cull");
+    // The count is the append position of the shader
+    VkBuffer count = culler->counts[frame->slot];
+    vkCmdFillBuffer(cmd, count, 0, sizeof(uint32_t), 0);
+    VkBufferMemoryBarrier cleared = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .buffer = count,
+        .size = VK_WHOLE_SIZE,
+    };
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        0, 0, NULL, 1, &cleared, 0, NULL);
+    if (culler->slotCount > 0) {
+        uint32_t dynamicOffset = (uint32_t)offset;
+        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, culler->pipeline);
+        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, culler->layout,
+            0, 1, &culler->sets[frame->slot], 1, &dynamicOffset);
+        vkCmdDispatch(cmd, (culler->slotCount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+    }
+    VkMemoryBarrier culled = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+    };
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+        0, 1, &culled, 0, NULL, 0, NULL);
+    GPU_SCOPE_END(frame);
+}
+
+void drawCulledChunks(const ChunkCuller* culler, VkCommandBuffer cmd, uint32_t frameSlot)
+{
+    vkCmdBindIndexBuffer(cmd, culler->indices, 0, VK_INDEX_TYPE_UINT16);
+    vkCmdDrawIndexedIndirectCount(cmd, culler->draws[frameSlot], 0, culler->counts[frameSlot], 0,
+        CULL_MAX_CHUNKS, sizeof(VkDrawIndexedIndirectCommand));
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+#include "frame.h"
+#include "memory.h"
+#include "slot_buffer.h"
+
+struct RenderDevice;
+typedef struct RenderDevice RenderDevice;
+struct StagingRing;
+typedef struct StagingRing StagingRing;
+
+/// @brief Chunk slots on the GPU, four sectors
+#define CULL_MAX_CHUNKS 16384
+/// @brief Of `allocChunkSlot` once every slot is taken
+#define CULL_NO_SLOT UINT32_MAX
+/// @brief Meshes of a chunk, each with half the tiles per edge of the one
+/// before, the last a single quad
+#define CHUNK_LODS 4
+/// @brief Must match `local_size_x` of cull_chunks.comp
+#define CULL_GROUP_SIZE 64
+
+/// @brief Box of one chunk slot as laid out in the storage buffer
+typedef struct ChunkBounds {
+    /// @brief `min[3]` is 1 for a slot that holds a chunk, 0 for a free one
+    float min[4];
+    /// @brief `max[3]` is the nominal height of the chunk
+    float max[4];
+} ChunkBounds;
+
+/// @brief Frustum culls chunks and selects their LOD on the GPU, then draws
+/// the survivors with one indirect draw. Chunks live in slots of a storage
+/// buffer, which the draw's vertex shader reads through `firstInstance`
+typedef struct ChunkCuller {
+    VkDevice device;
+    DeviceAllocator* allocator;
+    StagingRing* staging;
+    /// @brief `ChunkBounds` per slot, a copy per frame slot
+    SlotBuffer bounds;
+    /// @brief One grid mesh per LOD, over the `(CHUNK_SIZE + 1)^2` corners
+    /// of the tiles of a chunk. Each has a skirt hanging from its border,
+    /// which hides cracks between chunks and between LODs
+    VkBuffer indices;
+    DeviceAllocation indicesMemory;
+    uint32_t lodFirstIndex[CHUNK_LODS];
+    uint32_t lodIndexCount[CHUNK_LODS];
+    /// @brief Distance from the eye to a chunk's box at which each LOD past
+    /// the first starts, in m
+    float lodDistances[CHUNK_LODS - 1];
+    /// @brief Per frame slot, written by the culling pass of the frame
+    VkBuffer draws[MAX_FRAMES_IN_FLIGHT];
+    DeviceAllocation drawsMemory[MAX_FRAMES_IN_FLIGHT];
+    VkBuffer counts[MAX_FRAMES_IN_FLIGHT];
+    DeviceAllocation countsMemory[MAX_FRAMES_IN_FLIGHT];
+    uint32_t nFrames;
+    VkDescriptorSetLayout setLayout;
+    VkPipelineLayout layout;
+    VkPipeline pipeline;
+    VkDescriptorPool descriptorPool;
+    VkDescriptorSet sets[MAX_FRAMES_IN_FLIGHT];
+    /// @brief Every slot in use is below this
+    uint32_t slotCount;
+    /// @brief Slots below `slotCount` that were freed
+    uint32_t* arrFreeSlots;
+    /// @brief Running out of slots was reported
+    bool warnedFull;
+} ChunkCuller;
+
+/// @brief Create the buffers and the culling pipeline
+/// @param device
+/// @param frames Culling parameters go into the transient pools of its frames
+/// @return The culler
+ChunkCuller newChunkCuller(const RenderDevice* device, const FrameManager* frames);
+
+/// @brief Destroy the culler. The device must be done with it
+/// @param culler
+void cleanupChunkCuller(ChunkCuller* culler);
+
+/// @brief Take a free slot. Its bounds must be set before it is drawn
+/// @param culler
+/// @return The slot, or `CULL_NO_SLOT` while all `CULL_MAX_CHUNKS` are in
+/// use, which is warned about once
+uint32_t allocChunkSlot(ChunkCuller* culler);
+
+/// @brief Mark a slot free, so it is culled. It can be reused right away,
+/// as frames in flight cull their own copy of the bounds
+/// @param culler
+/// @param slot
+void freeChunkSlot(ChunkCuller* culler, uint32_t slot);
+
+/// @brief Set the bounds of a slot, uploaded by the culling pass of each
+/// frame slot
+/// @param culler
+/// @param slot
+/// @param bounds
+void setChunkBounds(ChunkCuller* culler, uint32_t slot, const ChunkBounds* bounds);
+
+/// @brief Inward facing planes of a view frustum, as `a x + b y + c z + d >= 0`
+/// @param viewProj Column major, with clip space depth from 0 to 1
+/// @param planes Receives left, right, bottom, top, near and far
+void frustumPlanes(const float viewProj[16], float planes[6][4]);
+
+/// @brief Record the culling pass of a frame. Must be outside rendering,
+/// before `drawCulledChunks`. Uploads the bounds set since the frame slot
+/// last culled, and makes the frame wait for every upload queued so far
+/// @param culler
+/// @param frame
+/// @param viewProj Column major, with clip space depth from 0 to 1
+/// @param eye Where LOD distances are measured from
+void recordChunkCulling(ChunkCuller* culler, Frame* frame, const float viewProj[16], const float eye[3]);
+
+/// @brief Draw the chunks that the culling pass of a frame slot kept. The
+/// caller binds a pipeline whose vertex shader finds its chunk by
+/// `gl_InstanceIndex` and its corner by `gl_VertexIndex`. Indices from
+/// `(CHUNK_SIZE + 1)^2` on are the skirt below corner `index - (CHUNK_SIZE + 1)^2`
+/// @param culler
+/// @param cmd Inside rendering
+/// @param frameSlot
+void drawCulledChunks(const ChunkCuller* culler, VkCommandBuffer cmd, uint32_t frameSlot);
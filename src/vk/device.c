@@ -2,15 +2,27 @@
 #include "vk.h"
 
 #include <stb_ds.h>
+#include <utils/arena.h>
+#include <utils/trace.h>
 
 #include "physical_device.h"
 
-static const char* _requiredExtensions[] = {
-    VK_KHR_SWAPCHAIN_EXTENSION_NAME,
-    "VK_KHR_portability_subset",
-};
-
-static const uint32_t _nRequiredExtensions = 2;
+/// @brief Extensions to enable on a device
+/// @param phys
+/// @param headless Without presentation
+/// @return An stb array of names
+static const char** _getDeviceExtensions(const PhysicalDevice* phys, bool headless)
+{
+    const char** exts = NULL;
+    if (!headless) {
+        arrput(exts, VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+    }
+    // Must be enabled where present (MoltenVK), but most drivers lack it
+    if (hasDeviceExt(phys, "VK_KHR_portability_subset")) {
+        arrput(exts, "VK_KHR_portability_subset");
+    }
+    return exts;
+}
 
 static VkQueue
 _newDeviceQueue(VkDevice device, int queueFamilyIndex, int queueIndex)
@@ -22,67 +34,216 @@ _newDeviceQueue(VkDevice device, int queueFamilyIndex, int queueIndex)
     return q;
 }
 
-static VkDevice _newLogicalDevice(const PhysicalDevice* phys)
+/// @brief Roles of the queues of a render device
+enum {
+    _QUEUE_GRAPHICS,
+    _QUEUE_COMPUTE,
+    _QUEUE_TRANSFER,
+    _QUEUE_ROLES,
+};
+
+/// @brief Graphics work is latency critical, streaming is not
+static const float _queuePriorities[_QUEUE_ROLES] = { 1.0f, 0.5f, 0.25f };
+
+static const char* _queueRoleNames[_QUEUE_ROLES] = { "graphics", "compute", "transfer" };
+
+/// @brief Where each role's queue lives. Roles without a queue of their own
+/// share one with another role
+typedef struct {
+    uint32_t family[_QUEUE_ROLES];
+    uint32_t index[_QUEUE_ROLES];
+} _QueuePlan;
+
+/// @brief First family that has all of `flags` and none of `without`
+static int _findQueueFamily(const PhysicalDevice* phys, VkQueueFlags flags, VkQueueFlags without)
+{
+    for (int i = 0; i < arrlen(phys->arrQueueFamilyProps); ++i) {
+        VkQueueFlags f = phys->arrQueueFamilyProps[i].queueFlags;
+        if ((f & flags) == flags && (f & without) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/// @brief First family with graphics and compute that can present to
+/// `surface`, then any graphics family that can
+static int _findGraphicsFamily(const PhysicalDevice* phys, VkSurfaceKHR surface)
+{
+    VkQueueFlags flags = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT;
+    for (int i = 0; i < arrlen(phys->arrQueueFamilyProps); ++i) {
+        if ((phys->arrQueueFamilyProps[i].queueFlags & flags) == flags
+            && (!surface || canPresent(phys, i, surface))) {
+            return i;
+        }
+    }
+    return getGraphicsQueueFamilyIndex(phys, surface);
+}
+
+/// @brief Put a role on `family` if it has a queue not taken yet, return
+/// whether it did
+static bool _tryAssign(const PhysicalDevice* phys, _QueuePlan* plan, int role, int family)
+{
+    if (family < 0) {
+        return false;
+    }
+    uint32_t used = 0;
+    for (int r = 0; r < role; ++r) {
+        used += plan->family[r] == (uint32_t)family;
+    }
+    if (used >= phys->arrQueueFamilyProps[family].queueCount) {
+        return false;
+    }
+    plan->family[role] = family;
+    plan->index[role] = used;
+    return true;
+}
+
+/// @brief Prefer queues that run alongside graphics: a compute family
+/// without graphics for compute, a pure transfer family (the DMA engines)
+/// for transfers. Otherwise fall back to spare queues of any capable
+/// family, and finally share the graphics queue
+static _QueuePlan _planQueues(const PhysicalDevice* phys, VkSurfaceKHR surface)
+{
+    _QueuePlan plan;
+    // Graphics queues can always compute and transfer, and the graphics
+    // queue presents
+    int graphics = _findGraphicsFamily(phys, surface);
+    plan.family[_QUEUE_GRAPHICS] = graphics;
+    plan.index[_QUEUE_GRAPHICS] = 0;
+
+    if (!_tryAssign(phys, &plan, _QUEUE_COMPUTE, _findQueueFamily(phys, VK_QUEUE_COMPUTE_BIT, VK_QUEUE_GRAPHICS_BIT))
+        && !_tryAssign(phys, &plan, _QUEUE_COMPUTE, graphics)) {
+        plan.family[_QUEUE_COMPUTE] = plan.family[_QUEUE_GRAPHICS];
+        plan.index[_QUEUE_COMPUTE] = plan.index[_QUEUE_GRAPHICS];
+    }
+    int compute = plan.family[_QUEUE_COMPUTE];
+    if (!_tryAssign(phys, &plan, _QUEUE_TRANSFER,
+            _findQueueFamily(phys, VK_QUEUE_TRANSFER_BIT, VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))
+        && !_tryAssign(phys, &plan, _QUEUE_TRANSFER, compute)
+        && !_tryAssign(phys, &plan, _QUEUE_TRANSFER, graphics)) {
+        plan.family[_QUEUE_TRANSFER] = plan.family[_QUEUE_GRAPHICS];
+        plan.index[_QUEUE_TRANSFER] = plan.index[_QUEUE_GRAPHICS];
+    }
+    for (int r = 0; r < _QUEUE_ROLES; ++r) {
+        ecs_trace("Queue for %s: family [%u] index [%u]", _queueRoleNames[r], plan.family[r], plan.index[r]);
+    }
+    return plan;
+}
+
+static VkDevice _newLogicalDevice(const PhysicalDevice* phys, const _QueuePlan* plan, bool headless)
 {
     ecs_trace("Creating logical device");
     ecs_log_push();
     ecs_trace("Selected physical device %#p", phys);
     VkPhysicalDevice vkPhysicalDevice = phys->handle;
-    VkPhysicalDeviceFeatures features = { 0 };
-    const VkQueueFamilyProperties* queueProps
-        = phys->arrQueueFamilyProps;
-
-    int nQueues = arrlen(queueProps);
-    VkDeviceQueueCreateInfo queueCI[nQueues];
-    for (int i = 0; i < nQueues; ++i) {
-        VkQueueFamilyProperties prop = queueProps[i];
-        uint32_t qc = prop.queueCount;
-        assert(qc > 0);
-        // Destroyed when returning!
-        float* priorities = alloca(qc * sizeof(float));
-        memset(priorities, 0, sizeof(*priorities) * qc);
-        queueCI[i]
-            = (VkDeviceQueueCreateInfo) {
-                  .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
-                  .queueFamilyIndex = i,
-                  .pQueuePriorities = priorities,
-                  .queueCount = qc,
-              };
+    // Culled chunk draws carry their slot in `firstInstance`
+    VkPhysicalDeviceFeatures features = { .drawIndirectFirstInstance = VK_TRUE };
+    // Secondary command buffers record draws inside render passes begun
+    // without render pass objects
+    VkPhysicalDeviceVulkan13Features features13 = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
+        .dynamicRendering = VK_TRUE,
+    };
+    // Uploads are tracked with timeline semaphores, and culled terrain is
+    // drawn with a count written by the GPU
+    VkPhysicalDeviceVulkan12Features features12 = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+        .pNext = &features13,
+        .timelineSemaphore = VK_TRUE,
+        .drawIndirectCount = VK_TRUE,
+    };
+
+    // One create info per family in use, with the queues of its roles
+    VkDeviceQueueCreateInfo queueCI[_QUEUE_ROLES];
+    float priorities[_QUEUE_ROLES][_QUEUE_ROLES];
+    int nFamilies = 0;
+    for (int r = 0; r < _QUEUE_ROLES; ++r) {
+        int f = 0;
+        while (f < nFamilies && queueCI[f].queueFamilyIndex != plan->family[r]) {
+            ++f;
+        }
+        if (f == nFamilies) {
+            queueCI[nFamilies++] = (VkDeviceQueueCreateInfo) {
+                .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+                .queueFamilyIndex = plan->family[r],
+                .pQueuePriorities = priorities[f],
+                .queueCount = 0,
+            };
+        }
+        // Shared queues keep the priority of the role that created them
+        if (plan->index[r] == queueCI[f].queueCount) {
+            priorities[f][queueCI[f].queueCount++] = _queuePriorities[r];
+        }
     }
+    Arena* scratch = scratchArena();
+    ArenaMark mark = arenaMark(scratch);
+    Arena* previous = stbdsUseArena(scratch);
+    const char** exts = _getDeviceExtensions(phys, headless);
+    stbdsUseArena(previous);
     VkDeviceCreateInfo deviceCI = {
         .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
-        .ppEnabledExtensionNames = _requiredExtensions,
-        .enabledExtensionCount = _nRequiredExtensions,
+        .pNext = &features12,
+        .ppEnabledExtensionNames = exts,
+        .enabledExtensionCount = arrlenu(exts),
         .pEnabledFeatures = &features,
-        .queueCreateInfoCount = nQueues,
+        .queueCreateInfoCount = nFamilies,
         .pQueueCreateInfos = queueCI,
     };
     VkDevice device;
-    vkCheck(vkCreateDevice(vkPhysicalDevice, &deviceCI, NULL, &device))
+    vkCheck(vkCreateDevice(vkPhysicalDevice, &deviceCI, hostAllocationCallbacks(), &device))
     {
         ecs_abort(1, "Failed to create logical device");
     }
+    arenaRelease(scratch, mark);
     ecs_trace("Done creating VkDevice = %#p", device);
 
     ecs_log_pop();
     return device;
 }
 
-RenderDevice newRenderDevice(PhysicalDevice* arrPhysicalDevices)
+RenderDevice newRenderDevice(PhysicalDevice* arrPhysicalDevices, DeviceSelection selection)
 {
+    TRACE_ZONE(__func__);
     ecs_trace("Creating RenderDevice");
     ecs_log_push();
     // Choose the best one
-    PhysicalDevice* physDev = selectPhysicalDevice(arrPhysicalDevices);
+    PhysicalDevice* physDev = selectPhysicalDevice(arrPhysicalDevices, selection);
+    if (!physDev) {
+        ecs_abort(1, "No suitable Vulkan device");
+    }
     // Create logical device
-    VkDevice device = _newLogicalDevice(physDev);
-    // Create graphics queue
-    int graphicsQueueFamilyIndex = getGraphicsQueueFamilyIndex(physDev);
-    VkQueue graphicsQueue = _newDeviceQueue(device, graphicsQueueFamilyIndex, 0);
+    _QueuePlan plan = _planQueues(physDev, selection.surface);
+    VkDevice device = _newLogicalDevice(physDev, &plan, selection.headless);
+    // Get queues, shared roles get the same handle
+    VkQueue queues[_QUEUE_ROLES];
+    for (int r = 0; r < _QUEUE_ROLES; ++r) {
+        queues[r] = _newDeviceQueue(device, plan.family[r], plan.index[r]);
+    }
     ecs_log_pop();
     return (RenderDevice) {
         .handle = device,
         .phys = physDev,
-        .queue = graphicsQueue,
+        .queue = queues[_QUEUE_GRAPHICS],
+        .computeQueue = queues[_QUEUE_COMPUTE],
+        .transferQueue = queues[_QUEUE_TRANSFER],
+        .graphicsFamily = plan.family[_QUEUE_GRAPHICS],
+        .computeFamily = plan.family[_QUEUE_COMPUTE],
+        .transferFamily = plan.family[_QUEUE_TRANSFER],
     };
+}
+
+void cleanupRenderDevice(RenderDevice* device)
+{
+    ecs_trace("Cleaning up RenderDevice");
+    if (device->staging) {
+        cleanupStagingRing(device->staging);
+    }
+    if (device->allocator) {
+        logDeviceAllocatorStats(device->allocator);
+        cleanupDeviceAllocator(device->allocator);
+    }
+    vkDestroyPipelineCache(device->handle, device->pipelineCache, hostAllocationCallbacks());
+    vkDestroyDevice(device->handle, hostAllocationCallbacks());
+    *device = (RenderDevice) { 0 };
 }
\ No newline at end of file
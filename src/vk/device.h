@@ -2,13 +2,38 @@
 
 #include <vulkan/vulkan.h>
 
-struct PhysicalDevice;
-typedef struct PhysicalDevice PhysicalDevice;
+#include "memory.h"
+#include "physical_device.h"
+#include "staging.h"
 
+/// @brief The logical device and what everything created on it shares. It
+/// moves around by value, so objects keep copies of the handles they need
+/// rather than a pointer to it
 typedef struct RenderDevice {
     VkDevice handle;
     const PhysicalDevice* phys;
+    /// @brief Graphics and present queue
     VkQueue queue;
+    /// @brief Queue for async compute. May be the same as `queue` when the
+    /// device has no spare queue, so compare handles before submitting to
+    /// both from different threads
+    VkQueue computeQueue;
+    /// @brief Queue for uploads, on the DMA engines where there are any. May
+    /// be the same as `queue` or `computeQueue`
+    VkQueue transferQueue;
+    uint32_t graphicsFamily;
+    uint32_t computeFamily;
+    uint32_t transferFamily;
+    /// @brief Every pipeline of the device is created through this
+    VkPipelineCache pipelineCache;
+    /// @brief Every buffer and image of the device gets its memory from this
+    DeviceAllocator* allocator;
+    /// @brief Uploads from the CPU go through this
+    StagingRing* staging;
 } RenderDevice;
 
-RenderDevice newRenderDevice(PhysicalDevice* arrPhysicalDevices);
\ No newline at end of file
+RenderDevice newRenderDevice(PhysicalDevice* arrPhysicalDevices, DeviceSelection selection);
+
+/// @brief Destroy the staging ring, the allocator, the pipeline cache and the logical device
+/// @param device
+void cleanupRenderDevice(RenderDevice* device);
\ No newline at end of file
@@ -0,0 +1,311 @@
+#include "frame.h"
+#include "vk.h"
+
+#include <stb_ds.h>
+
+#include "device.h"
+#include "staging.h"
+
+static VkSemaphore _newSemaphore(VkDevice device)
+{
+    VkSemaphoreCreateInfo ci = { .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
+    VkSemaphore semaphore;
+    vkCheck(vkCreateSemaphore(device, &ci, hostAllocationCallbacks(), &semaphore))
+    {
+        ecs_abort(1, "Failed to create semaphore");
+    }
+    return semaphore;
+}
+
+static Frame _newFrame(const RenderDevice* device, bool timestamps)
+{
+    Frame frame = { 0 };
+    // Command buffers are reset together with the pool
+    VkCommandPoolCreateInfo poolCI = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+        .queueFamilyIndex = device->graphicsFamily,
+    };
+    vkCheck(vkCreateCommandPool(device->handle, &poolCI, hostAllocationCallbacks(), &frame.pool))
+    {
+        ecs_abort(1, "Failed to create frame command pool");
+    }
+    VkCommandBufferAllocateInfo ai = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = frame.pool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1,
+    };
+    vkCheck(vkAllocateCommandBuffers(device->handle, &ai, &frame.cmd))
+    {
+        ecs_abort(1, "Failed to allocate frame command buffer");
+    }
+    // Signaled so that the first wait on it returns at once
+    VkFenceCreateInfo fenceCI = {
+        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+        .flags = VK_FENCE_CREATE_SIGNALED_BIT,
+    };
+    vkCheck(vkCreateFence(device->handle, &fenceCI, hostAllocationCallbacks(), &frame.fence))
+    {
+        ecs_abort(1, "Failed to create frame fence");
+    }
+    frame.imageAvailable = _newSemaphore(device->handle);
+    if (timestamps) {
+        VkQueryPoolCreateInfo queryCI = {
+            .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+            .queryType = VK_QUERY_TYPE_TIMESTAMP,
+            .queryCount = 2,
+        };
+        vkCheck(vkCreateQueryPool(device->handle, &queryCI, hostAllocationCallbacks(), &frame.timestamps))
+        {
+            ecs_abort(1, "Failed to create frame timestamp pool");
+        }
+    }
+    frame.transient = newLinearPool(device->allocator, FRAME_TRANSIENT_SIZE,
+        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT
+            | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT
+            | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+    return frame;
+}
+
+FrameManager newFrameManager(const RenderDevice* device, uint32_t nFrames)
+{
+    ecs_trace("Creating FrameManager with [%u] frames in flight", nFrames);
+    ecs_log_push();
+    if (nFrames < 1 || nFrames > MAX_FRAMES_IN_FLIGHT) {
+        ecs_abort(1, "Unsupported number of frames in flight [%u]", nFrames);
+    }
+    FrameManager frames = {
+        .device = device->handle,
+        .queue = device->queue,
+        .allocator = device->allocator,
+        .staging = device->staging,
+        .nFrames = nFrames,
+    };
+    const PhysicalDevice* phys = device->phys;
+    if (phys->arrQueueFamilyProps[device->graphicsFamily].timestampValidBits > 0) {
+        frames.timestampPeriod = phys->props.limits.timestampPeriod;
+    } else {
+        ecs_warn("Graphics queue has no timestamps, GPU frame times are unavailable");
+    }
+    frames.profiler = newGpuProfiler(device, nFrames);
+    for (uint32_t i = 0; i < nFrames; ++i) {
+        frames.frames[i] = _newFrame(device, frames.timestampPeriod > 0);
+        frames.frames[i].slot = i;
+        frames.frames[i].profiler = frames.profiler;
+    }
+    ecs_log_pop();
+    return frames;
+}
+
+void cleanupFrameManager(FrameManager* frames)
+{
+    ecs_trace("Cleaning up FrameManager");
+    for (uint32_t i = 0; i < frames->nFrames; ++i) {
+        Frame* frame = &frames->frames[i];
+        cleanupLinearPool(frames->allocator, &frame->transient);
+        if (frame->timestamps) {
+            vkDestroyQueryPool(frames->device, frame->timestamps, hostAllocationCallbacks());
+        }
+        vkDestroySemaphore(frames->device, frame->imageAvailable, hostAllocationCallbacks());
+        vkDestroyFence(frames->device, frame->fence, hostAllocationCallbacks());
+        vkDestroyCommandPool(frames->device, frame->pool, hostAllocationCallbacks());
+    }
+    cleanupGpuProfiler(frames->profiler);
+    *frames = (FrameManager) { 0 };
+}
+
+/// @brief GPU times of a frame whose fence has signaled
+static void _readTimestamps(FrameManager* frames, Frame* frame)
+{
+    uint64_t ticks[2];
+    VkResult result = vkGetQueryPoolResults(frames->device, frame->timestamps, 0, 2, sizeof(ticks), ticks,
+        sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+    if (result != VK_SUCCESS) {
+        return;
+    }
+    double period = frames->timestampPeriod * 1e-6;
+    frames->stats.gpuMs = (ticks[1] - ticks[0]) * period;
+    // Frames complete in order, so the previous end is the last one read
+    frames->stats.gpuIdleMs = frames->lastGpuEnd && ticks[0] > frames->lastGpuEnd
+        ? (ticks[0] - frames->lastGpuEnd) * period
+        : 0.0;
+    frames->lastGpuEnd = ticks[1];
+}
+
+FrameStatus beginFrame(FrameManager* frames, Swapchain* swapchain, uint64_t timeout, Frame** out)
+{
+    Frame* frame = &frames->frames[frames->frameIndex % frames->nFrames];
+    ecs_time_t t;
+    ecs_os_get_time(&t);
+    frames->_beginTime = t;
+    // Only waits when the GPU is `nFrames` frames behind
+    vkCheck(vkWaitForFences(frames->device, 1, &frame->fence, VK_TRUE, UINT64_MAX))
+    {
+        ecs_abort(1, "Failed to wait for frame fence");
+    }
+    double fenceWait = ecs_time_measure(&t);
+    if (frame->submitted && frame->timestamps) {
+        _readTimestamps(frames, frame);
+    }
+    frame->submitted = false;
+    // The fence waited for belongs to frame index - nFrames, one frame of
+    // slack covers presentation, which no fence tracks
+    if (swapchain && frames->frameIndex >= frames->nFrames) {
+        releaseRetiredSwapchains(frames->device, swapchain, frames->frameIndex - frames->nFrames);
+    }
+
+    VkResult result = VK_SUCCESS;
+    frame->imageIndex = 0;
+    if (swapchain) {
+        result = vkAcquireNextImageKHR(frames->device, swapchain->handle, timeout,
+            frame->imageAvailable, VK_NULL_HANDLE, &frame->imageIndex);
+    }
+    double acquireWait = ecs_time_measure(&t);
+    frames->stats.fenceWaitMs = fenceWait * 1e3;
+    frames->stats.acquireWaitMs = acquireWait * 1e3;
+    if (result == VK_TIMEOUT || result == VK_NOT_READY) {
+        return FRAME_TIMEOUT;
+    }
+    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+        return FRAME_OUT_OF_DATE;
+    }
+    // Suboptimal images can still be presented, recreate after this frame
+    if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+        ecs_abort(1, "Failed to acquire swapchain image");
+    }
+
+    vkCheck(vkResetFences(frames->device, 1, &frame->fence))
+    {
+        ecs_abort(1, "Failed to reset frame fence");
+    }
+    vkCheck(vkResetCommandPool(frames->device, frame->pool, 0))
+    {
+        ecs_abort(1, "Failed to reset frame command pool");
+    }
+    resetLinearPool(&frame->transient);
+    VkCommandBufferBeginInfo bi = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    vkCheck(vkBeginCommandBuffer(frame->cmd, &bi))
+    {
+        ecs_abort(1, "Failed to begin frame command buffer");
+    }
+    if (frame->timestamps) {
+        vkCmdResetQueryPool(frame->cmd, frame->timestamps, 0, 2);
+        vkCmdWriteTimestamp(frame->cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame->timestamps, 0);
+    }
+    beginGpuProfilerFrame(frames->profiler, frame->cmd, frame->slot);
+    // Uploads queued since the last frame become visible to this one
+    frame->stagingValue = 0;
+    acquireFrameUploads(frames->staging, frame);
+    frames->stats.frame = frames->frameIndex;
+    *out = frame;
+    return FRAME_OK;
+}
+
+void acquireFrameUploads(StagingRing* staging, Frame* frame)
+{
+    submitStaging(staging);
+    uint64_t value = recordStagingAcquires(staging, frame->cmd);
+    // Timeline values only grow, the last one covers earlier uploads too
+    if (value) {
+        frame->stagingValue = value;
+    }
+}
+
+FrameStatus endFrame(FrameManager* frames, const Swapchain* swapchain)
+{
+    Frame* frame = &frames->frames[frames->frameIndex % frames->nFrames];
+    if (frame->timestamps) {
+        vkCmdWriteTimestamp(frame->cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame->timestamps, 1);
+    }
+    vkCheck(vkEndCommandBuffer(frame->cmd))
+    {
+        ecs_abort(1, "Failed to end frame command buffer");
+    }
+    // Offscreen frames wait for uploads only
+    VkSemaphore waits[2];
+    VkPipelineStageFlags waitStages[2];
+    // The value for the binary semaphore is ignored
+    uint64_t waitValues[2];
+    uint32_t nWaits = 0;
+    if (swapchain) {
+        waits[nWaits] = frame->imageAvailable;
+        waitStages[nWaits] = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+        waitValues[nWaits++] = 0;
+    }
+    if (frame->stagingValue) {
+        waits[nWaits] = stagingTimeline(frames->staging);
+        waitStages[nWaits] = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        waitValues[nWaits++] = frame->stagingValue;
+    }
+    VkSemaphore renderFinished = swapchain ? swapchain->arrRenderFinished[frame->imageIndex] : VK_NULL_HANDLE;
+    VkTimelineSemaphoreSubmitInfo timelineSI = {
+        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+        .waitSemaphoreValueCount = nWaits,
+        .pWaitSemaphoreValues = waitValues,
+    };
+    VkSubmitInfo si = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext = &timelineSI,
+        .waitSemaphoreCount = nWaits,
+        .pWaitSemaphores = waits,
+        .pWaitDstStageMask = waitStages,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &frame->cmd,
+        .signalSemaphoreCount = swapchain ? 1 : 0,
+        .pSignalSemaphores = &renderFinished,
+    };
+    vkCheck(vkQueueSubmit(frames->queue, 1, &si, frame->fence))
+    {
+        ecs_abort(1, "Failed to submit frame");
+    }
+    frame->submitted = true;
+
+    VkResult result = VK_SUCCESS;
+    if (swapchain) {
+        VkPresentInfoKHR pi = {
+            .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+            .waitSemaphoreCount = 1,
+            .pWaitSemaphores = &renderFinished,
+            .swapchainCount = 1,
+            .pSwapchains = &swapchain->handle,
+            .pImageIndices = &frame->imageIndex,
+        };
+        result = vkQueuePresentKHR(frames->queue, &pi);
+    }
+    frames->frameIndex++;
+    // Waits were measured in beginFrame, the rest is recording
+    double total = ecs_time_measure(&frames->_beginTime) * 1e3;
+    FrameStats* s = &frames->stats;
+    s->cpuMs = total - s->fenceWaitMs - s->acquireWaitMs;
+    ecs_dbg("Frame [%llu]: CPU %.2f ms, waited %.2f ms on GPU and %.2f ms on present, "
+            "GPU %.2f ms, idle %.2f ms",
+        (unsigned long long)s->frame, s->cpuMs, s->fenceWaitMs, s->acquireWaitMs, s->gpuMs, s->gpuIdleMs);
+    if (isGpuProfilerEnabled(frames->profiler) && frames->frameIndex % GPU_PROFILER_HISTORY == 0) {
+        logGpuPassStats(frames->profiler);
+    }
+    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
+        return FRAME_OUT_OF_DATE;
+    }
+    if (result != VK_SUCCESS) {
+        ecs_abort(1, "Failed to present");
+    }
+    return FRAME_OK;
+}
+
+RenderTarget swapchainTarget(const Swapchain* swapchain, const Frame* frame)
+{
+    return (RenderTarget) {
+        .image = swapchain->arrImages[frame->imageIndex],
+        .view = swapchain->arrViews[frame->imageIndex],
+        .extent = swapchain->extent,
+        .format = (VkFormat)swapchain->imageFormat,
+        .finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+        // Presentation waits on a semaphore, which makes the writes visible
+        .finalStage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+        .finalAccess = 0,
+    };
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <flecs.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+#include "memory.h"
+#include "profiler.h"
+#include "swapchain.h"
+
+struct RenderDevice;
+typedef struct RenderDevice RenderDevice;
+struct StagingRing;
+typedef struct StagingRing StagingRing;
+
+#define MAX_FRAMES_IN_FLIGHT 3
+/// @brief Frames the CPU may record ahead of the GPU. With two, frame N+1
+/// is recorded while the GPU executes frame N
+#define FRAMES_IN_FLIGHT 2
+/// @brief Per-frame uniform and vertex data
+#define FRAME_TRANSIENT_SIZE (4ull << 20)
+
+/// @brief Resources of one frame in flight, reused every `nFrames` frames
+typedef struct Frame {
+    VkCommandPool pool;
+    VkCommandBuffer cmd;
+    /// @brief Signaled when the GPU is done with the frame
+    VkFence fence;
+    /// @brief Unused by offscreen frames
+    VkSemaphore imageAvailable;
+    /// @brief Timestamps at the start and the end of the frame
+    VkQueryPool timestamps;
+    /// @brief Reset when the frame begins
+    LinearPool transient;
+    /// @brief Index among the frames in flight, for per-frame resources
+    /// kept elsewhere
+    uint32_t slot;
+    /// @brief Swapchain image being drawn, 0 offscreen
+    uint32_t imageIndex;
+    /// @brief Staging timeline value the submission waits for
+    uint64_t stagingValue;
+    bool submitted;
+    /// @brief Of the frame manager, for `GPU_SCOPE_BEGIN`
+    GpuProfiler* profiler;
+} Frame;
+
+/// @brief Where the time of a frame went, in milliseconds
+typedef struct FrameStats {
+    uint64_t frame;
+    /// @brief CPU blocked on the fence of the frame slot: GPU bound
+    double fenceWaitMs;
+    /// @brief CPU blocked acquiring an image: presentation bound
+    double acquireWaitMs;
+    /// @brief CPU time from begin to end of the frame, without waits
+    double cpuMs;
+    /// @brief GPU time of the frame's commands, 0 without timestamps
+    double gpuMs;
+    /// @brief GPU idle before the frame started: CPU bound
+    double gpuIdleMs;
+} FrameStats;
+
+typedef enum FrameStatus {
+    FRAME_OK,
+    /// @brief No image within the timeout, try again next tick
+    FRAME_TIMEOUT,
+    /// @brief The swapchain must be recreated
+    FRAME_OUT_OF_DATE,
+} FrameStatus;
+
+/// @brief Color image a frame draws into, and how to hand it over once drawn
+typedef struct RenderTarget {
+    VkImage image;
+    VkImageView view;
+    VkExtent2D extent;
+    VkFormat format;
+    VkImageLayout finalLayout;
+    /// @brief Stage and access of whatever uses the image next
+    VkPipelineStageFlags finalStage;
+    VkAccessFlags finalAccess;
+} RenderTarget;
+
+/// @brief Acquire, record, submit and present loop over a swapchain, or
+/// record and submit loop without one
+typedef struct FrameManager {
+    VkDevice device;
+    VkQueue queue;
+    DeviceAllocator* allocator;
+    StagingRing* staging;
+    /// @brief Times passes of the frames, disabled until enabled
+    GpuProfiler* profiler;
+    uint32_t nFrames;
+    Frame frames[MAX_FRAMES_IN_FLIGHT];
+    uint64_t frameIndex;
+    /// @brief Nanoseconds per timestamp tick, 0 without timestamps
+    double timestampPeriod;
+    uint64_t lastGpuEnd;
+    /// @brief Of the frame that began last. GPU times are of the last
+    /// frame whose fence was waited for
+    FrameStats stats;
+    ecs_time_t _beginTime;
+} FrameManager;
+
+/// @brief Create the frame resources
+/// @param device
+/// @param nFrames Frames in flight, at most `MAX_FRAMES_IN_FLIGHT`
+/// @return The frame manager
+FrameManager newFrameManager(const RenderDevice* device, uint32_t nFrames);
+
+/// @brief Destroy the frame resources. The device must be idle
+/// @param frames
+void cleanupFrameManager(FrameManager* frames);
+
+/// @brief Wait for the frame slot, release swapchains retired before the
+/// frames now done, acquire an image and begin recording
+/// @param frames
+/// @param swapchain NULL for an offscreen frame, which acquires nothing
+/// @param timeout Nanoseconds to wait for an image
+/// @param frame Receives the frame to record into on `FRAME_OK`
+/// @return Whether a frame began
+FrameStatus beginFrame(FrameManager* frames, Swapchain* swapchain, uint64_t timeout, Frame** frame);
+
+/// @brief Submit the uploads queued so far and make a frame wait for them.
+/// `beginFrame` does so for uploads queued before it
+/// @param staging
+/// @param frame Being recorded, the ownership acquires go into its commands
+void acquireFrameUploads(StagingRing* staging, Frame* frame);
+
+/// @brief Submit the frame and present its image
+/// @param frames
+/// @param swapchain NULL for an offscreen frame, which presents nothing
+/// @return `FRAME_OUT_OF_DATE` when the swapchain no longer matches the surface
+FrameStatus endFrame(FrameManager* frames, const Swapchain* swapchain);
+
+/// @brief The swapchain image a frame acquired, handed over for presentation
+/// @param swapchain
+/// @param frame
+/// @return The target
+RenderTarget swapchainTarget(const Swapchain* swapchain, const Frame* frame);
\ No newline at end of file
@@ -2,47 +2,12 @@
 #include "vk.h"
 
 #include <stb_ds.h>
-#include <stdlib.h>
+#include <utils/arena.h>
 #include <vulkan/vulkan.h>
 
 extern const char* PROJECT_NAME;
 extern const char* ENGINE_NAME;
 
-static VKAPI_ATTR VkBool32 VKAPI_CALL _vkDebugCallback(
-    VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
-    VkDebugUtilsMessageTypeFlagsEXT messageType,
-    const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData,
-    void* pUserData)
-{
-    (void)messageType;
-    (void)pUserData;
-    const char* fmt = "Validation: %s";
-    switch (messageSeverity) {
-    case VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT:
-        ecs_err(fmt, pCallbackData->pMessage);
-        break;
-    case VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT:
-        ecs_warn(fmt, pCallbackData->pMessage);
-        break;
-    case VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT:
-        ecs_dbg(fmt, pCallbackData->pMessage);
-        break;
-    default:
-        // Anything else gets even lower level
-        ecs_dbg(fmt, pCallbackData->pMessage);
-        break;
-    }
-    return VK_FALSE;
-}
-
-static VkDebugUtilsMessengerCreateInfoEXT _debug_utils_messenger_create_info_ext = {
-    .sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT,
-    .messageSeverity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT,
-    .messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT,
-    .pfnUserCallback = _vkDebugCallback,
-    .pUserData = NULL,
-};
-
 static const char** _getValidationLayers()
 {
     const char** layers = NULL;
@@ -50,7 +15,7 @@ static const char** _getValidationLayers()
     if (vkEnumerateInstanceLayerProperties(&count, NULL) != VK_SUCCESS) {
         ecs_abort(1, "Failed to enumerate number of instance layer properties");
     }
-    VkLayerProperties* props = malloc(sizeof(*props) * count);
+    VkLayerProperties* props = ARENA_NEW(scratchArena(), VkLayerProperties, count);
     if (vkEnumerateInstanceLayerProperties(&count, props) != VK_SUCCESS) {
         ecs_abort(1, "Failed to enumerate instance layer properties");
     }
@@ -90,17 +55,19 @@ static const char** _getValidationLayers()
 }
 
 static const char**
-_getRequiredExtensions(const char** sdl_exts, uint32_t n_sdl_exts)
+_getRequiredExtensions(const char** sdl_exts, uint32_t n_sdl_exts, bool validation)
 {
     const char** extensions = NULL;
     arrsetlen(extensions, n_sdl_exts);
     memcpy(extensions, sdl_exts, sizeof(*extensions) * n_sdl_exts);
     arrput(extensions, VK_KHR_PORTABILITY_ENUMERATION_EXTENSION_NAME);
-    arrput(extensions, VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+    if (validation) {
+        arrput(extensions, VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
+    }
     return extensions;
 }
 
-VkDebugUtilsMessengerEXT newVkDebugUtilsMessengerEXT(VkInstance instance)
+VkDebugUtilsMessengerEXT newVkDebugUtilsMessengerEXT(VkInstance instance, const VkDebugUtilsMessengerCreateInfoEXT* info)
 {
     ecs_trace("Setting up messenger");
     ecs_log_push();
@@ -112,7 +79,7 @@ VkDebugUtilsMessengerEXT newVkDebugUtilsMessengerEXT(VkInstance instance)
         ecs_abort(1, "Failed to load debug extension");
     }
     VkDebugUtilsMessengerEXT messenger;
-    if (create(instance, &_debug_utils_messenger_create_info_ext, NULL, &messenger) != VK_SUCCESS) {
+    if (create(instance, info, hostAllocationCallbacks(), &messenger) != VK_SUCCESS) {
         ecs_abort(1, "Failed to create debug messenger");
     }
     ecs_trace("Done setting up messenger");
@@ -120,7 +87,7 @@ VkDebugUtilsMessengerEXT newVkDebugUtilsMessengerEXT(VkInstance instance)
     return messenger;
 }
 
-VkInstance newVkInstance(const char** sdl_exts, uint32_t n_sdl_exts)
+VkInstance newVkInstance(const char** sdl_exts, uint32_t n_sdl_exts, const VkDebugUtilsMessengerCreateInfoEXT* debug)
 {
     ecs_trace("Creating VkInstance");
     ecs_log_push();
@@ -133,9 +100,14 @@ VkInstance newVkInstance(const char** sdl_exts, uint32_t n_sdl_exts)
               .engineVersion = VK_MAKE_VERSION(0, 1, 0),
               .apiVersion = VK_API_VERSION_1_3,
           };
-    // FIXME allow turning off validation
-    const char** extensions = _getRequiredExtensions(sdl_exts, n_sdl_exts);
-    const char** layers = _getValidationLayers();
+    // Lists and what they are made from only live until the instance is
+    // created
+    Arena* scratch = scratchArena();
+    ArenaMark mark = arenaMark(scratch);
+    Arena* previous = stbdsUseArena(scratch);
+    const char** extensions = _getRequiredExtensions(sdl_exts, n_sdl_exts, debug != NULL);
+    const char** layers = debug ? _getValidationLayers() : NULL;
+    stbdsUseArena(previous);
     VkInstanceCreateInfo ci = {
         .sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
         .pApplicationInfo = &app_info,
@@ -144,15 +116,14 @@ VkInstance newVkInstance(const char** sdl_exts, uint32_t n_sdl_exts)
         .enabledLayerCount = arrlenu(layers),
         .ppEnabledLayerNames = layers,
         .flags = VK_INSTANCE_CREATE_ENUMERATE_PORTABILITY_BIT_KHR,
-        .pNext = &_debug_utils_messenger_create_info_ext
+        .pNext = debug,
     };
     VkInstance instance;
-    vkCheck(vkCreateInstance(&ci, NULL, &instance))
+    vkCheck(vkCreateInstance(&ci, hostAllocationCallbacks(), &instance))
     {
         ecs_abort(1, "Failed to created Vulkan instance");
     }
-    arrfree(extensions);
-    arrfree(layers);
+    arenaRelease(scratch, mark);
     ecs_trace("Done creating VkInstance = %#llx", instance);
     ecs_log_pop();
     return instance;
@@ -2,6 +2,11 @@
 
 #include <vulkan/vulkan.h>
 
-VkInstance newVkInstance(const char** extensions, uint32_t n_extensions);
-VkDebugUtilsMessengerEXT newVkDebugUtilsMessengerEXT(VkInstance instance);
-
+/// @brief Create the instance
+/// @param extensions Instance extensions the surface needs
+/// @param n_extensions
+/// @param debug Messenger to chain in, or NULL to leave out the validation
+/// layers and `VK_EXT_debug_utils`
+/// @return The instance
+VkInstance newVkInstance(const char** extensions, uint32_t n_extensions, const VkDebugUtilsMessengerCreateInfoEXT* debug);
+VkDebugUtilsMessengerEXT newVkDebugUtilsMessengerEXT(VkInstance instance, const VkDebugUtilsMessengerCreateInfoEXT* info);
@@ -0,0 +1,588 @@
+#include "memory.h"
+#include "vk.h"
+
+#include <stb_ds.h>
+#include <stdlib.h>
+#include <string.h>
+#include <utils/arena.h>
+#include <utils/math.h>
+#include <utils/memtrack.h>
+
+#include "device.h"
+#include "tlsf.h"
+
+/// @brief Allocations larger than this fraction of a block get their own
+/// device memory, they would fragment blocks more than they would save
+#define DEDICATED_FRACTION 2
+
+typedef struct _MemoryBlock {
+    VkDeviceMemory memory;
+    VkDeviceSize size;
+    void* mapped;
+    Tlsf* tlsf;
+} _MemoryBlock;
+
+/// @brief Blocks of one memory type holding either linear or optimal
+/// resources
+typedef struct {
+    _MemoryBlock** arrBlocks;
+} _MemoryPool;
+
+struct DeviceAllocator {
+    VkDevice device;
+    const PhysicalDevice* phys;
+    ecs_os_mutex_t lock;
+    /// @brief Whether linear and optimal resources need separate blocks
+    bool separateLinear;
+    _MemoryPool pools[VK_MAX_MEMORY_TYPES][2];
+    DeviceMemoryStats stats[VK_MAX_MEMORY_TYPES];
+};
+
+static const char* _memoryUsageNames[] = { "GPU only", "CPU to GPU", "GPU to CPU", "CPU only" };
+
+/// @brief Required, preferred and unwanted property flags of a usage
+static void _usageFlags(MemoryUsage usage, VkMemoryPropertyFlags* required,
+    VkMemoryPropertyFlags* preferred, VkMemoryPropertyFlags* unwanted)
+{
+    *required = 0;
+    *preferred = 0;
+    *unwanted = 0;
+    switch (usage) {
+    case MEMORY_USAGE_GPU_ONLY:
+        *preferred = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        *unwanted = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+        break;
+    case MEMORY_USAGE_CPU_TO_GPU:
+        *required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+        *preferred = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        *unwanted = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+        break;
+    case MEMORY_USAGE_GPU_TO_CPU:
+        *required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+        *preferred = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+        break;
+    case MEMORY_USAGE_CPU_ONLY:
+        *required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        *unwanted = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        break;
+    }
+}
+
+int findMemoryType(const VkPhysicalDeviceMemoryProperties* memProps, uint32_t typeBits, MemoryUsage usage)
+{
+    VkMemoryPropertyFlags required, preferred, unwanted;
+    _usageFlags(usage, &required, &preferred, &unwanted);
+    int best = -1, bestScore = 0;
+    for (uint32_t i = 0; i < memProps->memoryTypeCount; ++i) {
+        VkMemoryPropertyFlags flags = memProps->memoryTypes[i].propertyFlags;
+        if (!(typeBits & (1u << i)) || (flags & required) != required) {
+            continue;
+        }
+        int score = __builtin_popcount(flags & preferred) - __builtin_popcount(flags & unwanted);
+        if (best < 0 || score > bestScore) {
+            best = i;
+            bestScore = score;
+        }
+    }
+    return best;
+}
+
+DeviceAllocator* newDeviceAllocator(const RenderDevice* device)
+{
+    ecs_trace("Creating DeviceAllocator");
+    DeviceAllocator* allocator = memCalloc(MEM_VULKAN_HOST, 1, sizeof(*allocator));
+    allocator->device = device->handle;
+    allocator->phys = device->phys;
+    allocator->lock = ecs_os_mutex_new();
+    allocator->separateLinear = device->phys->props.limits.bufferImageGranularity > 1;
+    return allocator;
+}
+
+static void _freeBlock(DeviceAllocator* allocator, uint32_t memoryType, _MemoryBlock* block)
+{
+    if (block->mapped) {
+        vkUnmapMemory(allocator->device, block->memory);
+    }
+    vkFreeMemory(allocator->device, block->memory, hostAllocationCallbacks());
+    cleanupTlsf(block->tlsf);
+    allocator->stats[memoryType].blockCount--;
+    allocator->stats[memoryType].blockBytes -= block->size;
+    memFree(block);
+}
+
+void cleanupDeviceAllocator(DeviceAllocator* allocator)
+{
+    ecs_trace("Cleaning up DeviceAllocator");
+    ecs_log_push();
+    for (int t = 0; t < VK_MAX_MEMORY_TYPES; ++t) {
+        DeviceMemoryStats* stats = &allocator->stats[t];
+        if (stats->allocationCount > 0) {
+            ecs_warn("Leaked [%u] allocations, [%llu] bytes, of memory type [%d]",
+                stats->allocationCount, (unsigned long long)stats->allocatedBytes, t);
+        }
+        for (int k = 0; k < 2; ++k) {
+            _MemoryPool* pool = &allocator->pools[t][k];
+            for (int i = 0; i < arrlen(pool->arrBlocks); ++i) {
+                _freeBlock(allocator, t, pool->arrBlocks[i]);
+            }
+            arrfree(pool->arrBlocks);
+        }
+    }
+    ecs_os_mutex_free(allocator->lock);
+    memFree(allocator);
+    ecs_log_pop();
+}
+
+static bool _isHostVisible(const DeviceAllocator* allocator, uint32_t memoryType)
+{
+    return allocator->phys->memProps.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+}
+
+static bool _isHostCoherent(const DeviceAllocator* allocator, uint32_t memoryType)
+{
+    return allocator->phys->memProps.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+}
+
+/// @brief Allocate and map device memory, updating stats
+static bool _allocateMemory(DeviceAllocator* allocator, uint32_t memoryType, VkDeviceSize size,
+    VkDeviceMemory* memory, void** mapped)
+{
+    VkMemoryAllocateInfo ai = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = size,
+        .memoryTypeIndex = memoryType,
+    };
+    if (vkAllocateMemory(allocator->device, &ai, hostAllocationCallbacks(), memory) != VK_SUCCESS) {
+        return false;
+    }
+    *mapped = NULL;
+    // Host visible memory stays mapped for its whole life
+    if (_isHostVisible(allocator, memoryType)) {
+        vkCheck(vkMapMemory(allocator->device, *memory, 0, VK_WHOLE_SIZE, 0, mapped))
+        {
+            ecs_abort(1, "Failed to map device memory");
+        }
+    }
+    return true;
+}
+
+static _MemoryBlock* _newBlock(DeviceAllocator* allocator, uint32_t memoryType, VkDeviceSize minSize)
+{
+    // Small heaps, such as the 256 MiB host visible local heap, get smaller blocks
+    uint32_t heap = allocator->phys->memProps.memoryTypes[memoryType].heapIndex;
+    VkDeviceSize heapSize = allocator->phys->memProps.memoryHeaps[heap].size;
+    VkDeviceSize size = DEVICE_MEMORY_BLOCK_SIZE;
+    while (size > heapSize / 8 && size / 2 >= minSize) {
+        size /= 2;
+    }
+    _MemoryBlock* block = memCalloc(MEM_VULKAN_HOST, 1, sizeof(*block));
+    // Under memory pressure try smaller blocks before giving up
+    while (!_allocateMemory(allocator, memoryType, size, &block->memory, &block->mapped)) {
+        if (size / 2 < minSize) {
+            memFree(block);
+            return NULL;
+        }
+        size /= 2;
+    }
+    ecs_trace("New [%llu] MiB block of memory type [%u]", (unsigned long long)(size >> 20), memoryType);
+    block->size = size;
+    block->tlsf = newTlsf(size);
+    allocator->stats[memoryType].blockCount++;
+    allocator->stats[memoryType].blockBytes += size;
+    return block;
+}
+
+static void _countAllocation(DeviceAllocator* allocator, const DeviceAllocation* a, int sign)
+{
+    DeviceMemoryStats* stats = &allocator->stats[a->memoryType];
+    stats->allocationCount += sign;
+    stats->allocatedBytes += sign * (int64_t)a->size;
+    if (stats->allocatedBytes > stats->peakAllocatedBytes) {
+        stats->peakAllocatedBytes = stats->allocatedBytes;
+    }
+    memCount(MEM_VULKAN_DEVICE, sign * (int64_t)a->size, sign);
+}
+
+static bool _allocDedicated(DeviceAllocator* allocator, uint32_t memoryType, VkMemoryRequirements reqs,
+    DeviceAllocation* out)
+{
+    VkDeviceMemory memory;
+    void* mapped;
+    if (!_allocateMemory(allocator, memoryType, reqs.size, &memory, &mapped)) {
+        return false;
+    }
+    *out = (DeviceAllocation) {
+        .memory = memory,
+        .offset = 0,
+        .size = reqs.size,
+        .mapped = mapped,
+        .memoryType = memoryType,
+    };
+    DeviceMemoryStats* stats = &allocator->stats[memoryType];
+    stats->dedicatedCount++;
+    stats->blockBytes += reqs.size;
+    return true;
+}
+
+static bool _allocFromPool(DeviceAllocator* allocator, uint32_t memoryType, bool linear,
+    VkMemoryRequirements reqs, DeviceAllocation* out)
+{
+    _MemoryPool* pool = &allocator->pools[memoryType][allocator->separateLinear && linear];
+    VkDeviceSize align = u64max(reqs.alignment, 1);
+    // Flushes and invalidations are widened to whole atoms, which must not
+    // reach into a neighbour, so non-coherent allocations own whole atoms
+    if (_isHostVisible(allocator, memoryType) && !_isHostCoherent(allocator, memoryType)) {
+        VkDeviceSize atom = allocator->phys->props.limits.nonCoherentAtomSize;
+        align = u64max(align, atom);
+        reqs.size = (reqs.size + atom - 1) / atom * atom;
+    }
+    _MemoryBlock* block = NULL;
+    TlsfBlock* range = NULL;
+    uint64_t offset = 0;
+    // Newest blocks are the emptiest
+    for (int i = arrlen(pool->arrBlocks) - 1; i >= 0 && !range; --i) {
+        block = pool->arrBlocks[i];
+        range = tlsfAlloc(block->tlsf, reqs.size, align, &offset);
+    }
+    if (!range) {
+        block = _newBlock(allocator, memoryType, reqs.size + align);
+        if (!block) {
+            return false;
+        }
+        arrput(pool->arrBlocks, block);
+        range = tlsfAlloc(block->tlsf, reqs.size, align, &offset);
+    }
+    *out = (DeviceAllocation) {
+        .memory = block->memory,
+        .offset = offset,
+        .size = reqs.size,
+        .mapped = block->mapped ? (char*)block->mapped + offset : NULL,
+        .memoryType = memoryType,
+        ._block = block,
+        ._range = range,
+    };
+    return true;
+}
+
+bool deviceAlloc(DeviceAllocator* allocator, VkMemoryRequirements reqs, MemoryUsage usage,
+    bool linear, DeviceAllocation* out)
+{
+    int memoryType = findMemoryType(&allocator->phys->memProps, reqs.memoryTypeBits, usage);
+    if (memoryType < 0) {
+        ecs_err("No memory type for [%s] among [%#x]", _memoryUsageNames[usage], reqs.memoryTypeBits);
+        return false;
+    }
+    ecs_os_mutex_lock(allocator->lock);
+    bool ok;
+    if (reqs.size > DEVICE_MEMORY_BLOCK_SIZE / DEDICATED_FRACTION) {
+        ok = _allocDedicated(allocator, memoryType, reqs, out);
+    } else {
+        ok = _allocFromPool(allocator, memoryType, linear, reqs, out);
+    }
+    if (ok) {
+        _countAllocation(allocator, out, 1);
+    }
+    ecs_os_mutex_unlock(allocator->lock);
+    return ok;
+}
+
+void deviceFree(DeviceAllocator* allocator, DeviceAllocation* allocation)
+{
+    if (!allocation->memory) {
+        return;
+    }
+    ecs_os_mutex_lock(allocator->lock);
+    uint32_t t = allocation->memoryType;
+    _countAllocation(allocator, allocation, -1);
+    _MemoryBlock* block = allocation->_block;
+    if (!block) {
+        if (allocation->mapped) {
+            vkUnmapMemory(allocator->device, allocation->memory);
+        }
+        vkFreeMemory(allocator->device, allocation->memory, hostAllocationCallbacks());
+        allocator->stats[t].dedicatedCount--;
+        allocator->stats[t].blockBytes -= allocation->size;
+    } else {
+        tlsfFree(block->tlsf, allocation->_range);
+        // Keep one empty block per pool around so that a resource freed and
+        // created every frame does not allocate device memory every frame
+        for (int k = 0; k < 2 && tlsfIsEmpty(block->tlsf); ++k) {
+            _MemoryPool* pool = &allocator->pools[t][k];
+            int nEmpty = 0, index = -1;
+            for (int i = 0; i < arrlen(pool->arrBlocks); ++i) {
+                nEmpty += tlsfIsEmpty(pool->arrBlocks[i]->tlsf);
+                index = pool->arrBlocks[i] == block ? i : index;
+            }
+            if (index >= 0 && nEmpty > 1) {
+                arrdel(pool->arrBlocks, index);
+                _freeBlock(allocator, t, block);
+                break;
+            }
+        }
+    }
+    ecs_os_mutex_unlock(allocator->lock);
+    *allocation = (DeviceAllocation) { 0 };
+}
+
+/// @brief Range of an allocation to flush or invalidate
+/// @return False when the memory is coherent and nothing needs doing
+static bool _mappedRange(DeviceAllocator* allocator, const DeviceAllocation* allocation,
+    VkDeviceSize offset, VkDeviceSize size, VkMappedMemoryRange* range)
+{
+    if (_isHostCoherent(allocator, allocation->memoryType)) {
+        return false;
+    }
+    // Ranges must be aligned to the atom size. Non-coherent allocations
+    // start and end on atoms, so widening stays inside the allocation
+    VkDeviceSize atom = allocator->phys->props.limits.nonCoherentAtomSize;
+    VkDeviceSize begin = (allocation->offset + offset) / atom * atom;
+    VkDeviceSize end = (allocation->offset + offset + size + atom - 1) / atom * atom;
+    VkDeviceSize memSize = allocation->_block ? allocation->_block->size : allocation->size;
+    *range = (VkMappedMemoryRange) {
+        .sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+        .memory = allocation->memory,
+        .offset = begin,
+        .size = end >= memSize ? VK_WHOLE_SIZE : end - begin,
+    };
+    return true;
+}
+
+void flushDeviceAllocation(DeviceAllocator* allocator, const DeviceAllocation* allocation,
+    VkDeviceSize offset, VkDeviceSize size)
+{
+    VkMappedMemoryRange range;
+    if (!_mappedRange(allocator, allocation, offset, size, &range)) {
+        return;
+    }
+    vkCheck(vkFlushMappedMemoryRanges(allocator->device, 1, &range))
+    {
+        ecs_abort(1, "Failed to flush mapped memory");
+    }
+}
+
+void invalidateDeviceAllocation(DeviceAllocator* allocator, const DeviceAllocation* allocation,
+    VkDeviceSize offset, VkDeviceSize size)
+{
+    VkMappedMemoryRange range;
+    if (!_mappedRange(allocator, allocation, offset, size, &range)) {
+        return;
+    }
+    vkCheck(vkInvalidateMappedMemoryRanges(allocator->device, 1, &range))
+    {
+        ecs_abort(1, "Failed to invalidate mapped memory");
+    }
+}
+
+VkBuffer newBuffer(DeviceAllocator* allocator, VkDeviceSize size, VkBufferUsageFlags usage,
+    MemoryUsage memUsage, DeviceAllocation* allocation)
+{
+    VkBufferCreateInfo ci = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = size,
+        .usage = usage,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+    VkBuffer buffer;
+    vkCheck(vkCreateBuffer(allocator->device, &ci, hostAllocationCallbacks(), &buffer))
+    {
+        ecs_abort(1, "Failed to create buffer");
+    }
+    VkMemoryRequirements reqs;
+    vkGetBufferMemoryRequirements(allocator->device, buffer, &reqs);
+    if (!deviceAlloc(allocator, reqs, memUsage, true, allocation)) {
+        ecs_abort(1, "Out of device memory for a [%llu] byte buffer", (unsigned long long)size);
+    }
+    vkCheck(vkBindBufferMemory(allocator->device, buffer, allocation->memory, allocation->offset))
+    {
+        ecs_abort(1, "Failed to bind buffer memory");
+    }
+    return buffer;
+}
+
+void cleanupBuffer(DeviceAllocator* allocator, VkBuffer buffer, DeviceAllocation* allocation)
+{
+    vkDestroyBuffer(allocator->device, buffer, hostAllocationCallbacks());
+    deviceFree(allocator, allocation);
+}
+
+VkImage newImage(DeviceAllocator* allocator, const VkImageCreateInfo* ci, MemoryUsage memUsage,
+    DeviceAllocation* allocation)
+{
+    VkImage image;
+    vkCheck(vkCreateImage(allocator->device, ci, hostAllocationCallbacks(), &image))
+    {
+        ecs_abort(1, "Failed to create image");
+    }
+    VkMemoryRequirements reqs;
+    vkGetImageMemoryRequirements(allocator->device, image, &reqs);
+    bool linear = ci->tiling == VK_IMAGE_TILING_LINEAR;
+    if (!deviceAlloc(allocator, reqs, memUsage, linear, allocation)) {
+        ecs_abort(1, "Out of device memory for a [%ux%u] image", ci->extent.width, ci->extent.height);
+    }
+    vkCheck(vkBindImageMemory(allocator->device, image, allocation->memory, allocation->offset))
+    {
+        ecs_abort(1, "Failed to bind image memory");
+    }
+    return image;
+}
+
+void cleanupImage(DeviceAllocator* allocator, VkImage image, DeviceAllocation* allocation)
+{
+    vkDestroyImage(allocator->device, image, hostAllocationCallbacks());
+    deviceFree(allocator, allocation);
+}
+
+DeviceMemoryStats deviceAllocatorStats(DeviceAllocator* allocator, uint32_t memoryType)
+{
+    ecs_os_mutex_lock(allocator->lock);
+    DeviceMemoryStats stats = allocator->stats[memoryType];
+    for (int k = 0; k < 2; ++k) {
+        _MemoryPool* pool = &allocator->pools[memoryType][k];
+        for (int i = 0; i < arrlen(pool->arrBlocks); ++i) {
+            stats.largestFreeBytes = u64max(stats.largestFreeBytes, tlsfLargestFree(pool->arrBlocks[i]->tlsf));
+        }
+    }
+    ecs_os_mutex_unlock(allocator->lock);
+    return stats;
+}
+
+void logDeviceAllocatorStats(DeviceAllocator* allocator)
+{
+    ecs_trace("Device memory");
+    ecs_log_push();
+    for (uint32_t t = 0; t < allocator->phys->memProps.memoryTypeCount; ++t) {
+        DeviceMemoryStats s = deviceAllocatorStats(allocator, t);
+        if (s.blockCount == 0 && s.dedicatedCount == 0) {
+            continue;
+        }
+        VkDeviceSize freeBytes = s.blockBytes - s.allocatedBytes;
+        double fragmentation = freeBytes ? 1.0 - (double)s.largestFreeBytes / freeBytes : 0.0;
+        ecs_trace("Type [%u]: [%u] blocks + [%u] dedicated, [%llu] KiB held, "
+                  "[%u] allocations of [%llu] KiB, peak [%llu] KiB, fragmentation [%.2f]",
+            t, s.blockCount, s.dedicatedCount, (unsigned long long)(s.blockBytes >> 10),
+            s.allocationCount, (unsigned long long)(s.allocatedBytes >> 10),
+            (unsigned long long)(s.peakAllocatedBytes >> 10), fragmentation);
+    }
+    ecs_log_pop();
+}
+
+////// Linear pools
+
+LinearPool newLinearPool(DeviceAllocator* allocator, VkDeviceSize size, VkBufferUsageFlags usage)
+{
+    const VkPhysicalDeviceLimits* limits = &allocator->phys->props.limits;
+    VkDeviceSize alignment = 16;
+    if (usage & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT) {
+        alignment = u64max(alignment, limits->minUniformBufferOffsetAlignment);
+    }
+    if (usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT) {
+        alignment = u64max(alignment, limits->minStorageBufferOffsetAlignment);
+    }
+    LinearPool pool = { .alignment = alignment };
+    pool.buffer = newBuffer(allocator, size, usage, MEMORY_USAGE_CPU_TO_GPU, &pool.allocation);
+    return pool;
+}
+
+void* linearPoolAlloc(LinearPool* pool, VkDeviceSize size, VkDeviceSize align, VkDeviceSize* offset)
+{
+    align = u64max(align, pool->alignment);
+    VkDeviceSize begin = (pool->head + align - 1) & ~(align - 1);
+    if (begin + size > pool->allocation.size) {
+        return NULL;
+    }
+    pool->head = begin + size;
+    *offset = begin;
+    return (char*)pool->allocation.mapped + begin;
+}
+
+void resetLinearPool(LinearPool* pool)
+{
+    pool->head = 0;
+}
+
+void cleanupLinearPool(DeviceAllocator* allocator, LinearPool* pool)
+{
+    cleanupBuffer(allocator, pool->buffer, &pool->allocation);
+    *pool = (LinearPool) { 0 };
+}
+
+////// Host memory
+
+/// @brief In front of every aligned host allocation
+typedef struct {
+    void* base;
+    size_t size;
+} _HostHeader;
+
+static void* VKAPI_PTR _hostAlloc(void* userData, size_t size, size_t alignment, VkSystemAllocationScope scope)
+{
+    (void)userData;
+    (void)scope;
+    if (size == 0) {
+        return NULL;
+    }
+    alignment = alignment < ARENA_ALIGN ? ARENA_ALIGN : alignment;
+    // Memory of memAlloc is aligned to 16 bytes, larger alignments need
+    // room to move forward
+    char* base = memAlloc(MEM_VULKAN_HOST, sizeof(_HostHeader) + alignment + size);
+    uintptr_t p = ((uintptr_t)base + sizeof(_HostHeader) + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    _HostHeader* header = (_HostHeader*)p - 1;
+    header->base = base;
+    header->size = size;
+    return (void*)p;
+}
+
+static void VKAPI_PTR _hostFree(void* userData, void* ptr)
+{
+    (void)userData;
+    if (ptr) {
+        memFree(((_HostHeader*)ptr - 1)->base);
+    }
+}
+
+static void* VKAPI_PTR _hostRealloc(void* userData, void* ptr, size_t size, size_t alignment,
+    VkSystemAllocationScope scope)
+{
+    if (!ptr) {
+        return _hostAlloc(userData, size, alignment, scope);
+    }
+    if (size == 0) {
+        _hostFree(userData, ptr);
+        return NULL;
+    }
+    void* moved = _hostAlloc(userData, size, alignment, scope);
+    size_t old = ((_HostHeader*)ptr - 1)->size;
+    memcpy(moved, ptr, old < size ? old : size);
+    _hostFree(userData, ptr);
+    return moved;
+}
+
+static void VKAPI_PTR _hostInternalAlloc(void* userData, size_t size, VkInternalAllocationType type,
+    VkSystemAllocationScope scope)
+{
+    (void)userData;
+    (void)type;
+    (void)scope;
+    memCount(MEM_VULKAN_HOST, (int64_t)size, 1);
+}
+
+static void VKAPI_PTR _hostInternalFree(void* userData, size_t size, VkInternalAllocationType type,
+    VkSystemAllocationScope scope)
+{
+    (void)userData;
+    (void)type;
+    (void)scope;
+    memCount(MEM_VULKAN_HOST, -(int64_t)size, -1);
+}
+
+const VkAllocationCallbacks* hostAllocationCallbacks()
+{
+    static const VkAllocationCallbacks callbacks = {
+        .pfnAllocation = _hostAlloc,
+        .pfnReallocation = _hostRealloc,
+        .pfnFree = _hostFree,
+        .pfnInternalAllocation = _hostInternalAlloc,
+        .pfnInternalFree = _hostInternalFree,
+    };
+    return &callbacks;
+}
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+#include "physical_device.h"
+
+struct RenderDevice;
+typedef struct RenderDevice RenderDevice;
+
+/// @brief Sub-allocates device memory from large blocks, one set of blocks
+/// per memory type. Thread safe
+typedef struct DeviceAllocator DeviceAllocator;
+
+/// @brief Block size unless a heap is too small for it
+#define DEVICE_MEMORY_BLOCK_SIZE (64ull << 20)
+
+/// @brief How memory is accessed, decides the memory type
+typedef enum MemoryUsage {
+    /// @brief Written and read by the GPU only
+    MEMORY_USAGE_GPU_ONLY,
+    /// @brief Written by the CPU every frame or once, read by the GPU.
+    /// Device local when the device has host visible local memory
+    MEMORY_USAGE_CPU_TO_GPU,
+    /// @brief Written by the GPU, read back by the CPU
+    MEMORY_USAGE_GPU_TO_CPU,
+    /// @brief Staging memory
+    MEMORY_USAGE_CPU_ONLY,
+} MemoryUsage;
+
+/// @brief One sub-allocation
+typedef struct DeviceAllocation {
+    VkDeviceMemory memory;
+    VkDeviceSize offset;
+    VkDeviceSize size;
+    /// @brief Persistent mapping of `offset`, NULL unless host visible
+    void* mapped;
+    uint32_t memoryType;
+    /// @brief Owning block, NULL for a dedicated allocation
+    struct _MemoryBlock* _block;
+    struct TlsfBlock* _range;
+} DeviceAllocation;
+
+/// @brief Usage of one memory type
+typedef struct DeviceMemoryStats {
+    uint32_t blockCount;
+    uint32_t allocationCount;
+    uint32_t dedicatedCount;
+    /// @brief Device memory held, including free space in blocks
+    VkDeviceSize blockBytes;
+    /// @brief Device memory handed out
+    VkDeviceSize allocatedBytes;
+    VkDeviceSize peakAllocatedBytes;
+    /// @brief Largest range that can be allocated without a new block.
+    /// Fragmentation is `1 - largestFreeBytes / (blockBytes - allocatedBytes)`
+    VkDeviceSize largestFreeBytes;
+} DeviceMemoryStats;
+
+/// @brief Best memory type for a resource
+/// @param memProps
+/// @param typeBits From `VkMemoryRequirements.memoryTypeBits`
+/// @param usage
+/// @return The index, or -1 if no allowed type fits the usage
+int findMemoryType(const VkPhysicalDeviceMemoryProperties* memProps, uint32_t typeBits, MemoryUsage usage);
+
+/// @brief Create the allocator of a device
+/// @param device
+/// @return The allocator
+DeviceAllocator* newDeviceAllocator(const RenderDevice* device);
+
+/// @brief Free all blocks. Allocations still live are reported as leaks
+/// @param allocator
+void cleanupDeviceAllocator(DeviceAllocator* allocator);
+
+/// @brief Allocate memory for a resource
+/// @param allocator
+/// @param reqs
+/// @param usage
+/// @param linear Whether the resource is a buffer or a linear image. Linear
+/// and optimal resources are kept in separate blocks so that
+/// `bufferImageGranularity` never needs padding
+/// @param out
+/// @return Whether memory was found
+bool deviceAlloc(DeviceAllocator* allocator, VkMemoryRequirements reqs, MemoryUsage usage,
+    bool linear, DeviceAllocation* out);
+
+/// @brief Return an allocation
+/// @param allocator
+/// @param allocation Zeroed on return
+void deviceFree(DeviceAllocator* allocator, DeviceAllocation* allocation);
+
+/// @brief Make CPU writes visible to the GPU, needed unless host coherent
+/// @param allocator
+/// @param allocation
+/// @param offset Relative to the allocation
+/// @param size
+void flushDeviceAllocation(DeviceAllocator* allocator, const DeviceAllocation* allocation,
+    VkDeviceSize offset, VkDeviceSize size);
+
+/// @brief Make GPU writes visible to the CPU, needed unless host coherent.
+/// The GPU writes must be made available to the host by a barrier first
+/// @param allocator
+/// @param allocation
+/// @param offset Relative to the allocation
+/// @param size
+void invalidateDeviceAllocation(DeviceAllocator* allocator, const DeviceAllocation* allocation,
+    VkDeviceSize offset, VkDeviceSize size);
+
+/// @brief Create a buffer with memory bound
+/// @param allocator
+/// @param size
+/// @param usage
+/// @param memUsage
+/// @param allocation Receives the memory of the buffer
+/// @return The buffer
+VkBuffer newBuffer(DeviceAllocator* allocator, VkDeviceSize size, VkBufferUsageFlags usage,
+    MemoryUsage memUsage, DeviceAllocation* allocation);
+
+/// @brief Destroy a buffer and free its memory
+void cleanupBuffer(DeviceAllocator* allocator, VkBuffer buffer, DeviceAllocation* allocation);
+
+/// @brief Create an image with memory bound
+/// @param allocator
+/// @param ci
+/// @param memUsage
+/// @param allocation Receives the memory of the image
+/// @return The image
+VkImage newImage(DeviceAllocator* allocator, const VkImageCreateInfo* ci, MemoryUsage memUsage,
+    DeviceAllocation* allocation);
+
+/// @brief Destroy an image and free its memory
+void cleanupImage(DeviceAllocator* allocator, VkImage image, DeviceAllocation* allocation);
+
+/// @brief Usage of a memory type
+/// @param allocator
+/// @param memoryType
+/// @return A snapshot
+DeviceMemoryStats deviceAllocatorStats(DeviceAllocator* allocator, uint32_t memoryType);
+
+/// @brief Trace usage of every memory type in use
+/// @param allocator
+void logDeviceAllocatorStats(DeviceAllocator* allocator);
+
+////// Linear pools
+
+/// @brief Host visible buffer handed out front to back and reset as a whole,
+/// such as once per frame
+typedef struct LinearPool {
+    VkBuffer buffer;
+    DeviceAllocation allocation;
+    VkDeviceSize head;
+    /// @brief Least alignment of every piece, from the device limits for
+    /// the usage of the buffer
+    VkDeviceSize alignment;
+} LinearPool;
+
+/// @brief Create a mapped linear pool
+/// @param allocator
+/// @param size
+/// @param usage How the GPU reads the buffer
+/// @return The pool
+LinearPool newLinearPool(DeviceAllocator* allocator, VkDeviceSize size, VkBufferUsageFlags usage);
+
+/// @brief Take space from the pool
+/// @param pool
+/// @param size
+/// @param align Power of two
+/// @param offset Receives the offset into `pool->buffer`
+/// @return Mapped pointer to the space, or NULL when the pool is full
+void* linearPoolAlloc(LinearPool* pool, VkDeviceSize size, VkDeviceSize align, VkDeviceSize* offset);
+
+/// @brief Make all space available again. The GPU must be done with it
+/// @param pool
+void resetLinearPool(LinearPool* pool);
+
+/// @brief Destroy the pool
+void cleanupLinearPool(DeviceAllocator* allocator, LinearPool* pool);
+
+////// Host memory
+
+/// @brief Allocation callbacks counting host memory of Vulkan objects under
+/// `MEM_VULKAN_HOST`, passed to every create and destroy call
+/// @return Callbacks that live for the whole program
+const VkAllocationCallbacks* hostAllocationCallbacks();
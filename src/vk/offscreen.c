@@ -0,0 +1,107 @@
+#include "offscreen.h"
+#include "vk.h"
+
+#include "device.h"
+
+OffscreenImage newOffscreenImage(const RenderDevice* device, VkExtent2D extent, uint32_t nReadback)
+{
+    ecs_trace("Creating [%ux%u] OffscreenImage, [%u] readback buffers", extent.width, extent.height, nReadback);
+    ecs_log_push();
+    if (nReadback > MAX_FRAMES_IN_FLIGHT) {
+        ecs_abort(1, "Unsupported number of readback buffers [%u]", nReadback);
+    }
+    OffscreenImage image = {
+        .device = device->handle,
+        .allocator = device->allocator,
+        .extent = extent,
+        .nReadback = nReadback,
+    };
+    VkImageCreateInfo ci = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = OFFSCREEN_FORMAT,
+        .extent = { extent.width, extent.height, 1 },
+        .mipLevels = 1,
+        .arrayLayers = 1,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+    };
+    image.image = newImage(device->allocator, &ci, MEMORY_USAGE_GPU_ONLY, &image.memory);
+    VkImageViewCreateInfo viewCI = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .image = image.image,
+        .viewType = VK_IMAGE_VIEW_TYPE_2D,
+        .format = OFFSCREEN_FORMAT,
+        .subresourceRange = { .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .levelCount = 1, .layerCount = 1 },
+    };
+    vkCheck(vkCreateImageView(device->handle, &viewCI, hostAllocationCallbacks(), &image.view))
+    {
+        ecs_abort(1, "Failed to create offscreen image view");
+    }
+    VkDeviceSize size = (VkDeviceSize)extent.width * extent.height * 4;
+    for (uint32_t f = 0; f < nReadback; ++f) {
+        image.readback[f] = newBuffer(device->allocator, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            MEMORY_USAGE_GPU_TO_CPU, &image.readbackMemory[f]);
+    }
+    ecs_log_pop();
+    return image;
+}
+
+void cleanupOffscreenImage(OffscreenImage* image)
+{
+    ecs_trace("Cleaning up OffscreenImage");
+    for (uint32_t f = 0; f < image->nReadback; ++f) {
+        cleanupBuffer(image->allocator, image->readback[f], &image->readbackMemory[f]);
+    }
+    vkDestroyImageView(image->device, image->view, hostAllocationCallbacks());
+    cleanupImage(image->allocator, image->image, &image->memory);
+    *image = (OffscreenImage) { 0 };
+}
+
+RenderTarget offscreenTarget(const OffscreenImage* image)
+{
+    return (RenderTarget) {
+        .image = image->image,
+        .view = image->view,
+        .extent = image->extent,
+        .format = OFFSCREEN_FORMAT,
+        .finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        .finalStage = VK_PIPELINE_STAGE_TRANSFER_BIT,
+        .finalAccess = VK_ACCESS_TRANSFER_READ_BIT,
+    };
+}
+
+void recordOffscreenReadback(const OffscreenImage* image, const Frame* frame)
+{
+    if (frame->slot >= image->nReadback) {
+        return;
+    }
+    VkBufferImageCopy region = {
+        .imageSubresource = { .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .layerCount = 1 },
+        .imageExtent = { image->extent.width, image->extent.height, 1 },
+    };
+    vkCmdCopyImageToBuffer(frame->cmd, image->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        image->readback[frame->slot], 1, &region);
+    VkMemoryBarrier toHost = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+    };
+    vkCmdPipelineBarrier(frame->cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+        0, 1, &toHost, 0, NULL, 0, NULL);
+}
+
+const uint8_t* readOffscreenImage(OffscreenImage* image, const Frame* frame)
+{
+    if (frame->slot >= image->nReadback) {
+        return NULL;
+    }
+    vkCheck(vkWaitForFences(image->device, 1, &frame->fence, VK_TRUE, UINT64_MAX))
+    {
+        ecs_abort(1, "Failed to wait for frame fence");
+    }
+    const DeviceAllocation* memory = &image->readbackMemory[frame->slot];
+    invalidateDeviceAllocation(image->allocator, memory, 0, (VkDeviceSize)image->extent.width * image->extent.height * 4);
+    return memory->mapped;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+#include "frame.h"
+#include "memory.h"
+
+struct RenderDevice;
+typedef struct RenderDevice RenderDevice;
+
+/// @brief Format of offscreen images, and of their readback
+#define OFFSCREEN_FORMAT VK_FORMAT_R8G8B8A8_UNORM
+
+/// @brief A color image drawn instead of a swapchain image when there is no
+/// window. Frames in flight share it, barriers order their writes. Readback
+/// copies go to one host visible buffer per frame slot
+typedef struct OffscreenImage {
+    VkDevice device;
+    DeviceAllocator* allocator;
+    VkImage image;
+    VkImageView view;
+    DeviceAllocation memory;
+    VkExtent2D extent;
+    /// @brief Tightly packed RGBA rows, `VK_NULL_HANDLE` without readback
+    VkBuffer readback[MAX_FRAMES_IN_FLIGHT];
+    DeviceAllocation readbackMemory[MAX_FRAMES_IN_FLIGHT];
+    uint32_t nReadback;
+} OffscreenImage;
+
+/// @brief Create the image
+/// @param device
+/// @param extent
+/// @param nReadback Frames in flight to read back, or 0 for no readback
+/// @return The image
+OffscreenImage newOffscreenImage(const RenderDevice* device, VkExtent2D extent, uint32_t nReadback);
+
+/// @brief Destroy the image. The device must be done with it
+/// @param image
+void cleanupOffscreenImage(OffscreenImage* image);
+
+/// @brief The image, handed over for a readback copy once drawn
+/// @param image
+/// @return The target
+RenderTarget offscreenTarget(const OffscreenImage* image);
+
+/// @brief Copy the drawn image to the readback buffer of the frame's slot.
+/// Does nothing without readback
+/// @param image
+/// @param frame After the image is drawn
+void recordOffscreenReadback(const OffscreenImage* image, const Frame* frame);
+
+/// @brief Wait for a submitted frame and read what it drew
+/// @param image
+/// @param frame Ended with `recordOffscreenReadback` recorded
+/// @return `extent.width * extent.height` RGBA pixels, row major from the
+/// top left, valid until the frame slot is reused. NULL without readback
+const uint8_t* readOffscreenImage(OffscreenImage* image, const Frame* frame);
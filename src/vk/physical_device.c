@@ -2,6 +2,7 @@
 #include "vk.h"
 
 #include <stb_ds.h>
+#include <utils/arena.h>
 
 /// @brief Name of the `VkPhysicalDeviceType` enum.
 static const char* PHYSICAL_DEVICE_TYPES[] = {
@@ -76,6 +77,21 @@ _getPhysicalDeviceFeatures(VkPhysicalDevice device)
     return features;
 }
 
+static VkPhysicalDeviceVulkan12Features
+_getPhysicalDeviceFeatures12(VkPhysicalDevice device)
+{
+    VkPhysicalDeviceVulkan12Features features12 = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+    };
+    VkPhysicalDeviceFeatures2 features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext = &features12,
+    };
+    vkGetPhysicalDeviceFeatures2(device, &features);
+    features12.pNext = NULL;
+    return features12;
+}
+
 static VkPhysicalDeviceMemoryProperties
 _getPhysicalDeviceMemoryProperties(VkPhysicalDevice device)
 {
@@ -84,16 +100,21 @@ _getPhysicalDeviceMemoryProperties(VkPhysicalDevice device)
     return memory;
 }
 
-bool hasKHRSwapchainExt(const PhysicalDevice* phys)
+bool hasDeviceExt(const PhysicalDevice* phys, const char* name)
 {
     for (int i = 0; i < arrlen(phys->arrExtProps); ++i) {
-        if (strcmp(phys->arrExtProps[i].extensionName, VK_KHR_SWAPCHAIN_EXTENSION_NAME) == 0) {
+        if (strcmp(phys->arrExtProps[i].extensionName, name) == 0) {
             return true;
         }
     }
     return false;
 }
 
+bool hasKHRSwapchainExt(const PhysicalDevice* phys)
+{
+    return hasDeviceExt(phys, VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+}
+
 bool hasGraphicsQueueFamily(const PhysicalDevice* phys)
 {
     const VkQueueFamilyProperties* qfs = phys->arrQueueFamilyProps;
@@ -105,21 +126,143 @@ bool hasGraphicsQueueFamily(const PhysicalDevice* phys)
     return false;
 }
 
-PhysicalDevice* selectPhysicalDevice(PhysicalDevice* arrPhysicalDevices)
+bool canPresent(const PhysicalDevice* phys, uint32_t family, VkSurfaceKHR surface)
 {
-    PhysicalDevice* selected = NULL;
-    ecs_trace("Selecting first appropriate device");
+    VkBool32 supported = VK_FALSE;
+    vkCheck(vkGetPhysicalDeviceSurfaceSupportKHR(phys->handle, family, surface, &supported))
+    {
+        ecs_warn("Failed to query present support of queue family [%u]", family);
+        return false;
+    }
+    return supported;
+}
+
+/// @brief Size of the largest device local heap, in bytes
+static VkDeviceSize _deviceLocalMemory(const PhysicalDevice* phys)
+{
+    VkDeviceSize best = 0;
+    for (uint32_t i = 0; i < phys->memProps.memoryHeapCount; ++i) {
+        VkMemoryHeap heap = phys->memProps.memoryHeaps[i];
+        if ((heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) && heap.size > best) {
+            best = heap.size;
+        }
+    }
+    return best;
+}
+
+/// @brief Whether some queue family has `flags` but none of `without`
+static bool _hasQueueFamily(const PhysicalDevice* phys, VkQueueFlags flags, VkQueueFlags without)
+{
+    for (int i = 0; i < arrlen(phys->arrQueueFamilyProps); ++i) {
+        VkQueueFlags f = phys->arrQueueFamilyProps[i].queueFlags;
+        if ((f & flags) == flags && (f & without) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int64_t scorePhysicalDevice(const PhysicalDevice* phys, const DeviceSelection* selection)
+{
+    // Timeline semaphores and dynamic rendering are core since 1.3
+    if ((!selection->headless && !hasKHRSwapchainExt(phys)) || !hasGraphicsQueueFamily(phys)
+        || phys->props.apiVersion < VK_API_VERSION_1_3) {
+        return -1;
+    }
+    // The graphics queue presents
+    if (selection->surface && getGraphicsQueueFamilyIndex(phys, selection->surface) < 0) {
+        return -1;
+    }
+    // Terrain is drawn with a GPU written draw count, and each draw finds
+    // its chunk slot through its first instance
+    if (!phys->features12.drawIndirectCount || !phys->features.drawIndirectFirstInstance) {
+        return -1;
+    }
+    // Device type dominates: any discrete GPU beats any integrated one, and
+    // a software rasterizer is the last resort
+    static const int64_t typeScore[] = {
+        [VK_PHYSICAL_DEVICE_TYPE_OTHER] = 0,
+        [VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU] = 3,
+        [VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU] = 4,
+        [VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU] = 2,
+        [VK_PHYSICAL_DEVICE_TYPE_CPU] = 1,
+    };
+    int64_t score = 0;
+    if ((uint32_t)phys->props.deviceType < sizeof(typeScore) / sizeof(*typeScore)) {
+        score = typeScore[phys->props.deviceType] << 40;
+    }
+    // Then memory for terrain and models, in MiB
+    score += (int64_t)(_deviceLocalMemory(phys) >> 20) << 8;
+    // Then separate queues for uploads and compute, and texture limits
+    if (_hasQueueFamily(phys, VK_QUEUE_TRANSFER_BIT, VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) {
+        score += 64;
+    }
+    if (_hasQueueFamily(phys, VK_QUEUE_COMPUTE_BIT, VK_QUEUE_GRAPHICS_BIT)) {
+        score += 64;
+    }
+    score += phys->props.limits.maxImageDimension2D / 1024;
+    return score;
+}
+
+PhysicalDevice* selectPhysicalDevice(PhysicalDevice* arrPhysicalDevices, DeviceSelection selection)
+{
+    ecs_trace("Ranking physical devices");
     ecs_log_push();
-    for (int i = 0; i < arrlen(arrPhysicalDevices); ++i) {
-        PhysicalDevice* phys = &arrPhysicalDevices[i];
-        if (hasKHRSwapchainExt(phys) && hasGraphicsQueueFamily(phys)) {
-            ecs_trace("SELECTED VkPhysicalDevice = %#p, [%s]", phys->handle, phys->props.deviceName);
-            selected = phys;
-            break;
+    int n = arrlen(arrPhysicalDevices);
+    if (n == 0) {
+        ecs_warn("No Vulkan devices");
+        ecs_log_pop();
+        return NULL;
+    }
+    int order[n];
+    int64_t scores[n];
+    for (int i = 0; i < n; ++i) {
+        order[i] = i;
+        scores[i] = scorePhysicalDevice(&arrPhysicalDevices[i], &selection);
+    }
+    // Insertion sort, there are only a handful of devices
+    for (int i = 1; i < n; ++i) {
+        for (int j = i; j > 0 && scores[order[j]] > scores[order[j - 1]]; --j) {
+            int t = order[j];
+            order[j] = order[j - 1];
+            order[j - 1] = t;
+        }
+    }
+    for (int r = 0; r < n; ++r) {
+        const PhysicalDevice* phys = &arrPhysicalDevices[order[r]];
+        if (scores[order[r]] < 0) {
+            ecs_trace("UNSUITABLE [%d] %s [%s]", order[r], phys->props.deviceName, physicalDeviceType(phys));
         } else {
-            ecs_trace("IGNORED VkPhysicalDevice = %#p, [%s]", phys->handle, phys->props.deviceName);
+            ecs_trace("#%d [%d] %s [%s], %llu MiB local memory, score %lld",
+                r + 1, order[r], phys->props.deviceName, physicalDeviceType(phys),
+                (unsigned long long)(_deviceLocalMemory(phys) >> 20), (long long)scores[order[r]]);
         }
     }
+
+    PhysicalDevice* selected = NULL;
+    if (selection.index >= 0) {
+        if (selection.index < n && scores[selection.index] >= 0) {
+            selected = &arrPhysicalDevices[selection.index];
+        } else {
+            ecs_warn("Requested device [%d] does not exist or is unsuitable", selection.index);
+        }
+    } else if (selection.name) {
+        for (int r = 0; r < n && !selected; ++r) {
+            PhysicalDevice* phys = &arrPhysicalDevices[order[r]];
+            if (scores[order[r]] >= 0 && strstr(phys->props.deviceName, selection.name)) {
+                selected = phys;
+            }
+        }
+        if (!selected) {
+            ecs_warn("No suitable device matches [%s]", selection.name);
+        }
+    }
+    if (!selected && scores[order[0]] >= 0) {
+        selected = &arrPhysicalDevices[order[0]];
+    }
+    if (selected) {
+        ecs_trace("SELECTED VkPhysicalDevice = %#p, [%s]", selected->handle, selected->props.deviceName);
+    }
     ecs_log_pop();
     return selected;
 }
@@ -132,7 +275,11 @@ PhysicalDevice* getPhysicalDevices(VkInstance instance)
     ecs_log_push();
 
     PhysicalDevice* physicalDevices = NULL;
+    Arena* scratch = scratchArena();
+    ArenaMark mark = arenaMark(scratch);
+    Arena* previous = stbdsUseArena(scratch);
     VkPhysicalDevice* phys = _getPhysicalDevices(instance);
+    stbdsUseArena(previous);
     arrsetlen(physicalDevices, arrlen(phys));
     for (int i = 0; i < arrlen(phys); ++i) {
         VkPhysicalDevice d = phys[i];
@@ -142,14 +289,27 @@ PhysicalDevice* getPhysicalDevices(VkInstance instance)
             .arrExtProps = _getPhysicalDeviceExtensionProperties(d),
             .arrQueueFamilyProps = _getPhysicalDeviceQueueFamiliyProperties(d),
             .features = _getPhysicalDeviceFeatures(d),
+            .features12 = _getPhysicalDeviceFeatures12(d),
             .memProps = _getPhysicalDeviceMemoryProperties(d),
         };
     }
-    arrfree(phys);
+    arenaRelease(scratch, mark);
     ecs_log_pop();
     return physicalDevices;
 }
 
+void cleanupPhysicalDevices(PhysicalDevice* arrPhysicalDevices)
+{
+    for (int i = 0; i < arrlen(arrPhysicalDevices); ++i) {
+        // Read only to everyone else
+        VkExtensionProperties* extProps = (VkExtensionProperties*)arrPhysicalDevices[i].arrExtProps;
+        VkQueueFamilyProperties* queueFamilyProps = (VkQueueFamilyProperties*)arrPhysicalDevices[i].arrQueueFamilyProps;
+        arrfree(extProps);
+        arrfree(queueFamilyProps);
+    }
+    arrfree(arrPhysicalDevices);
+}
+
 VkPhysicalDevice physicalDeviceHandle(const PhysicalDevice* phys)
 {
     return phys->handle;
@@ -185,10 +345,11 @@ const VkPhysicalDeviceMemoryProperties* physicalDeviceMemoryProperties(const Phy
     return &phys->memProps;
 }
 
-int getGraphicsQueueFamilyIndex(const PhysicalDevice* phys)
+int getGraphicsQueueFamilyIndex(const PhysicalDevice* phys, VkSurfaceKHR surface)
 {
     for (int i = 0; i < arrlen(phys->arrQueueFamilyProps); ++i) {
-        if (phys->arrQueueFamilyProps[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+        if ((phys->arrQueueFamilyProps[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)
+            && (!surface || canPresent(phys, i, surface))) {
             ecs_trace("Found graphics queue family index [%d]", i);
             return i;
         }
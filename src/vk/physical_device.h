@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <vulkan/vulkan.h>
 
 typedef struct PhysicalDevice {
@@ -9,15 +10,60 @@ typedef struct PhysicalDevice {
     const VkExtensionProperties* arrExtProps;
     const VkQueueFamilyProperties* arrQueueFamilyProps;
     VkPhysicalDeviceFeatures features;
+    /// @brief `pNext` is cleared
+    VkPhysicalDeviceVulkan12Features features12;
     VkPhysicalDeviceMemoryProperties memProps;
 } PhysicalDevice;
 
+/// @brief Which physical device to use. Without overrides the best scoring
+/// suitable device is used
+typedef struct DeviceSelection {
+    /// @brief Use the first suitable device whose name contains this, or NULL
+    const char* name;
+    /// @brief Use the device at this enumeration index, or -1
+    int index;
+    /// @brief Nothing is presented, so devices without `VK_KHR_swapchain`
+    /// will do and it is not enabled
+    bool headless;
+    /// @brief What is presented to. Devices whose graphics queues cannot
+    /// present to it are unsuitable. `VK_NULL_HANDLE` when headless
+    VkSurfaceKHR surface;
+} DeviceSelection;
+
 PhysicalDevice* getPhysicalDevices(VkInstance instance);
 
+/// @brief Free what `getPhysicalDevices` returned. Devices created from them
+/// must be cleaned up first
+/// @param arrPhysicalDevices
+void cleanupPhysicalDevices(PhysicalDevice* arrPhysicalDevices);
+
 const char*
 physicalDeviceType(const PhysicalDevice* phys);
 
+bool hasDeviceExt(const PhysicalDevice* phys, const char* name);
 bool hasKHRSwapchainExt(const PhysicalDevice* phys);
 bool hasGraphicsQueueFamily(const PhysicalDevice* phys);
-PhysicalDevice* selectPhysicalDevice(PhysicalDevice* arrPhysicalDevices);
-int getGraphicsQueueFamilyIndex(const PhysicalDevice* phys);
+
+/// @brief Whether queues of a family can present to a surface
+/// @param phys
+/// @param family
+/// @param surface
+bool canPresent(const PhysicalDevice* phys, uint32_t family, VkSurfaceKHR surface);
+
+/// @brief Estimate how fast a device is for rendering
+/// @param phys
+/// @param selection Whether and where the device presents
+/// @return Higher is better, negative if the device cannot be used at all
+int64_t scorePhysicalDevice(const PhysicalDevice* phys, const DeviceSelection* selection);
+
+/// @brief Rank suitable devices and pick one, honoring overrides
+/// @param arrPhysicalDevices
+/// @param selection
+/// @return The device, or NULL if none is suitable
+PhysicalDevice* selectPhysicalDevice(PhysicalDevice* arrPhysicalDevices, DeviceSelection selection);
+
+/// @brief First family with graphics queues
+/// @param phys
+/// @param surface The family must present to it, unless `VK_NULL_HANDLE`
+/// @return The family, -1 if there is none
+int getGraphicsQueueFamilyIndex(const PhysicalDevice* phys, VkSurfaceKHR surface);
@@ -1,3 +1,193 @@
 #include "pipeline.h"
 #include "swapchain.h"
 #include "vk.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <utils/memtrack.h>
+
+#include "physical_device.h"
+
+/// @brief Size of `VkPipelineCacheHeaderVersionOne` as laid out in the data
+#define PIPELINE_CACHE_HEADER_SIZE 32
+
+/// @brief Read a whole file
+/// @param path
+/// @param size Size of the returned data
+/// @return Data to be freed by the caller with `memFree`, or NULL
+static void* _readFile(const char* path, size_t* size)
+{
+    FILE* f = fopen(path, "rb");
+    if (!f) {
+        return NULL;
+    }
+    void* data = NULL;
+    long n = -1;
+    if (fseek(f, 0, SEEK_END) == 0) {
+        n = ftell(f);
+    }
+    if (n > 0 && fseek(f, 0, SEEK_SET) == 0) {
+        data = memAlloc(MEM_ASSETS, n);
+        if (fread(data, 1, n, f) != (size_t)n) {
+            memFree(data);
+            data = NULL;
+        }
+    }
+    fclose(f);
+    *size = data ? (size_t)n : 0;
+    return data;
+}
+
+/// @brief Whether cache data was written for this driver and device. Drivers
+/// should reject foreign data themselves, but not all of them do
+static bool _isCompatibleCache(const PhysicalDevice* phys, const uint8_t* data, size_t size)
+{
+    if (size < PIPELINE_CACHE_HEADER_SIZE) {
+        return false;
+    }
+    // Fields are little endian 32 bit words, read them without assuming alignment
+    uint32_t headerSize, headerVersion, vendorID, deviceID;
+    memcpy(&headerSize, data, 4);
+    memcpy(&headerVersion, data + 4, 4);
+    memcpy(&vendorID, data + 8, 4);
+    memcpy(&deviceID, data + 12, 4);
+    if (headerSize < PIPELINE_CACHE_HEADER_SIZE || headerSize > size
+        || headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE) {
+        ecs_trace("Pipeline cache header is malformed");
+        return false;
+    }
+    if (vendorID != phys->props.vendorID || deviceID != phys->props.deviceID) {
+        ecs_trace("Pipeline cache is for device [%#x:%#x], not [%#x:%#x]",
+            vendorID, deviceID, phys->props.vendorID, phys->props.deviceID);
+        return false;
+    }
+    if (memcmp(data + 16, phys->props.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+        ecs_trace("Pipeline cache UUID mismatch, driver changed");
+        return false;
+    }
+    return true;
+}
+
+void* readPipelineCacheFile(const char* path, size_t* size)
+{
+    *size = 0;
+    if (!path) {
+        return NULL;
+    }
+    ecs_trace("Reading pipeline cache [%s]", path);
+    return _readFile(path, size);
+}
+
+VkPipelineCache newPipelineCache(const RenderDevice* device, const char* path)
+{
+    size_t size;
+    void* data = readPipelineCacheFile(path, &size);
+    VkPipelineCache cache = newPipelineCacheFromData(device, data, size);
+    memFree(data);
+    return cache;
+}
+
+VkPipelineCache newPipelineCacheFromData(const RenderDevice* device, const void* data, size_t size)
+{
+    ecs_trace("Creating VkPipelineCache from [%zu] bytes", size);
+    ecs_log_push();
+    if (data && !_isCompatibleCache(device->phys, data, size)) {
+        data = NULL;
+        size = 0;
+    }
+    ecs_trace("Starting with [%zu] bytes of cached pipelines", size);
+    VkPipelineCacheCreateInfo ci = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+        .initialDataSize = size,
+        .pInitialData = data,
+    };
+    VkPipelineCache cache;
+    if (vkCreatePipelineCache(device->handle, &ci, hostAllocationCallbacks(), &cache) != VK_SUCCESS) {
+        // Some drivers fail on data they do not like instead of ignoring it
+        ecs_trace("Rejected cached data, starting empty");
+        ci.initialDataSize = 0;
+        ci.pInitialData = NULL;
+        vkCheck(vkCreatePipelineCache(device->handle, &ci, hostAllocationCallbacks(), &cache))
+        {
+            ecs_abort(1, "Failed to create pipeline cache");
+        }
+    }
+    ecs_trace("VkPipelineCache = %#p", cache);
+    ecs_log_pop();
+    return cache;
+}
+
+void savePipelineCache(const RenderDevice* device, const char* path)
+{
+    ecs_trace("Saving VkPipelineCache to [%s]", path);
+    ecs_log_push();
+    size_t size;
+    vkCheck(vkGetPipelineCacheData(device->handle, device->pipelineCache, &size, NULL))
+    {
+        ecs_abort(1, "Failed to get pipeline cache size");
+    }
+    void* data = memAlloc(MEM_ASSETS, size);
+    vkCheck(vkGetPipelineCacheData(device->handle, device->pipelineCache, &size, data))
+    {
+        ecs_abort(1, "Failed to get pipeline cache data");
+    }
+    // Write next to the old file, then rename over it
+    size_t tmpLen = strlen(path) + 5;
+    char* tmp = memAlloc(MEM_GENERAL, tmpLen);
+    snprintf(tmp, tmpLen, "%s.tmp", path);
+    FILE* f = fopen(tmp, "wb");
+    bool ok = f != NULL;
+    if (ok) {
+        ok = fwrite(data, 1, size, f) == size;
+        ok = fflush(f) == 0 && ok;
+        ok = fsync(fileno(f)) == 0 && ok;
+        ok = fclose(f) == 0 && ok;
+    }
+    if (ok && rename(tmp, path) == 0) {
+        ecs_trace("Saved [%zu] bytes", size);
+    } else {
+        // Losing the cache only costs startup time
+        ecs_warn("Failed to save pipeline cache to [%s]", path);
+        remove(tmp);
+    }
+    memFree(tmp);
+    memFree(data);
+    ecs_log_pop();
+}
+
+VkShaderModule newShaderModule(const RenderDevice* device, const uint32_t* code, size_t size)
+{
+    VkShaderModuleCreateInfo ci = {
+        .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+        .codeSize = size,
+        .pCode = code,
+    };
+    VkShaderModule module;
+    vkCheck(vkCreateShaderModule(device->handle, &ci, hostAllocationCallbacks(), &module))
+    {
+        ecs_abort(1, "Failed to create shader module");
+    }
+    return module;
+}
+
+VkPipeline newGraphicsPipeline(const RenderDevice* device, const VkGraphicsPipelineCreateInfo* ci)
+{
+    VkPipeline pipeline;
+    vkCheck(vkCreateGraphicsPipelines(device->handle, device->pipelineCache, 1, ci, hostAllocationCallbacks(), &pipeline))
+    {
+        ecs_abort(1, "Failed to create graphics pipeline");
+    }
+    return pipeline;
+}
+
+VkPipeline newComputePipeline(const RenderDevice* device, const VkComputePipelineCreateInfo* ci)
+{
+    VkPipeline pipeline;
+    vkCheck(vkCreateComputePipelines(device->handle, device->pipelineCache, 1, ci, hostAllocationCallbacks(), &pipeline))
+    {
+        ecs_abort(1, "Failed to create compute pipeline");
+    }
+    return pipeline;
+}
@@ -1 +1,54 @@
 #pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+struct RenderDevice;
+typedef struct RenderDevice RenderDevice;
+
+/// @brief Create the pipeline cache of a device. It starts from the file at
+/// `path` if that was written by the same driver for the same device
+/// @param device
+/// @param path May be NULL for a cache that lives in memory only
+/// @return The cache
+VkPipelineCache newPipelineCache(const RenderDevice* device, const char* path);
+
+/// @brief Read a pipeline cache file, which needs no device, so that it can
+/// be read while the device is being created
+/// @param path May be NULL
+/// @param size Receives the size of the data
+/// @return Data to be freed by the caller with `memFree`, or NULL
+void* readPipelineCacheFile(const char* path, size_t* size);
+
+/// @brief Create the pipeline cache of a device from data read before
+/// @param device
+/// @param data Used if written by the same driver for the same device, may be NULL
+/// @param size
+/// @return The cache
+VkPipelineCache newPipelineCacheFromData(const RenderDevice* device, const void* data, size_t size);
+
+/// @brief Write the pipeline cache of a device to disk. The file is replaced
+/// atomically, so a crash never leaves half a cache behind
+/// @param device
+/// @param path
+void savePipelineCache(const RenderDevice* device, const char* path);
+
+/// @brief Create a shader module from SPIR-V
+/// @param device
+/// @param code
+/// @param size Size of `code` in bytes
+/// @return The module
+VkShaderModule newShaderModule(const RenderDevice* device, const uint32_t* code, size_t size);
+
+/// @brief Create a graphics pipeline through the pipeline cache of the device
+/// @param device
+/// @param ci
+/// @return The pipeline
+VkPipeline newGraphicsPipeline(const RenderDevice* device, const VkGraphicsPipelineCreateInfo* ci);
+
+/// @brief Create a compute pipeline through the pipeline cache of the device
+/// @param device
+/// @param ci
+/// @return The pipeline
+VkPipeline newComputePipeline(const RenderDevice* device, const VkComputePipelineCreateInfo* ci);
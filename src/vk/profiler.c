@@ -0,0 +1,187 @@
+#include "profiler.h"
+#include "vk.h"
+
+#include <stb_ds.h>
+#include <stdlib.h>
+#include <string.h>
+#include <utils/memtrack.h>
+
+#include "device.h"
+
+/// @brief Scopes written into a slot's queries
+typedef struct {
+    /// @brief Index of each scope's pass
+    uint32_t passes[GPU_PROFILER_MAX_SCOPES];
+    uint32_t count;
+    /// @brief Whether the queries were reset for the frame being recorded
+    bool reset;
+} _SlotScopes;
+
+/// @brief Ring of the last times of a pass
+typedef struct {
+    const char* name;
+    double history[GPU_PROFILER_HISTORY];
+    uint32_t next;
+    uint32_t samples;
+} _GpuPass;
+
+struct GpuProfiler {
+    VkDevice device;
+    uint32_t nFrames;
+    /// @brief Milliseconds per tick
+    double periodMs;
+    /// @brief Bits of a timestamp that count
+    uint64_t validMask;
+    bool supported;
+    bool enabled;
+    VkQueryPool pools[MAX_FRAMES_IN_FLIGHT];
+    _SlotScopes slots[MAX_FRAMES_IN_FLIGHT];
+    _GpuPass* arrPasses;
+};
+
+GpuProfiler* newGpuProfiler(const RenderDevice* device, uint32_t nFrames)
+{
+    ecs_trace("Creating GpuProfiler");
+    GpuProfiler* profiler = memCalloc(MEM_VULKAN_HOST, 1, sizeof(*profiler));
+    profiler->device = device->handle;
+    profiler->nFrames = nFrames;
+    uint32_t validBits = device->phys->arrQueueFamilyProps[device->graphicsFamily].timestampValidBits;
+    profiler->supported = validBits > 0;
+    if (!profiler->supported) {
+        ecs_warn("Graphics queue has no timestamps, GPU passes cannot be timed");
+        return profiler;
+    }
+    profiler->periodMs = device->phys->props.limits.timestampPeriod * 1e-6;
+    profiler->validMask = validBits >= 64 ? UINT64_MAX : (1ull << validBits) - 1;
+    VkQueryPoolCreateInfo ci = {
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .queryType = VK_QUERY_TYPE_TIMESTAMP,
+        .queryCount = 2 * GPU_PROFILER_MAX_SCOPES,
+    };
+    for (uint32_t f = 0; f < nFrames; ++f) {
+        vkCheck(vkCreateQueryPool(device->handle, &ci, hostAllocationCallbacks(), &profiler->pools[f]))
+        {
+            ecs_abort(1, "Failed to create profiler query pool");
+        }
+    }
+    return profiler;
+}
+
+void cleanupGpuProfiler(GpuProfiler* profiler)
+{
+    ecs_trace("Cleaning up GpuProfiler");
+    for (uint32_t f = 0; f < profiler->nFrames; ++f) {
+        if (profiler->pools[f]) {
+            vkDestroyQueryPool(profiler->device, profiler->pools[f], hostAllocationCallbacks());
+        }
+    }
+    arrfree(profiler->arrPasses);
+    memFree(profiler);
+}
+
+void setGpuProfilerEnabled(GpuProfiler* profiler, bool enabled)
+{
+    profiler->enabled = enabled && profiler->supported;
+}
+
+bool isGpuProfilerEnabled(const GpuProfiler* profiler)
+{
+    return profiler->enabled;
+}
+
+static uint32_t _findPass(GpuProfiler* profiler, const char* name)
+{
+    for (int i = 0; i < arrlen(profiler->arrPasses); ++i) {
+        if (profiler->arrPasses[i].name == name || strcmp(profiler->arrPasses[i].name, name) == 0) {
+            return i;
+        }
+    }
+    _GpuPass pass = { .name = name };
+    arrput(profiler->arrPasses, pass);
+    return arrlen(profiler->arrPasses) - 1;
+}
+
+void beginGpuProfilerFrame(GpuProfiler* profiler, VkCommandBuffer cmd, uint32_t slot)
+{
+    _SlotScopes* scopes = &profiler->slots[slot];
+    if (scopes->count > 0) {
+        uint64_t ticks[2 * GPU_PROFILER_MAX_SCOPES];
+        // No wait flag, the slot's fence has signaled
+        VkResult result = vkGetQueryPoolResults(profiler->device, profiler->pools[slot], 0, 2 * scopes->count,
+            sizeof(ticks), ticks, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+        for (uint32_t s = 0; s < scopes->count && result == VK_SUCCESS; ++s) {
+            _GpuPass* pass = &profiler->arrPasses[scopes->passes[s]];
+            uint64_t elapsed = ((ticks[2 * s + 1] - ticks[2 * s]) & profiler->validMask);
+            pass->history[pass->next] = elapsed * profiler->periodMs;
+            pass->next = (pass->next + 1) % GPU_PROFILER_HISTORY;
+            pass->samples += pass->samples < GPU_PROFILER_HISTORY;
+        }
+        scopes->count = 0;
+    }
+    scopes->reset = profiler->enabled;
+    if (scopes->reset) {
+        vkCmdResetQueryPool(cmd, profiler->pools[slot], 0, 2 * GPU_PROFILER_MAX_SCOPES);
+    }
+}
+
+uint32_t beginGpuScope(GpuProfiler* profiler, VkCommandBuffer cmd, uint32_t slot, const char* name)
+{
+    _SlotScopes* scopes = &profiler->slots[slot];
+    // Enabled mid-frame, the queries were not reset
+    if (!profiler->enabled || !scopes->reset || scopes->count == GPU_PROFILER_MAX_SCOPES) {
+        return UINT32_MAX;
+    }
+    uint32_t scope = scopes->count++;
+    scopes->passes[scope] = _findPass(profiler, name);
+    vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, profiler->pools[slot], 2 * scope);
+    return scope;
+}
+
+void endGpuScope(GpuProfiler* profiler, VkCommandBuffer cmd, uint32_t slot, uint32_t scope)
+{
+    if (scope == UINT32_MAX) {
+        return;
+    }
+    vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, profiler->pools[slot], 2 * scope + 1);
+}
+
+static int _compareMs(const void* a, const void* b)
+{
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+uint32_t getGpuPassStats(const GpuProfiler* profiler, GpuPassStats* stats, uint32_t max)
+{
+    uint32_t n = arrlen(profiler->arrPasses);
+    for (uint32_t p = 0; p < n && p < max; ++p) {
+        const _GpuPass* pass = &profiler->arrPasses[p];
+        GpuPassStats s = { .name = pass->name, .samples = pass->samples };
+        if (pass->samples > 0) {
+            double sorted[GPU_PROFILER_HISTORY];
+            double sum = 0;
+            memcpy(sorted, pass->history, pass->samples * sizeof(double));
+            for (uint32_t i = 0; i < pass->samples; ++i) {
+                sum += sorted[i];
+            }
+            qsort(sorted, pass->samples, sizeof(double), _compareMs);
+            s.lastMs = pass->history[(pass->next + GPU_PROFILER_HISTORY - 1) % GPU_PROFILER_HISTORY];
+            s.avgMs = sum / pass->samples;
+            s.p50Ms = sorted[pass->samples * 50 / 100];
+            s.p95Ms = sorted[pass->samples * 95 / 100];
+            s.p99Ms = sorted[pass->samples * 99 / 100];
+        }
+        stats[p] = s;
+    }
+    return n;
+}
+
+void logGpuPassStats(const GpuProfiler* profiler)
+{
+    GpuPassStats stats[GPU_PROFILER_MAX_SCOPES];
+    uint32_t n = getGpuPassStats(profiler, stats, GPU_PROFILER_MAX_SCOPES);
+    for (uint32_t p = 0; p < n && p < GPU_PROFILER_MAX_SCOPES; ++p) {
+        ecs_dbg("GPU pass [%s]: avg %.3f ms, p50 %.3f ms, p95 %.3f ms, p99 %.3f ms over [%u] frames",
+            stats[p].name, stats[p].avgMs, stats[p].p50Ms, stats[p].p95Ms, stats[p].p99Ms, stats[p].samples);
+    }
+}
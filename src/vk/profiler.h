@@ -0,0 +1,94 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+struct RenderDevice;
+typedef struct RenderDevice RenderDevice;
+
+/// @brief Times passes on the GPU with timestamp queries, one query pool
+/// per frame slot. A slot's results are read when the slot is reused, after
+/// its fence, so reading never stalls. Not thread safe, owned by the render
+/// thread
+typedef struct GpuProfiler GpuProfiler;
+
+/// @brief Scopes per frame, later ones are not timed
+#define GPU_PROFILER_MAX_SCOPES 32
+/// @brief Frames of each pass that averages and percentiles are over
+#define GPU_PROFILER_HISTORY 128
+
+/// @brief Rolling GPU times of one pass, in milliseconds
+typedef struct GpuPassStats {
+    const char* name;
+    double lastMs;
+    double avgMs;
+    double p50Ms;
+    double p95Ms;
+    double p99Ms;
+    /// @brief Frames the statistics are over, at most `GPU_PROFILER_HISTORY`
+    uint32_t samples;
+} GpuPassStats;
+
+#ifdef GPU_PROFILING
+/// @brief Time the commands recorded into a frame until `GPU_SCOPE_END`.
+/// At most one scope per block. Compiled out without `GPU_PROFILING`
+#define GPU_SCOPE_BEGIN(frame, name) \
+    uint32_t _gpuScope = beginGpuScope((frame)->profiler, (frame)->cmd, (frame)->slot, name)
+#define GPU_SCOPE_END(frame) endGpuScope((frame)->profiler, (frame)->cmd, (frame)->slot, _gpuScope)
+#else
+#define GPU_SCOPE_BEGIN(frame, name) ((void)0)
+#define GPU_SCOPE_END(frame) ((void)0)
+#endif
+
+/// @brief Create a profiler, disabled. It stays disabled when the graphics
+/// queue has no timestamps
+/// @param device
+/// @param nFrames Frames in flight
+/// @return The profiler
+GpuProfiler* newGpuProfiler(const RenderDevice* device, uint32_t nFrames);
+
+/// @brief Destroy the profiler. The device must be done with its queries
+/// @param profiler
+void cleanupGpuProfiler(GpuProfiler* profiler);
+
+/// @brief Start or stop timing. While stopped, scopes record nothing
+/// @param profiler
+/// @param enabled
+void setGpuProfilerEnabled(GpuProfiler* profiler, bool enabled);
+
+bool isGpuProfilerEnabled(const GpuProfiler* profiler);
+
+/// @brief Collect the times of the slot's last frame, then reset its
+/// queries. Call at the start of the slot's command buffer, once its fence
+/// has signaled
+/// @param profiler
+/// @param cmd
+/// @param slot
+void beginGpuProfilerFrame(GpuProfiler* profiler, VkCommandBuffer cmd, uint32_t slot);
+
+/// @brief Write the timestamp before a pass
+/// @param profiler
+/// @param cmd A primary command buffer of the slot's frame
+/// @param slot
+/// @param name Must outlive the profiler, passes with equal names are one
+/// @return Scope to end, `UINT32_MAX` when not timed
+uint32_t beginGpuScope(GpuProfiler* profiler, VkCommandBuffer cmd, uint32_t slot, const char* name);
+
+/// @brief Write the timestamp after a pass
+/// @param profiler
+/// @param cmd
+/// @param slot
+/// @param scope Returned by `beginGpuScope`
+void endGpuScope(GpuProfiler* profiler, VkCommandBuffer cmd, uint32_t slot, uint32_t scope);
+
+/// @brief Statistics of every pass timed so far
+/// @param profiler
+/// @param stats Receives at most `max` passes
+/// @param max
+/// @return Number of passes, which may exceed `max`
+uint32_t getGpuPassStats(const GpuProfiler* profiler, GpuPassStats* stats, uint32_t max);
+
+/// @brief Log the statistics of every pass at debug level
+/// @param profiler
+void logGpuPassStats(const GpuProfiler* profiler);
@@ -0,0 +1,143 @@
+#include "recorder.h"
+#include "vk.h"
+
+#include <stb_ds.h>
+#include <utils/jobs.h>
+#include <utils/math.h>
+
+#include "device.h"
+
+CommandRecorder newCommandRecorder(const RenderDevice* device, JobPool* jobs, uint32_t nFrames)
+{
+    CommandRecorder recorder = {
+        .device = device->handle,
+        .jobs = jobs,
+        .nFrames = nFrames,
+        .nSlices = i32min((jobPoolThreads(jobs) + 1) * RECORDER_SLICES_PER_THREAD, RECORDER_MAX_SLICES),
+    };
+    ecs_trace("Creating CommandRecorder with [%d] slices", recorder.nSlices);
+    VkCommandPoolCreateInfo ci = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+        .queueFamilyIndex = device->graphicsFamily,
+    };
+    for (uint32_t f = 0; f < nFrames; ++f) {
+        for (int s = 0; s < recorder.nSlices; ++s) {
+            vkCheck(vkCreateCommandPool(device->handle, &ci, hostAllocationCallbacks(), &recorder.slices[f][s].pool))
+            {
+                ecs_abort(1, "Failed to create recorder command pool");
+            }
+        }
+    }
+    return recorder;
+}
+
+void cleanupCommandRecorder(CommandRecorder* recorder)
+{
+    ecs_trace("Cleaning up CommandRecorder");
+    for (uint32_t f = 0; f < recorder->nFrames; ++f) {
+        for (int s = 0; s < recorder->nSlices; ++s) {
+            vkDestroyCommandPool(recorder->device, recorder->slices[f][s].pool, hostAllocationCallbacks());
+            arrfree(recorder->slices[f][s].arrBuffers);
+        }
+    }
+    *recorder = (CommandRecorder) { 0 };
+}
+
+void resetCommandRecorder(CommandRecorder* recorder, uint32_t frameSlot)
+{
+    for (int s = 0; s < recorder->nSlices; ++s) {
+        _RecorderSlice* slice = &recorder->slices[frameSlot][s];
+        vkCheck(vkResetCommandPool(recorder->device, slice->pool, 0))
+        {
+            ecs_abort(1, "Failed to reset recorder command pool");
+        }
+        slice->used = 0;
+    }
+}
+
+/// @brief Next unused buffer of a slice, allocating one if all are used
+static VkCommandBuffer _takeBuffer(VkDevice device, _RecorderSlice* slice)
+{
+    if (slice->used == arrlen(slice->arrBuffers)) {
+        VkCommandBufferAllocateInfo ai = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = slice->pool,
+            .level = VK_COMMAND_BUFFER_LEVEL_SECONDARY,
+            .commandBufferCount = 1,
+        };
+        VkCommandBuffer cmd;
+        vkCheck(vkAllocateCommandBuffers(device, &ai, &cmd))
+        {
+            ecs_abort(1, "Failed to allocate secondary command buffer");
+        }
+        arrput(slice->arrBuffers, cmd);
+    }
+    return slice->arrBuffers[slice->used++];
+}
+
+typedef struct {
+    CommandRecorder* recorder;
+    uint32_t frameSlot;
+    const VkCommandBufferInheritanceRenderingInfo* rendering;
+    int n, nSlices;
+    RecordDrawsFn fn;
+    void* ctx;
+    VkCommandBuffer* buffers;
+} _RecordJob;
+
+static void _recordSlices(void* ctx, int begin, int end)
+{
+    _RecordJob* job = ctx;
+    VkCommandBufferInheritanceInfo inheritance = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+        .pNext = job->rendering,
+    };
+    VkCommandBufferBeginInfo bi = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+        .pInheritanceInfo = &inheritance,
+    };
+    for (int s = begin; s < end; ++s) {
+        VkCommandBuffer cmd = job->buffers[s];
+        vkCheck(vkBeginCommandBuffer(cmd, &bi))
+        {
+            ecs_abort(1, "Failed to begin secondary command buffer");
+        }
+        // Contiguous, near equal ranges of the draw list
+        int first = (int)((int64_t)job->n * s / job->nSlices);
+        int last = (int)((int64_t)job->n * (s + 1) / job->nSlices);
+        job->fn(job->ctx, cmd, first, last);
+        vkCheck(vkEndCommandBuffer(cmd))
+        {
+            ecs_abort(1, "Failed to end secondary command buffer");
+        }
+    }
+}
+
+void recordParallel(CommandRecorder* recorder, uint32_t frameSlot, VkCommandBuffer primary,
+    const VkCommandBufferInheritanceRenderingInfo* rendering, int n, RecordDrawsFn fn, void* ctx)
+{
+    if (n <= 0) {
+        return;
+    }
+    // Small lists are not worth a buffer per slice
+    int nSlices = i32min(recorder->nSlices, (n + 63) / 64);
+    VkCommandBuffer buffers[RECORDER_MAX_SLICES];
+    // Buffers are taken up front on this thread, only recording is parallel
+    for (int s = 0; s < nSlices; ++s) {
+        buffers[s] = _takeBuffer(recorder->device, &recorder->slices[frameSlot][s]);
+    }
+    _RecordJob job = {
+        .recorder = recorder,
+        .frameSlot = frameSlot,
+        .rendering = rendering,
+        .n = n,
+        .nSlices = nSlices,
+        .fn = fn,
+        .ctx = ctx,
+        .buffers = buffers,
+    };
+    jobPoolParallelFor(recorder->jobs, nSlices, _recordSlices, &job);
+    vkCmdExecuteCommands(primary, nSlices, buffers);
+}
\ No newline at end of file
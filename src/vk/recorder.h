@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+#include "frame.h"
+
+struct RenderDevice;
+typedef struct RenderDevice RenderDevice;
+struct JobPool;
+typedef struct JobPool JobPool;
+
+/// @brief Upper bound on secondary command buffers per recording
+#define RECORDER_MAX_SLICES 64
+/// @brief Slices per thread, more than one evens out slices of uneven cost
+#define RECORDER_SLICES_PER_THREAD 2
+
+/// @brief Record draws [begin, end) of a draw list sorted by material.
+/// Called on several threads at once for disjoint ranges. Nothing is
+/// inherited from other slices, so each call binds the pipeline and
+/// dynamic state of its first draw
+typedef void (*RecordDrawsFn)(void* ctx, VkCommandBuffer cmd, int begin, int end);
+
+/// @brief A slice's command buffers in one frame slot. Pools are externally
+/// synchronized, so each slice has its own and is recorded by one thread
+/// at a time
+typedef struct {
+    VkCommandPool pool;
+    VkCommandBuffer* arrBuffers;
+    /// @brief Buffers handed out since the slot was reset
+    int used;
+} _RecorderSlice;
+
+/// @brief Records a draw list into secondary command buffers on the job
+/// pool and executes them from a primary buffer in list order
+typedef struct CommandRecorder {
+    VkDevice device;
+    JobPool* jobs;
+    uint32_t nFrames;
+    int nSlices;
+    _RecorderSlice slices[MAX_FRAMES_IN_FLIGHT][RECORDER_MAX_SLICES];
+} CommandRecorder;
+
+/// @brief Create the recorder with one command pool per slice per frame slot
+/// @param device
+/// @param jobs Threads that record, together with the caller
+/// @param nFrames Frames in flight
+/// @return The recorder
+CommandRecorder newCommandRecorder(const RenderDevice* device, JobPool* jobs, uint32_t nFrames);
+
+/// @brief Destroy the pools. The device must be done with the buffers
+/// @param recorder
+void cleanupCommandRecorder(CommandRecorder* recorder);
+
+/// @brief Reset the pools of a frame slot, once its fence has signaled
+/// @param recorder
+/// @param frameSlot
+void resetCommandRecorder(CommandRecorder* recorder, uint32_t frameSlot);
+
+/// @brief Record `n` draws in parallel and execute them in `primary`, in
+/// order, so the result does not depend on thread timing
+/// @param recorder
+/// @param frameSlot
+/// @param primary Recording inside `vkCmdBeginRendering` with
+/// `VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT`
+/// @param rendering Attachment formats of that rendering
+/// @param n
+/// @param fn
+/// @param ctx
+void recordParallel(CommandRecorder* recorder, uint32_t frameSlot, VkCommandBuffer primary,
+    const VkCommandBufferInheritanceRenderingInfo* rendering, int n, RecordDrawsFn fn, void* ctx);
\ No newline at end of file
@@ -0,0 +1,17 @@
+#version 450
+
+// Placeholder colors by height until terrain has materials
+
+layout(location = 0) in float inHeight;
+
+layout(location = 0) out vec4 outColor;
+
+void main()
+{
+    vec3 shallow = vec3(0.76, 0.70, 0.50);
+    vec3 grass = vec3(0.30, 0.50, 0.20);
+    vec3 rock = vec3(0.45, 0.42, 0.40);
+    vec3 color = mix(shallow, grass, smoothstep(0.0, 2.0, inHeight));
+    color = mix(color, rock, smoothstep(20.0, 40.0, inHeight));
+    outColor = vec4(color, 1.0);
+}
@@ -0,0 +1,63 @@
+#version 450
+
+// Chunks are drawn from one index buffer of grid meshes over the corners of
+// a chunk's tiles. The vertex index is the corner, the instance the slot of
+// the chunk. Heights are pulled from the chunk's tiles, so chunks have no
+// vertex buffer
+
+const uint CHUNK_SIZE = 16;
+const uint CHUNK_AREA = CHUNK_SIZE * CHUNK_SIZE;
+const uint CHUNK_VERTS = CHUNK_SIZE + 1;
+const uint CHUNK_SKIRT_BASE = CHUNK_VERTS * CHUNK_VERTS;
+const float TILE_SIZE = 1.0;
+
+struct ChunkBounds {
+    // xy is the chunk coordinate times CHUNK_SIZE * TILE_SIZE, z is where
+    // skirts end
+    vec4 min;
+    // w is the nominal height of the chunk
+    vec4 max;
+};
+
+layout(std430, set = 0, binding = 0) readonly buffer Chunks {
+    ChunkBounds chunks[];
+};
+
+// TileHeights of the chunk in each slot, as is
+layout(std430, set = 0, binding = 1) readonly buffer Heights {
+    float heights[];
+};
+
+layout(push_constant) uniform Camera {
+    mat4 viewProj;
+};
+
+layout(location = 0) out float outHeight;
+
+float tileHeight(uint base, uint x, uint y)
+{
+    return heights[base + y * CHUNK_SIZE + x];
+}
+
+void main()
+{
+    uint slot = gl_InstanceIndex;
+    ChunkBounds b = chunks[slot];
+    bool skirt = gl_VertexIndex >= CHUNK_SKIRT_BASE;
+    uint corner = skirt ? gl_VertexIndex - CHUNK_SKIRT_BASE : gl_VertexIndex;
+    uint x = corner % CHUNK_VERTS;
+    uint y = corner / CHUNK_VERTS;
+
+    // A corner is the mean of the tiles of this chunk around it
+    uint base = slot * CHUNK_AREA;
+    uint x0 = max(x, 1) - 1, x1 = min(x, CHUNK_SIZE - 1);
+    uint y0 = max(y, 1) - 1, y1 = min(y, CHUNK_SIZE - 1);
+    float h = (tileHeight(base, x0, y0) + tileHeight(base, x1, y0)
+                  + tileHeight(base, x0, y1) + tileHeight(base, x1, y1))
+        * 0.25;
+    // Skirts are coloured like the edge they hang from
+    outHeight = h;
+
+    vec3 pos = vec3(b.min.xy + vec2(x, y) * TILE_SIZE, skirt ? b.min.z : h);
+    gl_Position = viewProj * vec4(pos, 1.0);
+}
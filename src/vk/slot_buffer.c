@@ -0,0 +1,68 @@
+#include "slot_buffer.h"
+#include "vk.h"
+
+#include <string.h>
+
+#include "device.h"
+#include "staging.h"
+
+SlotBuffer newSlotBuffer(const RenderDevice* device, uint32_t nFrames, uint32_t capacity,
+    VkDeviceSize slotSize, MemTag tag)
+{
+    SlotBuffer buffer = {
+        .allocator = device->allocator,
+        .staging = device->staging,
+        .slotSize = slotSize,
+        .capacity = capacity,
+        .nFrames = nFrames,
+        .data = memCalloc(tag, capacity, slotSize),
+    };
+    uint32_t nWords = (capacity + 63) / 64;
+    for (uint32_t f = 0; f < nFrames; ++f) {
+        buffer.buffers[f] = newBuffer(device->allocator, capacity * slotSize,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            MEMORY_USAGE_GPU_ONLY, &buffer.memory[f]);
+        buffer.dirty[f] = memCalloc(tag, nWords, sizeof(uint64_t));
+    }
+    return buffer;
+}
+
+void cleanupSlotBuffer(SlotBuffer* buffer)
+{
+    for (uint32_t f = 0; f < buffer->nFrames; ++f) {
+        cleanupBuffer(buffer->allocator, buffer->buffers[f], &buffer->memory[f]);
+        memFree(buffer->dirty[f]);
+    }
+    memFree(buffer->data);
+    *buffer = (SlotBuffer) { 0 };
+}
+
+void writeSlot(SlotBuffer* buffer, uint32_t slot, const void* data)
+{
+    memcpy(buffer->data + slot * buffer->slotSize, data, buffer->slotSize);
+    for (uint32_t f = 0; f < buffer->nFrames; ++f) {
+        buffer->dirty[f][slot / 64] |= 1ull << (slot % 64);
+    }
+}
+
+void uploadSlots(SlotBuffer* buffer, uint32_t frameSlot)
+{
+    uint64_t* dirty = buffer->dirty[frameSlot];
+    uint32_t slot = 0;
+    while (slot < buffer->capacity) {
+        uint64_t word = dirty[slot / 64] >> (slot % 64);
+        if (!word) {
+            slot = (slot / 64 + 1) * 64;
+            continue;
+        }
+        slot += __builtin_ctzll(word);
+        uint32_t end = slot;
+        while (end < buffer->capacity && dirty[end / 64] & (1ull << (end % 64))) {
+            dirty[end / 64] &= ~(1ull << (end % 64));
+            end++;
+        }
+        stagingUpload(buffer->staging, buffer->buffers[frameSlot], slot * buffer->slotSize,
+            buffer->data + slot * buffer->slotSize, (end - slot) * buffer->slotSize);
+        slot = end;
+    }
+}
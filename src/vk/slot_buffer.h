@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdint.h>
+#include <utils/memtrack.h>
+#include <vulkan/vulkan.h>
+
+#include "frame.h"
+#include "memory.h"
+
+struct RenderDevice;
+typedef struct RenderDevice RenderDevice;
+struct StagingRing;
+typedef struct StagingRing StagingRing;
+
+/// @brief Storage buffer of fixed size slots with one copy per frame slot.
+/// Slots are written on the CPU and copied to a frame slot's buffer when
+/// that frame is recorded, so no buffer is written while the GPU may read it
+typedef struct SlotBuffer {
+    DeviceAllocator* allocator;
+    StagingRing* staging;
+    VkDeviceSize slotSize;
+    uint32_t capacity;
+    uint32_t nFrames;
+    VkBuffer buffers[MAX_FRAMES_IN_FLIGHT];
+    DeviceAllocation memory[MAX_FRAMES_IN_FLIGHT];
+    /// @brief Every slot as last written
+    uint8_t* data;
+    /// @brief Per frame slot, one bit per slot written since the frame
+    /// slot's buffer was last uploaded
+    uint64_t* dirty[MAX_FRAMES_IN_FLIGHT];
+} SlotBuffer;
+
+/// @brief Create the buffers
+/// @param device
+/// @param nFrames Frames in flight
+/// @param capacity Number of slots
+/// @param slotSize In bytes
+/// @param tag Of the CPU copy
+/// @return The buffer
+SlotBuffer newSlotBuffer(const RenderDevice* device, uint32_t nFrames, uint32_t capacity,
+    VkDeviceSize slotSize, MemTag tag);
+
+/// @brief Destroy the buffers. The device must be done with them
+/// @param buffer
+void cleanupSlotBuffer(SlotBuffer* buffer);
+
+/// @brief Write a slot, uploaded to each frame slot when it is recorded next
+/// @param buffer
+/// @param slot
+/// @param data `slotSize` bytes
+void writeSlot(SlotBuffer* buffer, uint32_t slot, const void* data);
+
+/// @brief Queue uploads of the slots written since a frame slot's buffer
+/// was last uploaded, one per run of adjacent slots. Call while recording
+/// that frame, then make the frame wait with `acquireFrameUploads`
+/// @param buffer
+/// @param frameSlot
+void uploadSlots(SlotBuffer* buffer, uint32_t frameSlot);
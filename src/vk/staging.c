@@ -0,0 +1,337 @@
+#include "staging.h"
+#include "vk.h"
+
+#include <stb_ds.h>
+#include <stdlib.h>
+#include <string.h>
+#include <utils/math.h>
+#include <utils/memtrack.h>
+
+#include "device.h"
+#include "memory.h"
+
+/// @brief A staging buffer of its own for an upload too large for the ring
+typedef struct {
+    VkBuffer buffer;
+    DeviceAllocation allocation;
+} _OversizedUpload;
+
+/// @brief Uploads submitted together
+typedef struct {
+    VkCommandBuffer cmd;
+    /// @brief Timeline value signaled when the copies are done
+    uint64_t value;
+    /// @brief Ring position up to which space is freed when done
+    uint64_t ringEnd;
+    _OversizedUpload* arrOversized;
+    /// @brief Ownership releases of the copies, recorded at submission.
+    /// The graphics queue acquires with the same barriers
+    VkBufferMemoryBarrier* arrReleases;
+} _StagingBatch;
+
+struct StagingRing {
+    VkDevice device;
+    DeviceAllocator* allocator;
+    VkQueue queue;
+    uint32_t transferFamily;
+    uint32_t graphicsFamily;
+    VkBuffer buffer;
+    DeviceAllocation allocation;
+    VkDeviceSize size;
+    VkDeviceSize alignment;
+    /// @brief Positions only grow, the offset in the buffer is modulo size
+    uint64_t head;
+    uint64_t tail;
+    VkCommandPool pool;
+    VkSemaphore timeline;
+    uint64_t submitted;
+    /// @brief Batch being recorded, or NULL
+    _StagingBatch* recording;
+    /// @brief Submitted batches, oldest first
+    _StagingBatch** arrPending;
+    _StagingBatch** arrIdle;
+    /// @brief Acquires of submitted batches not yet recorded by graphics
+    VkBufferMemoryBarrier* arrAcquires;
+    uint64_t acquireValue;
+};
+
+StagingRing* newStagingRing(const RenderDevice* device, VkDeviceSize size)
+{
+    ecs_trace("Creating StagingRing of [%llu] MiB", (unsigned long long)(size >> 20));
+    StagingRing* ring = memCalloc(MEM_VULKAN_HOST, 1, sizeof(*ring));
+    ring->device = device->handle;
+    ring->allocator = device->allocator;
+    ring->queue = device->transferQueue;
+    ring->transferFamily = device->transferFamily;
+    ring->graphicsFamily = device->graphicsFamily;
+    ring->size = size;
+    const VkPhysicalDeviceLimits* limits = &device->phys->props.limits;
+    ring->alignment = u64max(16, u64max(limits->optimalBufferCopyOffsetAlignment, limits->nonCoherentAtomSize));
+    ring->buffer = newBuffer(device->allocator, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+        MEMORY_USAGE_CPU_ONLY, &ring->allocation);
+
+    VkCommandPoolCreateInfo poolCI = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+        .queueFamilyIndex = device->transferFamily,
+    };
+    vkCheck(vkCreateCommandPool(device->handle, &poolCI, hostAllocationCallbacks(), &ring->pool))
+    {
+        ecs_abort(1, "Failed to create staging command pool");
+    }
+    VkSemaphoreTypeCreateInfo typeCI = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+        .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+        .initialValue = 0,
+    };
+    VkSemaphoreCreateInfo semCI = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        .pNext = &typeCI,
+    };
+    vkCheck(vkCreateSemaphore(device->handle, &semCI, hostAllocationCallbacks(), &ring->timeline))
+    {
+        ecs_abort(1, "Failed to create staging timeline semaphore");
+    }
+    return ring;
+}
+
+static void _releaseOversized(StagingRing* ring, _StagingBatch* batch)
+{
+    for (int i = 0; i < arrlen(batch->arrOversized); ++i) {
+        cleanupBuffer(ring->allocator, batch->arrOversized[i].buffer, &batch->arrOversized[i].allocation);
+    }
+    arrfree(batch->arrOversized);
+}
+
+static void _waitValue(StagingRing* ring, uint64_t value)
+{
+    VkSemaphoreWaitInfo wi = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+        .semaphoreCount = 1,
+        .pSemaphores = &ring->timeline,
+        .pValues = &value,
+    };
+    vkCheck(vkWaitSemaphores(ring->device, &wi, UINT64_MAX))
+    {
+        ecs_abort(1, "Failed to wait for staging uploads");
+    }
+}
+
+/// @brief Free the space and buffers of every finished batch
+static void _reclaim(StagingRing* ring)
+{
+    if (arrlen(ring->arrPending) == 0) {
+        return;
+    }
+    uint64_t completed;
+    vkCheck(vkGetSemaphoreCounterValue(ring->device, ring->timeline, &completed))
+    {
+        ecs_abort(1, "Failed to read staging timeline");
+    }
+    int n = 0;
+    while (n < arrlen(ring->arrPending) && ring->arrPending[n]->value <= completed) {
+        _StagingBatch* batch = ring->arrPending[n++];
+        ring->tail = batch->ringEnd;
+        _releaseOversized(ring, batch);
+        arrput(ring->arrIdle, batch);
+    }
+    arrdeln(ring->arrPending, 0, n);
+}
+
+void cleanupStagingRing(StagingRing* ring)
+{
+    ecs_trace("Cleaning up StagingRing");
+    submitStaging(ring);
+    _waitValue(ring, ring->submitted);
+    _reclaim(ring);
+    for (int i = 0; i < arrlen(ring->arrIdle); ++i) {
+        arrfree(ring->arrIdle[i]->arrOversized);
+        arrfree(ring->arrIdle[i]->arrReleases);
+        memFree(ring->arrIdle[i]);
+    }
+    arrfree(ring->arrIdle);
+    arrfree(ring->arrPending);
+    arrfree(ring->arrAcquires);
+    vkDestroySemaphore(ring->device, ring->timeline, hostAllocationCallbacks());
+    // Frees the command buffers too
+    vkDestroyCommandPool(ring->device, ring->pool, hostAllocationCallbacks());
+    cleanupBuffer(ring->allocator, ring->buffer, &ring->allocation);
+    memFree(ring);
+}
+
+/// @brief The batch being recorded, starting one if needed
+static _StagingBatch* _recordingBatch(StagingRing* ring)
+{
+    if (ring->recording) {
+        return ring->recording;
+    }
+    _StagingBatch* batch;
+    if (arrlen(ring->arrIdle) > 0) {
+        batch = arrpop(ring->arrIdle);
+        vkCheck(vkResetCommandBuffer(batch->cmd, 0))
+        {
+            ecs_abort(1, "Failed to reset staging command buffer");
+        }
+    } else {
+        batch = memCalloc(MEM_VULKAN_HOST, 1, sizeof(*batch));
+        VkCommandBufferAllocateInfo ai = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = ring->pool,
+            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            .commandBufferCount = 1,
+        };
+        vkCheck(vkAllocateCommandBuffers(ring->device, &ai, &batch->cmd))
+        {
+            ecs_abort(1, "Failed to allocate staging command buffer");
+        }
+    }
+    VkCommandBufferBeginInfo bi = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    vkCheck(vkBeginCommandBuffer(batch->cmd, &bi))
+    {
+        ecs_abort(1, "Failed to begin staging command buffer");
+    }
+    batch->value = ring->submitted + 1;
+    ring->recording = batch;
+    return batch;
+}
+
+uint64_t submitStaging(StagingRing* ring)
+{
+    _StagingBatch* batch = ring->recording;
+    if (!batch) {
+        return ring->submitted;
+    }
+    // Hand the buffers over to the graphics family, which acquires them
+    // with the same barriers
+    if (ring->transferFamily != ring->graphicsFamily && arrlen(batch->arrReleases) > 0) {
+        vkCmdPipelineBarrier(batch->cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+            0, 0, NULL, arrlen(batch->arrReleases), batch->arrReleases, 0, NULL);
+        for (int i = 0; i < arrlen(batch->arrReleases); ++i) {
+            VkBufferMemoryBarrier acquire = batch->arrReleases[i];
+            acquire.srcAccessMask = 0;
+            acquire.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+            arrput(ring->arrAcquires, acquire);
+        }
+    }
+    // Batches are reused, and keep what their lists have grown to
+    arrsetlen(batch->arrReleases, 0);
+    vkCheck(vkEndCommandBuffer(batch->cmd))
+    {
+        ecs_abort(1, "Failed to end staging command buffer");
+    }
+    VkTimelineSemaphoreSubmitInfo timelineSI = {
+        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+        .signalSemaphoreValueCount = 1,
+        .pSignalSemaphoreValues = &batch->value,
+    };
+    VkSubmitInfo si = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext = &timelineSI,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &batch->cmd,
+        .signalSemaphoreCount = 1,
+        .pSignalSemaphores = &ring->timeline,
+    };
+    vkCheck(vkQueueSubmit(ring->queue, 1, &si, VK_NULL_HANDLE))
+    {
+        ecs_abort(1, "Failed to submit staging uploads");
+    }
+    batch->ringEnd = ring->head;
+    ring->submitted = batch->value;
+    ring->acquireValue = batch->value;
+    arrput(ring->arrPending, batch);
+    ring->recording = NULL;
+    return ring->submitted;
+}
+
+/// @brief Take `size` bytes from the ring, waiting for the GPU only if it
+/// still reads every byte of free space
+/// @return Offset in the ring buffer
+static VkDeviceSize _ringAlloc(StagingRing* ring, VkDeviceSize size)
+{
+    for (;;) {
+        uint64_t begin = (ring->head + ring->alignment - 1) & ~(ring->alignment - 1);
+        // Never straddle the end of the buffer
+        if (begin % ring->size + size > ring->size) {
+            begin += ring->size - begin % ring->size;
+        }
+        if (begin + size - ring->tail <= ring->size) {
+            ring->head = begin + size;
+            return begin % ring->size;
+        }
+        _reclaim(ring);
+        if (begin + size - ring->tail <= ring->size) {
+            continue;
+        }
+        // The space may be held by the batch being recorded
+        if (arrlen(ring->arrPending) == 0) {
+            submitStaging(ring);
+        }
+        ecs_trace("Staging ring full, waiting for uploads");
+        _waitValue(ring, ring->arrPending[0]->value);
+    }
+}
+
+uint64_t stagingUpload(StagingRing* ring, VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size)
+{
+    VkBuffer src;
+    VkBufferCopy copy = { .dstOffset = dstOffset, .size = size };
+    if (size > ring->size / 4) {
+        _OversizedUpload upload;
+        upload.buffer = newBuffer(ring->allocator, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            MEMORY_USAGE_CPU_ONLY, &upload.allocation);
+        memcpy(upload.allocation.mapped, data, size);
+        flushDeviceAllocation(ring->allocator, &upload.allocation, 0, size);
+        src = upload.buffer;
+        _StagingBatch* batch = _recordingBatch(ring);
+        arrput(batch->arrOversized, upload);
+    } else {
+        // Allocate before starting a batch, a full ring may submit it
+        copy.srcOffset = _ringAlloc(ring, size);
+        memcpy((char*)ring->allocation.mapped + copy.srcOffset, data, size);
+        flushDeviceAllocation(ring->allocator, &ring->allocation, copy.srcOffset, size);
+        src = ring->buffer;
+    }
+    _StagingBatch* batch = _recordingBatch(ring);
+    vkCmdCopyBuffer(batch->cmd, src, dst, 1, &copy);
+    VkBufferMemoryBarrier release = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .srcQueueFamilyIndex = ring->transferFamily,
+        .dstQueueFamilyIndex = ring->graphicsFamily,
+        .buffer = dst,
+        .offset = dstOffset,
+        .size = size,
+    };
+    arrput(batch->arrReleases, release);
+    return batch->value;
+}
+
+uint64_t recordStagingAcquires(StagingRing* ring, VkCommandBuffer cmd)
+{
+    if (arrlen(ring->arrAcquires) > 0) {
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+            0, 0, NULL, arrlen(ring->arrAcquires), ring->arrAcquires, 0, NULL);
+        arrsetlen(ring->arrAcquires, 0);
+    }
+    uint64_t value = ring->acquireValue;
+    ring->acquireValue = 0;
+    return value;
+}
+
+VkSemaphore stagingTimeline(const StagingRing* ring)
+{
+    return ring->timeline;
+}
+
+bool stagingIsComplete(StagingRing* ring, uint64_t value)
+{
+    _reclaim(ring);
+    if (value > ring->submitted) {
+        return false;
+    }
+    return arrlen(ring->arrPending) == 0 || ring->arrPending[0]->value > value;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+struct RenderDevice;
+typedef struct RenderDevice RenderDevice;
+
+/// @brief Persistently mapped ring of staging memory. Uploads are copied
+/// into it, batched into one command buffer and submitted to the transfer
+/// queue, and their space is reused once the batch's timeline semaphore
+/// value has passed. Not thread safe, owned by the render thread
+typedef struct StagingRing StagingRing;
+
+/// @brief Ring size unless the caller asks otherwise
+#define STAGING_RING_SIZE (32ull << 20)
+
+/// @brief Create a ring
+/// @param device
+/// @param size In bytes
+/// @return The ring
+StagingRing* newStagingRing(const RenderDevice* device, VkDeviceSize size);
+
+/// @brief Wait for submitted uploads, then destroy the ring
+/// @param ring
+void cleanupStagingRing(StagingRing* ring);
+
+/// @brief Queue a copy of `data` into a buffer. Only waits for the GPU when
+/// the ring is full. Uploads larger than a quarter of the ring get a
+/// staging buffer of their own
+/// @param ring
+/// @param dst Must not be read until the returned value is reached
+/// @param dstOffset
+/// @param data
+/// @param size
+/// @return Timeline value after which the data is in `dst`
+uint64_t stagingUpload(StagingRing* ring, VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+
+/// @brief Submit the uploads queued so far, if any
+/// @param ring
+/// @return Timeline value of the last submitted batch
+uint64_t submitStaging(StagingRing* ring);
+
+/// @brief Make submitted uploads usable by the graphics queue. Records the
+/// queue family ownership acquires when transfers run on another family.
+/// The submission of `cmd` must wait on `stagingTimeline` for the returned
+/// value
+/// @param ring
+/// @param cmd A graphics command buffer being recorded
+/// @return The value to wait for, 0 if nothing was uploaded since last call
+uint64_t recordStagingAcquires(StagingRing* ring, VkCommandBuffer cmd);
+
+/// @brief Semaphore signaled with the values returned by uploads
+VkSemaphore stagingTimeline(const StagingRing* ring);
+
+/// @brief Whether the GPU has reached a value. Also reclaims ring space
+/// @param ring
+/// @param value
+bool stagingIsComplete(StagingRing* ring, uint64_t value);
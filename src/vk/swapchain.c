@@ -5,6 +5,7 @@
 
 #include <stb_ds.h>
 #include <utils/math.h>
+#include <utils/trace.h>
 
 static VkSurfaceCapabilitiesKHR
 _getSurfaceCapabilitiesKHR(VkPhysicalDevice phys, VkSurfaceKHR surface)
@@ -113,7 +114,7 @@ _VkImageView(VkDevice device, VkImage image, ImageViewData data)
         },
     };
     VkImageView view;
-    vkCheck(vkCreateImageView(device, &ci, NULL, &view))
+    vkCheck(vkCreateImageView(device, &ci, hostAllocationCallbacks(), &view))
     {
         ecs_abort(1, "Failed to create image view");
     }
@@ -121,7 +122,7 @@ _VkImageView(VkDevice device, VkImage image, ImageViewData data)
 }
 
 static VkImageView*
-_newImageViews(VkDevice device, VkSwapchainKHR swapchain, int format)
+_newImageViews(VkDevice device, VkSwapchainKHR swapchain, int format, VkImage** arrImages)
 {
     uint32_t count;
     VkImage* images = NULL;
@@ -144,12 +145,75 @@ _newImageViews(VkDevice device, VkSwapchainKHR swapchain, int format)
         views[i] = _VkImageView(device, images[i], data);
         ecs_trace("Created VkImageView = %#p", images[i]);
     }
+    *arrImages = images;
     return views;
 }
 
-Swapchain
-newSwapchain(const RenderDevice* renderDevice, VkSurfaceKHR surface,
-    int requestedImages, bool vsync, uint32_t defaultWidth, uint32_t defaultHeight)
+static const char* _presentModeName(VkPresentModeKHR mode)
+{
+    switch (mode) {
+    case VK_PRESENT_MODE_IMMEDIATE_KHR:
+        return "IMMEDIATE";
+    case VK_PRESENT_MODE_MAILBOX_KHR:
+        return "MAILBOX";
+    case VK_PRESENT_MODE_FIFO_KHR:
+        return "FIFO";
+    case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+        return "FIFO_RELAXED";
+    default:
+        return "OTHER";
+    }
+}
+
+/// @brief Lowest latency mode the surface supports. MAILBOX never tears and
+/// never blocks, FIFO_RELAXED tears only when a frame is late. FIFO is
+/// always supported. Without vsync IMMEDIATE comes first
+static VkPresentModeKHR
+_choosePresentMode(VkPhysicalDevice phys, VkSurfaceKHR surface, bool vsync)
+{
+    uint32_t count;
+    vkCheck(vkGetPhysicalDeviceSurfacePresentModesKHR(phys, surface, &count, NULL))
+    {
+        ecs_abort(1, "Failed to get count of present modes");
+    }
+    VkPresentModeKHR modes[count];
+    vkCheck(vkGetPhysicalDeviceSurfacePresentModesKHR(phys, surface, &count, modes))
+    {
+        ecs_abort(1, "Failed to get present modes");
+    }
+    static const VkPresentModeKHR preferred[] = {
+        VK_PRESENT_MODE_IMMEDIATE_KHR,
+        VK_PRESENT_MODE_MAILBOX_KHR,
+        VK_PRESENT_MODE_FIFO_RELAXED_KHR,
+    };
+    for (uint32_t p = vsync ? 1 : 0; p < sizeof(preferred) / sizeof(*preferred); ++p) {
+        for (uint32_t i = 0; i < count; ++i) {
+            if (modes[i] == preferred[p]) {
+                return preferred[p];
+            }
+        }
+    }
+    return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+static VkSemaphore* _newRenderFinishedSemaphores(VkDevice device, int count)
+{
+    VkSemaphore* semaphores = NULL;
+    VkSemaphoreCreateInfo ci = { .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
+    for (int i = 0; i < count; ++i) {
+        VkSemaphore s;
+        vkCheck(vkCreateSemaphore(device, &ci, hostAllocationCallbacks(), &s))
+        {
+            ecs_abort(1, "Failed to create semaphore");
+        }
+        arrput(semaphores, s);
+    }
+    return semaphores;
+}
+
+static Swapchain
+_createSwapchain(const RenderDevice* renderDevice, VkSurfaceKHR surface,
+    int requestedImages, bool vsync, uint32_t defaultWidth, uint32_t defaultHeight, VkSwapchainKHR oldSwapchain)
 {
     const PhysicalDevice* physDev = renderDevice->phys;
     VkPhysicalDevice vkPhysDev = physDev->handle;
@@ -161,6 +225,8 @@ newSwapchain(const RenderDevice* renderDevice, VkSurfaceKHR surface,
     int numImages = _calcNumImages(capabilities, requestedImages);
     SurfaceFormat format = _calcSurfaceFormat(vkPhysDev, surface);
     VkExtent2D extent = _calcSwapchainExtent(capabilities, defaultWidth, defaultHeight);
+    VkPresentModeKHR presentMode = _choosePresentMode(vkPhysDev, surface, vsync);
+    ecs_trace("Present mode [%s], extent [%ux%u]", _presentModeName(presentMode), extent.width, extent.height);
 
     VkSwapchainCreateInfoKHR ci = {
         .sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
@@ -170,31 +236,114 @@ newSwapchain(const RenderDevice* renderDevice, VkSurfaceKHR surface,
         .imageColorSpace = format.colorSpace,
         .imageExtent = extent,
         .imageArrayLayers = 1,
-        .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+        // Transfers allow clearing without a render pass
+        .imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
         .imageSharingMode = VK_SHARING_MODE_EXCLUSIVE,
         .preTransform = capabilities.currentTransform,
         .compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
+        .presentMode = presentMode,
         .clipped = true,
+        // Lets the driver hand over resources and keep presenting images
+        // of the old swapchain that are already queued
+        .oldSwapchain = oldSwapchain,
     };
-    if (vsync) {
-        ci.presentMode = VK_PRESENT_MODE_FIFO_KHR;
-    } else {
-        ci.presentMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
-    }
     VkSwapchainKHR swapchain;
-    vkCheck(vkCreateSwapchainKHR(device, &ci, NULL, &swapchain))
+    vkCheck(vkCreateSwapchainKHR(device, &ci, hostAllocationCallbacks(), &swapchain))
     {
         ecs_abort(1, "Failed to create swapchain");
     }
     ecs_trace("VkSwapchainKHR = %#p", swapchain);
 
-    VkImageView* views = _newImageViews(device, swapchain, format.imageFormat);
+    VkImage* images;
+    VkImageView* views = _newImageViews(device, swapchain, format.imageFormat, &images);
 
     ecs_log_pop();
     return (Swapchain) {
         .handle = swapchain,
         .device = renderDevice,
         .surface = surface,
+        .arrImages = images,
         .arrViews = views,
+        .arrRenderFinished = _newRenderFinishedSemaphores(device, arrlen(images)),
+        .extent = extent,
+        .windowExtent = { defaultWidth, defaultHeight },
+        .imageFormat = format.imageFormat,
+        .presentMode = presentMode,
+        .requestedImages = requestedImages,
+        .vsync = vsync,
+    };
+}
+
+Swapchain
+newSwapchain(const RenderDevice* renderDevice, VkSurfaceKHR surface,
+    int requestedImages, bool vsync, uint32_t defaultWidth, uint32_t defaultHeight)
+{
+    TRACE_ZONE(__func__);
+    return _createSwapchain(renderDevice, surface, requestedImages, vsync, defaultWidth, defaultHeight, VK_NULL_HANDLE);
+}
+
+static void _destroySwapchainResources(VkDevice device, _RetiredSwapchain* r)
+{
+    for (int i = 0; i < arrlen(r->arrViews); ++i) {
+        vkDestroyImageView(device, r->arrViews[i], hostAllocationCallbacks());
+    }
+    for (int i = 0; i < arrlen(r->arrRenderFinished); ++i) {
+        vkDestroySemaphore(device, r->arrRenderFinished[i], hostAllocationCallbacks());
+    }
+    arrfree(r->arrViews);
+    arrfree(r->arrImages);
+    arrfree(r->arrRenderFinished);
+    vkDestroySwapchainKHR(device, r->handle, hostAllocationCallbacks());
+}
+
+void recreateSwapchain(const RenderDevice* renderDevice, Swapchain* swapchain,
+    uint32_t width, uint32_t height, uint64_t frame)
+{
+    TRACE_ZONE(__func__);
+    ecs_trace("Recreating Swapchain at frame [%llu]", (unsigned long long)frame);
+    ecs_log_push();
+    Swapchain next = _createSwapchain(renderDevice, swapchain->surface, swapchain->requestedImages,
+        swapchain->vsync, width, height, swapchain->handle);
+    // Frames in flight may still draw to and present the old images
+    _RetiredSwapchain retired = {
+        .handle = swapchain->handle,
+        .arrImages = swapchain->arrImages,
+        .arrViews = swapchain->arrViews,
+        .arrRenderFinished = swapchain->arrRenderFinished,
+        .frame = frame,
+    };
+    next._arrRetired = swapchain->_arrRetired;
+    arrput(next._arrRetired, retired);
+    *swapchain = next;
+    ecs_log_pop();
+}
+
+void releaseRetiredSwapchains(VkDevice device, Swapchain* swapchain, uint64_t completedFrames)
+{
+    int n = 0;
+    while (n < arrlen(swapchain->_arrRetired) && swapchain->_arrRetired[n].frame <= completedFrames) {
+        ecs_trace("Destroying retired VkSwapchainKHR = %#p", swapchain->_arrRetired[n].handle);
+        _destroySwapchainResources(device, &swapchain->_arrRetired[n++]);
+    }
+    if (n > 0) {
+        arrdeln(swapchain->_arrRetired, 0, n);
+    }
+}
+
+void cleanupSwapchain(VkDevice device, Swapchain* swapchain)
+{
+    ecs_trace("Cleaning up Swapchain");
+    releaseRetiredSwapchains(device, swapchain, UINT64_MAX);
+    arrfree(swapchain->_arrRetired);
+    _RetiredSwapchain current = {
+        .handle = swapchain->handle,
+        .arrImages = swapchain->arrImages,
+        .arrViews = swapchain->arrViews,
+        .arrRenderFinished = swapchain->arrRenderFinished,
     };
+    _destroySwapchainResources(device, &current);
+    swapchain->handle = VK_NULL_HANDLE;
+    swapchain->arrImages = NULL;
+    swapchain->arrViews = NULL;
+    swapchain->arrRenderFinished = NULL;
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <stdbool.h>
 #include <vulkan/vulkan.h>
 
 #include "device.h"
@@ -9,9 +10,66 @@ typedef struct SurfaceFormat {
     int colorSpace;
 } SurfaceFormat;
 
+/// @brief A swapchain replaced by a new one, destroyed once the frames that
+/// used it are done
+typedef struct _RetiredSwapchain {
+    VkSwapchainKHR handle;
+    VkImage* arrImages;
+    VkImageView* arrViews;
+    VkSemaphore* arrRenderFinished;
+    /// @brief Frames before this one may use it
+    uint64_t frame;
+} _RetiredSwapchain;
+
 typedef struct Swapchain {
     VkSwapchainKHR handle;
     const RenderDevice* device;
     VkSurfaceKHR surface;
+    VkImage* arrImages;
     VkImageView* arrViews;
-} Swapchain;
\ No newline at end of file
+    /// @brief Signaled when an image is ready to present. One per image, as
+    /// presentation holds on to it until the image is acquired again
+    VkSemaphore* arrRenderFinished;
+    VkExtent2D extent;
+    /// @brief Window size the swapchain was made for, which differs from
+    /// `extent` when the surface decides the extent
+    VkExtent2D windowExtent;
+    int imageFormat;
+    VkPresentModeKHR presentMode;
+    int requestedImages;
+    bool vsync;
+    _RetiredSwapchain* _arrRetired;
+} Swapchain;
+
+/// @brief Create a swapchain and views of its images
+/// @param renderDevice
+/// @param surface
+/// @param requestedImages
+/// @param vsync
+/// @param defaultWidth Used when the surface does not decide the extent
+/// @param defaultHeight
+/// @return The swapchain
+Swapchain newSwapchain(const RenderDevice* renderDevice, VkSurfaceKHR surface,
+    int requestedImages, bool vsync, uint32_t defaultWidth, uint32_t defaultHeight);
+
+/// @brief Replace the swapchain after a resize or `VK_ERROR_OUT_OF_DATE_KHR`,
+/// without waiting for the device. The old one is handed to the driver as
+/// `oldSwapchain` and kept until `releaseRetiredSwapchains` says it is unused
+/// @param renderDevice
+/// @param swapchain
+/// @param width Used when the surface does not decide the extent
+/// @param height
+/// @param frame Index of the next frame to begin
+void recreateSwapchain(const RenderDevice* renderDevice, Swapchain* swapchain,
+    uint32_t width, uint32_t height, uint64_t frame);
+
+/// @brief Destroy retired swapchains no frame uses anymore
+/// @param device
+/// @param swapchain
+/// @param completedFrames Frames before this index are done on the GPU
+void releaseRetiredSwapchains(VkDevice device, Swapchain* swapchain, uint64_t completedFrames);
+
+/// @brief Destroy the views and the swapchain, but not the surface
+/// @param device
+/// @param swapchain
+void cleanupSwapchain(VkDevice device, Swapchain* swapchain);
\ No newline at end of file
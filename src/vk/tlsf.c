@@ -0,0 +1,285 @@
+#include "tlsf.h"
+
+#include <stdlib.h>
+#include <utils/memtrack.h>
+
+/// @brief Sizes are kept in units of `TLSF_GRANULARITY`
+#define TLSF_UNIT_LOG2 4
+/// @brief Each power of two range is split into this many free lists
+#define TLSF_SL_LOG2 5
+#define TLSF_SL_COUNT (1 << TLSF_SL_LOG2)
+#define TLSF_FL_COUNT 64
+
+struct TlsfBlock {
+    uint64_t offset;
+    uint64_t size;
+    bool free;
+    /// @brief Neighbours in address order
+    TlsfBlock* prevPhys;
+    TlsfBlock* nextPhys;
+    /// @brief Neighbours in the free list of the block's size class
+    TlsfBlock* prevFree;
+    TlsfBlock* nextFree;
+};
+
+struct Tlsf {
+    uint64_t size;
+    /// @brief The block at offset 0, which is never merged away
+    TlsfBlock* first;
+    uint64_t flBitmap;
+    uint32_t slBitmap[TLSF_FL_COUNT];
+    TlsfBlock* heads[TLSF_FL_COUNT][TLSF_SL_COUNT];
+    int nAllocated;
+};
+
+static inline int _log2(uint64_t x)
+{
+    return 63 - __builtin_clzll(x);
+}
+
+/// @brief Size class of a size in units. Small sizes get exact lists, larger
+/// ones a power of two range split `TLSF_SL_COUNT` ways
+static inline void _mapping(uint64_t units, int* fl, int* sl)
+{
+    if (units < TLSF_SL_COUNT) {
+        *fl = 0;
+        *sl = (int)units;
+        return;
+    }
+    int l = _log2(units);
+    *fl = l - TLSF_SL_LOG2 + 1;
+    *sl = (int)((units >> (l - TLSF_SL_LOG2)) - TLSF_SL_COUNT);
+}
+
+static void _insertFree(Tlsf* t, TlsfBlock* b)
+{
+    int fl, sl;
+    _mapping(b->size, &fl, &sl);
+    b->free = true;
+    b->prevFree = NULL;
+    b->nextFree = t->heads[fl][sl];
+    if (b->nextFree) {
+        b->nextFree->prevFree = b;
+    }
+    t->heads[fl][sl] = b;
+    t->flBitmap |= 1ull << fl;
+    t->slBitmap[fl] |= 1u << sl;
+}
+
+static void _removeFree(Tlsf* t, TlsfBlock* b)
+{
+    int fl, sl;
+    _mapping(b->size, &fl, &sl);
+    if (b->prevFree) {
+        b->prevFree->nextFree = b->nextFree;
+    } else {
+        t->heads[fl][sl] = b->nextFree;
+    }
+    if (b->nextFree) {
+        b->nextFree->prevFree = b->prevFree;
+    }
+    if (!t->heads[fl][sl]) {
+        t->slBitmap[fl] &= ~(1u << sl);
+        if (!t->slBitmap[fl]) {
+            t->flBitmap &= ~(1ull << fl);
+        }
+    }
+    b->free = false;
+}
+
+/// @brief First free block in class (fl, sl) or any larger one
+static TlsfBlock* _findFree(const Tlsf* t, int fl, int sl)
+{
+    if (fl >= TLSF_FL_COUNT) {
+        return NULL;
+    }
+    uint32_t slMap = t->slBitmap[fl] & (~0u << sl);
+    if (!slMap) {
+        uint64_t flMap = fl + 1 < TLSF_FL_COUNT ? t->flBitmap & (~0ull << (fl + 1)) : 0;
+        if (!flMap) {
+            return NULL;
+        }
+        fl = __builtin_ctzll(flMap);
+        slMap = t->slBitmap[fl];
+    }
+    return t->heads[fl][__builtin_ctz(slMap)];
+}
+
+/// @brief Cut `units` off the front of `b` into a new block after it
+static TlsfBlock* _split(TlsfBlock* b, uint64_t units)
+{
+    TlsfBlock* rest = memAlloc(MEM_VULKAN_HOST, sizeof(*rest));
+    *rest = (TlsfBlock) {
+        .offset = b->offset + units,
+        .size = b->size - units,
+        .prevPhys = b,
+        .nextPhys = b->nextPhys,
+    };
+    if (rest->nextPhys) {
+        rest->nextPhys->prevPhys = rest;
+    }
+    b->nextPhys = rest;
+    b->size = units;
+    return rest;
+}
+
+/// @brief Absorb the next block into `b`
+static void _merge(TlsfBlock* b)
+{
+    TlsfBlock* next = b->nextPhys;
+    b->size += next->size;
+    b->nextPhys = next->nextPhys;
+    if (b->nextPhys) {
+        b->nextPhys->prevPhys = b;
+    }
+    memFree(next);
+}
+
+Tlsf* newTlsf(uint64_t size)
+{
+    Tlsf* t = memCalloc(MEM_VULKAN_HOST, 1, sizeof(*t));
+    t->size = size >> TLSF_UNIT_LOG2;
+    TlsfBlock* b = memCalloc(MEM_VULKAN_HOST, 1, sizeof(*b));
+    b->size = t->size;
+    t->first = b;
+    _insertFree(t, b);
+    return t;
+}
+
+void cleanupTlsf(Tlsf* tlsf)
+{
+    TlsfBlock* b = tlsf->first;
+    while (b) {
+        TlsfBlock* next = b->nextPhys;
+        memFree(b);
+        b = next;
+    }
+    memFree(tlsf);
+}
+
+TlsfBlock* tlsfAlloc(Tlsf* tlsf, uint64_t size, uint64_t align, uint64_t* offset)
+{
+    uint64_t units = (size + TLSF_GRANULARITY - 1) >> TLSF_UNIT_LOG2;
+    uint64_t alignUnits = align > TLSF_GRANULARITY ? align >> TLSF_UNIT_LOG2 : 1;
+    units = units ? units : 1;
+    // Any block of the class found can fit the size and worst case padding
+    uint64_t search = units + alignUnits - 1;
+    if (search >= TLSF_SL_COUNT) {
+        search += (1ull << (_log2(search) - TLSF_SL_LOG2)) - 1;
+    }
+    int fl, sl;
+    _mapping(search, &fl, &sl);
+    TlsfBlock* b = _findFree(tlsf, fl, sl);
+    if (!b) {
+        return NULL;
+    }
+    _removeFree(tlsf, b);
+    uint64_t pad = ((b->offset + alignUnits - 1) & ~(alignUnits - 1)) - b->offset;
+    if (pad) {
+        // Its previous neighbour is in use, else the two would be merged
+        TlsfBlock* used = _split(b, pad);
+        _insertFree(tlsf, b);
+        b = used;
+    }
+    if (b->size > units) {
+        // Same for the next neighbour
+        _insertFree(tlsf, _split(b, units));
+    }
+    tlsf->nAllocated++;
+    *offset = b->offset << TLSF_UNIT_LOG2;
+    return b;
+}
+
+void tlsfFree(Tlsf* tlsf, TlsfBlock* block)
+{
+    tlsf->nAllocated--;
+    if (block->nextPhys && block->nextPhys->free) {
+        _removeFree(tlsf, block->nextPhys);
+        _merge(block);
+    }
+    if (block->prevPhys && block->prevPhys->free) {
+        TlsfBlock* prev = block->prevPhys;
+        _removeFree(tlsf, prev);
+        _merge(prev);
+        block = prev;
+    }
+    _insertFree(tlsf, block);
+}
+
+bool tlsfIsEmpty(const Tlsf* tlsf)
+{
+    return tlsf->nAllocated == 0;
+}
+
+uint64_t tlsfLargestFree(const Tlsf* tlsf)
+{
+    if (!tlsf->flBitmap) {
+        return 0;
+    }
+    int fl = _log2(tlsf->flBitmap);
+    int sl = _log2(tlsf->slBitmap[fl]);
+    uint64_t best = 0;
+    for (const TlsfBlock* b = tlsf->heads[fl][sl]; b; b = b->nextFree) {
+        best = b->size > best ? b->size : best;
+    }
+    return best << TLSF_UNIT_LOG2;
+}
+
+const char* tlsfValidate(const Tlsf* tlsf)
+{
+    uint64_t end = 0;
+    int nFree = 0, nUsed = 0;
+    const TlsfBlock* prev = NULL;
+    for (const TlsfBlock* b = tlsf->first; b; prev = b, b = b->nextPhys) {
+        if (b->prevPhys != prev) {
+            return "broken address order links";
+        }
+        if (b->offset != end || b->size == 0) {
+            return "blocks do not tile the range";
+        }
+        end += b->size;
+        if (!b->free) {
+            nUsed++;
+            continue;
+        }
+        if (prev && prev->free) {
+            return "free neighbours were not merged";
+        }
+        nFree++;
+        int fl, sl;
+        _mapping(b->size, &fl, &sl);
+        const TlsfBlock* f = tlsf->heads[fl][sl];
+        while (f && f != b) {
+            f = f->nextFree;
+        }
+        if (!f) {
+            return "free block missing from its list";
+        }
+    }
+    if (end != tlsf->size) {
+        return "blocks do not cover the range";
+    }
+    if (nUsed != tlsf->nAllocated) {
+        return "allocation count is off";
+    }
+    for (int fl = 0; fl < TLSF_FL_COUNT; ++fl) {
+        if (!!(tlsf->flBitmap & (1ull << fl)) != !!tlsf->slBitmap[fl]) {
+            return "first level bitmap disagrees with the second";
+        }
+        for (int sl = 0; sl < TLSF_SL_COUNT; ++sl) {
+            if (!!(tlsf->slBitmap[fl] & (1u << sl)) != !!tlsf->heads[fl][sl]) {
+                return "second level bitmap disagrees with the lists";
+            }
+            const TlsfBlock* before = NULL;
+            for (const TlsfBlock* f = tlsf->heads[fl][sl]; f; before = f, f = f->nextFree) {
+                int ffl, fsl;
+                _mapping(f->size, &ffl, &fsl);
+                if (!f->free || ffl != fl || fsl != sl || f->prevFree != before) {
+                    return "free list holds a wrong block";
+                }
+                nFree--;
+            }
+        }
+    }
+    return nFree == 0 ? NULL : "free lists hold more blocks than the range";
+}
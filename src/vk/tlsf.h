@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/// @brief Two-level segregated fit allocator of offsets in a range. Knows
+/// nothing about the memory it manages, so it can carve up device memory
+typedef struct Tlsf Tlsf;
+typedef struct TlsfBlock TlsfBlock;
+
+/// @brief Offsets and sizes are multiples of this
+#define TLSF_GRANULARITY 16
+
+/// @brief Manage [0, size)
+/// @param size
+/// @return The allocator
+Tlsf* newTlsf(uint64_t size);
+
+/// @brief Free the bookkeeping. Outstanding allocations become invalid
+/// @param tlsf
+void cleanupTlsf(Tlsf* tlsf);
+
+/// @brief Allocate a range in constant time
+/// @param tlsf
+/// @param size In bytes
+/// @param align Power of two
+/// @param offset Start of the range
+/// @return Handle for `tlsfFree`, or NULL if no free range is large enough
+TlsfBlock* tlsfAlloc(Tlsf* tlsf, uint64_t size, uint64_t align, uint64_t* offset);
+
+/// @brief Return a range and merge it with free neighbours
+/// @param tlsf
+/// @param block
+void tlsfFree(Tlsf* tlsf, TlsfBlock* block);
+
+/// @brief Whether nothing is allocated
+bool tlsfIsEmpty(const Tlsf* tlsf);
+
+/// @brief Size of the largest free range, in bytes
+uint64_t tlsfLargestFree(const Tlsf* tlsf);
+
+/// @brief Check the bookkeeping: blocks tile the range in address order, no
+/// two free blocks are neighbours, and every free block is in the list of
+/// its size class and nowhere else. Slow, for tests
+/// @param tlsf
+/// @return What is broken, or NULL
+const char* tlsfValidate(const Tlsf* tlsf);
@@ -0,0 +1,221 @@
+#include "validation.h"
+#include "vk.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <utils/log.h>
+#include <utils/memtrack.h>
+
+/// @brief Bytes of a message ID name kept
+#define MESSAGE_NAME_SIZE 64
+/// @brief Message IDs counted, a power of two. Messages of IDs beyond are
+/// logged without a limit
+#define MAX_MESSAGE_IDS 256
+
+/// @brief Recent count of one message ID. Claimed once by storing `key`,
+/// then only counted with atomics
+typedef struct {
+    /// @brief The ID plus one, 0 while unclaimed
+    _Atomic int64_t key;
+    /// @brief Set once `name` is written
+    atomic_bool named;
+    /// @brief Second since the sink was created that the counts are of
+    _Atomic uint32_t second;
+    _Atomic uint32_t logged;
+    _Atomic uint32_t suppressed;
+    char name[MESSAGE_NAME_SIZE];
+} _Repeats;
+
+struct ValidationSink {
+    VkDebugUtilsMessengerCreateInfoEXT info;
+    int32_t ignoredIds[VALIDATION_MAX_IGNORED];
+    uint32_t nIgnoredIds;
+    double start;
+    /// @brief Open addressed by message ID, as the callback runs on any
+    /// thread
+    _Repeats repeats[MAX_MESSAGE_IDS];
+};
+
+static double _now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void _copyString(char* dst, const char* src, size_t size)
+{
+    size_t len = src ? strlen(src) : 0;
+    if (len >= size) {
+        // Mark the cut
+        len = size - 1;
+        memcpy(dst + len - 3, "...", 3);
+        memcpy(dst, src, len - 3);
+    } else if (len) {
+        memcpy(dst, src, len);
+    }
+    dst[len] = '\0';
+}
+
+static void _logMessage(VkDebugUtilsMessageSeverityFlagBitsEXT severity, const char* text)
+{
+    int32_t level = 1;
+    switch (severity) {
+    case VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT:
+        level = -3;
+        break;
+    case VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT:
+        level = -2;
+        break;
+    default:
+        // Info and verbose alike
+        break;
+    }
+    logMessage(level, __FILE__, __LINE__, "Validation: ", text);
+}
+
+static void _logSuppressed(_Repeats* repeats, uint32_t suppressed)
+{
+    if (suppressed && atomic_load_explicit(&repeats->named, memory_order_acquire)) {
+        LOG_WARN("Validation: [%u] more of [%s] suppressed", suppressed, repeats->name);
+    }
+}
+
+/// @brief Find or claim the counts of an ID
+/// @return NULL when every entry is taken by other IDs
+static _Repeats* _findRepeats(ValidationSink* sink, int32_t id, const char* name)
+{
+    int64_t key = (int64_t)id + 1;
+    uint32_t slot = ((uint32_t)id * 2654435769u) & (MAX_MESSAGE_IDS - 1);
+    for (uint32_t probe = 0; probe < MAX_MESSAGE_IDS; ++probe) {
+        _Repeats* repeats = &sink->repeats[(slot + probe) & (MAX_MESSAGE_IDS - 1)];
+        int64_t found = atomic_load_explicit(&repeats->key, memory_order_relaxed);
+        if (!found && atomic_compare_exchange_strong(&repeats->key, &found, key)) {
+            _copyString(repeats->name, name, MESSAGE_NAME_SIZE);
+            atomic_store_explicit(&repeats->named, true, memory_order_release);
+            return repeats;
+        }
+        if (found == key) {
+            return repeats;
+        }
+    }
+    return NULL;
+}
+
+/// @brief Count a message of an ID
+/// @return Whether to log it, false once the ID was logged too often this
+/// second
+static bool _countRepeat(ValidationSink* sink, int32_t id, const char* name)
+{
+    _Repeats* repeats = _findRepeats(sink, id, name);
+    if (!repeats) {
+        return true;
+    }
+    uint32_t second = (uint32_t)(_now() - sink->start);
+    uint32_t seen = atomic_load_explicit(&repeats->second, memory_order_relaxed);
+    // One thread starts the new second. Counts of racing threads may land
+    // in either, which only moves a message across the limit
+    if (seen != second
+        && atomic_compare_exchange_strong_explicit(&repeats->second, &seen, second, memory_order_relaxed,
+            memory_order_relaxed)) {
+        atomic_store_explicit(&repeats->logged, 0, memory_order_relaxed);
+        _logSuppressed(repeats, atomic_exchange_explicit(&repeats->suppressed, 0, memory_order_relaxed));
+    }
+    if (atomic_fetch_add_explicit(&repeats->logged, 1, memory_order_relaxed) < VALIDATION_REPEATS_PER_SECOND) {
+        return true;
+    }
+    atomic_fetch_add_explicit(&repeats->suppressed, 1, memory_order_relaxed);
+    return false;
+}
+
+/// @brief Called by the layers on whatever thread made the Vulkan call.
+/// Counting takes no lock, and the message is only copied into the thread's
+/// log ring while async logging runs, errors included
+static VKAPI_ATTR VkBool32 VKAPI_CALL _vkDebugCallback(
+    VkDebugUtilsMessageSeverityFlagBitsEXT messageSeverity,
+    VkDebugUtilsMessageTypeFlagsEXT messageType,
+    const VkDebugUtilsMessengerCallbackDataEXT* pCallbackData,
+    void* pUserData)
+{
+    (void)messageType;
+    ValidationSink* sink = pUserData;
+    for (uint32_t i = 0; i < sink->nIgnoredIds; ++i) {
+        if (sink->ignoredIds[i] == pCallbackData->messageIdNumber) {
+            return VK_FALSE;
+        }
+    }
+    if (_countRepeat(sink, pCallbackData->messageIdNumber, pCallbackData->pMessageIdName)) {
+        _logMessage(messageSeverity, pCallbackData->pMessage);
+    }
+    return VK_FALSE;
+}
+
+ValidationLevel parseValidationLevel(const char* name)
+{
+    static const char* names[] = {
+        [VALIDATION_OFF] = "off",
+        [VALIDATION_ERRORS] = "errors",
+        [VALIDATION_WARNINGS] = "warnings",
+        [VALIDATION_INFO] = "info",
+        [VALIDATION_VERBOSE] = "verbose",
+    };
+    for (int level = VALIDATION_OFF; level <= VALIDATION_VERBOSE; ++level) {
+        if (strcmp(name, names[level]) == 0) {
+            return (ValidationLevel)level;
+        }
+    }
+    return VALIDATION_DEFAULT;
+}
+
+ValidationSink* newValidationSink(const ValidationSettings* settings)
+{
+    ValidationLevel level = settings->level == VALIDATION_DEFAULT ? VALIDATION_DEFAULT_LEVEL : settings->level;
+    if (level == VALIDATION_OFF) {
+        ecs_trace("Validation is off");
+        return NULL;
+    }
+    ecs_trace("Creating ValidationSink at level [%d]", level);
+    ValidationSink* sink = memCalloc(MEM_GENERAL, 1, sizeof(*sink));
+    // The layers skip the callback for severities not subscribed to, which
+    // saves formatting the message in the first place
+    VkDebugUtilsMessageSeverityFlagsEXT severity = VK_DEBUG_UTILS_MESSAGE_SEVERITY_ERROR_BIT_EXT;
+    if (level >= VALIDATION_WARNINGS) {
+        severity |= VK_DEBUG_UTILS_MESSAGE_SEVERITY_WARNING_BIT_EXT;
+    }
+    if (level >= VALIDATION_INFO) {
+        severity |= VK_DEBUG_UTILS_MESSAGE_SEVERITY_INFO_BIT_EXT;
+    }
+    if (level >= VALIDATION_VERBOSE) {
+        severity |= VK_DEBUG_UTILS_MESSAGE_SEVERITY_VERBOSE_BIT_EXT;
+    }
+    sink->info = (VkDebugUtilsMessengerCreateInfoEXT) {
+        .sType = VK_STRUCTURE_TYPE_DEBUG_UTILS_MESSENGER_CREATE_INFO_EXT,
+        .messageSeverity = severity,
+        .messageType = VK_DEBUG_UTILS_MESSAGE_TYPE_GENERAL_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_VALIDATION_BIT_EXT | VK_DEBUG_UTILS_MESSAGE_TYPE_PERFORMANCE_BIT_EXT,
+        .pfnUserCallback = _vkDebugCallback,
+        .pUserData = sink,
+    };
+    sink->nIgnoredIds = settings->nIgnoredIds < VALIDATION_MAX_IGNORED ? settings->nIgnoredIds : VALIDATION_MAX_IGNORED;
+    memcpy(sink->ignoredIds, settings->ignoredIds, sizeof(*sink->ignoredIds) * sink->nIgnoredIds);
+    sink->start = _now();
+    return sink;
+}
+
+void cleanupValidationSink(ValidationSink* sink)
+{
+    if (!sink) {
+        return;
+    }
+    ecs_trace("Cleaning up ValidationSink");
+    for (uint32_t i = 0; i < MAX_MESSAGE_IDS; ++i) {
+        _logSuppressed(&sink->repeats[i], atomic_load(&sink->repeats[i].suppressed));
+    }
+    memFree(sink);
+}
+
+const VkDebugUtilsMessengerCreateInfoEXT* validationMessengerInfo(const ValidationSink* sink)
+{
+    return &sink->info;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+/// @brief Messages of one ID logged per second, the rest are counted
+#define VALIDATION_REPEATS_PER_SECOND 4
+/// @brief Message IDs that can be ignored
+#define VALIDATION_MAX_IGNORED 32
+
+/// @brief How much the validation layers check and report
+typedef enum ValidationLevel {
+    /// @brief `VALIDATION_DEFAULT_LEVEL`, chosen by the `validation` build
+    /// option
+    VALIDATION_DEFAULT = 0,
+    /// @brief No layers, no messenger, no overhead
+    VALIDATION_OFF,
+    VALIDATION_ERRORS,
+    VALIDATION_WARNINGS,
+    VALIDATION_INFO,
+    VALIDATION_VERBOSE,
+} ValidationLevel;
+
+#ifndef VALIDATION_DEFAULT_LEVEL
+#define VALIDATION_DEFAULT_LEVEL VALIDATION_WARNINGS
+#endif
+
+/// @brief Which validation messages are reported
+typedef struct ValidationSettings {
+    ValidationLevel level;
+    /// @brief `messageIdNumber`s to drop in the callback
+    int32_t ignoredIds[VALIDATION_MAX_IGNORED];
+    uint32_t nIgnoredIds;
+} ValidationSettings;
+
+/// @brief Filters validation messages and hands them to the log without
+/// waiting, errors included, so the threads making Vulkan calls only copy
+/// them while async logging runs. Repeats of a message ID beyond
+/// `VALIDATION_REPEATS_PER_SECOND` are counted instead, without locks
+typedef struct ValidationSink ValidationSink;
+
+/// @brief Parse a level name: off, errors, warnings, info or verbose
+/// @param name
+/// @return The level, `VALIDATION_DEFAULT` for an unknown name
+ValidationLevel parseValidationLevel(const char* name);
+
+/// @brief Create the sink. Requires the flecs OS API to be set
+/// @param settings `VALIDATION_DEFAULT` is resolved
+/// @return The sink, NULL when validation is off
+ValidationSink* newValidationSink(const ValidationSettings* settings);
+
+/// @brief Log the repeats suppressed, then free the sink. Call after the
+/// instance is destroyed
+/// @param sink May be NULL
+void cleanupValidationSink(ValidationSink* sink);
+
+/// @brief Messenger create info subscribed to the sink's severities. Chain
+/// it into the instance create info to hear about instance creation too
+/// @param sink
+/// @return Owned by the sink
+const VkDebugUtilsMessengerCreateInfoEXT* validationMessengerInfo(const ValidationSink* sink);
@@ -2,36 +2,106 @@
 
 #include <stb_ds.h>
 #include <stdlib.h>
+#include <string.h>
+#include <utils/memtrack.h>
+#include <utils/trace.h>
 #include <vulkan/vulkan.h>
 
 #include "device.h"
 #include "instance.h"
+#include "memory.h"
 #include "physical_device.h"
 #include "pipeline.h"
+#include "staging.h"
 #include "swapchain.h"
+#include "validation.h"
 
 ECS_COMPONENT_DECLARE(VulkanSystem);
+ECS_COMPONENT_DECLARE(Swapchain);
+ECS_COMPONENT_DECLARE(FrameManager);
+ECS_COMPONENT_DECLARE(OffscreenImage);
 
 void registerVulkan(ecs_world_t* ecs)
 {
     ECS_COMPONENT_DEFINE(ecs, VulkanSystem);
+    ECS_COMPONENT_DEFINE(ecs, Swapchain);
+    ECS_COMPONENT_DEFINE(ecs, FrameManager);
+    ECS_COMPONENT_DEFINE(ecs, OffscreenImage);
 }
 
-VulkanSystem newVulkanSystem(const char** exts, uint32_t n_exts)
+VulkanSystem newVulkanSystem(const char** exts, uint32_t n_exts, const VulkanSettings* settings)
 {
+    TRACE_ZONE(__func__);
+    VulkanSystem system = newVulkanInstance(exts, n_exts, settings);
+    newVulkanDevice(&system, settings);
+    return system;
+}
+
+VulkanSystem newVulkanInstance(const char** exts, uint32_t n_exts, const VulkanSettings* settings)
+{
+    TRACE_ZONE(__func__);
     ecs_trace("Creating Vulkan Instance");
     ecs_log_push();
+    ValidationSink* validation = newValidationSink(&settings->validation);
+    const VkDebugUtilsMessengerCreateInfoEXT* debug = validation ? validationMessengerInfo(validation) : NULL;
     // Create VkInstance, adding compatibility extension
-    VkInstance instance = newVkInstance(exts, n_exts);
+    VkInstance instance = newVkInstance(exts, n_exts, debug);
     // Setup messenger
-    VkDebugUtilsMessengerEXT messenger = newVkDebugUtilsMessengerEXT(instance);
+    VkDebugUtilsMessengerEXT messenger = debug ? newVkDebugUtilsMessengerEXT(instance, debug) : VK_NULL_HANDLE;
     PhysicalDevice* phys = getPhysicalDevices(instance);
-    RenderDevice device = newRenderDevice(phys);
     ecs_log_pop();
     return (VulkanSystem) {
         .instance = instance,
+        .validation = validation,
         .messenger = messenger,
         .arrPhysicalDevices = phys,
-        .renderDevice = device,
     };
 }
+
+void newVulkanDevice(VulkanSystem* system, const VulkanSettings* settings)
+{
+    TRACE_ZONE(__func__);
+    ecs_trace("Creating Vulkan device");
+    ecs_log_push();
+    RenderDevice device = newRenderDevice(system->arrPhysicalDevices, settings->device);
+    if (settings->pipelineCacheData) {
+        device.pipelineCache = newPipelineCacheFromData(&device, settings->pipelineCacheData, settings->pipelineCacheSize);
+    } else {
+        device.pipelineCache = newPipelineCache(&device, settings->pipelineCachePath);
+    }
+    device.allocator = newDeviceAllocator(&device);
+    device.staging = newStagingRing(&device, settings->stagingSize ? settings->stagingSize : STAGING_RING_SIZE);
+    system->renderDevice = device;
+    system->pipelineCachePath = NULL;
+    if (settings->pipelineCachePath) {
+        size_t len = strlen(settings->pipelineCachePath) + 1;
+        system->pipelineCachePath = memAlloc(MEM_GENERAL, len);
+        memcpy(system->pipelineCachePath, settings->pipelineCachePath, len);
+    }
+    ecs_log_pop();
+}
+
+void cleanupVulkanSystem(VulkanSystem* system)
+{
+    ecs_trace("Cleaning up Vulkan");
+    ecs_log_push();
+    if (system->pipelineCachePath) {
+        savePipelineCache(&system->renderDevice, system->pipelineCachePath);
+    }
+    cleanupRenderDevice(&system->renderDevice);
+    cleanupPhysicalDevices(system->arrPhysicalDevices);
+    system->arrPhysicalDevices = NULL;
+    if (system->messenger) {
+        PFN_vkDestroyDebugUtilsMessengerEXT destroy = (PFN_vkDestroyDebugUtilsMessengerEXT)
+            vkGetInstanceProcAddr(system->instance, "vkDestroyDebugUtilsMessengerEXT");
+        if (destroy) {
+            destroy(system->instance, system->messenger, hostAllocationCallbacks());
+        }
+    }
+    vkDestroyInstance(system->instance, hostAllocationCallbacks());
+    cleanupValidationSink(system->validation);
+    system->validation = NULL;
+    memFree(system->pipelineCachePath);
+    system->pipelineCachePath = NULL;
+    ecs_log_pop();
+}
@@ -4,10 +4,17 @@
 #include <vulkan/vulkan.h>
 
 #include "device.h"
+#include "frame.h"
 #include "instance.h"
+#include "memory.h"
+#include "offscreen.h"
 #include "physical_device.h"
 #include "pipeline.h"
+#include "profiler.h"
+#include "recorder.h"
+#include "staging.h"
 #include "swapchain.h"
+#include "validation.h"
 
 #define vkCheck(stmt) if ((stmt) != VK_SUCCESS)
 
@@ -16,15 +23,55 @@ typedef struct PhysicalDevice PhysicalDevice;
 struct RenderDevice;
 typedef struct RenderDevice RenderDevice;
 
+/// @brief Options for creating the Vulkan system
+typedef struct VulkanSettings {
+    /// @brief File to keep compiled pipelines in between runs, or NULL
+    const char* pipelineCachePath;
+    /// @brief Contents of `pipelineCachePath` if read ahead with
+    /// `readPipelineCacheFile`, or NULL to read them when needed
+    const void* pipelineCacheData;
+    size_t pipelineCacheSize;
+    DeviceSelection device;
+    /// @brief Size of the staging ring, 0 for `STAGING_RING_SIZE`
+    VkDeviceSize stagingSize;
+    ValidationSettings validation;
+} VulkanSettings;
+
 typedef struct VulkanSystem {
     VkInstance instance;
+    /// @brief NULL with the messenger when validation is off
+    ValidationSink* validation;
     VkDebugUtilsMessengerEXT messenger;
     PhysicalDevice* arrPhysicalDevices;
     RenderDevice renderDevice;
+    /// @brief Owned copy of `VulkanSettings.pipelineCachePath`
+    char* pipelineCachePath;
 } VulkanSystem;
 
 extern ECS_COMPONENT_DECLARE(VulkanSystem);
+extern ECS_COMPONENT_DECLARE(Swapchain);
+extern ECS_COMPONENT_DECLARE(FrameManager);
+extern ECS_COMPONENT_DECLARE(OffscreenImage);
 
 void registerVulkan(ecs_world_t* ecs);
 
-VulkanSystem newVulkanSystem(const char** exts, uint32_t n_exts);
+VulkanSystem newVulkanSystem(const char** exts, uint32_t n_exts, const VulkanSettings* settings);
+
+/// @brief First half of `newVulkanSystem`: the instance, validation and the
+/// physical devices. Needs no window, only its instance extensions
+/// @param exts
+/// @param n_exts
+/// @param settings
+/// @return The system without a render device
+VulkanSystem newVulkanInstance(const char** exts, uint32_t n_exts, const VulkanSettings* settings);
+
+/// @brief Second half of `newVulkanSystem`: the render device with its
+/// pipeline cache, allocator and staging ring
+/// @param system From `newVulkanInstance`
+/// @param settings
+void newVulkanDevice(VulkanSystem* system, const VulkanSettings* settings);
+
+/// @brief Save the pipeline cache, then destroy the device and the instance.
+/// The device must be idle
+/// @param system
+void cleanupVulkanSystem(VulkanSystem* system);
@@ -1,2 +1,6 @@
+#include <utils/arena.h>
+
+#define STBDS_REALLOC(c, p, s) stbdsRealloc(c, p, s)
+#define STBDS_FREE(c, p) stbdsFree(c, p)
 #define STB_DS_IMPLEMENTATION
-#include "stb_ds.h"
\ No newline at end of file
+#include "stb_ds.h"